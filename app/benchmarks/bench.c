@@ -0,0 +1,173 @@
+#include "bench.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/tick.h"
+
+#define SC_BENCH_MIN_TIME SC_TICK_FROM_MS(200)
+#define SC_BENCH_MAX_ITERATIONS (UINT64_C(1) << 32)
+
+static const char *sc_bench_filter;
+
+#ifdef __GLIBC__
+# define SC_BENCH_COUNT_ALLOCS
+
+// Interpose the allocation functions (for this program and all the shared
+// libraries it uses) to count the allocations
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+static atomic_uint_least64_t sc_bench_allocs;
+static atomic_uint_least64_t sc_bench_alloc_bytes;
+
+static inline void
+sc_bench_count(size_t size) {
+    atomic_fetch_add_explicit(&sc_bench_allocs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&sc_bench_alloc_bytes, size,
+                              memory_order_relaxed);
+}
+
+void *
+malloc(size_t size) {
+    sc_bench_count(size);
+    return __libc_malloc(size);
+}
+
+void *
+calloc(size_t nmemb, size_t size) {
+    sc_bench_count(nmemb * size);
+    return __libc_calloc(nmemb, size);
+}
+
+void *
+realloc(void *ptr, size_t size) {
+    sc_bench_count(size);
+    return __libc_realloc(ptr, size);
+}
+
+void
+free(void *ptr) {
+    __libc_free(ptr);
+}
+
+int
+posix_memalign(void **memptr, size_t alignment, size_t size) {
+    sc_bench_count(size);
+    void *ptr = __libc_memalign(alignment, size);
+    if (!ptr) {
+        return ENOMEM;
+    }
+    *memptr = ptr;
+    return 0;
+}
+
+void *
+aligned_alloc(size_t alignment, size_t size) {
+    sc_bench_count(size);
+    return __libc_memalign(alignment, size);
+}
+
+void *
+memalign(size_t alignment, size_t size) {
+    sc_bench_count(size);
+    return __libc_memalign(alignment, size);
+}
+#endif
+
+void
+sc_bench_init(int argc, char *argv[]) {
+    sc_bench_filter = argc > 1 ? argv[1] : NULL;
+}
+
+void
+sc_bench_use(const void *p) {
+    // An empty asm statement with a memory clobber is an optimization barrier
+    __asm__ volatile("" : : "r"(p) : "memory");
+}
+
+static sc_tick
+sc_bench_measure(sc_bench_fn *fn, void *userdata, uint64_t n,
+                 uint64_t *allocs, uint64_t *alloc_bytes) {
+#ifdef SC_BENCH_COUNT_ALLOCS
+    uint64_t allocs_start = atomic_load(&sc_bench_allocs);
+    uint64_t bytes_start = atomic_load(&sc_bench_alloc_bytes);
+#endif
+
+    sc_tick start = sc_tick_now();
+    fn(userdata, n);
+    sc_tick elapsed = sc_tick_now() - start;
+
+#ifdef SC_BENCH_COUNT_ALLOCS
+    *allocs = atomic_load(&sc_bench_allocs) - allocs_start;
+    *alloc_bytes = atomic_load(&sc_bench_alloc_bytes) - bytes_start;
+#else
+    *allocs = 0;
+    *alloc_bytes = 0;
+#endif
+
+    return elapsed;
+}
+
+void
+sc_bench_run(const char *name, sc_bench_fn *fn, void *userdata) {
+    if (sc_bench_filter && !strstr(name, sc_bench_filter)) {
+        return;
+    }
+
+    uint64_t n = 1;
+    uint64_t allocs;
+    uint64_t alloc_bytes;
+    sc_tick elapsed;
+
+    for (;;) {
+        elapsed = sc_bench_measure(fn, userdata, n, &allocs, &alloc_bytes);
+        if (elapsed >= SC_BENCH_MIN_TIME || n >= SC_BENCH_MAX_ITERATIONS) {
+            break;
+        }
+
+        // Predict the number of iterations to reach the minimal time (with a
+        // margin), but grow at least x2 and at most x100 at each step
+        uint64_t next = elapsed ? n * SC_BENCH_MIN_TIME * 6 / 5 / elapsed
+                                : n * 100;
+        if (next < n * 2) {
+            next = n * 2;
+        } else if (next > n * 100) {
+            next = n * 100;
+        }
+        n = next < SC_BENCH_MAX_ITERATIONS ? next : SC_BENCH_MAX_ITERATIONS;
+    }
+
+    double ns_per_op = (double) SC_TICK_TO_NS(elapsed) / n;
+
+#ifdef SC_BENCH_COUNT_ALLOCS
+    printf("{\"name\":\"%s\",\"iterations\":%" PRIu64 ",\"ns_per_op\":%.2f,"
+           "\"allocs_per_op\":%.3f,\"bytes_per_op\":%.1f}\n", name, n,
+           ns_per_op, (double) allocs / n, (double) alloc_bytes / n);
+#else
+    (void) allocs;
+    (void) alloc_bytes;
+    printf("{\"name\":\"%s\",\"iterations\":%" PRIu64 ",\"ns_per_op\":%.2f,"
+           "\"allocs_per_op\":null,\"bytes_per_op\":null}\n", name, n,
+           ns_per_op);
+#endif
+    fflush(stdout);
+}
+
+void
+sc_bench_report(const char *name, const char *key, double value) {
+    if (sc_bench_filter && !strstr(name, sc_bench_filter)) {
+        return;
+    }
+
+    printf("{\"name\":\"%s\",\"%s\":%.2f}\n", name, key, value);
+    fflush(stdout);
+}
@@ -0,0 +1,47 @@
+#ifndef SC_BENCH_H
+#define SC_BENCH_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Minimal benchmark harness
+ *
+ * A benchmark function must execute the measured operation n times. The
+ * number of iterations is increased until a run lasts at least
+ * SC_BENCH_MIN_TIME.
+ *
+ * The results are printed on stdout, one JSON object per line, for example:
+ *
+ *     {"name":"vecdeque_push_pop","iterations":16777216,"ns_per_op":2.41,
+ *      "allocs_per_op":0.000,"bytes_per_op":0.0}
+ *
+ * The allocations are counted only with glibc ("allocs_per_op" and
+ * "bytes_per_op" are null otherwise).
+ */
+
+typedef void sc_bench_fn(void *userdata, uint64_t n);
+
+/**
+ * Initialize the harness from the command line
+ *
+ * The optional first argument is a filter: only the benchmarks whose name
+ * contains it are executed.
+ */
+void
+sc_bench_init(int argc, char *argv[]);
+
+void
+sc_bench_run(const char *name, sc_bench_fn *fn, void *userdata);
+
+// Report an additional metric of a benchmark (printed as a separate line)
+void
+sc_bench_report(const char *name, const char *key, double value);
+
+// Prevent the compiler from optimizing away a computed value
+void
+sc_bench_use(const void *p);
+
+#endif
@@ -0,0 +1,137 @@
+#include "common.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/channel_layout.h>
+
+#include "audio_regulator.h"
+#include "bench.h"
+#include "compat.h"
+#include "util/audiobuf.h"
+
+// 20ms at 48kHz (the Opus frame size)
+#define SAMPLES 960
+#define SAMPLE_RATE 48000
+#define CHANNELS 2
+#define SAMPLE_SIZE (CHANNELS * sizeof(float))
+
+struct bench_audiobuf {
+    struct sc_audiobuf buf;
+    float data[SAMPLES * CHANNELS];
+};
+
+static void
+bench_audiobuf_write_read(void *userdata, uint64_t n) {
+    struct bench_audiobuf *b = userdata;
+
+    for (uint64_t i = 0; i < n; ++i) {
+        uint32_t w = sc_audiobuf_write(&b->buf, b->data, SAMPLES);
+        uint32_t r = sc_audiobuf_read(&b->buf, b->data, SAMPLES);
+        assert(w == SAMPLES && r == SAMPLES);
+        (void) w;
+        (void) r;
+    }
+    sc_bench_use(b->data);
+}
+
+struct bench_audio_regulator {
+    struct sc_audio_regulator ar;
+    AVFrame *frame;
+    uint8_t out[SAMPLES * SAMPLE_SIZE];
+};
+
+static void
+bench_audio_regulator_push_pull(void *userdata, uint64_t n) {
+    struct bench_audio_regulator *b = userdata;
+
+    for (uint64_t i = 0; i < n; ++i) {
+        // The pts must be continuous (20ms per frame)
+        b->frame->pts += SAMPLES * INT64_C(1000000) / SAMPLE_RATE;
+        bool ok = sc_audio_regulator_push(&b->ar, b->frame);
+        assert(ok);
+        (void) ok;
+        sc_audio_regulator_pull(&b->ar, b->out, SAMPLES);
+    }
+    sc_bench_use(b->out);
+}
+
+static bool
+init_audio_frame(AVFrame *frame) {
+    // Planar float, as produced by the Opus decoder
+    frame->format = AV_SAMPLE_FMT_FLTP;
+    frame->nb_samples = SAMPLES;
+    frame->sample_rate = SAMPLE_RATE;
+#ifdef SCRCPY_LAVU_HAS_CHLAYOUT
+    frame->ch_layout = (AVChannelLayout) AV_CHANNEL_LAYOUT_STEREO;
+#else
+    frame->channel_layout = AV_CH_LAYOUT_STEREO;
+    frame->channels = CHANNELS;
+#endif
+    if (av_frame_get_buffer(frame, 0) < 0) {
+        return false;
+    }
+
+    for (int c = 0; c < CHANNELS; ++c) {
+        float *samples = (float *) frame->data[c];
+        for (int i = 0; i < SAMPLES; ++i) {
+            // 440Hz tone
+            samples[i] = 0.5f * sinf(2 * M_PI * 440 * i / SAMPLE_RATE);
+        }
+    }
+
+    frame->pts = 0;
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    sc_bench_init(argc, argv);
+
+    struct bench_audiobuf ab;
+    memset(ab.data, 0, sizeof(ab.data));
+    bool ok = sc_audiobuf_init(&ab.buf, SAMPLE_SIZE, SAMPLE_RATE);
+    if (!ok) {
+        return 1;
+    }
+
+    sc_bench_run("audiobuf_write_read", bench_audiobuf_write_read, &ab);
+    sc_audiobuf_destroy(&ab.buf);
+
+    AVCodecContext *ctx = avcodec_alloc_context3(NULL);
+    if (!ctx) {
+        fprintf(stderr, "Could not allocate codec context\n");
+        return 1;
+    }
+#ifdef SCRCPY_LAVU_HAS_CHLAYOUT
+    ctx->ch_layout = (AVChannelLayout) AV_CHANNEL_LAYOUT_STEREO;
+#else
+    ctx->channel_layout = AV_CH_LAYOUT_STEREO;
+    ctx->channels = CHANNELS;
+#endif
+    ctx->sample_rate = SAMPLE_RATE;
+    ctx->sample_fmt = AV_SAMPLE_FMT_FLTP;
+
+    struct bench_audio_regulator ar;
+    ar.frame = av_frame_alloc();
+    if (!ar.frame || !init_audio_frame(ar.frame)) {
+        fprintf(stderr, "Could not allocate audio frame\n");
+        return 1;
+    }
+
+    // 50ms of target buffering
+    ok = sc_audio_regulator_init(&ar.ar, SAMPLE_SIZE, ctx, SAMPLE_RATE / 20);
+    if (!ok) {
+        return 1;
+    }
+
+    sc_bench_run("audio_regulator_push_pull", bench_audio_regulator_push_pull,
+                 &ar);
+
+    sc_audio_regulator_destroy(&ar.ar);
+    av_frame_free(&ar.frame);
+    avcodec_free_context(&ctx);
+
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include "common.h"
+
+#include <stdint.h>
+
+#include "bench.h"
+#include "control_msg.h"
+
+static void
+bench_control_msg_serialize(void *userdata, uint64_t n) {
+    const struct sc_control_msg *msg = userdata;
+
+    uint8_t buf[SC_CONTROL_MSG_MAX_SIZE];
+    for (uint64_t i = 0; i < n; ++i) {
+        size_t size = sc_control_msg_serialize(msg, buf);
+        sc_bench_use(buf);
+        sc_bench_use(&size);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    sc_bench_init(argc, argv);
+
+    // The most frequent messages (on mouse motion)
+    struct sc_control_msg touch = {
+        .type = SC_CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT,
+        .inject_touch_event = {
+            .action = AMOTION_EVENT_ACTION_MOVE,
+            .pointer_id = SC_POINTER_ID_MOUSE,
+            .position = {
+                .point = {
+                    .x = 100,
+                    .y = 200,
+                },
+                .screen_size = {
+                    .width = 1080,
+                    .height = 1920,
+                },
+            },
+            .pressure = 1.0f,
+            .action_button = 0,
+            .buttons = AMOTION_EVENT_BUTTON_PRIMARY,
+        },
+    };
+    sc_bench_run("control_msg_serialize_touch", bench_control_msg_serialize,
+                 &touch);
+
+    struct sc_control_msg scroll = {
+        .type = SC_CONTROL_MSG_TYPE_INJECT_SCROLL_EVENT,
+        .inject_scroll_event = {
+            .position = {
+                .point = {
+                    .x = 260,
+                    .y = 1026,
+                },
+                .screen_size = {
+                    .width = 1080,
+                    .height = 1920,
+                },
+            },
+            .hscroll = 0,
+            .vscroll = -1,
+            .buttons = 0,
+        },
+    };
+    sc_bench_run("control_msg_serialize_scroll", bench_control_msg_serialize,
+                 &scroll);
+
+    struct sc_control_msg text = {
+        .type = SC_CONTROL_MSG_TYPE_INJECT_TEXT,
+        .inject_text = {
+            .text = "hello, world!",
+        },
+    };
+    sc_bench_run("control_msg_serialize_text", bench_control_msg_serialize,
+                 &text);
+
+    return 0;
+}
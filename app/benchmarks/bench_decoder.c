@@ -0,0 +1,429 @@
+#include "common.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/channel_layout.h>
+
+#include "bench.h"
+#include "compat.h"
+
+#define VIDEO_WIDTH 1280
+#define VIDEO_HEIGHT 720
+#define VIDEO_FPS 60
+#define VIDEO_FRAMES 120
+
+#define AUDIO_SAMPLE_RATE 48000
+#define AUDIO_DURATION_MS 2000
+
+#define MAX_PACKETS 256
+
+/**
+ * Packets encoded at setup (with the encoders available in this FFmpeg
+ * build), then decoded in a loop, like the packets received from the device.
+ */
+struct bench_stream {
+    AVPacket *packets[MAX_PACKETS];
+    unsigned count;
+    AVCodecContext *dec_ctx;
+    AVFrame *frame;
+    // Frames sent to the decoder but not output yet (the latency added by
+    // frame threading)
+    uint64_t pending;
+    uint64_t max_pending;
+};
+
+static bool
+encode(struct bench_stream *stream, AVCodecContext *ctx, const AVFrame *frame) {
+    int ret = avcodec_send_frame(ctx, frame);
+    if (ret < 0) {
+        return false;
+    }
+
+    for (;;) {
+        if (stream->count == MAX_PACKETS) {
+            // Enough packets, ignore the others
+            return true;
+        }
+
+        AVPacket *packet = av_packet_alloc();
+        if (!packet) {
+            return false;
+        }
+
+        ret = avcodec_receive_packet(ctx, packet);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+            av_packet_free(&packet);
+            return true;
+        }
+        if (ret < 0) {
+            av_packet_free(&packet);
+            return false;
+        }
+
+        stream->packets[stream->count++] = packet;
+    }
+}
+
+static void
+draw_pattern(AVFrame *frame, int index) {
+    // Moving gradients, so that the encoder produces non-trivial packets
+    for (int y = 0; y < frame->height; ++y) {
+        uint8_t *line = &frame->data[0][y * frame->linesize[0]];
+        for (int x = 0; x < frame->width; ++x) {
+            line[x] = x + y + index * 3;
+        }
+    }
+    for (int y = 0; y < frame->height / 2; ++y) {
+        uint8_t *u = &frame->data[1][y * frame->linesize[1]];
+        uint8_t *v = &frame->data[2][y * frame->linesize[2]];
+        for (int x = 0; x < frame->width / 2; ++x) {
+            u[x] = 128 + y + index * 2;
+            v[x] = 64 + x + index * 5;
+        }
+    }
+}
+
+static bool
+encode_video(struct bench_stream *stream, const AVCodec *codec) {
+    AVCodecContext *ctx = avcodec_alloc_context3(codec);
+    if (!ctx) {
+        return false;
+    }
+
+    bool ret = false;
+    AVFrame *frame = NULL;
+
+    ctx->width = VIDEO_WIDTH;
+    ctx->height = VIDEO_HEIGHT;
+    ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+    ctx->time_base = (AVRational) {1, VIDEO_FPS};
+    ctx->framerate = (AVRational) {VIDEO_FPS, 1};
+    ctx->bit_rate = 8000000;
+    // One keyframe per second, no B-frames (like a device encoder), and the
+    // parameter sets in-band
+    ctx->gop_size = VIDEO_FPS;
+    ctx->max_b_frames = 0;
+
+    // Options for the encoders which support them (ignored by the others)
+    AVDictionary *opts = NULL;
+    av_dict_set(&opts, "preset", "ultrafast", 0);
+    av_dict_set(&opts, "tune", "zerolatency", 0);
+    av_dict_set(&opts, "cpu-used", "8", 0);
+    int r = avcodec_open2(ctx, codec, &opts);
+    av_dict_free(&opts);
+    if (r < 0) {
+        goto end;
+    }
+
+    frame = av_frame_alloc();
+    if (!frame) {
+        goto end;
+    }
+
+    frame->format = ctx->pix_fmt;
+    frame->width = ctx->width;
+    frame->height = ctx->height;
+    if (av_frame_get_buffer(frame, 0) < 0) {
+        goto end;
+    }
+
+    for (int i = 0; i < VIDEO_FRAMES; ++i) {
+        if (av_frame_make_writable(frame) < 0) {
+            goto end;
+        }
+
+        draw_pattern(frame, i);
+        frame->pts = i;
+
+        if (!encode(stream, ctx, frame)) {
+            goto end;
+        }
+    }
+
+    // Flush
+    ret = encode(stream, ctx, NULL);
+
+end:
+    av_frame_free(&frame);
+    avcodec_free_context(&ctx);
+    return ret;
+}
+
+static enum AVSampleFormat
+select_sample_fmt(const AVCodec *codec) {
+    const enum AVSampleFormat *fmt = codec->sample_fmts;
+    if (!fmt) {
+        return AV_SAMPLE_FMT_NONE;
+    }
+
+    for (; *fmt != AV_SAMPLE_FMT_NONE; ++fmt) {
+        if (*fmt == AV_SAMPLE_FMT_FLT || *fmt == AV_SAMPLE_FMT_FLTP) {
+            return *fmt;
+        }
+    }
+
+    return AV_SAMPLE_FMT_NONE;
+}
+
+static void
+write_tone(AVFrame *frame, int64_t pos) {
+    bool planar = av_sample_fmt_is_planar(frame->format);
+
+    for (int i = 0; i < frame->nb_samples; ++i) {
+        // 440 Hz
+        double t = (double) (pos + i) / AUDIO_SAMPLE_RATE;
+        float sample = 0.3f * (float) sin(2 * M_PI * 440 * t);
+
+        for (int c = 0; c < 2; ++c) {
+            float *data = (float *) (planar ? frame->data[c] : frame->data[0]);
+            data[planar ? i : i * 2 + c] = sample;
+        }
+    }
+}
+
+static bool
+encode_audio(struct bench_stream *stream, const AVCodec *codec,
+             uint8_t **extradata, int *extradata_size) {
+    enum AVSampleFormat sample_fmt = select_sample_fmt(codec);
+    if (sample_fmt == AV_SAMPLE_FMT_NONE) {
+        return false;
+    }
+
+    AVCodecContext *ctx = avcodec_alloc_context3(codec);
+    if (!ctx) {
+        return false;
+    }
+
+    bool ret = false;
+    AVFrame *frame = NULL;
+
+    ctx->sample_rate = AUDIO_SAMPLE_RATE;
+    ctx->sample_fmt = sample_fmt;
+    ctx->time_base = (AVRational) {1, AUDIO_SAMPLE_RATE};
+    ctx->bit_rate = 128000;
+#ifdef SCRCPY_LAVU_HAS_CHLAYOUT
+    av_channel_layout_default(&ctx->ch_layout, 2);
+#else
+    ctx->channel_layout = AV_CH_LAYOUT_STEREO;
+    ctx->channels = 2;
+#endif
+    // The native FFmpeg Opus encoder is experimental
+    ctx->strict_std_compliance = FF_COMPLIANCE_EXPERIMENTAL;
+
+    if (avcodec_open2(ctx, codec, NULL) < 0) {
+        goto end;
+    }
+
+    // The OpusHead is required by the decoder
+    if (ctx->extradata_size) {
+        *extradata = av_mallocz(ctx->extradata_size
+                                    + AV_INPUT_BUFFER_PADDING_SIZE);
+        if (!*extradata) {
+            goto end;
+        }
+        memcpy(*extradata, ctx->extradata, ctx->extradata_size);
+        *extradata_size = ctx->extradata_size;
+    }
+
+    frame = av_frame_alloc();
+    if (!frame) {
+        goto end;
+    }
+
+    frame->format = ctx->sample_fmt;
+    frame->nb_samples = ctx->frame_size;
+#ifdef SCRCPY_LAVU_HAS_CHLAYOUT
+    if (av_channel_layout_copy(&frame->ch_layout, &ctx->ch_layout) < 0) {
+        goto end;
+    }
+#else
+    frame->channel_layout = ctx->channel_layout;
+    frame->channels = ctx->channels;
+#endif
+    if (av_frame_get_buffer(frame, 0) < 0) {
+        goto end;
+    }
+
+    int64_t total = AUDIO_SAMPLE_RATE * AUDIO_DURATION_MS / 1000;
+    for (int64_t pos = 0; pos + frame->nb_samples <= total;
+            pos += frame->nb_samples) {
+        if (av_frame_make_writable(frame) < 0) {
+            goto end;
+        }
+
+        write_tone(frame, pos);
+        frame->pts = pos;
+
+        if (!encode(stream, ctx, frame)) {
+            goto end;
+        }
+    }
+
+    // Flush
+    ret = encode(stream, ctx, NULL);
+
+end:
+    av_frame_free(&frame);
+    avcodec_free_context(&ctx);
+    return ret;
+}
+
+static void
+bench_stream_destroy(struct bench_stream *stream) {
+    for (unsigned i = 0; i < stream->count; ++i) {
+        av_packet_free(&stream->packets[i]);
+    }
+    av_frame_free(&stream->frame);
+    avcodec_free_context(&stream->dec_ctx);
+}
+
+static bool
+bench_stream_init(struct bench_stream *stream, enum AVCodecID codec_id,
+                  int threads, int thread_type) {
+    stream->count = 0;
+    stream->dec_ctx = NULL;
+    stream->frame = NULL;
+    stream->pending = 0;
+    stream->max_pending = 0;
+
+    const AVCodec *encoder = avcodec_find_encoder(codec_id);
+    const AVCodec *decoder = avcodec_find_decoder(codec_id);
+    if (!encoder || !decoder) {
+        return false;
+    }
+
+    uint8_t *extradata = NULL;
+    int extradata_size = 0;
+
+    bool ok;
+    if (encoder->type == AVMEDIA_TYPE_VIDEO) {
+        ok = encode_video(stream, encoder);
+    } else {
+        ok = encode_audio(stream, encoder, &extradata, &extradata_size);
+    }
+    if (!ok || !stream->count) {
+        goto error;
+    }
+
+    // Configure the decoder like the demuxer does
+    stream->dec_ctx = avcodec_alloc_context3(decoder);
+    if (!stream->dec_ctx) {
+        goto error;
+    }
+
+    stream->dec_ctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+    if (decoder->type == AVMEDIA_TYPE_VIDEO) {
+        stream->dec_ctx->width = VIDEO_WIDTH;
+        stream->dec_ctx->height = VIDEO_HEIGHT;
+        stream->dec_ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+        if (threads != 1) {
+            stream->dec_ctx->thread_count = threads;
+            stream->dec_ctx->thread_type = thread_type;
+            if (thread_type == FF_THREAD_FRAME) {
+                // FFmpeg disables frame threading in low delay mode
+                stream->dec_ctx->flags &= ~AV_CODEC_FLAG_LOW_DELAY;
+            }
+        }
+    } else {
+#ifdef SCRCPY_LAVU_HAS_CHLAYOUT
+        stream->dec_ctx->ch_layout = (AVChannelLayout) AV_CHANNEL_LAYOUT_STEREO;
+#else
+        stream->dec_ctx->channel_layout = AV_CH_LAYOUT_STEREO;
+        stream->dec_ctx->channels = 2;
+#endif
+        stream->dec_ctx->sample_rate = AUDIO_SAMPLE_RATE;
+        // moved
+        stream->dec_ctx->extradata = extradata;
+        stream->dec_ctx->extradata_size = extradata_size;
+        extradata = NULL;
+    }
+
+    if (avcodec_open2(stream->dec_ctx, decoder, NULL) < 0) {
+        goto error;
+    }
+
+    stream->frame = av_frame_alloc();
+    if (!stream->frame) {
+        goto error;
+    }
+
+    return true;
+
+error:
+    av_free(extradata);
+    bench_stream_destroy(stream);
+    return false;
+}
+
+static void
+bench_decode(void *userdata, uint64_t n) {
+    struct bench_stream *stream = userdata;
+
+    for (uint64_t i = 0; i < n; ++i) {
+        // The stream loops on the first packet, which is a key frame
+        AVPacket *packet = stream->packets[i % stream->count];
+        int ret = avcodec_send_packet(stream->dec_ctx, packet);
+        if (ret < 0 && ret != AVERROR(EAGAIN)) {
+            fprintf(stderr, "Could not send packet: %d\n", ret);
+            abort();
+        }
+
+        if (++stream->pending > stream->max_pending) {
+            stream->max_pending = stream->pending;
+        }
+
+        while (avcodec_receive_frame(stream->dec_ctx, stream->frame) >= 0) {
+            --stream->pending;
+            sc_bench_use(stream->frame->data[0]);
+            av_frame_unref(stream->frame);
+        }
+    }
+}
+
+static void
+run_decode_benchmark(const char *name, enum AVCodecID codec_id, int threads,
+                     int thread_type) {
+    struct bench_stream stream;
+    if (!bench_stream_init(&stream, codec_id, threads, thread_type)) {
+        fprintf(stderr, "Skipping %s: codec not available\n", name);
+        return;
+    }
+
+    sc_bench_run(name, bench_decode, &stream);
+    if (threads != 1) {
+        // The decoding latency, in frames (0 when a frame is output for each
+        // packet)
+        sc_bench_report(name, "latency_frames",
+                        stream.max_pending ? stream.max_pending - 1 : 0);
+    }
+
+    bench_stream_destroy(&stream);
+}
+
+int main(int argc, char *argv[]) {
+    sc_bench_init(argc, argv);
+
+    // One op is one packet (one video frame, or 20ms of audio)
+    run_decode_benchmark("decode_h264_720p", AV_CODEC_ID_H264, 1, 0);
+    run_decode_benchmark("decode_h265_720p", AV_CODEC_ID_HEVC, 1, 0);
+#ifdef SCRCPY_LAVC_HAS_AV1
+    run_decode_benchmark("decode_av1_720p", AV_CODEC_ID_AV1, 1, 0);
+#endif
+    run_decode_benchmark("decode_opus", AV_CODEC_ID_OPUS, 1, 0);
+
+    // Threading modes (see --decoder-threads and --decoder-thread-type)
+    run_decode_benchmark("decode_h264_720p_slice4", AV_CODEC_ID_H264, 4,
+                         FF_THREAD_SLICE);
+    run_decode_benchmark("decode_h264_720p_frame4", AV_CODEC_ID_H264, 4,
+                         FF_THREAD_FRAME);
+    run_decode_benchmark("decode_h265_720p_slice4", AV_CODEC_ID_HEVC, 4,
+                         FF_THREAD_SLICE);
+    run_decode_benchmark("decode_h265_720p_frame4", AV_CODEC_ID_HEVC, 4,
+                         FF_THREAD_FRAME);
+
+    return 0;
+}
@@ -0,0 +1,257 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libavcodec/avcodec.h>
+
+#include "bench.h"
+#include "demuxer.h"
+#include "packet_merger.h"
+#include "trait/packet_sink.h"
+#include "util/binary.h"
+#include "util/net.h"
+#include "util/thread.h"
+
+#define DOWNCAST(SINK) container_of(SINK, struct bench_sink, packet_sink)
+
+// Typical sizes of H.264 packets (8Mbps at 60fps)
+#define CONFIG_PACKET_SIZE 32
+#define MEDIA_PACKET_SIZE 16384
+#define KEY_FRAME_INTERVAL 60
+
+#define PORT_FIRST 27300
+#define PORT_LAST 27399
+
+#define PACKET_FLAG_CONFIG    (UINT64_C(1) << 63)
+#define PACKET_FLAG_KEY_FRAME (UINT64_C(1) << 62)
+
+struct bench_sink {
+    struct sc_packet_sink packet_sink;
+    uint64_t packets;
+};
+
+static bool
+bench_sink_open(struct sc_packet_sink *sink, AVCodecContext *ctx) {
+    (void) sink;
+    (void) ctx;
+    return true;
+}
+
+static void
+bench_sink_close(struct sc_packet_sink *sink) {
+    (void) sink;
+}
+
+static bool
+bench_sink_push(struct sc_packet_sink *sink, const AVPacket *packet) {
+    struct bench_sink *s = DOWNCAST(sink);
+    sc_bench_use(packet->data);
+    ++s->packets;
+    return true;
+}
+
+struct bench_demuxer {
+    sc_socket server_socket;
+    uint16_t port;
+
+    // writer
+    sc_socket socket;
+    uint64_t n;
+    uint8_t packet[12 + MEDIA_PACKET_SIZE];
+};
+
+static void
+write_header(uint8_t *buf, uint64_t pts_flags, uint32_t len) {
+    sc_write64be(buf, pts_flags);
+    sc_write32be(&buf[8], len);
+}
+
+static int
+run_writer(void *data) {
+    struct bench_demuxer *b = data;
+
+    // "h264" codec id, followed by the video size
+    uint8_t header[12];
+    sc_write32be(header, UINT32_C(0x68323634));
+    sc_write32be(&header[4], 1920);
+    sc_write32be(&header[8], 1080);
+    if (net_send_all(b->socket, header, sizeof(header)) < 0) {
+        goto end;
+    }
+
+    // The payload content does not matter, the packets are not decoded
+    uint8_t config[12 + CONFIG_PACKET_SIZE] = {0};
+    write_header(config, PACKET_FLAG_CONFIG, CONFIG_PACKET_SIZE);
+
+    for (uint64_t i = 0; i < b->n; ++i) {
+        uint64_t pts_flags = i * 16666;
+        if (i % KEY_FRAME_INTERVAL == 0) {
+            // A config packet is sent before each key frame (as on device
+            // rotation), to also exercise the packet merger
+            if (net_send_all(b->socket, config, sizeof(config)) < 0) {
+                goto end;
+            }
+            pts_flags |= PACKET_FLAG_KEY_FRAME;
+        }
+
+        write_header(b->packet, pts_flags, MEDIA_PACKET_SIZE);
+        if (net_send_all(b->socket, b->packet, sizeof(b->packet)) < 0) {
+            goto end;
+        }
+    }
+
+end:
+    // End of stream
+    net_close(b->socket);
+    return 0;
+}
+
+static void
+on_demuxer_ended(struct sc_demuxer *demuxer, enum sc_demuxer_status status,
+                 void *userdata) {
+    (void) demuxer;
+    (void) userdata;
+    assert(status == SC_DEMUXER_STATUS_EOS);
+    (void) status;
+}
+
+static void
+bench_demuxer_recv(void *userdata, uint64_t n) {
+    // Each run streams n media packets over a new TCP connection on localhost
+    // (the connection setup is amortized over the packets)
+    struct bench_demuxer *b = userdata;
+
+    b->socket = net_socket();
+    if (b->socket == SC_SOCKET_NONE
+            || !net_connect(b->socket, IPV4_LOCALHOST, b->port)) {
+        fprintf(stderr, "Could not connect\n");
+        abort();
+    }
+
+    sc_socket socket = net_accept(b->server_socket);
+    if (socket == SC_SOCKET_NONE) {
+        fprintf(stderr, "Could not accept\n");
+        abort();
+    }
+
+    static const struct sc_packet_sink_ops ops = {
+        .open = bench_sink_open,
+        .close = bench_sink_close,
+        .push = bench_sink_push,
+    };
+
+    struct bench_sink sink = {
+        .packet_sink = {
+            .ops = &ops,
+        },
+        .packets = 0,
+    };
+
+    static const struct sc_demuxer_callbacks cbs = {
+        .on_ended = on_demuxer_ended,
+    };
+
+    struct sc_demuxer demuxer;
+    sc_demuxer_init(&demuxer, "bench", socket, &cbs, NULL);
+    sc_packet_source_add_sink(&demuxer.packet_source, &sink.packet_sink);
+
+    b->n = n;
+    sc_thread writer;
+    bool ok = sc_thread_create(&writer, run_writer, "bench-writer", b);
+    if (!ok) {
+        abort();
+    }
+
+    ok = sc_demuxer_start(&demuxer);
+    if (!ok) {
+        abort();
+    }
+
+    sc_demuxer_join(&demuxer);
+    sc_thread_join(&writer, NULL);
+    net_close(socket);
+
+    // Config packets are merged, they are not pushed separately
+    assert(sink.packets == n);
+}
+
+static void
+bench_packet_merger_merge(void *userdata, uint64_t n) {
+    (void) userdata;
+
+    struct sc_packet_merger merger;
+    sc_packet_merger_init(&merger);
+
+    AVPacket *config = av_packet_alloc();
+    AVPacket *media = av_packet_alloc();
+    if (!config || !media) {
+        abort();
+    }
+
+    for (uint64_t i = 0; i < n; ++i) {
+        if (av_new_packet(config, CONFIG_PACKET_SIZE)
+                || av_new_packet(media, MEDIA_PACKET_SIZE)) {
+            abort();
+        }
+        config->pts = AV_NOPTS_VALUE;
+        media->pts = i;
+
+        bool ok = sc_packet_merger_merge(&merger, config);
+        ok &= sc_packet_merger_merge(&merger, media);
+        assert(ok);
+        (void) ok;
+        sc_bench_use(media->data);
+
+        av_packet_unref(config);
+        av_packet_unref(media);
+    }
+
+    av_packet_free(&config);
+    av_packet_free(&media);
+    sc_packet_merger_destroy(&merger);
+}
+
+int main(int argc, char *argv[]) {
+    sc_bench_init(argc, argv);
+
+    if (!net_init()) {
+        return 1;
+    }
+
+    struct bench_demuxer *b = malloc(sizeof(*b));
+    if (!b) {
+        return 1;
+    }
+    memset(b->packet, 0, sizeof(b->packet));
+
+    b->server_socket = SC_SOCKET_NONE;
+    for (uint16_t port = PORT_FIRST; port <= PORT_LAST; ++port) {
+        sc_socket server_socket = net_socket();
+        if (server_socket == SC_SOCKET_NONE) {
+            return 1;
+        }
+        if (net_listen(server_socket, IPV4_LOCALHOST, port, 1)) {
+            b->server_socket = server_socket;
+            b->port = port;
+            break;
+        }
+        net_close(server_socket);
+    }
+
+    if (b->server_socket == SC_SOCKET_NONE) {
+        fprintf(stderr, "Could not listen on any port in [%d, %d]\n",
+                PORT_FIRST, PORT_LAST);
+        return 1;
+    }
+
+    sc_bench_run("demuxer_recv_h264", bench_demuxer_recv, b);
+    sc_bench_run("packet_merger_merge_config", bench_packet_merger_merge, NULL);
+
+    net_close(b->server_socket);
+    free(b);
+    net_cleanup();
+
+    return 0;
+}
@@ -0,0 +1,140 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <libavutil/frame.h>
+
+#include "bench.h"
+#include "frame_buffer.h"
+#include "util/thread.h"
+
+struct bench_frame_buffer {
+    struct sc_frame_buffer fb;
+    AVFrame *frame; // the frame to push
+    AVFrame *consumed;
+
+    // Consumer notification, like the "new frame" event of the screen
+    sc_thread consumer;
+    sc_mutex mutex;
+    sc_cond cond;
+    bool pending;
+    bool stopped;
+};
+
+static void
+bench_frame_buffer_push_consume(void *userdata, uint64_t n) {
+    struct bench_frame_buffer *b = userdata;
+
+    for (uint64_t i = 0; i < n; ++i) {
+        bool ok = sc_frame_buffer_push(&b->fb, b->frame, NULL);
+        assert(ok);
+        (void) ok;
+        sc_frame_buffer_consume(&b->fb, b->consumed);
+        av_frame_unref(b->consumed);
+    }
+}
+
+static int
+run_consumer(void *data) {
+    struct bench_frame_buffer *b = data;
+
+    for (;;) {
+        sc_mutex_lock(&b->mutex);
+        while (!b->pending && !b->stopped) {
+            sc_cond_wait(&b->cond, &b->mutex);
+        }
+        if (!b->pending) {
+            // stopped
+            sc_mutex_unlock(&b->mutex);
+            break;
+        }
+        b->pending = false;
+        sc_mutex_unlock(&b->mutex);
+
+        sc_frame_buffer_consume(&b->fb, b->consumed);
+        av_frame_unref(b->consumed);
+    }
+
+    return 0;
+}
+
+static void
+bench_frame_buffer_contention(void *userdata, uint64_t n) {
+    struct bench_frame_buffer *b = userdata;
+
+    for (uint64_t i = 0; i < n; ++i) {
+        bool skipped;
+        bool ok = sc_frame_buffer_push(&b->fb, b->frame, &skipped);
+        assert(ok);
+        (void) ok;
+
+        if (!skipped) {
+            // The consumer has consumed the previous frame, notify it
+            sc_mutex_lock(&b->mutex);
+            b->pending = true;
+            sc_cond_signal(&b->cond);
+            sc_mutex_unlock(&b->mutex);
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    sc_bench_init(argc, argv);
+
+    struct bench_frame_buffer b = {0};
+
+    b.frame = av_frame_alloc();
+    b.consumed = av_frame_alloc();
+    if (!b.frame || !b.consumed) {
+        fprintf(stderr, "Could not allocate frames\n");
+        return 1;
+    }
+
+    b.frame->format = AV_PIX_FMT_YUV420P;
+    b.frame->width = 1920;
+    b.frame->height = 1080;
+    if (av_frame_get_buffer(b.frame, 0) < 0) {
+        fprintf(stderr, "Could not allocate frame buffer\n");
+        return 1;
+    }
+
+    bool ok = sc_frame_buffer_init(&b.fb);
+    if (!ok) {
+        return 1;
+    }
+
+    sc_bench_run("frame_buffer_push_consume", bench_frame_buffer_push_consume,
+                 &b);
+
+    ok = sc_mutex_init(&b.mutex);
+    if (!ok) {
+        return 1;
+    }
+    ok = sc_cond_init(&b.cond);
+    if (!ok) {
+        return 1;
+    }
+
+    ok = sc_thread_create(&b.consumer, run_consumer, "bench-consumer", &b);
+    if (!ok) {
+        return 1;
+    }
+
+    // The frame buffer is initially consumed, so the first push notifies the
+    // consumer
+    sc_bench_run("frame_buffer_contention", bench_frame_buffer_contention, &b);
+
+    sc_mutex_lock(&b.mutex);
+    b.stopped = true;
+    sc_cond_signal(&b.cond);
+    sc_mutex_unlock(&b.mutex);
+    sc_thread_join(&b.consumer, NULL);
+
+    sc_cond_destroy(&b.cond);
+    sc_mutex_destroy(&b.mutex);
+    sc_frame_buffer_destroy(&b.fb);
+    av_frame_free(&b.frame);
+    av_frame_free(&b.consumed);
+
+    return 0;
+}
@@ -0,0 +1,163 @@
+#include "common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libavutil/frame.h>
+
+#include "bench.h"
+#include "snapshot.h"
+#include "yuv2rgb.h"
+
+static void
+bench_snapshot_bmp(void *userdata, uint64_t n) {
+    const AVFrame *frame = userdata;
+
+    for (uint64_t i = 0; i < n; ++i) {
+        uint8_t *data;
+        size_t size;
+        if (!sc_snapshot_encode(frame, "bmp", &data, &size)) {
+            fprintf(stderr, "Could not encode snapshot\n");
+            abort();
+        }
+        sc_bench_use(data);
+        free(data);
+    }
+}
+
+struct bench_snapshot_scaled {
+    const AVFrame *frame;
+    unsigned width;
+    unsigned height;
+    struct sc_scaler_cache scalers;
+};
+
+static void
+bench_snapshot_bmp_scaled(void *userdata, uint64_t n) {
+    struct bench_snapshot_scaled *b = userdata;
+
+    for (uint64_t i = 0; i < n; ++i) {
+        uint8_t *data;
+        size_t size;
+        if (!sc_snapshot_encode_scaled(b->frame, "bmp", b->width, b->height,
+                                       &b->scalers, &data, &size)) {
+            fprintf(stderr, "Could not encode snapshot\n");
+            abort();
+        }
+        sc_bench_use(data);
+        free(data);
+    }
+}
+
+struct bench_yuv2rgb {
+    struct sc_yuv_image image;
+    enum sc_yuv2rgb_impl impl;
+    unsigned scale_shift;
+    uint8_t *dst;
+};
+
+static void
+bench_yuv2rgb(void *userdata, uint64_t n) {
+    struct bench_yuv2rgb *b = userdata;
+    ptrdiff_t linesize = (b->image.width >> b->scale_shift) * 3;
+
+    for (uint64_t i = 0; i < n; ++i) {
+        if (!sc_yuv2rgb_convert_with(b->impl, &b->image, b->scale_shift,
+                                     SC_RGB_FORMAT_RGB24, b->dst, linesize)) {
+            fprintf(stderr, "Could not convert frame\n");
+            abort();
+        }
+        sc_bench_use(b->dst);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    sc_bench_init(argc, argv);
+
+    // A decoded frame, as served by /api/v1/frame
+    AVFrame *frame = av_frame_alloc();
+    if (!frame) {
+        return 1;
+    }
+
+    frame->format = AV_PIX_FMT_YUV420P;
+    frame->width = 1080;
+    frame->height = 2340;
+    if (av_frame_get_buffer(frame, 0) < 0) {
+        av_frame_free(&frame);
+        return 1;
+    }
+
+    for (int p = 0; p < 3; ++p) {
+        int h = p ? frame->height / 2 : frame->height;
+        memset(frame->data[p], p ? 128 : 64, frame->linesize[p] * h);
+    }
+
+    sc_bench_run("snapshot_bmp_1080x2340", bench_snapshot_bmp, frame);
+
+    // Scaled by the area filter (not by 2 or 4, which is fused with the
+    // color conversion)
+    struct bench_snapshot_scaled scaled = {
+        .frame = frame,
+    };
+    sc_scaler_cache_init(&scaled.scalers);
+
+    static const unsigned scaled_sizes[][2] = {{720, 1560}, {320, 693}};
+    for (size_t i = 0; i < ARRAY_LEN(scaled_sizes); ++i) {
+        scaled.width = scaled_sizes[i][0];
+        scaled.height = scaled_sizes[i][1];
+
+        char name[64];
+        snprintf(name, sizeof(name), "snapshot_bmp_1080x2340_to_%ux%u",
+                 scaled.width, scaled.height);
+        sc_bench_run(name, bench_snapshot_bmp_scaled, &scaled);
+    }
+
+    sc_scaler_cache_destroy(&scaled.scalers);
+
+    struct bench_yuv2rgb b = {
+        .image = {
+            .planes = {frame->data[0], frame->data[1], frame->data[2]},
+            .linesizes = {frame->linesize[0], frame->linesize[1],
+                          frame->linesize[2]},
+            .width = frame->width,
+            .height = frame->height,
+            .matrix = SC_YUV_MATRIX_BT709,
+            .full_range = false,
+        },
+    };
+    b.dst = malloc((size_t) frame->width * frame->height * 3);
+    if (!b.dst) {
+        av_frame_free(&frame);
+        return 1;
+    }
+
+    static const struct {
+        enum sc_yuv2rgb_impl impl;
+        const char *name;
+    } impls[] = {
+        {SC_YUV2RGB_IMPL_SCALAR, "scalar"},
+        {SC_YUV2RGB_IMPL_SSE2, "sse2"},
+        {SC_YUV2RGB_IMPL_SSSE3, "ssse3"},
+        {SC_YUV2RGB_IMPL_AVX2, "avx2"},
+        {SC_YUV2RGB_IMPL_NEON, "neon"},
+    };
+
+    for (size_t i = 0; i < ARRAY_LEN(impls); ++i) {
+        if (!sc_yuv2rgb_is_supported(impls[i].impl)) {
+            continue;
+        }
+
+        b.impl = impls[i].impl;
+        for (b.scale_shift = 0; b.scale_shift <= 2; ++b.scale_shift) {
+            char name[64];
+            snprintf(name, sizeof(name), "yuv2rgb_%s_1080x2340_div%u",
+                     impls[i].name, 1u << b.scale_shift);
+            sc_bench_run(name, bench_yuv2rgb, &b);
+        }
+    }
+
+    free(b.dst);
+    av_frame_free(&frame);
+    return 0;
+}
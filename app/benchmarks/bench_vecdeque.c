@@ -0,0 +1,59 @@
+#include "common.h"
+
+#include <assert.h>
+
+#include "bench.h"
+#include "util/vecdeque.h"
+
+struct sc_bench_queue SC_VECDEQUE(int);
+
+static void
+bench_vecdeque_push_pop(void *userdata, uint64_t n) {
+    struct sc_bench_queue *queue = userdata;
+
+    for (uint64_t i = 0; i < n; ++i) {
+        // Keep a few items in the queue, so that the ring wraps around
+        bool ok = sc_vecdeque_push(queue, (int) i);
+        assert(ok);
+        (void) ok;
+        int item = sc_vecdeque_pop(queue);
+        sc_bench_use(&item);
+    }
+}
+
+static void
+bench_vecdeque_grow(void *userdata, uint64_t n) {
+    (void) userdata;
+
+    // Push into a new queue, to measure the reallocations
+    uint64_t i = 0;
+    while (i < n) {
+        struct sc_bench_queue queue = SC_VECDEQUE_INITIALIZER;
+        for (int j = 0; j < 1024 && i < n; ++j, ++i) {
+            bool ok = sc_vecdeque_push(&queue, j);
+            assert(ok);
+            (void) ok;
+        }
+        sc_bench_use(queue.data);
+        sc_vecdeque_destroy(&queue);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    sc_bench_init(argc, argv);
+
+    struct sc_bench_queue queue;
+    sc_vecdeque_init(&queue);
+    for (int i = 0; i < 10; ++i) {
+        bool ok = sc_vecdeque_push(&queue, i);
+        assert(ok);
+        (void) ok;
+    }
+
+    sc_bench_run("vecdeque_push_pop", bench_vecdeque_push_pop, &queue);
+    sc_vecdeque_destroy(&queue);
+
+    sc_bench_run("vecdeque_grow", bench_vecdeque_grow, NULL);
+
+    return 0;
+}
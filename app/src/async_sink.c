@@ -0,0 +1,556 @@
+#include "async_sink.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include "util/log.h"
+
+/** Downcast frame_sink to sc_async_frame_sink */
+#define DOWNCAST_FRAME(SINK) \
+    container_of(SINK, struct sc_async_frame_sink, frame_sink)
+/** Downcast packet_sink to sc_async_packet_sink */
+#define DOWNCAST_PACKET(SINK) \
+    container_of(SINK, struct sc_async_packet_sink, packet_sink)
+
+static void
+sc_async_sink_counters_init(struct sc_async_sink_counters *counters) {
+    atomic_init(&counters->pushed, 0);
+    atomic_init(&counters->delivered, 0);
+    atomic_init(&counters->dropped, 0);
+    atomic_init(&counters->queued, 0);
+    atomic_init(&counters->max_queued, 0);
+    atomic_init(&counters->total_lag, 0);
+    atomic_init(&counters->max_lag, 0);
+}
+
+// Called with the adapter mutex locked (so the counters are only written by
+// one thread at a time)
+static void
+sc_async_sink_counters_set_queued(struct sc_async_sink_counters *counters,
+                                  size_t queued) {
+    atomic_store_explicit(&counters->queued, queued, memory_order_relaxed);
+    if (queued > atomic_load_explicit(&counters->max_queued,
+                                      memory_order_relaxed)) {
+        atomic_store_explicit(&counters->max_queued, queued,
+                              memory_order_relaxed);
+    }
+}
+
+static void
+sc_async_sink_counters_add(atomic_uint_least64_t *counter, uint64_t value) {
+    atomic_fetch_add_explicit(counter, value, memory_order_relaxed);
+}
+
+// Called from the adapter thread only
+static void
+sc_async_sink_counters_delivered(struct sc_async_sink_counters *counters,
+                                 sc_tick push_date) {
+    sc_tick lag = sc_tick_now() - push_date;
+    sc_async_sink_counters_add(&counters->delivered, 1);
+    atomic_fetch_add_explicit(&counters->total_lag, lag, memory_order_relaxed);
+    if (lag > atomic_load_explicit(&counters->max_lag, memory_order_relaxed)) {
+        atomic_store_explicit(&counters->max_lag, lag, memory_order_relaxed);
+    }
+}
+
+static void
+sc_async_sink_counters_get(struct sc_async_sink_counters *counters,
+                           struct sc_async_sink_stats *stats) {
+    stats->pushed =
+        atomic_load_explicit(&counters->pushed, memory_order_relaxed);
+    stats->delivered =
+        atomic_load_explicit(&counters->delivered, memory_order_relaxed);
+    stats->dropped =
+        atomic_load_explicit(&counters->dropped, memory_order_relaxed);
+    stats->queued =
+        atomic_load_explicit(&counters->queued, memory_order_relaxed);
+    stats->max_queued =
+        atomic_load_explicit(&counters->max_queued, memory_order_relaxed);
+    sc_tick total_lag =
+        atomic_load_explicit(&counters->total_lag, memory_order_relaxed);
+    stats->avg_lag = stats->delivered ? total_lag / (sc_tick) stats->delivered
+                                      : 0;
+    stats->max_lag =
+        atomic_load_explicit(&counters->max_lag, memory_order_relaxed);
+}
+
+static void
+sc_async_sink_log_stats(const char *name,
+                        struct sc_async_sink_counters *counters) {
+    struct sc_async_sink_stats stats;
+    sc_async_sink_counters_get(counters, &stats);
+    LOGD("Async sink '%s': %" PRIu64 " delivered, %" PRIu64 " dropped, max "
+         "%" PRIu32 " queued, lag avg %" PRItick " ms, max %" PRItick " ms",
+         name, stats.delivered, stats.dropped, stats.max_queued,
+         SC_TICK_TO_MS(stats.avg_lag), SC_TICK_TO_MS(stats.max_lag));
+}
+
+static void
+sc_async_frame_destroy(struct sc_async_frame *aframe) {
+    av_frame_free(&aframe->frame);
+}
+
+static int
+run_async_frame_sink(void *data) {
+    struct sc_async_frame_sink *as = data;
+
+    for (;;) {
+        sc_mutex_lock(&as->mutex);
+
+        while (!as->stopped && sc_vecdeque_is_empty(&as->queue)) {
+            sc_cond_wait(&as->queue_cond, &as->mutex);
+        }
+
+        if (as->stopped) {
+            sc_mutex_unlock(&as->mutex);
+            break;
+        }
+
+        struct sc_async_frame aframe = sc_vecdeque_pop(&as->queue);
+        sc_async_sink_counters_set_queued(&as->counters,
+                                          sc_vecdeque_size(&as->queue));
+        sc_mutex_unlock(&as->mutex);
+
+        sc_async_sink_counters_delivered(&as->counters, aframe.push_date);
+        bool ok = sc_frame_source_sinks_push(&as->frame_source, aframe.frame);
+        sc_async_frame_destroy(&aframe);
+        if (!ok) {
+            LOGE("Async sink '%s': frame could not be pushed, stopping",
+                 as->name);
+            sc_mutex_lock(&as->mutex);
+            // Fail on the next push
+            as->failed = true;
+            sc_mutex_unlock(&as->mutex);
+            break;
+        }
+    }
+
+    LOGD("Async sink '%s': thread ended", as->name);
+
+    return 0;
+}
+
+static bool
+sc_async_frame_sink_open(struct sc_frame_sink *sink,
+                         const AVCodecContext *ctx) {
+    struct sc_async_frame_sink *as = DOWNCAST_FRAME(sink);
+
+    bool ok = sc_mutex_init(&as->mutex);
+    if (!ok) {
+        return false;
+    }
+
+    ok = sc_cond_init(&as->queue_cond);
+    if (!ok) {
+        goto error_destroy_mutex;
+    }
+
+    sc_vecdeque_init(&as->queue);
+    // Never allocate once started
+    ok = sc_vecdeque_reserve(&as->queue, as->capacity);
+    if (!ok) {
+        LOG_OOM();
+        goto error_destroy_cond;
+    }
+
+    as->stopped = false;
+    as->failed = false;
+
+    if (!sc_frame_source_sinks_open(&as->frame_source, ctx)) {
+        goto error_destroy_queue;
+    }
+
+    ok = sc_thread_create(&as->thread, run_async_frame_sink, "scrcpy-async",
+                          as);
+    if (!ok) {
+        LOGE("Async sink '%s': could not start thread", as->name);
+        goto error_close_sinks;
+    }
+
+    return true;
+
+error_close_sinks:
+    sc_frame_source_sinks_close(&as->frame_source);
+error_destroy_queue:
+    sc_vecdeque_destroy(&as->queue);
+error_destroy_cond:
+    sc_cond_destroy(&as->queue_cond);
+error_destroy_mutex:
+    sc_mutex_destroy(&as->mutex);
+
+    return false;
+}
+
+static void
+sc_async_frame_sink_close(struct sc_frame_sink *sink) {
+    struct sc_async_frame_sink *as = DOWNCAST_FRAME(sink);
+
+    sc_mutex_lock(&as->mutex);
+    as->stopped = true;
+    sc_cond_signal(&as->queue_cond);
+    sc_mutex_unlock(&as->mutex);
+
+    sc_thread_join(&as->thread, NULL);
+
+    sc_frame_source_sinks_close(&as->frame_source);
+
+    // The remaining frames are dropped
+    while (!sc_vecdeque_is_empty(&as->queue)) {
+        struct sc_async_frame *aframe = sc_vecdeque_popref(&as->queue);
+        sc_async_frame_destroy(aframe);
+    }
+    sc_vecdeque_destroy(&as->queue);
+
+    sc_async_sink_log_stats(as->name, &as->counters);
+
+    sc_cond_destroy(&as->queue_cond);
+    sc_mutex_destroy(&as->mutex);
+}
+
+static bool
+sc_async_frame_sink_push(struct sc_frame_sink *sink, const AVFrame *frame) {
+    struct sc_async_frame_sink *as = DOWNCAST_FRAME(sink);
+
+    struct sc_async_frame aframe;
+    aframe.frame = av_frame_alloc();
+    if (!aframe.frame) {
+        LOG_OOM();
+        return false;
+    }
+
+    if (av_frame_ref(aframe.frame, frame)) {
+        LOG_OOM();
+        av_frame_free(&aframe.frame);
+        return false;
+    }
+
+    aframe.push_date = sc_tick_now();
+
+    sc_mutex_lock(&as->mutex);
+
+    if (as->failed) {
+        sc_mutex_unlock(&as->mutex);
+        sc_async_frame_destroy(&aframe);
+        return false;
+    }
+
+    sc_async_sink_counters_add(&as->counters.pushed, 1);
+
+    if (sc_vecdeque_size(&as->queue) >= as->capacity) {
+        // The sinks do not keep up, drop the oldest frame
+        struct sc_async_frame dropped = sc_vecdeque_pop(&as->queue);
+        if (!sc_frame_is_unchanged(dropped.frame)) {
+            // The next frame may be identical to the dropped one, but not to
+            // the last frame received by the sinks
+            AVFrame *next = sc_vecdeque_is_empty(&as->queue)
+                          ? aframe.frame
+                          : sc_vecdeque_peekref(&as->queue)->frame;
+            sc_frame_set_unchanged(next, false);
+        }
+        sc_async_frame_destroy(&dropped);
+        sc_async_sink_counters_add(&as->counters.dropped, 1);
+    }
+
+    sc_vecdeque_push_noresize(&as->queue, aframe);
+    sc_async_sink_counters_set_queued(&as->counters,
+                                      sc_vecdeque_size(&as->queue));
+    sc_cond_signal(&as->queue_cond);
+
+    sc_mutex_unlock(&as->mutex);
+
+    return true;
+}
+
+void
+sc_async_frame_sink_init(struct sc_async_frame_sink *as, const char *name,
+                         enum sc_async_frame_policy policy, size_t capacity) {
+    assert(policy == SC_ASYNC_FRAME_POLICY_LATEST || capacity);
+
+    as->name = name; // statically allocated
+    as->policy = policy;
+    as->capacity = policy == SC_ASYNC_FRAME_POLICY_LATEST ? 1 : capacity;
+
+    sc_frame_source_init(&as->frame_source);
+    sc_async_sink_counters_init(&as->counters);
+
+    static const struct sc_frame_sink_ops ops = {
+        .open = sc_async_frame_sink_open,
+        .close = sc_async_frame_sink_close,
+        .push = sc_async_frame_sink_push,
+    };
+
+    as->frame_sink.ops = &ops;
+}
+
+void
+sc_async_frame_sink_destroy(struct sc_async_frame_sink *as) {
+    sc_frame_source_destroy(&as->frame_source);
+}
+
+void
+sc_async_frame_sink_get_stats(struct sc_async_frame_sink *as,
+                              struct sc_async_sink_stats *stats) {
+    sc_async_sink_counters_get(&as->counters, stats);
+}
+
+static bool
+sc_async_packet_is_config(const AVPacket *packet) {
+    return packet->pts == AV_NOPTS_VALUE;
+}
+
+static void
+sc_async_packet_destroy(struct sc_async_packet *apacket) {
+    av_packet_free(&apacket->packet);
+}
+
+static int
+run_async_packet_sink(void *data) {
+    struct sc_async_packet_sink *as = data;
+
+    for (;;) {
+        sc_mutex_lock(&as->mutex);
+
+        while (!as->stopped && sc_vecdeque_is_empty(&as->queue)) {
+            sc_cond_wait(&as->queue_cond, &as->mutex);
+        }
+
+        if (sc_vecdeque_is_empty(&as->queue)) {
+            // Stopped, and all the packets have been delivered
+            assert(as->stopped);
+            sc_mutex_unlock(&as->mutex);
+            break;
+        }
+
+        struct sc_async_packet apacket = sc_vecdeque_pop(&as->queue);
+        sc_async_sink_counters_set_queued(&as->counters,
+                                          sc_vecdeque_size(&as->queue));
+        sc_mutex_unlock(&as->mutex);
+
+        sc_async_sink_counters_delivered(&as->counters, apacket.push_date);
+        bool ok = sc_packet_source_sinks_push(&as->packet_source,
+                                              apacket.packet);
+        sc_async_packet_destroy(&apacket);
+        if (!ok) {
+            LOGE("Async sink '%s': packet could not be pushed, stopping",
+                 as->name);
+            sc_mutex_lock(&as->mutex);
+            // Fail on the next push
+            as->failed = true;
+            sc_mutex_unlock(&as->mutex);
+            break;
+        }
+    }
+
+    LOGD("Async sink '%s': thread ended", as->name);
+
+    return 0;
+}
+
+static bool
+sc_async_packet_sink_open(struct sc_packet_sink *sink, AVCodecContext *ctx) {
+    struct sc_async_packet_sink *as = DOWNCAST_PACKET(sink);
+
+    bool ok = sc_mutex_init(&as->mutex);
+    if (!ok) {
+        return false;
+    }
+
+    ok = sc_cond_init(&as->queue_cond);
+    if (!ok) {
+        goto error_destroy_mutex;
+    }
+
+    sc_vecdeque_init(&as->queue);
+    // Never allocate once started
+    ok = sc_vecdeque_reserve(&as->queue, as->capacity);
+    if (!ok) {
+        LOG_OOM();
+        goto error_destroy_cond;
+    }
+
+    as->skipping = false;
+    as->stopped = false;
+    as->failed = false;
+
+    if (!sc_packet_source_sinks_open(&as->packet_source, ctx)) {
+        goto error_destroy_queue;
+    }
+
+    ok = sc_thread_create(&as->thread, run_async_packet_sink, "scrcpy-async",
+                          as);
+    if (!ok) {
+        LOGE("Async sink '%s': could not start thread", as->name);
+        goto error_close_sinks;
+    }
+
+    return true;
+
+error_close_sinks:
+    sc_packet_source_sinks_close(&as->packet_source);
+error_destroy_queue:
+    sc_vecdeque_destroy(&as->queue);
+error_destroy_cond:
+    sc_cond_destroy(&as->queue_cond);
+error_destroy_mutex:
+    sc_mutex_destroy(&as->mutex);
+
+    return false;
+}
+
+static void
+sc_async_packet_sink_close(struct sc_packet_sink *sink) {
+    struct sc_async_packet_sink *as = DOWNCAST_PACKET(sink);
+
+    sc_mutex_lock(&as->mutex);
+    // The thread delivers the remaining packets before exiting
+    as->stopped = true;
+    sc_cond_signal(&as->queue_cond);
+    sc_mutex_unlock(&as->mutex);
+
+    sc_thread_join(&as->thread, NULL);
+
+    sc_packet_source_sinks_close(&as->packet_source);
+
+    // Non-empty only if the sinks failed
+    while (!sc_vecdeque_is_empty(&as->queue)) {
+        struct sc_async_packet *apacket = sc_vecdeque_popref(&as->queue);
+        sc_async_packet_destroy(apacket);
+    }
+    sc_vecdeque_destroy(&as->queue);
+
+    sc_async_sink_log_stats(as->name, &as->counters);
+
+    sc_cond_destroy(&as->queue_cond);
+    sc_mutex_destroy(&as->mutex);
+}
+
+// Drop all the queued packets but the config packets
+static void
+sc_async_packet_sink_drop_queue(struct sc_async_packet_sink *as) {
+    size_t size = sc_vecdeque_size(&as->queue);
+    uint64_t dropped = 0;
+    for (size_t i = 0; i < size; ++i) {
+        struct sc_async_packet apacket = sc_vecdeque_pop(&as->queue);
+        if (sc_async_packet_is_config(apacket.packet)) {
+            // Keep it (there is room, since it has just been popped)
+            sc_vecdeque_push_noresize(&as->queue, apacket);
+        } else {
+            sc_async_packet_destroy(&apacket);
+            ++dropped;
+        }
+    }
+
+    sc_async_sink_counters_add(&as->counters.dropped, dropped);
+}
+
+static bool
+sc_async_packet_sink_push(struct sc_packet_sink *sink,
+                          const AVPacket *packet) {
+    struct sc_async_packet_sink *as = DOWNCAST_PACKET(sink);
+
+    bool config = sc_async_packet_is_config(packet);
+    bool key_frame = packet->flags & AV_PKT_FLAG_KEY;
+
+    sc_mutex_lock(&as->mutex);
+
+    if (as->failed) {
+        sc_mutex_unlock(&as->mutex);
+        return false;
+    }
+
+    sc_async_sink_counters_add(&as->counters.pushed, 1);
+
+    if (as->skipping && !config) {
+        if (!key_frame) {
+            // Wait for the next key frame
+            sc_async_sink_counters_add(&as->counters.dropped, 1);
+            sc_mutex_unlock(&as->mutex);
+            return true;
+        }
+
+        LOGD("Async sink '%s': resuming on key frame", as->name);
+        as->skipping = false;
+    }
+
+    if (sc_vecdeque_size(&as->queue) >= as->capacity) {
+        // The sinks do not keep up: drop the queued packets, and the next
+        // ones until a key frame (the packets depend on the previous ones)
+        LOGD("Async sink '%s': queue full, dropping packets until the next "
+             "key frame", as->name);
+        sc_async_packet_sink_drop_queue(as);
+        if (!config && !key_frame) {
+            as->skipping = true;
+            sc_async_sink_counters_add(&as->counters.dropped, 1);
+            sc_async_sink_counters_set_queued(&as->counters,
+                                              sc_vecdeque_size(&as->queue));
+            sc_mutex_unlock(&as->mutex);
+            return true;
+        }
+
+        if (sc_vecdeque_size(&as->queue) >= as->capacity) {
+            // Only config packets: drop the oldest one
+            struct sc_async_packet *dropped = sc_vecdeque_popref(&as->queue);
+            sc_async_packet_destroy(dropped);
+            sc_async_sink_counters_add(&as->counters.dropped, 1);
+        }
+    }
+
+    struct sc_async_packet apacket;
+    apacket.packet = av_packet_clone(packet);
+    if (!apacket.packet) {
+        sc_mutex_unlock(&as->mutex);
+        LOG_OOM();
+        return false;
+    }
+    apacket.push_date = sc_tick_now();
+
+    sc_vecdeque_push_noresize(&as->queue, apacket);
+    sc_async_sink_counters_set_queued(&as->counters,
+                                      sc_vecdeque_size(&as->queue));
+    sc_cond_signal(&as->queue_cond);
+
+    sc_mutex_unlock(&as->mutex);
+
+    return true;
+}
+
+static void
+sc_async_packet_sink_disable(struct sc_packet_sink *sink) {
+    struct sc_async_packet_sink *as = DOWNCAST_PACKET(sink);
+
+    // Not opened, no thread
+    sc_packet_source_sinks_disable(&as->packet_source);
+}
+
+void
+sc_async_packet_sink_init(struct sc_async_packet_sink *as, const char *name,
+                          size_t capacity) {
+    assert(capacity);
+
+    as->name = name; // statically allocated
+    as->capacity = capacity;
+
+    sc_packet_source_init(&as->packet_source);
+    sc_async_sink_counters_init(&as->counters);
+
+    static const struct sc_packet_sink_ops ops = {
+        .open = sc_async_packet_sink_open,
+        .close = sc_async_packet_sink_close,
+        .push = sc_async_packet_sink_push,
+        .disable = sc_async_packet_sink_disable,
+    };
+
+    as->packet_sink.ops = &ops;
+}
+
+void
+sc_async_packet_sink_destroy(struct sc_async_packet_sink *as) {
+    sc_packet_source_destroy(&as->packet_source);
+}
+
+void
+sc_async_packet_sink_get_stats(struct sc_async_packet_sink *as,
+                               struct sc_async_sink_stats *stats) {
+    sc_async_sink_counters_get(&as->counters, stats);
+}
@@ -0,0 +1,154 @@
+#ifndef SC_ASYNC_SINK_H
+#define SC_ASYNC_SINK_H
+
+#include "common.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <libavcodec/avcodec.h>
+
+#include "trait/frame_sink.h"
+#include "trait/frame_source.h"
+#include "trait/packet_sink.h"
+#include "trait/packet_source.h"
+#include "util/thread.h"
+#include "util/tick.h"
+#include "util/vecdeque.h"
+
+/**
+ * Asynchronous adapters, to deliver the frames or packets to their sinks from
+ * a separate thread, so that a slow sink never stalls the producer (and the
+ * other sinks).
+ *
+ * An adapter is a sink (to be added to the producer) and a source (to which
+ * the actual sinks are added). The queue is bounded: when the sinks do not
+ * keep up, frames or packets are dropped (according to the policy for frames).
+ */
+
+enum sc_async_frame_policy {
+    // Keep only the latest frame (like sc_frame_buffer)
+    SC_ASYNC_FRAME_POLICY_LATEST,
+    // Keep up to "capacity" frames, drop the oldest when full
+    SC_ASYNC_FRAME_POLICY_FIFO,
+};
+
+struct sc_async_sink_stats {
+    uint64_t pushed; // received from the producer
+    uint64_t delivered; // pushed to the sinks
+    uint64_t dropped;
+    uint32_t queued; // currently in the queue
+    uint32_t max_queued;
+    // Time spent in the queue
+    sc_tick avg_lag;
+    sc_tick max_lag;
+};
+
+// Statistics, written by the adapter threads, readable from any thread
+struct sc_async_sink_counters {
+    atomic_uint_least64_t pushed;
+    atomic_uint_least64_t delivered;
+    atomic_uint_least64_t dropped;
+    atomic_uint_least32_t queued;
+    atomic_uint_least32_t max_queued;
+    atomic_int_least64_t total_lag;
+    atomic_int_least64_t max_lag;
+};
+
+struct sc_async_frame {
+    AVFrame *frame;
+    sc_tick push_date;
+};
+
+struct sc_async_frame_queue SC_VECDEQUE(struct sc_async_frame);
+
+struct sc_async_frame_sink {
+    struct sc_frame_source frame_source; // frame source trait
+    struct sc_frame_sink frame_sink; // frame sink trait
+
+    const char *name;
+    enum sc_async_frame_policy policy;
+    size_t capacity;
+
+    sc_thread thread;
+    sc_mutex mutex;
+    sc_cond queue_cond;
+
+    struct sc_async_frame_queue queue;
+    bool stopped;
+    bool failed;
+
+    struct sc_async_sink_counters counters;
+};
+
+struct sc_async_packet {
+    AVPacket *packet;
+    sc_tick push_date;
+};
+
+struct sc_async_packet_queue SC_VECDEQUE(struct sc_async_packet);
+
+struct sc_async_packet_sink {
+    struct sc_packet_source packet_source; // packet source trait
+    struct sc_packet_sink packet_sink; // packet sink trait
+
+    const char *name;
+    size_t capacity;
+
+    sc_thread thread;
+    sc_mutex mutex;
+    sc_cond queue_cond;
+
+    struct sc_async_packet_queue queue;
+    // Set when packets have been dropped, until the next key frame
+    bool skipping;
+    bool stopped;
+    bool failed;
+
+    struct sc_async_sink_counters counters;
+};
+
+/**
+ * Initialize an asynchronous packet sink
+ *
+ * When the queue is full, all the queued media packets are dropped (but not
+ * the config packets), and the next packets are dropped until the next key
+ * frame, so that the sinks never receive a broken GOP.
+ *
+ * The packets still queued on close are delivered (for example, a recorder
+ * must not lose the end of the stream).
+ */
+/**
+ * Initialize an asynchronous frame sink
+ *
+ * The capacity is ignored for SC_ASYNC_FRAME_POLICY_LATEST. The frames still
+ * queued on close are dropped.
+ *
+ * A frame following a dropped frame is never delivered as unchanged (see
+ * sc_frame_is_unchanged()) unless the dropped frame was itself unchanged: the
+ * sinks did not receive the content it is compared to.
+ */
+void
+sc_async_frame_sink_init(struct sc_async_frame_sink *as, const char *name,
+                         enum sc_async_frame_policy policy, size_t capacity);
+
+void
+sc_async_frame_sink_destroy(struct sc_async_frame_sink *as);
+
+void
+sc_async_frame_sink_get_stats(struct sc_async_frame_sink *as,
+                              struct sc_async_sink_stats *stats);
+
+void
+sc_async_packet_sink_init(struct sc_async_packet_sink *as, const char *name,
+                          size_t capacity);
+
+void
+sc_async_packet_sink_destroy(struct sc_async_packet_sink *as);
+
+void
+sc_async_packet_sink_get_stats(struct sc_async_packet_sink *as,
+                               struct sc_async_sink_stats *stats);
+
+#endif
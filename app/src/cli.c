@@ -116,6 +116,22 @@ enum {
     OPT_DISPLAY_IME_POLICY,
     OPT_WEB_SERVER_ADDRESS,
     OPT_WEB_SERVER_PORT,
+    OPT_RECORD_TEE,
+    OPT_WEB_SERVER_HLS,
+    OPT_RTP_HOST,
+    OPT_RTP_PORT,
+    OPT_RTP_MTU,
+    OPT_RTP_SDP,
+    OPT_DUMP_STREAMS,
+    OPT_REPLAY_STREAMS,
+    OPT_REPLAY_FAST,
+    OPT_NO_ADB,
+    OPT_DECODER_THREADS,
+    OPT_DECODER_THREAD_TYPE,
+    OPT_WEB_SERVER_THUMBNAIL,
+    OPT_WEB_SERVER_THUMBNAIL_INTERVAL,
+    OPT_VIDEO_BUFFER_MAX,
+    OPT_VSYNC,
 };
 
 struct sc_option {
@@ -355,6 +371,31 @@ static const struct sc_option options[] = {
                 "The values are expressed in the device natural orientation "
                 "(typically, portrait for a phone, landscape for a tablet).",
     },
+    {
+        .longopt_id = OPT_DECODER_THREAD_TYPE,
+        .longopt = "decoder-thread-type",
+        .argdesc = "type",
+        .text = "Select the threading of the video decoder (when "
+                "--decoder-threads is not 1).\n"
+                "Possible values are \"auto\", \"slice\" and \"frame\".\n"
+                "Slice threading does not add latency, but it is only "
+                "effective if the device encoder produces several slices per "
+                "frame. Frame threading is always effective, but it adds up "
+                "to one frame of latency per additional thread.\n"
+                "\"auto\" selects slice threading if the decoder supports "
+                "it, frame threading otherwise.\n"
+                "Default is auto.",
+    },
+    {
+        .longopt_id = OPT_DECODER_THREADS,
+        .longopt = "decoder-threads",
+        .argdesc = "value",
+        .text = "Set the number of threads of the video software decoder "
+                "(0 for automatic, depending on the number of CPUs).\n"
+                "It may be necessary to decode high resolution H.265 or AV1 "
+                "streams.\n"
+                "Default is 1.",
+    },
     {
         .shortopt = 'd',
         .longopt = "select-usb",
@@ -411,6 +452,16 @@ static const struct sc_option options[] = {
                 "before the rotation.\n"
                 "Default is 0.",
     },
+    {
+        .longopt_id = OPT_DUMP_STREAMS,
+        .longopt = "dump-streams",
+        .argdesc = "dir",
+        .text = "Capture the raw bytes received on the video, audio and "
+                "control sockets, with their receive time, into files in the "
+                "given (existing) directory.\n"
+                "They can be replayed later without a device by "
+                "--replay-streams.",
+    },
     {
         .shortopt = 'e',
         .longopt = "select-tcpip",
@@ -634,6 +685,15 @@ static const struct sc_option options[] = {
                 "    --new-display         # main display size and density\n"
                 "    --new-display=/240    # main display size and 240 dpi",
     },
+    {
+        .longopt_id = OPT_NO_ADB,
+        .longopt = "no-adb",
+        .text = "Do not use adb: connect directly to a server already "
+                "listening on --tunnel-host:--tunnel-port (typically "
+                "scrcpy-fake-device, to run the client without any device).\n"
+                "The server must be configured with the same video, audio "
+                "and control settings.",
+    },
     {
         .longopt_id = OPT_NO_AUDIO,
         .longopt = "no-audio",
@@ -826,6 +886,19 @@ static const struct sc_option options[] = {
                 "the clockwise rotation in degrees.\n"
                 "Default is 0.",
     },
+    {
+        .longopt_id = OPT_RECORD_TEE,
+        .longopt = "record-tee",
+        .argdesc = "[video:|audio:]file",
+        .text = "Also record to another file, from the same stream as "
+                "--record (without encoding or capturing it twice).\n"
+                "The format is determined by the file extension.\n"
+                "The optional prefix selects the stream to record to this "
+                "file. By default, all the streams supported by the container "
+                "are recorded.\n"
+                "This option may be passed up to "
+                STR(SC_MAX_RECORD_TEES) " times.",
+    },
     {
         .longopt_id = OPT_RENDER_DRIVER,
         .longopt = "render-driver",
@@ -836,6 +909,21 @@ static const struct sc_option options[] = {
                 "\"opengles2\", \"opengles\", \"metal\" and \"software\".\n"
                 "<https://wiki.libsdl.org/SDL_HINT_RENDER_DRIVER>",
     },
+    {
+        .longopt_id = OPT_REPLAY_FAST,
+        .longopt = "replay-fast",
+        .text = "Replay the streams as fast as possible, instead of in real "
+                "time.",
+    },
+    {
+        .longopt_id = OPT_REPLAY_STREAMS,
+        .longopt = "replay-streams",
+        .argdesc = "dir",
+        .text = "Read the video and audio streams from the files captured by "
+                "--dump-streams in the given directory, instead of a "
+                "device.\n"
+                "Control is disabled.",
+    },
     {
         .longopt_id = OPT_REQUIRE_AUDIO,
         .longopt = "require-audio",
@@ -849,6 +937,37 @@ static const struct sc_option options[] = {
         .longopt = "rotation",
         .argdesc = "value",
     },
+    {
+        .longopt_id = OPT_RTP_HOST,
+        .longopt = "rtp-host",
+        .argdesc = "ip",
+        .text = "Set the destination IP address of the RTP streams.\n"
+                "Default is 127.0.0.1.",
+    },
+    {
+        .longopt_id = OPT_RTP_MTU,
+        .longopt = "rtp-mtu",
+        .argdesc = "bytes",
+        .text = "Set the maximum size of the RTP datagrams. Larger video "
+                "NAL units are fragmented.\n"
+                "Default is " STR(SC_RTP_DEFAULT_MTU) ".",
+    },
+    {
+        .longopt_id = OPT_RTP_PORT,
+        .longopt = "rtp-port",
+        .argdesc = "port",
+        .text = "Send the video and audio streams over RTP/UDP (without "
+                "re-encoding), the video to the given port and the audio to "
+                "port + 2.\n"
+                "Only H.264 and H.265 video and Opus audio are supported.",
+    },
+    {
+        .longopt_id = OPT_RTP_SDP,
+        .longopt = "rtp-sdp",
+        .argdesc = "file",
+        .text = "Write the SDP file describing the RTP session (to be opened "
+                "by the receiver).",
+    },
     {
         .shortopt = 's',
         .longopt = "serial",
@@ -985,6 +1104,17 @@ static const struct sc_option options[] = {
                 "This increases latency to compensate for jitter.\n"
                 "Default is 0 (no buffering).",
     },
+    {
+        .longopt_id = OPT_VIDEO_BUFFER_MAX,
+        .longopt = "video-buffer-max",
+        .argdesc = "ms",
+        .text = "Make the video buffering adaptive: the delay follows the "
+                "measured jitter, between --video-buffer (the minimum) and "
+                "this maximum (in milliseconds).\n"
+                "It grows as soon as the frames arrive late, and shrinks "
+                "slowly when the network gets better.\n"
+                "Default is 0 (fixed buffering delay).",
+    },
     {
         .longopt_id = OPT_VIDEO_CODEC,
         .longopt = "video-codec",
@@ -1020,6 +1150,16 @@ static const struct sc_option options[] = {
                 "Camera mirroring requires Android 12+.\n"
                 "Default is display.",
     },
+    {
+        .longopt_id = OPT_VSYNC,
+        .longopt = "vsync",
+        .text = "Present the frames in sync with the display refresh: the "
+                "latest frame is rendered just before each vertical blank, "
+                "and presented with vsync.\n"
+                "This improves the frame pacing when the device frame rate "
+                "is higher than the display refresh rate, at the cost of up "
+                "to one refresh period of additional latency.",
+    },
     {
         .shortopt = 'w',
         .longopt = "stay-awake",
@@ -1079,6 +1219,31 @@ static const struct sc_option options[] = {
         .text = "Set the web server listening port.\n"
                 "Default is 4001.",
     },
+    {
+        .longopt_id = OPT_WEB_SERVER_HLS,
+        .longopt = "http-hls",
+        .text = "Serve the video (and audio) stream as low-latency HLS from "
+                "the web server, under /api/v1/hls/index.m3u8.\n"
+                "The segments are kept in memory.",
+    },
+    {
+        .longopt_id = OPT_WEB_SERVER_THUMBNAIL,
+        .longopt = "http-thumbnail",
+        .text = "Serve a small JPEG thumbnail of the device screen from the "
+                "web server, under /api/v1/thumbnail.\n"
+                "Only the video key frames are decoded, so the thumbnail is "
+                "updated at the key frame interval of the device encoder "
+                "(see --http-thumbnail-interval).",
+    },
+    {
+        .longopt_id = OPT_WEB_SERVER_THUMBNAIL_INTERVAL,
+        .longopt = "http-thumbnail-interval",
+        .argdesc = "ms",
+        .text = "Request a key frame from the device if none has been "
+                "received for this delay, to refresh the thumbnail.\n"
+                "It requires control, and implies --http-thumbnail.\n"
+                "Default is 0 (never request key frames).",
+    },
 };
 
 static const struct sc_shortcut shortcuts[] = {
@@ -1985,6 +2150,49 @@ parse_port(const char *optarg, uint16_t *port) {
     return true;
 }
 
+static bool
+parse_decoder_threads(const char *s, uint16_t *threads) {
+    long value;
+    if (!parse_integer_arg(s, &value, false, 0, 64, "decoder threads")) {
+        return false;
+    }
+    *threads = (uint16_t) value;
+    return true;
+}
+
+static bool
+parse_decoder_thread_type(const char *s, enum sc_decoder_thread_type *type) {
+    if (!strcmp(s, "auto")) {
+        *type = SC_DECODER_THREAD_TYPE_AUTO;
+        return true;
+    }
+
+    if (!strcmp(s, "slice")) {
+        *type = SC_DECODER_THREAD_TYPE_SLICE;
+        return true;
+    }
+
+    if (!strcmp(s, "frame")) {
+        *type = SC_DECODER_THREAD_TYPE_FRAME;
+        return true;
+    }
+
+    LOGE("Unsupported decoder thread type: %s (expected auto, slice or "
+         "frame)", s);
+    return false;
+}
+
+static bool
+parse_rtp_mtu(const char *s, uint16_t *mtu) {
+    long value;
+    // The datagrams must fit in a UDP packet over IPv4
+    if (!parse_integer_arg(s, &value, false, 64, 65507, "RTP MTU")) {
+        return false;
+    }
+    *mtu = (uint16_t) value;
+    return true;
+}
+
 static enum sc_record_format
 guess_record_format(const char *filename) {
     const char *dot = strrchr(filename, '.');
@@ -1996,6 +2204,134 @@ guess_record_format(const char *filename) {
     return get_record_format(ext);
 }
 
+static bool
+parse_record_tee(const char *optarg, struct scrcpy_options *opts) {
+    if (opts->record_tee_count == SC_MAX_RECORD_TEES) {
+        LOGE("Too many --record-tee (max %d)", SC_MAX_RECORD_TEES);
+        return false;
+    }
+
+    struct sc_record_tee *tee = &opts->record_tees[opts->record_tee_count];
+
+    if (!strncmp(optarg, "video:", 6)) {
+        tee->streams = SC_RECORD_STREAMS_VIDEO;
+        optarg += 6;
+    } else if (!strncmp(optarg, "audio:", 6)) {
+        tee->streams = SC_RECORD_STREAMS_AUDIO;
+        optarg += 6;
+    } else {
+        tee->streams = SC_RECORD_STREAMS_ALL;
+    }
+
+    if (!*optarg) {
+        LOGE("Missing file for --record-tee");
+        return false;
+    }
+
+    tee->filename = optarg;
+    tee->format = guess_record_format(optarg);
+    if (!tee->format) {
+        LOGE("No format detected for \"%s\" (expected mp4, mkv, m4a, mka, "
+             "opus, aac, flac or wav extension)", optarg);
+        return false;
+    }
+
+    ++opts->record_tee_count;
+    return true;
+}
+
+static bool
+validate_record_format(const struct scrcpy_options *opts,
+                       enum sc_record_format format, bool video, bool audio) {
+    if (video && sc_record_format_is_audio_only(format)) {
+        LOGE("Audio container does not support video stream");
+        return false;
+    }
+
+    if (!audio) {
+        // The audio codec does not matter
+        return true;
+    }
+
+    if (format == SC_RECORD_FORMAT_OPUS && opts->audio_codec != SC_CODEC_OPUS) {
+        LOGE("Recording to OPUS file requires an OPUS audio stream "
+             "(try with --audio-codec=opus)");
+        return false;
+    }
+
+    if (format == SC_RECORD_FORMAT_AAC && opts->audio_codec != SC_CODEC_AAC) {
+        LOGE("Recording to AAC file requires an AAC audio stream "
+             "(try with --audio-codec=aac)");
+        return false;
+    }
+
+    if (format == SC_RECORD_FORMAT_FLAC && opts->audio_codec != SC_CODEC_FLAC) {
+        LOGE("Recording to FLAC file requires a FLAC audio stream "
+             "(try with --audio-codec=flac)");
+        return false;
+    }
+
+    if (format == SC_RECORD_FORMAT_WAV && opts->audio_codec != SC_CODEC_RAW) {
+        LOGE("Recording to WAV file requires a RAW audio stream "
+             "(try with --audio-codec=raw)");
+        return false;
+    }
+
+    if ((format == SC_RECORD_FORMAT_MP4 || format == SC_RECORD_FORMAT_M4A)
+            && opts->audio_codec == SC_CODEC_RAW) {
+        LOGE("Recording to MP4 container does not support RAW audio");
+        return false;
+    }
+
+    return true;
+}
+
+static bool
+resolve_record_tee(const struct scrcpy_options *opts,
+                   struct sc_record_tee *tee) {
+    bool audio_only = sc_record_format_is_audio_only(tee->format);
+
+    if (tee->streams == SC_RECORD_STREAMS_ALL) {
+        // Record all the streams supported by the container
+        if (!opts->audio) {
+            tee->streams = SC_RECORD_STREAMS_VIDEO;
+        } else if (!opts->video || audio_only) {
+            tee->streams = SC_RECORD_STREAMS_AUDIO;
+        }
+    }
+
+    bool video = tee->streams != SC_RECORD_STREAMS_AUDIO;
+    bool audio = tee->streams != SC_RECORD_STREAMS_VIDEO;
+
+    if (video && !opts->video) {
+        LOGE("Could not record video to \"%s\": video is disabled",
+             tee->filename);
+        return false;
+    }
+
+    if (audio && !opts->audio) {
+        LOGE("Could not record audio to \"%s\": audio is disabled",
+             tee->filename);
+        return false;
+    }
+
+    if (!strcmp(tee->filename, opts->record_filename)) {
+        LOGE("--record-tee file must differ from the --record file: %s",
+             tee->filename);
+        return false;
+    }
+
+    for (const struct sc_record_tee *other = opts->record_tees; other != tee;
+            ++other) {
+        if (!strcmp(tee->filename, other->filename)) {
+            LOGE("Duplicate --record-tee file: %s", tee->filename);
+            return false;
+        }
+    }
+
+    return validate_record_format(opts, tee->format, video, audio);
+}
+
 static bool
 parse_video_codec(const char *optarg, enum sc_codec *codec) {
     if (!strcmp(optarg, "h264")) {
@@ -2246,6 +2582,19 @@ parse_gamepad(const char *optarg, enum sc_gamepad_input_mode *mode) {
     return false;
 }
 
+static bool
+parse_thumbnail_interval(const char *s, sc_tick *tick) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 0, 0x7FFFFFFF,
+                                "thumbnail interval");
+    if (!ok) {
+        return false;
+    }
+
+    *tick = SC_TICK_FROM_MS(value);
+    return true;
+}
+
 static bool
 parse_time_limit(const char *s, sc_tick *tick) {
     long value;
@@ -2482,6 +2831,33 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
                     return false;
                 }
                 break;
+            case OPT_RTP_HOST:
+                if (!parse_ip(optarg, &opts->rtp_host)) {
+                    return false;
+                }
+                break;
+            case OPT_RTP_PORT:
+                if (!parse_port(optarg, &opts->rtp_port)) {
+                    return false;
+                }
+                break;
+            case OPT_RTP_MTU:
+                if (!parse_rtp_mtu(optarg, &opts->rtp_mtu)) {
+                    return false;
+                }
+                break;
+            case OPT_RTP_SDP:
+                opts->rtp_sdp_filename = optarg;
+                break;
+            case OPT_DUMP_STREAMS:
+                opts->dump_streams_dir = optarg;
+                break;
+            case OPT_REPLAY_STREAMS:
+                opts->replay_streams_dir = optarg;
+                break;
+            case OPT_REPLAY_FAST:
+                opts->replay_fast = true;
+                break;
             case 'n':
                 opts->control = false;
                 break;
@@ -2587,6 +2963,11 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
                     return false;
                 }
                 break;
+            case OPT_RECORD_TEE:
+                if (!parse_record_tee(optarg, opts)) {
+                    return false;
+                }
+                break;
             case OPT_ORIENTATION: {
                 enum sc_orientation orientation;
                 if (!parse_orientation(optarg, &orientation)) {
@@ -2602,6 +2983,9 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
             case OPT_NO_MIPMAPS:
                 opts->mipmaps = false;
                 break;
+            case OPT_VSYNC:
+                opts->vsync = true;
+                break;
             case OPT_NO_KEY_REPEAT:
                 opts->forward_key_repeat = false;
                 break;
@@ -2655,6 +3039,11 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
                     return false;
                 }
                 break;
+            case OPT_VIDEO_BUFFER_MAX:
+                if (!parse_buffering_time(optarg, &opts->video_buffer_max)) {
+                    return false;
+                }
+                break;
             case OPT_NO_CLIPBOARD_AUTOSYNC:
                 opts->clipboard_autosync = false;
                 break;
@@ -2668,6 +3057,20 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
             case OPT_NO_VIDEO:
                 opts->video = false;
                 break;
+            case OPT_NO_ADB:
+                opts->no_adb = true;
+                break;
+            case OPT_DECODER_THREADS:
+                if (!parse_decoder_threads(optarg, &opts->decoder_threads)) {
+                    return false;
+                }
+                break;
+            case OPT_DECODER_THREAD_TYPE:
+                if (!parse_decoder_thread_type(optarg,
+                                               &opts->decoder_thread_type)) {
+                    return false;
+                }
+                break;
             case OPT_NO_AUDIO:
                 opts->audio = false;
                 break;
@@ -2855,6 +3258,19 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
                     opts->web_server_port = (uint16_t) value;
                 }
                 break;
+            case OPT_WEB_SERVER_HLS:
+                opts->web_server_hls = true;
+                break;
+            case OPT_WEB_SERVER_THUMBNAIL:
+                opts->web_server_thumbnail = true;
+                break;
+            case OPT_WEB_SERVER_THUMBNAIL_INTERVAL:
+                if (!parse_thumbnail_interval(optarg,
+                        &opts->web_server_thumbnail_interval)) {
+                    return false;
+                }
+                opts->web_server_thumbnail = true;
+                break;
             default:
                 // getopt prints the error message on stderr
                 return false;
@@ -2905,18 +3321,40 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
         opts->power_on = false;
     }
 
+    if (opts->replay_streams_dir) {
+        if (opts->dump_streams_dir) {
+            LOGE("Could not both dump and replay the streams");
+            return false;
+        }
+
+        if (otg || opts->list) {
+            LOGE("--replay-streams requires the video or audio streams");
+            return false;
+        }
+
+        if (opts->control) {
+            LOGI("Replay: control disabled");
+            opts->control = false;
+        }
+    } else if (opts->replay_fast) {
+        LOGE("--replay-fast requires --replay-streams");
+        return false;
+    }
+
     if (!opts->audio) {
         opts->audio_playback = false;
     }
 
     if (opts->video && !opts->video_playback && !opts->record_filename
-            && !v4l2) {
-        LOGI("No video playback, no recording, no V4L2 sink: video disabled");
+            && !v4l2 && !opts->rtp_port) {
+        LOGI("No video playback, no recording, no V4L2 sink, no RTP: video "
+             "disabled");
         opts->video = false;
     }
 
-    if (opts->audio && !opts->audio_playback && !opts->record_filename) {
-        LOGI("No audio playback, no recording: audio disabled");
+    if (opts->audio && !opts->audio_playback && !opts->record_filename
+            && !opts->rtp_port) {
+        LOGI("No audio playback, no recording, no RTP: audio disabled");
         opts->audio = false;
     }
 
@@ -2930,6 +3368,12 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
         opts->require_audio = true;
     }
 
+    if (opts->video_buffer_max
+            && opts->video_buffer_max <= opts->video_buffer) {
+        LOGE("--video-buffer-max must be greater than --video-buffer");
+        return false;
+    }
+
     if (opts->audio_playback && opts->audio_buffer == -1) {
         if (opts->audio_codec == SC_CODEC_FLAC) {
             // Use 50 ms audio buffer by default, but use a higher value for
@@ -3099,6 +3543,18 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
         return false;
     }
 
+    if (opts->no_adb) {
+        if (!opts->tunnel_port) {
+            LOGE("--no-adb requires --tunnel-port");
+            return false;
+        }
+
+        if (otg || opts->tcpip || opts->list) {
+            LOGE("--no-adb is incompatible with --otg, --tcpip and --list-*");
+            return false;
+        }
+    }
+
     if ((opts->tunnel_host || opts->tunnel_port) && !opts->force_adb_forward) {
         LOGI("Tunnel host/port is set, "
              "--force-adb-forward automatically enabled.");
@@ -3197,6 +3653,11 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
         return false;
     }
 
+    if (opts->record_tee_count && !opts->record_filename) {
+        LOGE("--record-tee requires --record");
+        return false;
+    }
+
     if (opts->record_filename) {
         if (!opts->video && !opts->audio) {
             LOGE("Video and audio disabled, nothing to record");
@@ -3222,45 +3683,61 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
             }
         }
 
-        if (opts->video
-                && sc_record_format_is_audio_only(opts->record_format)) {
-            LOGE("Audio container does not support video stream");
+        if (!validate_record_format(opts, opts->record_format, opts->video,
+                                    opts->audio)) {
             return false;
         }
 
-        if (opts->record_format == SC_RECORD_FORMAT_OPUS
-                && opts->audio_codec != SC_CODEC_OPUS) {
-            LOGE("Recording to OPUS file requires an OPUS audio stream "
-                 "(try with --audio-codec=opus)");
-            return false;
+        for (unsigned i = 0; i < opts->record_tee_count; ++i) {
+            if (!resolve_record_tee(opts, &opts->record_tees[i])) {
+                return false;
+            }
         }
+    }
 
-        if (opts->record_format == SC_RECORD_FORMAT_AAC
-                && opts->audio_codec != SC_CODEC_AAC) {
-            LOGE("Recording to AAC file requires an AAC audio stream "
-                 "(try with --audio-codec=aac)");
+    if (opts->web_server_thumbnail) {
+        if (!opts->video) {
+            LOGE("--http-thumbnail requires video capture, but --no-video was "
+                 "set");
             return false;
         }
-        if (opts->record_format == SC_RECORD_FORMAT_FLAC
-                && opts->audio_codec != SC_CODEC_FLAC) {
-            LOGE("Recording to FLAC file requires a FLAC audio stream "
-                 "(try with --audio-codec=flac)");
+
+        if (opts->web_server_thumbnail_interval && !opts->control) {
+            LOGE("--http-thumbnail-interval requires control to request key "
+                 "frames");
             return false;
         }
+    }
 
-        if (opts->record_format == SC_RECORD_FORMAT_WAV
-                && opts->audio_codec != SC_CODEC_RAW) {
-            LOGE("Recording to WAV file requires a RAW audio stream "
-                 "(try with --audio-codec=raw)");
+    if (!opts->rtp_port && (opts->rtp_host != IPV4_LOCALHOST
+                            || opts->rtp_mtu != SC_RTP_DEFAULT_MTU
+                            || opts->rtp_sdp_filename)) {
+        LOGE("RTP options require --rtp-port");
+        return false;
+    }
+
+    if (opts->rtp_port) {
+        if (!opts->video && !opts->audio) {
+            LOGE("Video and audio disabled, nothing to send over RTP");
             return false;
         }
 
-        if ((opts->record_format == SC_RECORD_FORMAT_MP4 ||
-             opts->record_format == SC_RECORD_FORMAT_M4A)
-                && opts->audio_codec == SC_CODEC_RAW) {
-            LOGE("Recording to MP4 container does not support RAW audio");
+        if (opts->video && opts->video_codec != SC_CODEC_H264
+                && opts->video_codec != SC_CODEC_H265) {
+            LOGE("RTP only supports H.264 and H.265 video (try with "
+                 "--video-codec=h264)");
             return false;
         }
+
+        if (opts->audio) {
+            if (opts->audio_codec != SC_CODEC_OPUS) {
+                LOGW("RTP only supports Opus audio, audio will not be sent");
+            } else if (opts->rtp_port > 0xFFFF - 2) {
+                LOGE("Invalid RTP port for audio (port + 2): %u",
+                     (unsigned) opts->rtp_port);
+                return false;
+            }
+        }
     }
 
     if (opts->audio_codec == SC_CODEC_FLAC && opts->audio_bit_rate) {
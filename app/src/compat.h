@@ -61,6 +61,13 @@
 # define SCRCPY_LAVC_HAS_CODECPAR_CODEC_SIDEDATA
 #endif
 
+// Since the lavf 61 major bump (FF_API_AVIO_WRITE_NONCONST removed), the
+// write_packet callback of avio_alloc_context() takes a pointer-to-const
+// buffer.
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(61, 0, 100)
+# define SCRCPY_LAVF_HAS_AVIO_WRITE_CONST
+#endif
+
 #if SDL_VERSION_ATLEAST(2, 0, 6)
 // <https://github.com/libsdl-org/SDL/commit/d7a318de563125e5bb465b1000d6bc9576fbc6fc>
 # define SCRCPY_SDL_HAS_HINT_TOUCH_MOUSE_EVENTS
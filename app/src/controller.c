@@ -7,6 +7,11 @@
 // Drop droppable events above this limit
 #define SC_CONTROL_MSG_QUEUE_LIMIT 60
 
+// Maximum number of msgs sent with a single send()
+#define SC_CONTROL_MSG_BATCH_COUNT 16
+// Serialized msgs are accumulated up to this size before being sent
+#define SC_CONTROL_MSG_BATCH_SIZE 4096
+
 static void
 sc_controller_receiver_on_ended(struct sc_receiver *receiver, bool error,
                                 void *userdata) {
@@ -124,20 +129,33 @@ sc_controller_push_msg(struct sc_controller *controller,
 }
 
 static bool
-process_msg(struct sc_controller *controller,
-            const struct sc_control_msg *msg, bool *eos) {
-    static uint8_t serialized_msg[SC_CONTROL_MSG_MAX_SIZE];
-    size_t length = sc_control_msg_serialize(msg, serialized_msg);
-    if (!length) {
-        *eos = false;
-        return false;
-    }
-
-    ssize_t w =
-        net_send_all(controller->control_socket, serialized_msg, length);
-    if ((size_t) w != length) {
-        *eos = true;
-        return false;
+process_msgs(struct sc_controller *controller,
+             const struct sc_control_msg *msgs, size_t count, bool *eos) {
+    // A message is serialized only if the buffer contains less than
+    // SC_CONTROL_MSG_BATCH_SIZE bytes, so it always fits
+    static uint8_t serialized_msgs[SC_CONTROL_MSG_BATCH_SIZE
+                                   + SC_CONTROL_MSG_MAX_SIZE];
+    size_t length = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        size_t len = sc_control_msg_serialize(&msgs[i],
+                                              &serialized_msgs[length]);
+        if (!len) {
+            *eos = false;
+            return false;
+        }
+        length += len;
+
+        if (length >= SC_CONTROL_MSG_BATCH_SIZE || i == count - 1) {
+            // Send all the serialized messages at once
+            ssize_t w = net_send_all(controller->control_socket,
+                                     serialized_msgs, length);
+            if ((size_t) w != length) {
+                *eos = true;
+                return false;
+            }
+            length = 0;
+        }
     }
 
     return true;
@@ -162,13 +180,22 @@ run_controller(void *data) {
             break;
         }
 
+        // Take all the pending msgs (typically a burst of mouse events), to
+        // send them with a single syscall
+        struct sc_control_msg msgs[SC_CONTROL_MSG_BATCH_COUNT];
+        size_t count = 0;
         assert(!sc_vecdeque_is_empty(&controller->queue));
-        struct sc_control_msg msg = sc_vecdeque_pop(&controller->queue);
+        do {
+            msgs[count++] = sc_vecdeque_pop(&controller->queue);
+        } while (count < SC_CONTROL_MSG_BATCH_COUNT
+                    && !sc_vecdeque_is_empty(&controller->queue));
         sc_mutex_unlock(&controller->mutex);
 
         bool eos;
-        bool ok = process_msg(controller, &msg, &eos);
-        sc_control_msg_destroy(&msg);
+        bool ok = process_msgs(controller, msgs, count, &eos);
+        for (size_t i = 0; i < count; ++i) {
+            sc_control_msg_destroy(&msgs[i]);
+        }
         if (!ok) {
             if (eos) {
                 LOGD("Controller stopped (socket closed)");
@@ -1,6 +1,8 @@
 #include "decoder.h"
 
+#include <assert.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <libavcodec/packet.h>
 #include <libavutil/avutil.h>
 
@@ -9,6 +11,122 @@
 /** Downcast packet_sink to decoder */
 #define DOWNCAST(SINK) container_of(SINK, struct sc_decoder, packet_sink)
 
+// Intervals between packets longer than this are pauses of the device screen
+// capture, not the frame rate
+#define SC_DECODER_GOVERNOR_MAX_INTERVAL SC_TICK_FROM_MS(100)
+// Minimal interval between two key frame requests
+#define SC_DECODER_KEY_FRAME_REQUEST_INTERVAL SC_TICK_FROM_MS(500)
+
+// Number of consecutive frames to increase or decrease the degradation level
+#define SC_DECODER_GOVERNOR_OVERLOAD_FRAMES 30
+#define SC_DECODER_GOVERNOR_HEADROOM_FRAMES 120
+
+static const char *
+sc_decoder_degradation_name(enum sc_decoder_degradation level) {
+    switch (level) {
+        case SC_DECODER_DEGRADATION_NONE:
+            return "none";
+        case SC_DECODER_DEGRADATION_SKIP_LOOP_FILTER:
+            return "skip loop filter";
+        case SC_DECODER_DEGRADATION_FAST:
+            return "fast decoding";
+        case SC_DECODER_DEGRADATION_SKIP_NONREF:
+            return "skip non-reference frames";
+        default:
+            assert(!"unexpected degradation level");
+            return NULL;
+    }
+}
+
+static void
+sc_decoder_governor_init(struct sc_decoder_governor *gov,
+                         const AVCodecContext *ctx) {
+    gov->enabled = ctx->codec_type == AVMEDIA_TYPE_VIDEO;
+    bool h26x = ctx->codec_id == AV_CODEC_ID_H264
+             || ctx->codec_id == AV_CODEC_ID_HEVC;
+    gov->max_level = h26x ? SC_DECODER_DEGRADATION_SKIP_NONREF
+                          : SC_DECODER_DEGRADATION_FAST;
+    gov->level = SC_DECODER_DEGRADATION_NONE;
+    gov->last_pts = AV_NOPTS_VALUE;
+    gov->avg_decode_time = 0;
+    gov->avg_interval = 0;
+    gov->overload_count = 0;
+    gov->headroom_count = 0;
+}
+
+static void
+sc_decoder_set_degradation(struct sc_decoder *decoder,
+                           enum sc_decoder_degradation level) {
+    // These fields are read by the FFmpeg decoders for each frame (and copied
+    // to the frame threads), so they may be changed while decoding
+    AVCodecContext *ctx = decoder->ctx;
+    ctx->skip_loop_filter = level >= SC_DECODER_DEGRADATION_SKIP_LOOP_FILTER
+                          ? AVDISCARD_ALL : AVDISCARD_DEFAULT;
+    if (level >= SC_DECODER_DEGRADATION_FAST) {
+        ctx->flags2 |= AV_CODEC_FLAG2_FAST;
+    } else {
+        ctx->flags2 &= ~AV_CODEC_FLAG2_FAST;
+    }
+    ctx->skip_frame = level >= SC_DECODER_DEGRADATION_SKIP_NONREF
+                    ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+
+    LOGI("Decoder '%s': degradation level %d (%s)", decoder->name, (int) level,
+         sc_decoder_degradation_name(level));
+
+    decoder->governor.level = level;
+    atomic_store_explicit(&decoder->degradation, level, memory_order_relaxed);
+}
+
+static void
+sc_decoder_governor_update(struct sc_decoder *decoder, int64_t pts,
+                           sc_tick decode_time) {
+    struct sc_decoder_governor *gov = &decoder->governor;
+    assert(gov->enabled);
+
+    int64_t last_pts = gov->last_pts;
+    gov->last_pts = pts;
+    if (last_pts == AV_NOPTS_VALUE) {
+        return;
+    }
+
+    // The PTS are in microseconds, like the ticks
+    sc_tick interval = pts - last_pts;
+    if (interval <= 0 || interval > SC_DECODER_GOVERNOR_MAX_INTERVAL) {
+        return;
+    }
+
+    if (!gov->avg_interval) {
+        gov->avg_interval = interval;
+        gov->avg_decode_time = decode_time;
+        return;
+    }
+
+    // Exponential moving averages (alpha = 1/16)
+    gov->avg_interval += (interval - gov->avg_interval) / 16;
+    gov->avg_decode_time += (decode_time - gov->avg_decode_time) / 16;
+
+    if (gov->avg_decode_time * 10 > gov->avg_interval * 9) {
+        // Less than 10% of headroom: the decoder is about to fall behind
+        gov->headroom_count = 0;
+        if (++gov->overload_count >= SC_DECODER_GOVERNOR_OVERLOAD_FRAMES
+                && gov->level < gov->max_level) {
+            gov->overload_count = 0;
+            sc_decoder_set_degradation(decoder, gov->level + 1);
+        }
+    } else if (gov->avg_decode_time * 2 < gov->avg_interval) {
+        // More than 50% of headroom: restore the quality, progressively
+        gov->overload_count = 0;
+        if (++gov->headroom_count >= SC_DECODER_GOVERNOR_HEADROOM_FRAMES
+                && gov->level > SC_DECODER_DEGRADATION_NONE) {
+            gov->headroom_count = 0;
+            sc_decoder_set_degradation(decoder, gov->level - 1);
+        }
+    } else {
+        gov->overload_count = 0;
+        gov->headroom_count = 0;
+    }
+}
+
 static bool
 sc_decoder_open(struct sc_decoder *decoder, AVCodecContext *ctx) {
     decoder->frame = av_frame_alloc();
@@ -17,12 +135,36 @@ sc_decoder_open(struct sc_decoder *decoder, AVCodecContext *ctx) {
         return false;
     }
 
+    if (decoder->cbs) {
+        decoder->key_packet = av_packet_alloc();
+        if (!decoder->key_packet) {
+            LOG_OOM();
+            av_frame_free(&decoder->frame);
+            return false;
+        }
+    }
+
     if (!sc_frame_source_sinks_open(&decoder->frame_source, ctx)) {
+        av_packet_free(&decoder->key_packet);
         av_frame_free(&decoder->frame);
         return false;
     }
 
     decoder->ctx = ctx;
+    decoder->video = ctx->codec_type == AVMEDIA_TYPE_VIDEO;
+    decoder->idle = false;
+    decoder->wait_key_frame = false;
+    decoder->recovery_start = 0;
+    decoder->last_key_frame_request = 0;
+
+    sc_decoder_governor_init(&decoder->governor, ctx);
+    sc_static_detector_init(&decoder->static_detector);
+
+    atomic_store_explicit(&decoder->threads, ctx->thread_count,
+                          memory_order_relaxed);
+    atomic_store_explicit(&decoder->frame_threading,
+                          ctx->active_thread_type == FF_THREAD_FRAME,
+                          memory_order_relaxed);
 
     return true;
 }
@@ -30,37 +172,178 @@ sc_decoder_open(struct sc_decoder *decoder, AVCodecContext *ctx) {
 static void
 sc_decoder_close(struct sc_decoder *decoder) {
     sc_frame_source_sinks_close(&decoder->frame_source);
+    av_packet_free(&decoder->key_packet);
     av_frame_free(&decoder->frame);
 }
 
+static void
+sc_decoder_request_key_frame(struct sc_decoder *decoder) {
+    if (!decoder->cbs) {
+        // Wait for the next periodic key frame
+        return;
+    }
+
+    sc_tick now = sc_tick_now();
+    if (decoder->last_key_frame_request
+            && now - decoder->last_key_frame_request
+                < SC_DECODER_KEY_FRAME_REQUEST_INTERVAL) {
+        // Already requested recently
+        return;
+    }
+
+    decoder->last_key_frame_request = now;
+    decoder->cbs->on_key_frame_needed(decoder, decoder->cbs_userdata);
+}
+
+// Called on a decoding error or on a corrupted frame
+static void
+sc_decoder_start_recovery(struct sc_decoder *decoder) {
+    atomic_fetch_add_explicit(&decoder->errors, 1, memory_order_relaxed);
+
+    if (!decoder->video) {
+        // Audio packets are decoded independently, just drop the packet
+        return;
+    }
+
+    if (!decoder->recovery_start) {
+        LOGW("Decoder '%s': decoding error, waiting for a key frame",
+             decoder->name);
+        decoder->recovery_start = sc_tick_now();
+    }
+
+    // The next frames would reference corrupted frames: drop the frames in
+    // flight and the packets until the next key frame
+    avcodec_flush_buffers(decoder->ctx);
+    decoder->wait_key_frame = true;
+    sc_decoder_request_key_frame(decoder);
+}
+
+static void
+sc_decoder_end_recovery(struct sc_decoder *decoder) {
+    assert(decoder->recovery_start);
+
+    sc_tick duration = sc_tick_now() - decoder->recovery_start;
+    decoder->recovery_start = 0;
+
+    LOGI("Decoder '%s': recovered in %" PRItick " ms", decoder->name,
+         SC_TICK_TO_MS(duration));
+
+    atomic_fetch_add_explicit(&decoder->recoveries, 1, memory_order_relaxed);
+    atomic_store_explicit(&decoder->last_recovery_time, duration,
+                          memory_order_relaxed);
+    // Only written by the decoder thread, no need for a compare-and-swap
+    if (duration > atomic_load_explicit(&decoder->max_recovery_time,
+                                        memory_order_relaxed)) {
+        atomic_store_explicit(&decoder->max_recovery_time, duration,
+                              memory_order_relaxed);
+    }
+}
+
 static bool
-sc_decoder_push(struct sc_decoder *decoder, const AVPacket *packet) {
-    bool is_config = packet->pts == AV_NOPTS_VALUE;
-    if (is_config) {
-        // nothing to do
-        return true;
+sc_decoder_is_corrupted(const AVFrame *frame) {
+    // Errors concealed by the decoder, or missing references
+    return frame->decode_error_flags || (frame->flags & AV_FRAME_FLAG_CORRUPT);
+}
+
+// Mark the frame if it is identical to the previous one
+static void
+sc_decoder_detect_unchanged(struct sc_decoder *decoder, AVFrame *frame) {
+    assert(decoder->video);
+
+    bool unchanged = false;
+    if (frame->format == AV_PIX_FMT_YUV420P) {
+        struct sc_static_detector *sd = &decoder->static_detector;
+        bool was_static = sd->is_static;
+
+        const uint8_t *const planes[3] = {
+            frame->data[0], frame->data[1], frame->data[2],
+        };
+        unchanged = sc_static_detector_check_frame(sd, frame->pts, planes,
+                                                   frame->linesize,
+                                                   frame->width, frame->height,
+                                                   sc_tick_now());
+
+        if (sd->is_static != was_static) {
+            LOGD("Decoder '%s': %s", decoder->name,
+                 sd->is_static ? "static screen" : "screen changed");
+            atomic_store_explicit(&decoder->static_screen, sd->is_static,
+                                  memory_order_relaxed);
+        }
+    }
+
+    if (unchanged) {
+        atomic_fetch_add_explicit(&decoder->unchanged_frames, 1,
+                                  memory_order_relaxed);
+    }
+    sc_frame_set_unchanged(frame, unchanged);
+}
+
+static bool
+sc_decoder_decode(struct sc_decoder *decoder, const AVPacket *packet) {
+    if (decoder->video) {
+        sc_static_detector_push_packet(&decoder->static_detector, packet->pts,
+                                       packet->size,
+                                       packet->flags & AV_PKT_FLAG_KEY);
     }
 
+    // The time spent in the sinks is not counted
+    sc_tick decode_time = 0;
+    sc_tick start = sc_tick_now();
+
     int ret = avcodec_send_packet(decoder->ctx, packet);
-    if (ret < 0 && ret != AVERROR(EAGAIN)) {
-        LOGE("Decoder '%s': could not send video packet: %d",
-             decoder->name, ret);
+    if (ret == AVERROR(ENOMEM)) {
+        LOG_OOM();
         return false;
     }
+    if (ret < 0 && ret != AVERROR(EAGAIN)) {
+        LOGD("Decoder '%s': could not send packet: %d", decoder->name, ret);
+        sc_decoder_start_recovery(decoder);
+        return true;
+    }
+
+    atomic_fetch_add_explicit(&decoder->packets, 1, memory_order_relaxed);
 
+    bool received = false;
     for (;;) {
         ret = avcodec_receive_frame(decoder->ctx, decoder->frame);
+        decode_time += sc_tick_now() - start;
         if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
             break;
         }
 
-        if (ret) {
-            LOGE("Decoder '%s', could not receive video frame: %d",
-                 decoder->name, ret);
+        if (ret == AVERROR(ENOMEM)) {
+            LOG_OOM();
             return false;
         }
+        if (ret) {
+            LOGD("Decoder '%s': could not receive frame: %d", decoder->name,
+                 ret);
+            sc_decoder_start_recovery(decoder);
+            return true;
+        }
+
+        if (sc_decoder_is_corrupted(decoder->frame)) {
+            av_frame_unref(decoder->frame);
+            sc_decoder_start_recovery(decoder);
+            if (decoder->wait_key_frame) {
+                // The decoder has been flushed
+                return true;
+            }
+            // Audio, continue
+            start = sc_tick_now();
+            continue;
+        }
+
+        if (decoder->recovery_start) {
+            sc_decoder_end_recovery(decoder);
+        }
 
         // a frame was received
+        received = true;
+        atomic_fetch_add_explicit(&decoder->frames, 1, memory_order_relaxed);
+        if (decoder->video) {
+            sc_decoder_detect_unchanged(decoder, decoder->frame);
+        }
         bool ok = sc_frame_source_sinks_push(&decoder->frame_source,
                                              decoder->frame);
         av_frame_unref(decoder->frame);
@@ -68,11 +351,139 @@ sc_decoder_push(struct sc_decoder *decoder, const AVPacket *packet) {
             // Error already logged
             return false;
         }
+
+        start = sc_tick_now();
+    }
+
+    if (decoder->governor.enabled) {
+        if (!received
+                && decoder->governor.level >= SC_DECODER_DEGRADATION_SKIP_NONREF
+                && decoder->ctx->active_thread_type != FF_THREAD_FRAME) {
+            // Without frame threading, a frame is output for each packet,
+            // unless it is skipped
+            atomic_fetch_add_explicit(&decoder->skipped_frames, 1,
+                                      memory_order_relaxed);
+        }
+        sc_decoder_governor_update(decoder, packet->pts, decode_time);
+    }
+
+    atomic_fetch_add_explicit(&decoder->decode_time, decode_time,
+                              memory_order_relaxed);
+    // Only written by the decoder thread, no need for a compare-and-swap
+    if ((uint64_t) decode_time > atomic_load_explicit(&decoder->max_decode_time,
+                                                      memory_order_relaxed)) {
+        atomic_store_explicit(&decoder->max_decode_time, decode_time,
+                              memory_order_relaxed);
+    }
+
+    return true;
+}
+
+static bool
+sc_decoder_has_demand(struct sc_decoder *decoder) {
+    if (atomic_load_explicit(&decoder->consumers, memory_order_relaxed)) {
+        return true;
+    }
+
+    sc_tick deadline = atomic_load_explicit(&decoder->demand_deadline,
+                                            memory_order_relaxed);
+    return sc_tick_now() < deadline;
+}
+
+static void
+sc_decoder_set_idle(struct sc_decoder *decoder, bool idle) {
+    decoder->idle = idle;
+    atomic_store_explicit(&decoder->idle_state, idle, memory_order_relaxed);
+}
+
+// Return false on error, set *decode if the packet must be decoded
+static bool
+sc_decoder_handle_demand(struct sc_decoder *decoder, const AVPacket *packet,
+                         bool *decode) {
+    bool key_frame = packet->flags & AV_PKT_FLAG_KEY;
+
+    if (!sc_decoder_has_demand(decoder)) {
+        if (!decoder->idle) {
+            LOGI("Decoder '%s': no frame consumer, decoding paused",
+                 decoder->name);
+            // Drop the frames in flight, decoding will restart from a key
+            // frame
+            avcodec_flush_buffers(decoder->ctx);
+            sc_decoder_set_idle(decoder, true);
+        }
+
+        if (key_frame) {
+            // Keep only the latest key frame (which contains the config for
+            // H.264 and H.265), to resume immediately
+            av_packet_unref(decoder->key_packet);
+            if (av_packet_ref(decoder->key_packet, packet)) {
+                LOG_OOM();
+                return false;
+            }
+        }
+
+        *decode = false;
+        return true;
+    }
+
+    if (decoder->idle) {
+        LOGI("Decoder '%s': decoding resumed", decoder->name);
+        sc_decoder_set_idle(decoder, false);
+
+        if (!key_frame) {
+            // Request a fresh key frame, the packets are skipped until then
+            sc_decoder_request_key_frame(decoder);
+            decoder->wait_key_frame = true;
+
+            if (decoder->key_packet->data) {
+                // Meanwhile, show the latest known key frame
+                bool ok = sc_decoder_decode(decoder, decoder->key_packet);
+                av_packet_unref(decoder->key_packet);
+                if (!ok) {
+                    return false;
+                }
+            }
+        }
+
+        av_packet_unref(decoder->key_packet);
     }
 
+    *decode = true;
     return true;
 }
 
+static bool
+sc_decoder_push(struct sc_decoder *decoder, const AVPacket *packet) {
+    bool is_config = packet->pts == AV_NOPTS_VALUE;
+    if (is_config) {
+        // nothing to do
+        return true;
+    }
+
+    if (decoder->cbs) {
+        bool decode;
+        if (!sc_decoder_handle_demand(decoder, packet, &decode)) {
+            return false;
+        }
+        if (!decode) {
+            return true;
+        }
+    }
+
+    if (decoder->wait_key_frame) {
+        if (!(packet->flags & AV_PKT_FLAG_KEY)) {
+            atomic_fetch_add_explicit(&decoder->dropped_packets, 1,
+                                      memory_order_relaxed);
+            // In case the previous request was lost (rate limited)
+            sc_decoder_request_key_frame(decoder);
+            return true;
+        }
+        decoder->wait_key_frame = false;
+    }
+
+    return sc_decoder_decode(decoder, packet);
+}
+
 static bool
 sc_decoder_packet_sink_open(struct sc_packet_sink *sink, AVCodecContext *ctx) {
     struct sc_decoder *decoder = DOWNCAST(sink);
@@ -104,4 +515,116 @@ sc_decoder_init(struct sc_decoder *decoder, const char *name) {
     };
 
     decoder->packet_sink.ops = &ops;
+
+    atomic_init(&decoder->packets, 0);
+    atomic_init(&decoder->frames, 0);
+    atomic_init(&decoder->skipped_frames, 0);
+    atomic_init(&decoder->decode_time, 0);
+    atomic_init(&decoder->max_decode_time, 0);
+    atomic_init(&decoder->threads, 0);
+    atomic_init(&decoder->frame_threading, false);
+    atomic_init(&decoder->degradation, SC_DECODER_DEGRADATION_NONE);
+
+    decoder->cbs = NULL;
+    decoder->cbs_userdata = NULL;
+    decoder->key_packet = NULL;
+    atomic_init(&decoder->consumers, 0);
+    atomic_init(&decoder->demand_deadline, 0);
+    atomic_init(&decoder->idle_state, false);
+    atomic_init(&decoder->unchanged_frames, 0);
+    atomic_init(&decoder->static_screen, false);
+    atomic_init(&decoder->errors, 0);
+    atomic_init(&decoder->dropped_packets, 0);
+    atomic_init(&decoder->recoveries, 0);
+    atomic_init(&decoder->last_recovery_time, 0);
+    atomic_init(&decoder->max_recovery_time, 0);
+}
+
+void
+sc_decoder_destroy(struct sc_decoder *decoder) {
+    sc_frame_source_destroy(&decoder->frame_source);
+}
+
+void
+sc_decoder_set_callbacks(struct sc_decoder *decoder,
+                         const struct sc_decoder_callbacks *cbs,
+                         void *cbs_userdata) {
+    assert(cbs && cbs->on_key_frame_needed);
+    decoder->cbs = cbs;
+    decoder->cbs_userdata = cbs_userdata;
+}
+
+void
+sc_decoder_add_consumer(struct sc_decoder *decoder) {
+    atomic_fetch_add_explicit(&decoder->consumers, 1, memory_order_relaxed);
+}
+
+void
+sc_decoder_remove_consumer(struct sc_decoder *decoder) {
+    unsigned prev = atomic_fetch_sub_explicit(&decoder->consumers, 1,
+                                              memory_order_relaxed);
+    assert(prev);
+    (void) prev;
+}
+
+void
+sc_decoder_request_frames(struct sc_decoder *decoder, sc_tick duration) {
+    sc_tick deadline = sc_tick_now() + duration;
+    // Only extend the deadline
+    int_least64_t current = atomic_load_explicit(&decoder->demand_deadline,
+                                                 memory_order_relaxed);
+    while (current < deadline
+            && !atomic_compare_exchange_weak_explicit(&decoder->demand_deadline,
+                                                      &current, deadline,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+        // retry
+    }
+}
+
+void
+sc_decoder_get_stats(struct sc_decoder *decoder,
+                     struct sc_decoder_stats *stats) {
+    // Read frames before packets, so that pending_frames is never negative
+    uint64_t frames =
+        atomic_load_explicit(&decoder->frames, memory_order_acquire);
+    uint64_t skipped_frames =
+        atomic_load_explicit(&decoder->skipped_frames, memory_order_acquire);
+    uint64_t packets =
+        atomic_load_explicit(&decoder->packets, memory_order_acquire);
+    uint64_t decode_time =
+        atomic_load_explicit(&decoder->decode_time, memory_order_relaxed);
+
+    stats->packets = packets;
+    stats->frames = frames;
+    stats->skipped_frames = skipped_frames;
+    uint64_t done = frames + skipped_frames;
+    stats->pending_frames = packets > done ? packets - done : 0;
+    stats->avg_decode_time = packets ? decode_time / packets : 0;
+    stats->max_decode_time =
+        atomic_load_explicit(&decoder->max_decode_time, memory_order_relaxed);
+    stats->threads =
+        atomic_load_explicit(&decoder->threads, memory_order_relaxed);
+    stats->frame_threading =
+        atomic_load_explicit(&decoder->frame_threading, memory_order_relaxed);
+    stats->degradation =
+        atomic_load_explicit(&decoder->degradation, memory_order_relaxed);
+    stats->idle =
+        atomic_load_explicit(&decoder->idle_state, memory_order_relaxed);
+    stats->unchanged_frames =
+        atomic_load_explicit(&decoder->unchanged_frames, memory_order_relaxed);
+    stats->static_screen =
+        atomic_load_explicit(&decoder->static_screen, memory_order_relaxed);
+    stats->errors =
+        atomic_load_explicit(&decoder->errors, memory_order_relaxed);
+    stats->dropped_packets =
+        atomic_load_explicit(&decoder->dropped_packets, memory_order_relaxed);
+    stats->recoveries =
+        atomic_load_explicit(&decoder->recoveries, memory_order_relaxed);
+    stats->last_recovery_time =
+        atomic_load_explicit(&decoder->last_recovery_time,
+                             memory_order_relaxed);
+    stats->max_recovery_time =
+        atomic_load_explicit(&decoder->max_recovery_time,
+                             memory_order_relaxed);
 }
@@ -3,10 +3,40 @@
 
 #include "common.h"
 
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <libavcodec/avcodec.h>
 
+#include "static_detector.h"
 #include "trait/frame_source.h"
 #include "trait/packet_sink.h"
+#include "util/tick.h"
+
+/**
+ * Degradation levels applied by the governor when the decoder cannot keep up
+ * with the frame rate, each level including the previous ones
+ */
+enum sc_decoder_degradation {
+    SC_DECODER_DEGRADATION_NONE,
+    SC_DECODER_DEGRADATION_SKIP_LOOP_FILTER,
+    SC_DECODER_DEGRADATION_FAST,
+    SC_DECODER_DEGRADATION_SKIP_NONREF, // H.264 and H.265 only
+};
+
+struct sc_decoder_governor {
+    bool enabled; // video only
+    enum sc_decoder_degradation max_level;
+    enum sc_decoder_degradation level;
+
+    int64_t last_pts;
+    // moving averages, in ticks
+    sc_tick avg_decode_time;
+    sc_tick avg_interval;
+    // consecutive frames in overload or with headroom
+    unsigned overload_count;
+    unsigned headroom_count;
+};
 
 struct sc_decoder {
     struct sc_packet_sink packet_sink; // packet sink trait
@@ -16,10 +46,114 @@ struct sc_decoder {
 
     AVCodecContext *ctx;
     AVFrame *frame;
+
+    struct sc_decoder_governor governor;
+    struct sc_static_detector static_detector; // video only
+
+    // To request key frames (may be NULL)
+    const struct sc_decoder_callbacks *cbs;
+    void *cbs_userdata;
+    sc_tick last_key_frame_request;
+
+    bool video;
+    bool wait_key_frame; // packets are dropped until the next key frame
+    sc_tick recovery_start; // time of the last decoding error, 0 if none
+
+    // Decode-on-demand (only if cbs is set)
+    atomic_uint consumers;
+    atomic_int_least64_t demand_deadline; // sc_tick
+    bool idle; // packets are not decoded
+    AVPacket *key_packet; // the latest key frame received while idle
+
+    // Statistics, written by the decoder thread, readable from any thread
+    atomic_uint_least64_t packets;
+    atomic_uint_least64_t frames;
+    atomic_uint_least64_t skipped_frames; // by the governor
+    atomic_uint_least64_t decode_time; // total, in ticks
+    atomic_uint_least64_t max_decode_time; // in ticks
+    atomic_int threads;
+    atomic_bool frame_threading;
+    atomic_int degradation; // enum sc_decoder_degradation
+    atomic_bool idle_state; // copy of idle, for the statistics
+    atomic_uint_least64_t unchanged_frames;
+    atomic_bool static_screen;
+    atomic_uint_least64_t errors;
+    atomic_uint_least64_t dropped_packets; // while waiting for a key frame
+    atomic_uint_least64_t recoveries;
+    atomic_int_least64_t last_recovery_time; // in ticks
+    atomic_int_least64_t max_recovery_time; // in ticks
+};
+
+struct sc_decoder_stats {
+    uint64_t packets;
+    uint64_t frames;
+    uint64_t skipped_frames; // not counted with frame threading
+    // packets sent to the decoder but not output yet (the decoder latency, in
+    // frames)
+    uint64_t pending_frames;
+    sc_tick avg_decode_time;
+    sc_tick max_decode_time;
+    int threads;
+    bool frame_threading;
+    enum sc_decoder_degradation degradation;
+    bool idle;
+    // frames identical to the previous one (marked unchanged for the sinks)
+    uint64_t unchanged_frames;
+    // no frame has changed recently (unlike idle, the frames are decoded)
+    bool static_screen;
+    uint64_t errors;
+    uint64_t dropped_packets;
+    // recoveries from decoding errors (time from the error to the first
+    // correct frame)
+    uint64_t recoveries;
+    sc_tick last_recovery_time;
+    sc_tick max_recovery_time;
+};
+
+struct sc_decoder_callbacks {
+    // Called from the decoder thread to request a new key frame (when
+    // decoding resumes after an idle period, or after a decoding error)
+    void (*on_key_frame_needed)(struct sc_decoder *decoder, void *userdata);
 };
 
 // The name must be statically allocated (e.g. a string literal)
 void
 sc_decoder_init(struct sc_decoder *decoder, const char *name);
 
+// Release the frame sinks still attached at runtime (the thread of the
+// packet source must be terminated)
+void
+sc_decoder_destroy(struct sc_decoder *decoder);
+
+/**
+ * Set the callbacks to request key frames from the device
+ *
+ * This enables decode-on-demand (the packets are not decoded while there is
+ * no frame consumer), and allows to recover from decoding errors without
+ * waiting for the next periodic key frame.
+ *
+ * Must be called before the decoder is started.
+ */
+void
+sc_decoder_set_callbacks(struct sc_decoder *decoder,
+                         const struct sc_decoder_callbacks *cbs,
+                         void *cbs_userdata);
+
+// Register or unregister a frame consumer (may be called from any thread)
+void
+sc_decoder_add_consumer(struct sc_decoder *decoder);
+
+void
+sc_decoder_remove_consumer(struct sc_decoder *decoder);
+
+// Keep decoding for at least the given duration (may be called from any
+// thread)
+void
+sc_decoder_request_frames(struct sc_decoder *decoder, sc_tick duration);
+
+// May be called from any thread
+void
+sc_decoder_get_stats(struct sc_decoder *decoder,
+                     struct sc_decoder_stats *stats);
+
 #endif
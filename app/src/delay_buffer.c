@@ -1,47 +1,83 @@
 #include "delay_buffer.h"
 
 #include <assert.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <libavcodec/avcodec.h>
 
 #include "util/log.h"
+#include "util/memory.h"
 
 /** Downcast frame_sink to sc_delay_buffer */
 #define DOWNCAST(SINK) container_of(SINK, struct sc_delay_buffer, frame_sink)
 
+static void
+sc_delay_buffer_free_frames(struct sc_delay_buffer *db, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        av_frame_free(&db->frames[i].frame);
+    }
+    free(db->frames);
+}
+
 static bool
-sc_delayed_frame_init(struct sc_delayed_frame *dframe, const AVFrame *frame) {
-    dframe->frame = av_frame_alloc();
-    if (!dframe->frame) {
+sc_delay_buffer_alloc_frames(struct sc_delay_buffer *db) {
+    db->frames = sc_allocarray(db->capacity, sizeof(*db->frames));
+    if (!db->frames) {
         LOG_OOM();
         return false;
     }
 
-    if (av_frame_ref(dframe->frame, frame)) {
+    for (size_t i = 0; i < db->capacity; ++i) {
+        db->frames[i].frame = av_frame_alloc();
+        if (!db->frames[i].frame) {
+            LOG_OOM();
+            sc_delay_buffer_free_frames(db, i);
+            return false;
+        }
+    }
+
+    db->out.frame = av_frame_alloc();
+    if (!db->out.frame) {
         LOG_OOM();
-        av_frame_free(&dframe->frame);
+        sc_delay_buffer_free_frames(db, db->capacity);
         return false;
     }
 
+    db->head = 0;
+    db->size = 0;
     return true;
 }
 
 static void
-sc_delayed_frame_destroy(struct sc_delayed_frame *dframe) {
-    av_frame_unref(dframe->frame);
-    av_frame_free(&dframe->frame);
+sc_delay_buffer_destroy_frames(struct sc_delay_buffer *db) {
+    // av_frame_free() also unrefs the frames still in the ring
+    sc_delay_buffer_free_frames(db, db->capacity);
+    av_frame_free(&db->out.frame);
+}
+
+// Move the oldest frame of the ring into db->out
+static void
+sc_delay_buffer_pop(struct sc_delay_buffer *db) {
+    assert(db->size);
+    struct sc_delayed_frame *dframe = &db->frames[db->head];
+    av_frame_move_ref(db->out.frame, dframe->frame);
+#ifdef SC_BUFFERING_DEBUG
+    db->out.push_date = dframe->push_date;
+#endif
+    db->head = (db->head + 1) % db->capacity;
+    --db->size;
 }
 
 static int
 run_buffering(void *data) {
     struct sc_delay_buffer *db = data;
 
-    assert(db->delay > 0);
+    assert(db->adaptive || db->delay > 0);
 
     for (;;) {
         sc_mutex_lock(&db->mutex);
 
-        while (!db->stopped && sc_vecdeque_is_empty(&db->queue)) {
+        while (!db->stopped && !db->size) {
             sc_cond_wait(&db->queue_cond, &db->mutex);
         }
 
@@ -50,11 +86,12 @@ run_buffering(void *data) {
             goto stopped;
         }
 
-        struct sc_delayed_frame dframe = sc_vecdeque_pop(&db->queue);
+        sc_delay_buffer_pop(db);
+        AVFrame *frame = db->out.frame;
 
         sc_tick max_deadline = sc_tick_now() + db->delay;
         // PTS (written by the server) are expressed in microseconds
-        sc_tick pts = SC_TICK_FROM_US(dframe.frame->pts);
+        sc_tick pts = SC_TICK_FROM_US(frame->pts);
 
         bool timed_out = false;
         while (!db->stopped && !timed_out) {
@@ -72,17 +109,17 @@ run_buffering(void *data) {
         sc_mutex_unlock(&db->mutex);
 
         if (stopped) {
-            sc_delayed_frame_destroy(&dframe);
+            av_frame_unref(frame);
             goto stopped;
         }
 
 #ifdef SC_BUFFERING_DEBUG
         LOGD("Buffering: %" PRItick ";%" PRItick ";%" PRItick,
-             pts, dframe.push_date, sc_tick_now());
+             pts, db->out.push_date, sc_tick_now());
 #endif
 
-        bool ok = sc_frame_source_sinks_push(&db->frame_source, dframe.frame);
-        sc_delayed_frame_destroy(&dframe);
+        bool ok = sc_frame_source_sinks_push(&db->frame_source, frame);
+        av_frame_unref(frame);
         if (!ok) {
             LOGE("Delayed frame could not be pushed, stopping");
             sc_mutex_lock(&db->mutex);
@@ -96,12 +133,6 @@ run_buffering(void *data) {
 stopped:
     assert(db->stopped);
 
-    // Flush queue
-    while (!sc_vecdeque_is_empty(&db->queue)) {
-        struct sc_delayed_frame *dframe = sc_vecdeque_popref(&db->queue);
-        sc_delayed_frame_destroy(dframe);
-    }
-
     LOGD("Buffering thread ended");
 
     return 0;
@@ -128,12 +159,22 @@ sc_delay_buffer_frame_sink_open(struct sc_frame_sink *sink,
         goto error_destroy_queue_cond;
     }
 
+    ok = sc_delay_buffer_alloc_frames(db);
+    if (!ok) {
+        goto error_destroy_wait_cond;
+    }
+
     sc_clock_init(&db->clock);
-    sc_vecdeque_init(&db->queue);
+    if (db->adaptive) {
+        sc_jitter_init(&db->jitter, db->min_delay, db->max_delay);
+        db->delay = db->jitter.delay;
+        atomic_store_explicit(&db->current_delay, db->delay,
+                              memory_order_relaxed);
+    }
     db->stopped = false;
 
     if (!sc_frame_source_sinks_open(&db->frame_source, ctx)) {
-        goto error_destroy_wait_cond;
+        goto error_destroy_frames;
     }
 
     ok = sc_thread_create(&db->thread, run_buffering, "scrcpy-dbuf", db);
@@ -146,6 +187,8 @@ sc_delay_buffer_frame_sink_open(struct sc_frame_sink *sink,
 
 error_close_sinks:
     sc_frame_source_sinks_close(&db->frame_source);
+error_destroy_frames:
+    sc_delay_buffer_destroy_frames(db);
 error_destroy_wait_cond:
     sc_cond_destroy(&db->wait_cond);
 error_destroy_queue_cond:
@@ -170,6 +213,12 @@ sc_delay_buffer_frame_sink_close(struct sc_frame_sink *sink) {
 
     sc_frame_source_sinks_close(&db->frame_source);
 
+    uint64_t dropped = sc_delay_buffer_get_dropped(db);
+    if (dropped) {
+        LOGD("Delay buffer: %" PRIu64 " frames dropped (ring full)", dropped);
+    }
+
+    sc_delay_buffer_destroy_frames(db);
     sc_cond_destroy(&db->wait_cond);
     sc_cond_destroy(&db->queue_cond);
     sc_mutex_destroy(&db->mutex);
@@ -187,8 +236,16 @@ sc_delay_buffer_frame_sink_push(struct sc_frame_sink *sink,
         return false;
     }
 
+    sc_tick now = sc_tick_now();
     sc_tick pts = SC_TICK_FROM_US(frame->pts);
-    sc_clock_update(&db->clock, sc_tick_now(), pts);
+    if (db->adaptive && db->clock.range) {
+        // Measure how late the frame arrives compared to the clock estimation
+        sc_tick deviation = now - sc_clock_to_system_time(&db->clock, pts);
+        db->delay = sc_jitter_push(&db->jitter, deviation);
+        atomic_store_explicit(&db->current_delay, db->delay,
+                              memory_order_relaxed);
+    }
+    sc_clock_update(&db->clock, now, pts);
     sc_cond_signal(&db->wait_cond);
 
     if (db->first_frame_asap && db->clock.range == 1) {
@@ -196,24 +253,38 @@ sc_delay_buffer_frame_sink_push(struct sc_frame_sink *sink,
         return sc_frame_source_sinks_push(&db->frame_source, frame);
     }
 
-    struct sc_delayed_frame dframe;
-    bool ok = sc_delayed_frame_init(&dframe, frame);
-    if (!ok) {
-        sc_mutex_unlock(&db->mutex);
-        return false;
+    bool dropped = false;
+    if (db->size == db->capacity) {
+        // The ring is full, drop the oldest frame
+        av_frame_unref(db->frames[db->head].frame);
+        db->head = (db->head + 1) % db->capacity;
+        --db->size;
+        atomic_fetch_add_explicit(&db->dropped, 1, memory_order_relaxed);
+        dropped = true;
+
+        if (db->size) {
+            // The sinks will not receive the dropped frame, so its successor
+            // may not be skipped
+            sc_frame_set_unchanged(db->frames[db->head].frame, false);
+        }
     }
 
-#ifdef SC_BUFFERING_DEBUG
-    dframe.push_date = sc_tick_now();
-#endif
-
-    ok = sc_vecdeque_push(&db->queue, dframe);
-    if (!ok) {
+    size_t index = (db->head + db->size) % db->capacity;
+    struct sc_delayed_frame *dframe = &db->frames[index];
+    if (av_frame_ref(dframe->frame, frame)) {
         sc_mutex_unlock(&db->mutex);
         LOG_OOM();
         return false;
     }
+    if (dropped && !db->size) {
+        sc_frame_set_unchanged(dframe->frame, false);
+    }
+
+#ifdef SC_BUFFERING_DEBUG
+    dframe->push_date = now;
+#endif
 
+    ++db->size;
     sc_cond_signal(&db->queue_cond);
 
     sc_mutex_unlock(&db->mutex);
@@ -221,13 +292,37 @@ sc_delay_buffer_frame_sink_push(struct sc_frame_sink *sink,
     return true;
 }
 
+static size_t
+sc_delay_buffer_compute_capacity(sc_tick delay, unsigned max_fps) {
+    if (!max_fps) {
+        max_fps = SC_DELAY_BUFFER_DEFAULT_FPS;
+    }
+
+    // The frames delayed, plus some margin for the frames in flight
+    uint64_t capacity = (SC_TICK_TO_MS(delay) * max_fps + 999) / 1000 + 2;
+    if (capacity < SC_DELAY_BUFFER_MIN_CAPACITY) {
+        capacity = SC_DELAY_BUFFER_MIN_CAPACITY;
+    } else if (capacity > SC_DELAY_BUFFER_MAX_CAPACITY) {
+        LOGW("Delay buffer limited to %d frames, frames may be dropped",
+             SC_DELAY_BUFFER_MAX_CAPACITY);
+        capacity = SC_DELAY_BUFFER_MAX_CAPACITY;
+    }
+
+    return capacity;
+}
+
 void
 sc_delay_buffer_init(struct sc_delay_buffer *db, sc_tick delay,
-                     bool first_frame_asap) {
+                     unsigned max_fps, bool first_frame_asap) {
     assert(delay > 0);
 
     db->delay = delay;
     db->first_frame_asap = first_frame_asap;
+    db->adaptive = false;
+    atomic_init(&db->current_delay, delay);
+    db->capacity = sc_delay_buffer_compute_capacity(delay, max_fps);
+    db->frames = NULL;
+    atomic_init(&db->dropped, 0);
 
     sc_frame_source_init(&db->frame_source);
 
@@ -239,3 +334,27 @@ sc_delay_buffer_init(struct sc_delay_buffer *db, sc_tick delay,
 
     db->frame_sink.ops = &ops;
 }
+
+void
+sc_delay_buffer_init_adaptive(struct sc_delay_buffer *db, sc_tick min_delay,
+                              sc_tick max_delay, unsigned max_fps,
+                              bool first_frame_asap) {
+    assert(min_delay >= 0);
+    assert(max_delay > min_delay);
+
+    // The ring is sized for the maximum delay
+    sc_delay_buffer_init(db, max_delay, max_fps, first_frame_asap);
+    db->adaptive = true;
+    db->min_delay = min_delay;
+    db->max_delay = max_delay;
+}
+
+sc_tick
+sc_delay_buffer_get_delay(struct sc_delay_buffer *db) {
+    return atomic_load_explicit(&db->current_delay, memory_order_relaxed);
+}
+
+uint64_t
+sc_delay_buffer_get_dropped(struct sc_delay_buffer *db) {
+    return atomic_load_explicit(&db->dropped, memory_order_relaxed);
+}
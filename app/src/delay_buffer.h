@@ -3,18 +3,27 @@
 
 #include "common.h"
 
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <libavutil/frame.h>
 
 #include "clock.h"
+#include "jitter.h"
 #include "trait/frame_source.h"
 #include "trait/frame_sink.h"
 #include "util/thread.h"
 #include "util/tick.h"
-#include "util/vecdeque.h"
 
 //#define SC_BUFFERING_DEBUG // uncomment to debug
 
+// Frame rate assumed to size the ring if the maximum frame rate is unknown
+#define SC_DELAY_BUFFER_DEFAULT_FPS 120
+// Bounds of the ring capacity (in frames)
+#define SC_DELAY_BUFFER_MIN_CAPACITY 4
+#define SC_DELAY_BUFFER_MAX_CAPACITY 1024
+
 // forward declarations
 typedef struct AVFrame AVFrame;
 
@@ -25,23 +34,42 @@ struct sc_delayed_frame {
 #endif
 };
 
-struct sc_delayed_frame_queue SC_VECDEQUE(struct sc_delayed_frame);
-
 struct sc_delay_buffer {
     struct sc_frame_source frame_source; // frame source trait
     struct sc_frame_sink frame_sink; // frame sink trait
 
-    sc_tick delay;
+    sc_tick delay; // variable in adaptive mode, protected by the mutex
     bool first_frame_asap;
 
+    // If adaptive, the delay follows the measured jitter
+    bool adaptive;
+    sc_tick min_delay;
+    sc_tick max_delay;
+    struct sc_jitter jitter;
+
+    // The current delay, readable from any thread
+    atomic_int_least64_t current_delay;
+
     sc_thread thread;
     sc_mutex mutex;
     sc_cond queue_cond;
     sc_cond wait_cond;
 
     struct sc_clock clock;
-    struct sc_delayed_frame_queue queue;
+
+    // Ring of frames allocated once on open, so that buffering a frame never
+    // allocates (only the frame references are moved)
+    struct sc_delayed_frame *frames;
+    size_t capacity;
+    size_t head; // index of the oldest frame
+    size_t size;
+    // The frame being delayed by the buffering thread (preallocated too)
+    struct sc_delayed_frame out;
+
     bool stopped;
+
+    // Number of frames dropped because the ring was full
+    atomic_uint_least64_t dropped;
 };
 
 struct sc_delay_buffer_callbacks {
@@ -52,12 +80,35 @@ struct sc_delay_buffer_callbacks {
 /**
  * Initialize a delay buffer.
  *
+ * The frames are buffered in a fixed-capacity ring, sized from the delay and
+ * the maximum frame rate. If it is full, the oldest frame is dropped.
+ *
  * \param delay a (strictly) positive delay
+ * \param max_fps the maximum frame rate (0 if unknown)
  * \param first_frame_asap if true, do not delay the first frame (useful for
                            a video stream).
  */
 void
 sc_delay_buffer_init(struct sc_delay_buffer *db, sc_tick delay,
-                     bool first_frame_asap);
+                     unsigned max_fps, bool first_frame_asap);
+
+/**
+ * Initialize an adaptive delay buffer
+ *
+ * The delay follows the arrival jitter of the frames, between min_delay and
+ * max_delay (see sc_jitter).
+ */
+void
+sc_delay_buffer_init_adaptive(struct sc_delay_buffer *db, sc_tick min_delay,
+                              sc_tick max_delay, unsigned max_fps,
+                              bool first_frame_asap);
+
+// Return the current delay (may be called from any thread)
+sc_tick
+sc_delay_buffer_get_delay(struct sc_delay_buffer *db);
+
+// Return the number of frames dropped (may be called from any thread)
+uint64_t
+sc_delay_buffer_get_dropped(struct sc_delay_buffer *db);
 
 #endif
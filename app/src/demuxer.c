@@ -2,6 +2,8 @@
 
 #include <assert.h>
 #include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
 #include <libavcodec/avcodec.h>
 #include <libavutil/channel_layout.h>
 
@@ -16,6 +18,21 @@
 
 #define SC_PACKET_PTS_MASK (SC_PACKET_FLAG_KEY_FRAME - 1)
 
+// Buffer sizes (including the padding) of the packet pools, in powers of 4 so
+// that a buffer is never more than 4 times larger than its packet (the sinks
+// may keep many references, and a pool never shrinks)
+static const size_t sc_demuxer_pool_sizes[SC_DEMUXER_POOL_COUNT] = {
+    4096,
+    16384,
+    65536,
+    262144,
+    1048576, // key frames only
+};
+
+// The largest pool is reserved to the key frames: the other packets larger
+// than the previous class are rare, they are allocated exactly
+#define SC_DEMUXER_KEY_FRAME_POOL (SC_DEMUXER_POOL_COUNT - 1)
+
 static enum AVCodecID
 sc_demuxer_to_avcodec_id(uint32_t codec_id) {
 #define SC_CODEC_ID_H264 UINT32_C(0x68323634) // "h264" in ASCII
@@ -51,10 +68,152 @@ sc_demuxer_to_avcodec_id(uint32_t codec_id) {
     }
 }
 
+static ssize_t
+sc_demuxer_recv_all(struct sc_demuxer *demuxer, void *buf, size_t len) {
+    if (demuxer->replay) {
+        // Read exactly len bytes, to deliver each record on time
+        return sc_stream_replay_read_all(demuxer->replay, buf, len);
+    }
+
+#ifdef HAVE_IO_URING
+    if (demuxer->uring_stream) {
+        ssize_t r = sc_net_uring_stream_recv_all(demuxer->uring_stream, buf,
+                                                 len);
+        if (r > 0 && demuxer->dump) {
+            sc_stream_dump_write(demuxer->dump, buf, r);
+        }
+        return r;
+    }
+#endif
+
+    uint8_t *out = buf;
+
+    // Consume the data already received first
+    size_t copied = MIN(len, demuxer->buf_len - demuxer->buf_pos);
+    memcpy(out, &demuxer->buf[demuxer->buf_pos], copied);
+    demuxer->buf_pos += copied;
+
+    while (copied < len) {
+        size_t remaining = len - copied;
+        ssize_t r;
+        if (remaining >= SC_DEMUXER_READ_AHEAD_SIZE) {
+            // Large payload, receive it directly into the destination
+            r = net_recv_all(demuxer->socket, out + copied, remaining);
+            if (r > 0 && demuxer->dump) {
+                sc_stream_dump_write(demuxer->dump, out + copied, r);
+            }
+            if (r <= 0) {
+                break;
+            }
+            copied += r;
+            continue;
+        }
+
+        // Receive as much as available (possibly several packets) at once
+        r = net_recv(demuxer->socket, demuxer->buf,
+                     SC_DEMUXER_READ_AHEAD_SIZE);
+        if (r > 0 && demuxer->dump) {
+            sc_stream_dump_write(demuxer->dump, demuxer->buf, r);
+        }
+        if (r <= 0) {
+            break;
+        }
+
+        size_t n = MIN(remaining, (size_t) r);
+        memcpy(out + copied, demuxer->buf, n);
+        demuxer->buf_pos = n;
+        demuxer->buf_len = r;
+        copied += n;
+    }
+
+    return copied;
+}
+
+static bool
+sc_demuxer_init_pools(struct sc_demuxer *demuxer) {
+    for (unsigned i = 0; i < SC_DEMUXER_POOL_COUNT; ++i) {
+        // The buffers are allocated on demand
+        demuxer->pools[i] = av_buffer_pool_init(sc_demuxer_pool_sizes[i], NULL);
+        if (!demuxer->pools[i]) {
+            LOG_OOM();
+            while (i--) {
+                av_buffer_pool_uninit(&demuxer->pools[i]);
+            }
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void
+sc_demuxer_destroy_pools(struct sc_demuxer *demuxer) {
+    for (unsigned i = 0; i < SC_DEMUXER_POOL_COUNT; ++i) {
+        // The pool is actually freed once all its buffers are released (the
+        // sinks may still reference some packets)
+        av_buffer_pool_uninit(&demuxer->pools[i]);
+    }
+}
+
+// Like av_new_packet(), but with a recycled buffer if possible
+static bool
+sc_demuxer_alloc_packet(struct sc_demuxer *demuxer, AVPacket *packet,
+                        uint32_t len, bool key_frame) {
+    size_t size = (size_t) len + AV_INPUT_BUFFER_PADDING_SIZE;
+    unsigned count = key_frame ? SC_DEMUXER_POOL_COUNT
+                               : SC_DEMUXER_KEY_FRAME_POOL;
+    for (unsigned i = 0; i < count; ++i) {
+        if (size <= sc_demuxer_pool_sizes[i]) {
+            AVBufferRef *buf = av_buffer_pool_get(demuxer->pools[i]);
+            if (!buf) {
+                return false;
+            }
+
+            packet->buf = buf;
+            packet->data = buf->data;
+            packet->size = len;
+            // The recycled buffer content is not initialized
+            memset(packet->data + len, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+            return true;
+        }
+    }
+
+    // Too large for the pools (or for the pools of the non-key packets)
+    return !av_new_packet(packet, len);
+}
+
+static void
+sc_demuxer_configure_threads(struct sc_demuxer *demuxer, const AVCodec *codec,
+                             AVCodecContext *ctx) {
+    if (demuxer->decoder_threads == 1) {
+        // Single-threaded decoding (the FFmpeg default)
+        return;
+    }
+
+    ctx->thread_count = demuxer->decoder_threads; // 0 for auto
+
+    enum sc_decoder_thread_type type = demuxer->decoder_thread_type;
+    if (type == SC_DECODER_THREAD_TYPE_AUTO) {
+        // Prefer slice threading, which does not add latency
+        type = codec->capabilities & AV_CODEC_CAP_SLICE_THREADS
+             ? SC_DECODER_THREAD_TYPE_SLICE
+             : SC_DECODER_THREAD_TYPE_FRAME;
+    }
+
+    if (type == SC_DECODER_THREAD_TYPE_SLICE) {
+        ctx->thread_type = FF_THREAD_SLICE;
+    } else {
+        assert(type == SC_DECODER_THREAD_TYPE_FRAME);
+        ctx->thread_type = FF_THREAD_FRAME;
+        // FFmpeg disables frame threading in low delay mode
+        ctx->flags &= ~AV_CODEC_FLAG_LOW_DELAY;
+    }
+}
+
 static bool
 sc_demuxer_recv_codec_id(struct sc_demuxer *demuxer, uint32_t *codec_id) {
     uint8_t data[4];
-    ssize_t r = net_recv_all(demuxer->socket, data, 4);
+    ssize_t r = sc_demuxer_recv_all(demuxer, data, 4);
     if (r < 4) {
         return false;
     }
@@ -67,7 +226,7 @@ static bool
 sc_demuxer_recv_video_size(struct sc_demuxer *demuxer, uint32_t *width,
                            uint32_t *height) {
     uint8_t data[8];
-    ssize_t r = net_recv_all(demuxer->socket, data, 8);
+    ssize_t r = sc_demuxer_recv_all(demuxer, data, 8);
     if (r < 8) {
         return false;
     }
@@ -100,7 +259,7 @@ sc_demuxer_recv_packet(struct sc_demuxer *demuxer, AVPacket *packet) {
     //  `-- config packet
 
     uint8_t header[SC_PACKET_HEADER_SIZE];
-    ssize_t r = net_recv_all(demuxer->socket, header, SC_PACKET_HEADER_SIZE);
+    ssize_t r = sc_demuxer_recv_all(demuxer, header, SC_PACKET_HEADER_SIZE);
     if (r < SC_PACKET_HEADER_SIZE) {
         return false;
     }
@@ -109,12 +268,13 @@ sc_demuxer_recv_packet(struct sc_demuxer *demuxer, AVPacket *packet) {
     uint32_t len = sc_read32be(&header[8]);
     assert(len);
 
-    if (av_new_packet(packet, len)) {
+    bool key_frame = pts_flags & SC_PACKET_FLAG_KEY_FRAME;
+    if (!sc_demuxer_alloc_packet(demuxer, packet, len, key_frame)) {
         LOG_OOM();
         return false;
     }
 
-    r = net_recv_all(demuxer->socket, packet->data, len);
+    r = sc_demuxer_recv_all(demuxer, packet->data, len);
     if (r < 0 || ((uint32_t) r) < len) {
         av_packet_unref(packet);
         return false;
@@ -126,7 +286,7 @@ sc_demuxer_recv_packet(struct sc_demuxer *demuxer, AVPacket *packet) {
         packet->pts = pts_flags & SC_PACKET_PTS_MASK;
     }
 
-    if (pts_flags & SC_PACKET_FLAG_KEY_FRAME) {
+    if (key_frame) {
         packet->flags |= AV_PKT_FLAG_KEY;
     }
 
@@ -141,6 +301,19 @@ run_demuxer(void *data) {
     // Flag to report end-of-stream (i.e. device disconnected)
     enum sc_demuxer_status status = SC_DEMUXER_STATUS_ERROR;
 
+    bool read_ahead = !demuxer->replay;
+#ifdef HAVE_IO_URING
+    // The io_uring engine already receives the data by large chunks
+    read_ahead &= !demuxer->uring_stream;
+#endif
+    if (read_ahead) {
+        demuxer->buf = malloc(SC_DEMUXER_READ_AHEAD_SIZE);
+        if (!demuxer->buf) {
+            LOG_OOM();
+            goto end;
+        }
+    }
+
     uint32_t raw_codec_id;
     bool ok = sc_demuxer_recv_codec_id(demuxer, &raw_codec_id);
     if (!ok) {
@@ -198,6 +371,8 @@ run_demuxer(void *data) {
         codec_ctx->width = width;
         codec_ctx->height = height;
         codec_ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+
+        sc_demuxer_configure_threads(demuxer, codec, codec_ctx);
     } else {
         // Hardcoded audio properties
 #ifdef SCRCPY_LAVU_HAS_CHLAYOUT
@@ -219,10 +394,26 @@ run_demuxer(void *data) {
         goto finally_free_context;
     }
 
+    if (codec->type == AVMEDIA_TYPE_VIDEO && codec_ctx->thread_count != 1) {
+        // thread_count is resolved by avcodec_open2() if it was 0 (auto)
+        bool frame_threading = codec_ctx->active_thread_type == FF_THREAD_FRAME;
+        LOGD("Demuxer '%s': %d decoding thread(s), %s threading",
+             demuxer->name, codec_ctx->thread_count,
+             frame_threading ? "frame" : "slice");
+        if (frame_threading) {
+            LOGW("Demuxer '%s': frame threading adds up to %d frame(s) of "
+                 "latency", demuxer->name, codec_ctx->thread_count - 1);
+        }
+    }
+
     if (!sc_packet_source_sinks_open(&demuxer->packet_source, codec_ctx)) {
         goto finally_free_context;
     }
 
+    if (!sc_demuxer_init_pools(demuxer)) {
+        goto finally_close_sinks;
+    }
+
     // Config packets must be merged with the next non-config packet only for
     // H.26x
     bool must_merge_config_packet = raw_codec_id == SC_CODEC_ID_H264
@@ -237,7 +428,7 @@ run_demuxer(void *data) {
     AVPacket *packet = av_packet_alloc();
     if (!packet) {
         LOG_OOM();
-        goto finally_close_sinks;
+        goto finally_destroy_pools;
     }
 
     for (;;) {
@@ -272,11 +463,16 @@ run_demuxer(void *data) {
     }
 
     av_packet_free(&packet);
+finally_destroy_pools:
+    sc_demuxer_destroy_pools(demuxer);
 finally_close_sinks:
     sc_packet_source_sinks_close(&demuxer->packet_source);
 finally_free_context:
     avcodec_free_context(&codec_ctx);
 end:
+    free(demuxer->buf);
+    demuxer->buf = NULL;
+
     demuxer->cbs->on_ended(demuxer, status, demuxer->cbs_userdata);
 
     return 0;
@@ -289,6 +485,43 @@ sc_demuxer_init(struct sc_demuxer *demuxer, const char *name, sc_socket socket,
 
     demuxer->name = name; // statically allocated
     demuxer->socket = socket;
+    demuxer->replay = NULL;
+    demuxer->dump = NULL;
+#ifdef HAVE_IO_URING
+    demuxer->uring_stream = NULL;
+#endif
+    demuxer->decoder_threads = 1;
+    demuxer->decoder_thread_type = SC_DECODER_THREAD_TYPE_AUTO;
+    demuxer->buf = NULL;
+    demuxer->buf_pos = 0;
+    demuxer->buf_len = 0;
+    sc_packet_source_init(&demuxer->packet_source);
+
+    assert(cbs && cbs->on_ended);
+
+    demuxer->cbs = cbs;
+    demuxer->cbs_userdata = cbs_userdata;
+}
+
+void
+sc_demuxer_init_replay(struct sc_demuxer *demuxer, const char *name,
+                       struct sc_stream_replay *replay,
+                       const struct sc_demuxer_callbacks *cbs,
+                       void *cbs_userdata) {
+    assert(replay);
+
+    demuxer->name = name; // statically allocated
+    demuxer->socket = SC_SOCKET_NONE;
+    demuxer->replay = replay;
+    demuxer->dump = NULL;
+#ifdef HAVE_IO_URING
+    demuxer->uring_stream = NULL;
+#endif
+    demuxer->decoder_threads = 1;
+    demuxer->decoder_thread_type = SC_DECODER_THREAD_TYPE_AUTO;
+    demuxer->buf = NULL;
+    demuxer->buf_pos = 0;
+    demuxer->buf_len = 0;
     sc_packet_source_init(&demuxer->packet_source);
 
     assert(cbs && cbs->on_ended);
@@ -314,3 +547,8 @@ void
 sc_demuxer_join(struct sc_demuxer *demuxer) {
     sc_thread_join(&demuxer->thread, NULL);
 }
+
+void
+sc_demuxer_destroy(struct sc_demuxer *demuxer) {
+    sc_packet_source_destroy(&demuxer->packet_source);
+}
@@ -4,19 +4,55 @@
 #include "common.h"
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <libavutil/buffer.h>
 
+#include "options.h"
+#include "stream_dump.h"
 #include "trait/packet_source.h"
 #include "util/net.h"
 #include "util/thread.h"
+#ifdef HAVE_IO_URING
+# include "util/net_uring.h"
+#endif
+
+#define SC_DEMUXER_READ_AHEAD_SIZE 16384
+
+// Size classes of the recycled packet buffers (see sc_demuxer_alloc_packet())
+#define SC_DEMUXER_POOL_COUNT 5
 
 struct sc_demuxer {
     struct sc_packet_source packet_source; // packet source trait
 
     const char *name; // must be statically allocated (e.g. a string literal)
 
-    sc_socket socket;
+    sc_socket socket; // SC_SOCKET_NONE on replay
     sc_thread thread;
 
+    // if set, the stream is read from a dump instead of the socket
+    struct sc_stream_replay *replay;
+    // if set (after init), the received bytes are captured
+    struct sc_stream_dump *dump;
+
+#ifdef HAVE_IO_URING
+    // if set (after init), the socket is read through the io_uring engine
+    struct sc_net_uring_stream *uring_stream;
+#endif
+
+    // Read-ahead buffer, to receive several small packets with a single
+    // recv() (not used on replay)
+    uint8_t *buf;
+    size_t buf_pos;
+    size_t buf_len;
+
+    // Video decoding threads (may be set after init)
+    uint16_t decoder_threads; // 0 for auto
+    enum sc_decoder_thread_type decoder_thread_type;
+
+    // Packet buffer pools, from the smallest to the largest size class
+    AVBufferPool *pools[SC_DEMUXER_POOL_COUNT];
+
     const struct sc_demuxer_callbacks *cbs;
     void *cbs_userdata;
 };
@@ -37,10 +73,21 @@ void
 sc_demuxer_init(struct sc_demuxer *demuxer, const char *name, sc_socket socket,
                 const struct sc_demuxer_callbacks *cbs, void *cbs_userdata);
 
+// Read the stream from a dump (captured by --dump-streams) instead of a socket
+void
+sc_demuxer_init_replay(struct sc_demuxer *demuxer, const char *name,
+                       struct sc_stream_replay *replay,
+                       const struct sc_demuxer_callbacks *cbs,
+                       void *cbs_userdata);
+
 bool
 sc_demuxer_start(struct sc_demuxer *demuxer);
 
 void
 sc_demuxer_join(struct sc_demuxer *demuxer);
 
+// Must be called after sc_demuxer_join() if the demuxer has been started
+void
+sc_demuxer_destroy(struct sc_demuxer *demuxer);
+
 #endif
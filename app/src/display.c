@@ -30,9 +30,13 @@ sc_display_init_novideo_icon(struct sc_display *display,
 
 bool
 sc_display_init(struct sc_display *display, SDL_Window *window,
-                SDL_Surface *icon_novideo, bool mipmaps) {
-    display->renderer =
-        SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+                SDL_Surface *icon_novideo, bool mipmaps, bool vsync) {
+    uint32_t renderer_flags = SDL_RENDERER_ACCELERATED;
+    if (vsync) {
+        renderer_flags |= SDL_RENDERER_PRESENTVSYNC;
+    }
+
+    display->renderer = SDL_CreateRenderer(window, -1, renderer_flags);
     if (!display->renderer) {
         LOGE("Could not create renderer: %s", SDL_GetError());
         return false;
@@ -46,7 +46,7 @@ enum sc_display_result {
 
 bool
 sc_display_init(struct sc_display *display, SDL_Window *window,
-                SDL_Surface *icon_novideo, bool mipmaps);
+                SDL_Surface *icon_novideo, bool mipmaps, bool vsync);
 
 void
 sc_display_destroy(struct sc_display *display);
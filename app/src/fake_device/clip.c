@@ -0,0 +1,614 @@
+#include "clip.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libavcodec/avcodec.h>
+#include <libavcodec/bsf.h>
+#include <libavformat/avformat.h>
+#include <libavutil/channel_layout.h>
+
+#include "util/log.h"
+
+// Must match the values parsed by the client demuxer
+#define SC_CODEC_ID_H264 UINT32_C(0x68323634) // "h264" in ASCII
+#define SC_CODEC_ID_H265 UINT32_C(0x68323635) // "h265" in ASCII
+#define SC_CODEC_ID_OPUS UINT32_C(0x6f707573) // "opus" in ASCII
+#define SC_CODEC_ID_AAC UINT32_C(0x00616163) // "aac" in ASCII
+
+#define SC_AUDIO_SAMPLE_RATE 48000
+
+#define SC_TIME_BASE_US (AVRational) {1, SC_TICK_FREQ}
+
+static uint32_t
+sc_fake_clip_get_codec_id(enum AVCodecID codec_id) {
+    switch (codec_id) {
+        case AV_CODEC_ID_H264:
+            return SC_CODEC_ID_H264;
+        case AV_CODEC_ID_HEVC:
+            return SC_CODEC_ID_H265;
+        case AV_CODEC_ID_OPUS:
+            return SC_CODEC_ID_OPUS;
+        case AV_CODEC_ID_AAC:
+            return SC_CODEC_ID_AAC;
+        default:
+            return 0;
+    }
+}
+
+static bool
+sc_fake_stream_init(struct sc_fake_stream *stream, enum AVCodecID codec_id,
+                    const uint8_t *config, size_t config_size) {
+    stream->codec_id = sc_fake_clip_get_codec_id(codec_id);
+    if (!stream->codec_id) {
+        LOGE("Codec %s not supported", avcodec_get_name(codec_id));
+        return false;
+    }
+
+    if (config_size) {
+        stream->config = malloc(config_size);
+        if (!stream->config) {
+            LOG_OOM();
+            return false;
+        }
+        memcpy(stream->config, config, config_size);
+        stream->config_size = config_size;
+    }
+
+    stream->enabled = true;
+    return true;
+}
+
+static bool
+sc_fake_clip_push(struct sc_fake_clip *clip, bool video,
+                  const AVPacket *packet, AVRational time_base) {
+    if (packet->pts == AV_NOPTS_VALUE) {
+        // Could not be scheduled
+        return true;
+    }
+
+    int64_t pts = av_rescale_q(packet->pts, time_base, SC_TIME_BASE_US);
+    int64_t dts = packet->dts != AV_NOPTS_VALUE
+                ? av_rescale_q(packet->dts, time_base, SC_TIME_BASE_US)
+                : pts;
+    int64_t duration =
+        av_rescale_q(packet->duration, time_base, SC_TIME_BASE_US);
+
+    struct sc_fake_packet p = {
+        .video = video,
+        .key_frame = packet->flags & AV_PKT_FLAG_KEY,
+        // Packets are sent in decoding order
+        .time = dts,
+        .pts = pts,
+        .data = malloc(packet->size),
+        .size = packet->size,
+    };
+    if (!p.data) {
+        LOG_OOM();
+        return false;
+    }
+    memcpy(p.data, packet->data, packet->size);
+
+    bool ok = sc_vector_push(&clip->packets, p);
+    if (!ok) {
+        LOG_OOM();
+        free(p.data);
+        return false;
+    }
+
+    if (dts + duration > clip->duration) {
+        clip->duration = dts + duration;
+    }
+
+    return true;
+}
+
+// Make the timestamps start at 0, and interleave the streams in sending order
+static void
+sc_fake_clip_normalize(struct sc_fake_clip *clip) {
+    if (!clip->packets.size) {
+        return;
+    }
+
+    sc_tick start = clip->packets.data[0].time;
+    for (size_t i = 1; i < clip->packets.size; ++i) {
+        if (clip->packets.data[i].time < start) {
+            start = clip->packets.data[i].time;
+        }
+    }
+
+    for (size_t i = 0; i < clip->packets.size; ++i) {
+        struct sc_fake_packet *p = &clip->packets.data[i];
+        p->time -= start;
+        p->pts -= start;
+        if (p->pts < 0) {
+            // The pts must fit in the 62 bits of the packet header
+            p->pts = 0;
+        }
+    }
+    clip->duration -= start;
+
+    // Insertion sort: stable, and fast since the streams are (almost) already
+    // in order
+    for (size_t i = 1; i < clip->packets.size; ++i) {
+        struct sc_fake_packet p = clip->packets.data[i];
+        size_t j = i;
+        while (j && clip->packets.data[j - 1].time > p.time) {
+            clip->packets.data[j] = clip->packets.data[j - 1];
+            --j;
+        }
+        clip->packets.data[j] = p;
+    }
+}
+
+static bool
+sc_fake_clip_load_file(struct sc_fake_clip *clip,
+                       const struct sc_fake_clip_params *params) {
+    const char *filename = params->filename;
+
+    AVFormatContext *fmt_ctx = NULL;
+    if (avformat_open_input(&fmt_ctx, filename, NULL, NULL) < 0) {
+        LOGE("Could not open file: %s", filename);
+        return false;
+    }
+
+    bool ret = false;
+    AVBSFContext *bsf = NULL;
+    AVPacket *packet = NULL;
+
+    if (avformat_find_stream_info(fmt_ctx, NULL) < 0) {
+        LOGE("Could not find stream info: %s", filename);
+        goto end;
+    }
+
+    int video_index = -1;
+    if (params->video) {
+        video_index = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_VIDEO, -1, -1,
+                                          NULL, 0);
+        if (video_index < 0) {
+            LOGE("No video stream in %s (try with --no-video)", filename);
+            goto end;
+        }
+
+        AVStream *stream = fmt_ctx->streams[video_index];
+        enum AVCodecID codec_id = stream->codecpar->codec_id;
+
+        // The client expects an Annex B stream, with the parameter sets in a
+        // separate config packet (like MediaCodec produces)
+        const char *bsf_name = codec_id == AV_CODEC_ID_H264 ? "h264_mp4toannexb"
+                             : codec_id == AV_CODEC_ID_HEVC ? "hevc_mp4toannexb"
+                                                            : NULL;
+        if (!bsf_name) {
+            LOGE("Codec %s not supported", avcodec_get_name(codec_id));
+            goto end;
+        }
+
+        const AVBitStreamFilter *filter = av_bsf_get_by_name(bsf_name);
+        if (!filter || av_bsf_alloc(filter, &bsf) < 0) {
+            LOGE("Could not create bitstream filter %s", bsf_name);
+            goto end;
+        }
+
+        if (avcodec_parameters_copy(bsf->par_in, stream->codecpar) < 0) {
+            goto end;
+        }
+        bsf->time_base_in = stream->time_base;
+
+        if (av_bsf_init(bsf) < 0) {
+            LOGE("Could not initialize bitstream filter %s", bsf_name);
+            goto end;
+        }
+
+        if (!sc_fake_stream_init(&clip->video, codec_id,
+                                 bsf->par_out->extradata,
+                                 bsf->par_out->extradata_size)) {
+            goto end;
+        }
+        clip->video.width = stream->codecpar->width;
+        clip->video.height = stream->codecpar->height;
+    }
+
+    int audio_index = -1;
+    if (params->audio) {
+        audio_index = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_AUDIO, -1, -1,
+                                          NULL, 0);
+        if (audio_index < 0) {
+            LOGE("No audio stream in %s (try with --no-audio)", filename);
+            goto end;
+        }
+
+        AVCodecParameters *par = fmt_ctx->streams[audio_index]->codecpar;
+        if (par->sample_rate != SC_AUDIO_SAMPLE_RATE) {
+            LOGW("Audio sample rate is %d Hz, the client expects %d Hz",
+                 par->sample_rate, SC_AUDIO_SAMPLE_RATE);
+        }
+
+        if (!sc_fake_stream_init(&clip->audio, par->codec_id, par->extradata,
+                                 par->extradata_size)) {
+            goto end;
+        }
+    }
+
+    packet = av_packet_alloc();
+    if (!packet) {
+        LOG_OOM();
+        goto end;
+    }
+
+    bool eof = false;
+    while (!eof) {
+        int r = av_read_frame(fmt_ctx, packet);
+        if (r < 0) {
+            if (!bsf) {
+                break;
+            }
+            // Flush the bitstream filter
+            eof = true;
+        }
+
+        if (!eof && packet->stream_index == audio_index) {
+            AVRational time_base = fmt_ctx->streams[audio_index]->time_base;
+            bool ok = sc_fake_clip_push(clip, false, packet, time_base);
+            av_packet_unref(packet);
+            if (!ok) {
+                goto end;
+            }
+        } else if (eof || packet->stream_index == video_index) {
+            // On success, the packet ownership is transferred (the packet is
+            // reset)
+            if (av_bsf_send_packet(bsf, eof ? NULL : packet) < 0) {
+                LOGE("Could not filter video packet");
+                av_packet_unref(packet);
+                goto end;
+            }
+
+            while (!av_bsf_receive_packet(bsf, packet)) {
+                bool ok = sc_fake_clip_push(clip, true, packet,
+                                            bsf->time_base_out);
+                av_packet_unref(packet);
+                if (!ok) {
+                    goto end;
+                }
+            }
+        } else {
+            av_packet_unref(packet);
+        }
+    }
+
+    ret = true;
+
+end:
+    av_packet_free(&packet);
+    av_bsf_free(&bsf);
+    avformat_close_input(&fmt_ctx);
+
+    return ret;
+}
+
+// Send a frame (or NULL to flush) and store the resulting packets
+static bool
+sc_fake_clip_encode(struct sc_fake_clip *clip, bool video, AVCodecContext *ctx,
+                    const AVFrame *frame, AVPacket *packet) {
+    if (avcodec_send_frame(ctx, frame) < 0) {
+        LOGE("Could not send %s frame to the encoder",
+             video ? "video" : "audio");
+        return false;
+    }
+
+    for (;;) {
+        int r = avcodec_receive_packet(ctx, packet);
+        if (r == AVERROR(EAGAIN) || r == AVERROR_EOF) {
+            return true;
+        }
+        if (r < 0) {
+            LOGE("Could not encode %s frame", video ? "video" : "audio");
+            return false;
+        }
+
+        bool ok = sc_fake_clip_push(clip, video, packet, ctx->time_base);
+        av_packet_unref(packet);
+        if (!ok) {
+            return false;
+        }
+    }
+}
+
+static void
+sc_fake_clip_draw_pattern(AVFrame *frame, unsigned index) {
+    // A gradient scrolling diagonally, so that every frame is different
+    for (int y = 0; y < frame->height; ++y) {
+        uint8_t *line = &frame->data[0][y * frame->linesize[0]];
+        for (int x = 0; x < frame->width; ++x) {
+            line[x] = x + y + index * 3;
+        }
+    }
+
+    for (int y = 0; y < frame->height / 2; ++y) {
+        uint8_t *u = &frame->data[1][y * frame->linesize[1]];
+        uint8_t *v = &frame->data[2][y * frame->linesize[2]];
+        for (int x = 0; x < frame->width / 2; ++x) {
+            u[x] = 128 + y + index * 2;
+            v[x] = 64 + x + index * 5;
+        }
+    }
+}
+
+static bool
+sc_fake_clip_generate_video(struct sc_fake_clip *clip,
+                            const struct sc_fake_clip_params *params) {
+    const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+    if (!codec) {
+        LOGE("H.264 encoder not found");
+        return false;
+    }
+
+    AVCodecContext *ctx = avcodec_alloc_context3(codec);
+    if (!ctx) {
+        LOG_OOM();
+        return false;
+    }
+
+    bool ret = false;
+    AVFrame *frame = NULL;
+    AVPacket *packet = NULL;
+
+    ctx->width = params->width;
+    ctx->height = params->height;
+    ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+    ctx->time_base = (AVRational) {1, params->fps};
+    ctx->framerate = (AVRational) {params->fps, 1};
+    ctx->bit_rate = params->video_bit_rate;
+    // One keyframe per second, no B-frames (like a device encoder)
+    ctx->gop_size = params->fps;
+    ctx->max_b_frames = 0;
+    // Produce the parameter sets separately, to send them as a config packet
+    ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    if (avcodec_open2(ctx, codec, NULL) < 0) {
+        LOGE("Could not open the H.264 encoder");
+        goto end;
+    }
+
+    if (!sc_fake_stream_init(&clip->video, AV_CODEC_ID_H264, ctx->extradata,
+                             ctx->extradata_size)) {
+        goto end;
+    }
+    clip->video.width = params->width;
+    clip->video.height = params->height;
+
+    frame = av_frame_alloc();
+    packet = av_packet_alloc();
+    if (!frame || !packet) {
+        LOG_OOM();
+        goto end;
+    }
+
+    frame->format = ctx->pix_fmt;
+    frame->width = ctx->width;
+    frame->height = ctx->height;
+    if (av_frame_get_buffer(frame, 0) < 0) {
+        LOG_OOM();
+        goto end;
+    }
+
+    unsigned count = params->duration * params->fps / SC_TICK_FREQ;
+    for (unsigned i = 0; i < count; ++i) {
+        if (av_frame_make_writable(frame) < 0) {
+            LOG_OOM();
+            goto end;
+        }
+
+        sc_fake_clip_draw_pattern(frame, i);
+        frame->pts = i;
+
+        if (!sc_fake_clip_encode(clip, true, ctx, frame, packet)) {
+            goto end;
+        }
+    }
+
+    // Flush
+    ret = sc_fake_clip_encode(clip, true, ctx, NULL, packet);
+
+end:
+    av_packet_free(&packet);
+    av_frame_free(&frame);
+    avcodec_free_context(&ctx);
+
+    return ret;
+}
+
+static enum AVSampleFormat
+sc_fake_clip_select_sample_fmt(const AVCodec *codec) {
+    const enum AVSampleFormat *fmt = codec->sample_fmts;
+    if (!fmt) {
+        return AV_SAMPLE_FMT_NONE;
+    }
+
+    for (; *fmt != AV_SAMPLE_FMT_NONE; ++fmt) {
+        switch (*fmt) {
+            case AV_SAMPLE_FMT_FLT:
+            case AV_SAMPLE_FMT_FLTP:
+            case AV_SAMPLE_FMT_S16:
+            case AV_SAMPLE_FMT_S16P:
+                return *fmt;
+            default:
+                break;
+        }
+    }
+
+    return AV_SAMPLE_FMT_NONE;
+}
+
+static void
+sc_fake_clip_write_tone(AVFrame *frame, int64_t pos) {
+    bool planar = av_sample_fmt_is_planar(frame->format);
+    enum AVSampleFormat fmt = av_get_packed_sample_fmt(frame->format);
+
+    for (int i = 0; i < frame->nb_samples; ++i) {
+        // 440 Hz
+        double t = (double) (pos + i) / SC_AUDIO_SAMPLE_RATE;
+        float sample = 0.3f * (float) sin(2 * M_PI * 440 * t);
+
+        for (int c = 0; c < 2; ++c) {
+            uint8_t *data = planar ? frame->data[c] : frame->data[0];
+            int index = planar ? i : i * 2 + c;
+            if (fmt == AV_SAMPLE_FMT_FLT) {
+                ((float *) data)[index] = sample;
+            } else {
+                assert(fmt == AV_SAMPLE_FMT_S16);
+                ((int16_t *) data)[index] = (int16_t) (sample * INT16_MAX);
+            }
+        }
+    }
+}
+
+static bool
+sc_fake_clip_generate_audio(struct sc_fake_clip *clip,
+                            const struct sc_fake_clip_params *params) {
+    const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_OPUS);
+    if (!codec) {
+        LOGE("Opus encoder not found");
+        return false;
+    }
+
+    enum AVSampleFormat sample_fmt = sc_fake_clip_select_sample_fmt(codec);
+    if (sample_fmt == AV_SAMPLE_FMT_NONE) {
+        LOGE("No supported sample format for the Opus encoder");
+        return false;
+    }
+
+    AVCodecContext *ctx = avcodec_alloc_context3(codec);
+    if (!ctx) {
+        LOG_OOM();
+        return false;
+    }
+
+    bool ret = false;
+    AVFrame *frame = NULL;
+    AVPacket *packet = NULL;
+
+    ctx->sample_rate = SC_AUDIO_SAMPLE_RATE;
+    ctx->sample_fmt = sample_fmt;
+    ctx->time_base = (AVRational) {1, SC_AUDIO_SAMPLE_RATE};
+    ctx->bit_rate = params->audio_bit_rate;
+#ifdef SCRCPY_LAVU_HAS_CHLAYOUT
+    av_channel_layout_default(&ctx->ch_layout, 2);
+#else
+    ctx->channel_layout = AV_CH_LAYOUT_STEREO;
+    ctx->channels = 2;
+#endif
+    // The native FFmpeg Opus encoder is experimental
+    ctx->strict_std_compliance = FF_COMPLIANCE_EXPERIMENTAL;
+
+    if (avcodec_open2(ctx, codec, NULL) < 0) {
+        LOGE("Could not open the Opus encoder");
+        goto end;
+    }
+
+    // The extradata is the OpusHead, sent as config packet by the device
+    if (!sc_fake_stream_init(&clip->audio, AV_CODEC_ID_OPUS, ctx->extradata,
+                             ctx->extradata_size)) {
+        goto end;
+    }
+
+    frame = av_frame_alloc();
+    packet = av_packet_alloc();
+    if (!frame || !packet) {
+        LOG_OOM();
+        goto end;
+    }
+
+    frame->format = ctx->sample_fmt;
+    frame->nb_samples = ctx->frame_size;
+#ifdef SCRCPY_LAVU_HAS_CHLAYOUT
+    if (av_channel_layout_copy(&frame->ch_layout, &ctx->ch_layout) < 0) {
+        LOG_OOM();
+        goto end;
+    }
+#else
+    frame->channel_layout = ctx->channel_layout;
+    frame->channels = ctx->channels;
+#endif
+    if (av_frame_get_buffer(frame, 0) < 0) {
+        LOG_OOM();
+        goto end;
+    }
+
+    int64_t total = params->duration * SC_AUDIO_SAMPLE_RATE / SC_TICK_FREQ;
+    for (int64_t pos = 0; pos + frame->nb_samples <= total;
+            pos += frame->nb_samples) {
+        if (av_frame_make_writable(frame) < 0) {
+            LOG_OOM();
+            goto end;
+        }
+
+        sc_fake_clip_write_tone(frame, pos);
+        frame->pts = pos;
+
+        if (!sc_fake_clip_encode(clip, false, ctx, frame, packet)) {
+            goto end;
+        }
+    }
+
+    // Flush
+    ret = sc_fake_clip_encode(clip, false, ctx, NULL, packet);
+
+end:
+    av_packet_free(&packet);
+    av_frame_free(&frame);
+    avcodec_free_context(&ctx);
+
+    return ret;
+}
+
+bool
+sc_fake_clip_init(struct sc_fake_clip *clip,
+                  const struct sc_fake_clip_params *params) {
+    assert(params->video || params->audio);
+
+    memset(clip, 0, sizeof(*clip));
+    sc_vector_init(&clip->packets);
+
+    bool ok;
+    if (params->filename) {
+        ok = sc_fake_clip_load_file(clip, params);
+    } else {
+        ok = (!params->video || sc_fake_clip_generate_video(clip, params))
+          && (!params->audio || sc_fake_clip_generate_audio(clip, params));
+    }
+
+    if (!ok) {
+        sc_fake_clip_destroy(clip);
+        return false;
+    }
+
+    sc_fake_clip_normalize(clip);
+
+    if (!params->filename) {
+        // Loop exactly on the generated duration (the encoders may output
+        // packets slightly before 0 because of their initial padding)
+        clip->duration = params->duration;
+    }
+
+    if (!clip->packets.size || clip->duration <= 0) {
+        LOGE("No packets to serve");
+        sc_fake_clip_destroy(clip);
+        return false;
+    }
+
+    LOGI("Clip: %zu packets, %" PRItick " ms", clip->packets.size,
+         SC_TICK_TO_MS(clip->duration));
+    return true;
+}
+
+void
+sc_fake_clip_destroy(struct sc_fake_clip *clip) {
+    for (size_t i = 0; i < clip->packets.size; ++i) {
+        free(clip->packets.data[i].data);
+    }
+    sc_vector_destroy(&clip->packets);
+    free(clip->video.config);
+    free(clip->audio.config);
+}
@@ -0,0 +1,63 @@
+#ifndef SC_FAKE_DEVICE_CLIP_H
+#define SC_FAKE_DEVICE_CLIP_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "util/tick.h"
+#include "util/vector.h"
+
+struct sc_fake_stream {
+    bool enabled;
+    uint32_t codec_id; // as sent on the socket (see demuxer.c)
+    uint32_t width; // video only
+    uint32_t height; // video only
+    uint8_t *config; // config packet, may be NULL
+    size_t config_size;
+};
+
+struct sc_fake_packet {
+    bool video;
+    bool key_frame;
+    sc_tick time; // sending time, relative to the clip start
+    int64_t pts; // in microseconds
+    uint8_t *data;
+    size_t size;
+};
+
+/**
+ * Packets loaded in memory once, and served (in a loop) to all the clients
+ */
+struct sc_fake_clip {
+    struct sc_fake_stream video;
+    struct sc_fake_stream audio;
+
+    // interleaved in sending order
+    struct SC_VECTOR(struct sc_fake_packet) packets;
+    sc_tick duration;
+};
+
+struct sc_fake_clip_params {
+    bool video;
+    bool audio;
+    const char *filename; // if NULL, a synthetic pattern is encoded
+    // for the synthetic pattern only
+    uint16_t width;
+    uint16_t height;
+    uint16_t fps;
+    uint32_t video_bit_rate;
+    uint32_t audio_bit_rate;
+    sc_tick duration;
+};
+
+bool
+sc_fake_clip_init(struct sc_fake_clip *clip,
+                  const struct sc_fake_clip_params *params);
+
+void
+sc_fake_clip_destroy(struct sc_fake_clip *clip);
+
+#endif
@@ -0,0 +1,119 @@
+#include "control_msg_size.h"
+
+#include "control_msg.h"
+#include "util/binary.h"
+
+// Return the size of a message composed of a fixed header followed by a
+// variable part, whose length is stored (big-endian) at the end of the header
+static ssize_t
+get_size_with_length(const uint8_t *buf, size_t len, size_t header_size,
+                     unsigned length_size) {
+    if (len < header_size) {
+        return 0;
+    }
+
+    const uint8_t *p = &buf[header_size - length_size];
+    size_t data_len = length_size == 4 ? sc_read32be(p)
+                    : length_size == 2 ? sc_read16be(p)
+                                       : *p;
+
+    if (data_len > SC_CONTROL_MSG_MAX_SIZE - header_size) {
+        return -1;
+    }
+
+    return header_size + data_len;
+}
+
+ssize_t
+sc_control_msg_get_size(const uint8_t *buf, size_t len) {
+    if (!len) {
+        return 0;
+    }
+
+    switch (buf[0]) {
+        case SC_CONTROL_MSG_TYPE_INJECT_KEYCODE:
+            return 14;
+        case SC_CONTROL_MSG_TYPE_INJECT_TEXT:
+            return get_size_with_length(buf, len, 5, 4);
+        case SC_CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT:
+            return 32;
+        case SC_CONTROL_MSG_TYPE_INJECT_SCROLL_EVENT:
+            return 21;
+        case SC_CONTROL_MSG_TYPE_BACK_OR_SCREEN_ON:
+        case SC_CONTROL_MSG_TYPE_GET_CLIPBOARD:
+        case SC_CONTROL_MSG_TYPE_SET_DISPLAY_POWER:
+            return 2;
+        case SC_CONTROL_MSG_TYPE_SET_CLIPBOARD:
+            return get_size_with_length(buf, len, 14, 4);
+        case SC_CONTROL_MSG_TYPE_UHID_CREATE: {
+            // id, vendor id, product id, then the name (tiny string)
+            ssize_t name_end = get_size_with_length(buf, len, 8, 1);
+            if (name_end <= 0) {
+                return name_end;
+            }
+            // then the report descriptor (2-byte length)
+            ssize_t r = get_size_with_length(&buf[name_end], len - name_end, 2,
+                                             2);
+            return r <= 0 ? r : name_end + r;
+        }
+        case SC_CONTROL_MSG_TYPE_UHID_INPUT:
+            return get_size_with_length(buf, len, 5, 2);
+        case SC_CONTROL_MSG_TYPE_UHID_DESTROY:
+            return 3;
+        case SC_CONTROL_MSG_TYPE_START_APP:
+            return get_size_with_length(buf, len, 2, 1);
+        case SC_CONTROL_MSG_TYPE_EXPAND_NOTIFICATION_PANEL:
+        case SC_CONTROL_MSG_TYPE_EXPAND_SETTINGS_PANEL:
+        case SC_CONTROL_MSG_TYPE_COLLAPSE_PANELS:
+        case SC_CONTROL_MSG_TYPE_ROTATE_DEVICE:
+        case SC_CONTROL_MSG_TYPE_OPEN_HARD_KEYBOARD_SETTINGS:
+        case SC_CONTROL_MSG_TYPE_RESET_VIDEO:
+            return 1;
+        default:
+            return -1;
+    }
+}
+
+const char *
+sc_control_msg_get_type_name(uint8_t type) {
+    switch (type) {
+        case SC_CONTROL_MSG_TYPE_INJECT_KEYCODE:
+            return "inject keycode";
+        case SC_CONTROL_MSG_TYPE_INJECT_TEXT:
+            return "inject text";
+        case SC_CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT:
+            return "inject touch event";
+        case SC_CONTROL_MSG_TYPE_INJECT_SCROLL_EVENT:
+            return "inject scroll event";
+        case SC_CONTROL_MSG_TYPE_BACK_OR_SCREEN_ON:
+            return "back or screen on";
+        case SC_CONTROL_MSG_TYPE_EXPAND_NOTIFICATION_PANEL:
+            return "expand notification panel";
+        case SC_CONTROL_MSG_TYPE_EXPAND_SETTINGS_PANEL:
+            return "expand settings panel";
+        case SC_CONTROL_MSG_TYPE_COLLAPSE_PANELS:
+            return "collapse panels";
+        case SC_CONTROL_MSG_TYPE_GET_CLIPBOARD:
+            return "get clipboard";
+        case SC_CONTROL_MSG_TYPE_SET_CLIPBOARD:
+            return "set clipboard";
+        case SC_CONTROL_MSG_TYPE_SET_DISPLAY_POWER:
+            return "set display power";
+        case SC_CONTROL_MSG_TYPE_ROTATE_DEVICE:
+            return "rotate device";
+        case SC_CONTROL_MSG_TYPE_UHID_CREATE:
+            return "uhid create";
+        case SC_CONTROL_MSG_TYPE_UHID_INPUT:
+            return "uhid input";
+        case SC_CONTROL_MSG_TYPE_UHID_DESTROY:
+            return "uhid destroy";
+        case SC_CONTROL_MSG_TYPE_OPEN_HARD_KEYBOARD_SETTINGS:
+            return "open hard keyboard settings";
+        case SC_CONTROL_MSG_TYPE_START_APP:
+            return "start app";
+        case SC_CONTROL_MSG_TYPE_RESET_VIDEO:
+            return "reset video";
+        default:
+            return NULL;
+    }
+}
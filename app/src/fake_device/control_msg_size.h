@@ -0,0 +1,24 @@
+#ifndef SC_FAKE_DEVICE_CONTROL_MSG_SIZE_H
+#define SC_FAKE_DEVICE_CONTROL_MSG_SIZE_H
+
+#include "common.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * Return the size of the control message at the start of buf (the device side
+ * counterpart of sc_control_msg_serialize())
+ *
+ * Return 0 if more bytes are needed to know the size, or -1 if the message is
+ * invalid.
+ */
+ssize_t
+sc_control_msg_get_size(const uint8_t *buf, size_t len);
+
+// Return the message type name, or NULL if the type is unknown
+const char *
+sc_control_msg_get_type_name(uint8_t type);
+
+#endif
@@ -0,0 +1,465 @@
+#include "common.h"
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fake_device/clip.h"
+#include "fake_device/session.h"
+#include "util/log.h"
+#include "util/net.h"
+#include "util/str.h"
+#include "util/thread.h"
+
+#define DEFAULT_PORT 27183
+
+// shared by all the listeners
+static atomic_uint next_session_id;
+
+struct sc_fake_device_options {
+    uint16_t port_first;
+    uint16_t port_last;
+    const char *device_name;
+    bool video;
+    bool audio;
+    bool control;
+    struct sc_fake_clip_params clip;
+};
+
+struct sc_fake_listener {
+    uint16_t port;
+    sc_socket socket;
+    sc_thread thread;
+    const struct sc_fake_device_options *options;
+    const struct sc_fake_clip *clip;
+};
+
+static void
+print_usage(const char *arg0) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "\n"
+        "Serve the device side of the scrcpy protocol on localhost, so that\n"
+        "clients can be started without any device:\n"
+        "\n"
+        "    scrcpy --no-adb --tunnel-port=%d\n"
+        "\n"
+        "The video, audio and control options must match those of the\n"
+        "clients.\n"
+        "\n"
+        "Options:\n"
+        "\n"
+        "    --audio-bit-rate=value\n"
+        "        Synthetic audio bit rate (default 128K).\n"
+        "\n"
+        "    --device-name=name\n"
+        "        Device name sent to the clients.\n"
+        "\n"
+        "    --duration=seconds\n"
+        "        Synthetic clip duration, served in a loop (default 10).\n"
+        "\n"
+        "    --file=file\n"
+        "        Serve the H.264/H.265 and Opus/AAC streams of a media file\n"
+        "        (in a loop) instead of a synthetic pattern.\n"
+        "\n"
+        "    --fps=value\n"
+        "        Synthetic video frame rate (default 60).\n"
+        "\n"
+        "    -h, --help\n"
+        "        Print this help.\n"
+        "\n"
+        "    --no-audio\n"
+        "    --no-control\n"
+        "    --no-video\n"
+        "        Disable a stream (like the client options).\n"
+        "\n"
+        "    --port=port[:port]\n"
+        "        Listen on the given port, or on each port of the range (one\n"
+        "        per client instance, to start them concurrently).\n"
+        "        Default is %d.\n"
+        "\n"
+        "    --size=<width>x<height>\n"
+        "        Synthetic video size (default 1280x720).\n"
+        "\n"
+        "    --video-bit-rate=value\n"
+        "        Synthetic video bit rate (default 8M).\n"
+        "\n",
+        arg0, DEFAULT_PORT, DEFAULT_PORT);
+}
+
+static bool
+parse_integer_arg(const char *s, long *out, bool accept_suffix, long min,
+                  long max, const char *name) {
+    long value;
+    bool ok = accept_suffix ? sc_str_parse_integer_with_suffix(s, &value)
+                            : sc_str_parse_integer(s, &value);
+    if (!ok || value < min || value > max) {
+        LOGE("Invalid %s: %s", name, s);
+        return false;
+    }
+
+    *out = value;
+    return true;
+}
+
+static bool
+parse_ports(const char *s, uint16_t *first, uint16_t *last) {
+    long values[2];
+    size_t count = sc_str_parse_integers(s, ':', 2, values);
+    if (!count) {
+        LOGE("Invalid port: %s", s);
+        return false;
+    }
+
+    if (count == 1) {
+        values[1] = values[0];
+    }
+
+    if (values[0] < 1 || values[0] > 0xFFFF || values[1] < values[0]
+            || values[1] > 0xFFFF) {
+        LOGE("Invalid port range: %s", s);
+        return false;
+    }
+
+    *first = values[0];
+    *last = values[1];
+    return true;
+}
+
+static bool
+parse_size(const char *s, uint16_t *width, uint16_t *height) {
+    long values[2];
+    size_t count = sc_str_parse_integers(s, 'x', 2, values);
+    // The encoders require even dimensions for YUV 4:2:0
+    if (count != 2 || values[0] < 16 || values[0] > 0xFFFF || values[0] % 2
+            || values[1] < 16 || values[1] > 0xFFFF || values[1] % 2) {
+        LOGE("Invalid size: %s", s);
+        return false;
+    }
+
+    *width = values[0];
+    *height = values[1];
+    return true;
+}
+
+static bool
+parse_args(struct sc_fake_device_options *options, int argc, char *argv[],
+           bool *help) {
+    enum {
+        OPT_AUDIO_BIT_RATE = 1000,
+        OPT_DEVICE_NAME,
+        OPT_DURATION,
+        OPT_FILE,
+        OPT_FPS,
+        OPT_NO_AUDIO,
+        OPT_NO_CONTROL,
+        OPT_NO_VIDEO,
+        OPT_PORT,
+        OPT_SIZE,
+        OPT_VIDEO_BIT_RATE,
+    };
+
+    static const struct option long_options[] = {
+        {"audio-bit-rate", required_argument, NULL, OPT_AUDIO_BIT_RATE},
+        {"device-name",    required_argument, NULL, OPT_DEVICE_NAME},
+        {"duration",       required_argument, NULL, OPT_DURATION},
+        {"file",           required_argument, NULL, OPT_FILE},
+        {"fps",            required_argument, NULL, OPT_FPS},
+        {"help",           no_argument,       NULL, 'h'},
+        {"no-audio",       no_argument,       NULL, OPT_NO_AUDIO},
+        {"no-control",     no_argument,       NULL, OPT_NO_CONTROL},
+        {"no-video",       no_argument,       NULL, OPT_NO_VIDEO},
+        {"port",           required_argument, NULL, OPT_PORT},
+        {"size",           required_argument, NULL, OPT_SIZE},
+        {"video-bit-rate", required_argument, NULL, OPT_VIDEO_BIT_RATE},
+        {NULL,             0,                 NULL, 0},
+    };
+
+    struct sc_fake_clip_params *clip = &options->clip;
+
+    int c;
+    long value;
+    while ((c = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+        switch (c) {
+            case OPT_AUDIO_BIT_RATE:
+                if (!parse_integer_arg(optarg, &value, true, 1, 0x7FFFFFFF,
+                                       "audio bit rate")) {
+                    return false;
+                }
+                clip->audio_bit_rate = value;
+                break;
+            case OPT_DEVICE_NAME:
+                options->device_name = optarg;
+                break;
+            case OPT_DURATION:
+                if (!parse_integer_arg(optarg, &value, false, 1, 3600,
+                                       "duration")) {
+                    return false;
+                }
+                clip->duration = SC_TICK_FROM_SEC(value);
+                break;
+            case OPT_FILE:
+                clip->filename = optarg;
+                break;
+            case OPT_FPS:
+                if (!parse_integer_arg(optarg, &value, false, 1, 240,
+                                       "fps")) {
+                    return false;
+                }
+                clip->fps = value;
+                break;
+            case 'h':
+                *help = true;
+                break;
+            case OPT_NO_AUDIO:
+                options->audio = false;
+                break;
+            case OPT_NO_CONTROL:
+                options->control = false;
+                break;
+            case OPT_NO_VIDEO:
+                options->video = false;
+                break;
+            case OPT_PORT:
+                if (!parse_ports(optarg, &options->port_first,
+                                 &options->port_last)) {
+                    return false;
+                }
+                break;
+            case OPT_SIZE:
+                if (!parse_size(optarg, &clip->width, &clip->height)) {
+                    return false;
+                }
+                break;
+            case OPT_VIDEO_BIT_RATE:
+                if (!parse_integer_arg(optarg, &value, true, 1, 0x7FFFFFFF,
+                                       "video bit rate")) {
+                    return false;
+                }
+                clip->video_bit_rate = value;
+                break;
+            default:
+                // getopt prints the error message on stderr
+                return false;
+        }
+    }
+
+    if (optind < argc) {
+        LOGE("Unexpected additional argument: %s", argv[optind]);
+        return false;
+    }
+
+    if (!options->video && !options->audio && !options->control) {
+        LOGE("Nothing to serve");
+        return false;
+    }
+
+    clip->video = options->video;
+    clip->audio = options->audio;
+
+    return true;
+}
+
+static sc_socket
+sc_fake_listener_accept(struct sc_fake_listener *listener) {
+    sc_socket socket = net_accept(listener->socket);
+    if (socket == SC_SOCKET_NONE) {
+        LOGE("Port %" PRIu16 ": could not accept", listener->port);
+    }
+    return socket;
+}
+
+static bool
+sc_fake_listener_accept_session(struct sc_fake_listener *listener,
+                                struct sc_fake_session *session) {
+    const struct sc_fake_device_options *options = listener->options;
+
+    // Like the device server in forward mode, accept the sockets in the order
+    // the client connects them: video, audio then control
+    sc_socket *sockets[] = {
+        options->video ? &session->video_socket : NULL,
+        options->audio ? &session->audio_socket : NULL,
+        options->control ? &session->control_socket : NULL,
+    };
+
+    bool first = true;
+    for (size_t i = 0; i < ARRAY_LEN(sockets); ++i) {
+        if (!sockets[i]) {
+            continue;
+        }
+
+        *sockets[i] = sc_fake_listener_accept(listener);
+        if (*sockets[i] == SC_SOCKET_NONE) {
+            return false;
+        }
+
+        if (first) {
+            // The client reads one byte to detect a working connection
+            uint8_t dummy_byte = 0;
+            if (net_send_all(*sockets[i], &dummy_byte, 1) != 1) {
+                return false;
+            }
+            first = false;
+        }
+    }
+
+    if (session->control_socket != SC_SOCKET_NONE) {
+        // Device messages (e.g. clipboard) are small, send them immediately
+        net_set_tcp_nodelay(session->control_socket, true);
+    }
+
+    return true;
+}
+
+static int
+run_fake_listener(void *data) {
+    struct sc_fake_listener *listener = data;
+
+    for (;;) {
+        struct sc_fake_session *session = malloc(sizeof(*session));
+        if (!session) {
+            LOG_OOM();
+            break;
+        }
+
+        session->clip = listener->clip;
+        session->device_name = listener->options->device_name;
+        session->video_socket = SC_SOCKET_NONE;
+        session->audio_socket = SC_SOCKET_NONE;
+        session->control_socket = SC_SOCKET_NONE;
+
+        bool ok = sc_fake_listener_accept_session(listener, session);
+        if (ok) {
+            session->id = atomic_fetch_add(&next_session_id, 1);
+            LOGI("Port %" PRIu16 ": session %u started", listener->port,
+                 session->id);
+            ok = sc_fake_session_start(session);
+        }
+
+        if (!ok) {
+            if (session->video_socket != SC_SOCKET_NONE) {
+                net_close(session->video_socket);
+            }
+            if (session->audio_socket != SC_SOCKET_NONE) {
+                net_close(session->audio_socket);
+            }
+            if (session->control_socket != SC_SOCKET_NONE) {
+                net_close(session->control_socket);
+            }
+            free(session);
+        }
+    }
+
+    return 0;
+}
+
+int
+main(int argc, char *argv[]) {
+    struct sc_fake_device_options options = {
+        .port_first = DEFAULT_PORT,
+        .port_last = DEFAULT_PORT,
+        .device_name = "scrcpy-fake-device",
+        .video = true,
+        .audio = true,
+        .control = true,
+        .clip = {
+            .filename = NULL,
+            .width = 1280,
+            .height = 720,
+            .fps = 60,
+            .video_bit_rate = 8000000,
+            .audio_bit_rate = 128000,
+            .duration = SC_TICK_FROM_SEC(10),
+        },
+    };
+
+    bool help = false;
+    if (!parse_args(&options, argc, argv, &help)) {
+        return 1;
+    }
+
+    if (help) {
+        print_usage(argv[0]);
+        return 0;
+    }
+
+    if (!net_init()) {
+        return 1;
+    }
+
+    sc_log_configure();
+
+    int ret = 1;
+
+    struct sc_fake_clip clip;
+    if ((options.video || options.audio)
+            && !sc_fake_clip_init(&clip, &options.clip)) {
+        goto end_net;
+    }
+
+    size_t count = options.port_last - options.port_first + 1;
+    struct sc_fake_listener *listeners = calloc(count, sizeof(*listeners));
+    if (!listeners) {
+        LOG_OOM();
+        goto end_clip;
+    }
+
+    size_t started = 0;
+    for (; started < count; ++started) {
+        struct sc_fake_listener *listener = &listeners[started];
+        listener->port = options.port_first + started;
+        listener->options = &options;
+        listener->clip = &clip;
+
+        listener->socket = net_socket();
+        if (listener->socket == SC_SOCKET_NONE) {
+            LOGE("Could not create socket");
+            break;
+        }
+
+        if (!net_listen(listener->socket, IPV4_LOCALHOST, listener->port, 8)) {
+            LOGE("Could not listen on port %" PRIu16, listener->port);
+            net_close(listener->socket);
+            break;
+        }
+
+        if (!sc_thread_create(&listener->thread, run_fake_listener,
+                              "fake-listener", listener)) {
+            net_close(listener->socket);
+            break;
+        }
+    }
+
+    if (started == count) {
+        if (count == 1) {
+            LOGI("Listening on port %" PRIu16, options.port_first);
+        } else {
+            LOGI("Listening on ports %" PRIu16 " to %" PRIu16,
+                 options.port_first, options.port_last);
+        }
+        ret = 0;
+    }
+
+    for (size_t i = 0; i < started; ++i) {
+        if (ret) {
+            // Stop the listeners on error
+            net_interrupt(listeners[i].socket);
+        }
+        // Otherwise, serve until killed
+        sc_thread_join(&listeners[i].thread, NULL);
+        net_close(listeners[i].socket);
+    }
+
+    free(listeners);
+end_clip:
+    if (options.video || options.audio) {
+        sc_fake_clip_destroy(&clip);
+    }
+end_net:
+    net_cleanup();
+
+    return ret;
+}
@@ -0,0 +1,264 @@
+#include "session.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "control_msg.h"
+#include "server.h"
+#include "fake_device/control_msg_size.h"
+#include "util/binary.h"
+#include "util/log.h"
+
+#define SC_PACKET_HEADER_SIZE 12
+
+#define SC_PACKET_FLAG_CONFIG    (UINT64_C(1) << 63)
+#define SC_PACKET_FLAG_KEY_FRAME (UINT64_C(1) << 62)
+
+static bool
+sc_fake_session_send_packet(sc_socket socket, uint64_t pts_flags,
+                            const uint8_t *data, size_t len) {
+    assert(len && len <= UINT32_MAX);
+
+    uint8_t header[SC_PACKET_HEADER_SIZE];
+    sc_write64be(header, pts_flags);
+    sc_write32be(&header[8], len);
+
+    return net_send_all(socket, header, sizeof(header)) == sizeof(header)
+        && net_send_all(socket, data, len) == (ssize_t) len;
+}
+
+static bool
+sc_fake_session_send_stream_meta(sc_socket socket,
+                                 const struct sc_fake_stream *stream,
+                                 bool video) {
+    uint8_t buf[12];
+    size_t len = 4;
+    sc_write32be(buf, stream->codec_id);
+    if (video) {
+        sc_write32be(&buf[4], stream->width);
+        sc_write32be(&buf[8], stream->height);
+        len = 12;
+    }
+
+    if (net_send_all(socket, buf, len) != (ssize_t) len) {
+        return false;
+    }
+
+    if (!stream->config) {
+        return true;
+    }
+
+    return sc_fake_session_send_packet(socket, SC_PACKET_FLAG_CONFIG,
+                                       stream->config, stream->config_size);
+}
+
+static void
+sc_fake_session_sleep(struct sc_fake_session *session, sc_tick deadline) {
+    sc_mutex_lock(&session->mutex);
+    while (sc_cond_timedwait(&session->cond, &session->mutex, deadline)) {
+        // spurious wakeup (the condition is never signaled)
+    }
+    sc_mutex_unlock(&session->mutex);
+}
+
+static void
+sc_fake_session_stream(struct sc_fake_session *session) {
+    const struct sc_fake_clip *clip = session->clip;
+
+    sc_tick start = sc_tick_now();
+    for (uint64_t loop = 0;; ++loop) {
+        sc_tick offset = loop * clip->duration;
+
+        for (size_t i = 0; i < clip->packets.size; ++i) {
+            const struct sc_fake_packet *p = &clip->packets.data[i];
+            sc_socket socket = p->video ? session->video_socket
+                                        : session->audio_socket;
+            if (socket == SC_SOCKET_NONE) {
+                continue;
+            }
+
+            sc_fake_session_sleep(session, start + offset + p->time);
+
+            uint64_t pts_flags = offset + p->pts;
+            if (p->key_frame) {
+                pts_flags |= SC_PACKET_FLAG_KEY_FRAME;
+            }
+
+            if (!sc_fake_session_send_packet(socket, pts_flags, p->data,
+                                             p->size)) {
+                LOGI("Session %u: client disconnected", session->id);
+                return;
+            }
+        }
+    }
+}
+
+static int
+run_fake_control(void *data) {
+    struct sc_fake_session *session = data;
+
+    uint8_t *buf = malloc(SC_CONTROL_MSG_MAX_SIZE);
+    if (!buf) {
+        LOG_OOM();
+        return 0;
+    }
+
+    size_t head = 0;
+
+    for (;;) {
+        assert(head < SC_CONTROL_MSG_MAX_SIZE);
+        ssize_t r = net_recv(session->control_socket, &buf[head],
+                             SC_CONTROL_MSG_MAX_SIZE - head);
+        if (r <= 0) {
+            LOGD("Session %u: control stopped", session->id);
+            break;
+        }
+
+        head += r;
+
+        size_t consumed = 0;
+        for (;;) {
+            ssize_t size = sc_control_msg_get_size(&buf[consumed],
+                                                   head - consumed);
+            if (size < 0) {
+                LOGW("Session %u: invalid control message (type %d)",
+                     session->id, (int) buf[consumed]);
+                goto end;
+            }
+
+            if (!size || (size_t) size > head - consumed) {
+                // Incomplete
+                break;
+            }
+
+            const char *name = sc_control_msg_get_type_name(buf[consumed]);
+            assert(name);
+            LOGI("Session %u: control message: %s (%" PRIu64 " bytes)",
+                 session->id, name, (uint64_t) size);
+
+            consumed += size;
+        }
+
+        head -= consumed;
+        memmove(buf, &buf[consumed], head);
+    }
+
+end:
+    free(buf);
+    return 0;
+}
+
+static bool
+sc_fake_session_send_device_meta(struct sc_fake_session *session) {
+    sc_socket socket = session->video_socket != SC_SOCKET_NONE
+                     ? session->video_socket
+                     : session->audio_socket != SC_SOCKET_NONE
+                     ? session->audio_socket
+                     : session->control_socket;
+
+    uint8_t buf[SC_DEVICE_NAME_FIELD_LENGTH] = {0};
+    // Keep the final '\0'
+    strncpy((char *) buf, session->device_name, sizeof(buf) - 1);
+
+    return net_send_all(socket, buf, sizeof(buf)) == sizeof(buf);
+}
+
+static void
+sc_fake_session_destroy(struct sc_fake_session *session) {
+    if (session->video_socket != SC_SOCKET_NONE) {
+        net_close(session->video_socket);
+    }
+    if (session->audio_socket != SC_SOCKET_NONE) {
+        net_close(session->audio_socket);
+    }
+    if (session->control_socket != SC_SOCKET_NONE) {
+        net_close(session->control_socket);
+    }
+    sc_cond_destroy(&session->cond);
+    sc_mutex_destroy(&session->mutex);
+    free(session);
+}
+
+static int
+run_fake_session(void *data) {
+    struct sc_fake_session *session = data;
+    const struct sc_fake_clip *clip = session->clip;
+
+    bool control = session->control_socket != SC_SOCKET_NONE;
+    if (control) {
+        bool ok = sc_thread_create(&session->control_thread, run_fake_control,
+                                   "fake-control", session);
+        if (!ok) {
+            LOGE("Session %u: could not start control thread", session->id);
+            control = false;
+            goto end;
+        }
+    }
+
+    if (!sc_fake_session_send_device_meta(session)) {
+        goto end;
+    }
+
+    if (session->video_socket != SC_SOCKET_NONE
+            && !sc_fake_session_send_stream_meta(session->video_socket,
+                                                 &clip->video, true)) {
+        goto end;
+    }
+
+    if (session->audio_socket != SC_SOCKET_NONE
+            && !sc_fake_session_send_stream_meta(session->audio_socket,
+                                                 &clip->audio, false)) {
+        goto end;
+    }
+
+    if (session->video_socket != SC_SOCKET_NONE
+            || session->audio_socket != SC_SOCKET_NONE) {
+        sc_fake_session_stream(session);
+    }
+
+end:
+    if (control) {
+        // Wake up the control thread, or wait for the client to disconnect if
+        // there is no video nor audio
+        if (session->video_socket != SC_SOCKET_NONE
+                || session->audio_socket != SC_SOCKET_NONE) {
+            net_interrupt(session->control_socket);
+        }
+        sc_thread_join(&session->control_thread, NULL);
+    }
+
+    LOGI("Session %u: closed", session->id);
+    sc_fake_session_destroy(session);
+
+    return 0;
+}
+
+bool
+sc_fake_session_start(struct sc_fake_session *session) {
+    bool ok = sc_mutex_init(&session->mutex);
+    if (!ok) {
+        return false;
+    }
+
+    ok = sc_cond_init(&session->cond);
+    if (!ok) {
+        sc_mutex_destroy(&session->mutex);
+        return false;
+    }
+
+    // The session may be released as soon as the thread is started, so the
+    // thread handle must not be stored in the session
+    sc_thread thread;
+    ok = sc_thread_create(&thread, run_fake_session, "fake-session", session);
+    if (!ok) {
+        LOGE("Could not start session thread");
+        sc_cond_destroy(&session->cond);
+        sc_mutex_destroy(&session->mutex);
+        return false;
+    }
+
+    sc_thread_detach(&thread);
+    return true;
+}
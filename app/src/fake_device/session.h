@@ -0,0 +1,41 @@
+#ifndef SC_FAKE_DEVICE_SESSION_H
+#define SC_FAKE_DEVICE_SESSION_H
+
+#include "common.h"
+
+#include <stdbool.h>
+
+#include "fake_device/clip.h"
+#include "util/net.h"
+#include "util/thread.h"
+
+/**
+ * The device side of one client connection
+ */
+struct sc_fake_session {
+    unsigned id;
+    const struct sc_fake_clip *clip; // shared by all the sessions
+    const char *device_name;
+
+    // SC_SOCKET_NONE if disabled
+    sc_socket video_socket;
+    sc_socket audio_socket;
+    sc_socket control_socket;
+
+    sc_thread control_thread;
+
+    // to wait for the packets sending time
+    sc_mutex mutex;
+    sc_cond cond;
+};
+
+/**
+ * Serve the clip to the client in a detached thread
+ *
+ * On success, the session (allocated by the caller) and its sockets are
+ * released once the client disconnects.
+ */
+bool
+sc_fake_session_start(struct sc_fake_session *session);
+
+#endif
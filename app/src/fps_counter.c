@@ -1,36 +1,27 @@
 #include "fps_counter.h"
 
 #include <assert.h>
-#include <stdint.h>
 
 #include "util/log.h"
 
 #define SC_FPS_COUNTER_INTERVAL SC_TICK_FROM_SEC(1)
 
-bool
+void
 sc_fps_counter_init(struct sc_fps_counter *counter) {
-    bool ok = sc_mutex_init(&counter->mutex);
-    if (!ok) {
-        return false;
-    }
+    atomic_init(&counter->started, false);
 
-    ok = sc_cond_init(&counter->state_cond);
-    if (!ok) {
-        sc_mutex_destroy(&counter->mutex);
-        return false;
-    }
+    atomic_init(&counter->nr_rendered, 0);
+    atomic_init(&counter->nr_skipped, 0);
+    atomic_init(&counter->nr_invisible, 0);
+    atomic_init(&counter->next_timestamp, 0);
 
-    counter->thread_started = false;
-    atomic_init(&counter->started, 0);
-    // no need to initialize the other fields, they are unused until started
+    atomic_init(&counter->rendered, 0);
+    atomic_init(&counter->skipped, 0);
+    atomic_init(&counter->invisible, 0);
 
-    return true;
-}
-
-void
-sc_fps_counter_destroy(struct sc_fps_counter *counter) {
-    sc_cond_destroy(&counter->state_cond);
-    sc_mutex_destroy(&counter->mutex);
+    atomic_init(&counter->last_rendered, 0);
+    sc_histogram_init(&counter->intervals);
+    sc_histogram_init(&counter->latencies);
 }
 
 static inline bool
@@ -43,91 +34,89 @@ set_started(struct sc_fps_counter *counter, bool started) {
     atomic_store_explicit(&counter->started, started, memory_order_release);
 }
 
-// must be called with mutex locked
 static void
-display_fps(struct sc_fps_counter *counter) {
+display_fps(unsigned nr_rendered, unsigned nr_skipped, unsigned nr_invisible,
+            sc_tick duration) {
+    assert(duration > 0);
     unsigned rendered_per_second =
-        counter->nr_rendered * SC_TICK_FREQ / SC_FPS_COUNTER_INTERVAL;
-    if (counter->nr_skipped) {
-        LOGI("%u fps (+%u frames skipped)", rendered_per_second,
-                                            counter->nr_skipped);
+        (sc_tick) nr_rendered * SC_TICK_FREQ / duration;
+    if (nr_invisible) {
+        LOGI("%u fps (+%u frames skipped, +%u frames not visible)",
+             rendered_per_second, nr_skipped, nr_invisible);
+    } else if (nr_skipped) {
+        LOGI("%u fps (+%u frames skipped)", rendered_per_second, nr_skipped);
     } else {
         LOGI("%u fps", rendered_per_second);
     }
 }
 
-// must be called with mutex locked
 static void
 check_interval_expired(struct sc_fps_counter *counter, sc_tick now) {
-    if (now < counter->next_timestamp) {
+    sc_tick next = atomic_load_explicit(&counter->next_timestamp,
+                                        memory_order_relaxed);
+    if (now < next) {
         return;
     }
 
-    display_fps(counter);
-    counter->nr_rendered = 0;
-    counter->nr_skipped = 0;
     // add a multiple of the interval
-    uint32_t elapsed_slices =
-        (now - counter->next_timestamp) / SC_FPS_COUNTER_INTERVAL + 1;
-    counter->next_timestamp += SC_FPS_COUNTER_INTERVAL * elapsed_slices;
+    uint32_t elapsed_slices = (now - next) / SC_FPS_COUNTER_INTERVAL + 1;
+    sc_tick new_next = next + SC_FPS_COUNTER_INTERVAL * elapsed_slices;
+    if (!atomic_compare_exchange_strong_explicit(&counter->next_timestamp,
+                                                 &next, new_next,
+                                                 memory_order_relaxed,
+                                                 memory_order_relaxed)) {
+        // Rolled over concurrently by another thread
+        return;
+    }
+
+    unsigned nr_rendered =
+        atomic_exchange_explicit(&counter->nr_rendered, 0,
+                                 memory_order_relaxed);
+    unsigned nr_skipped =
+        atomic_exchange_explicit(&counter->nr_skipped, 0, memory_order_relaxed);
+    unsigned nr_invisible =
+        atomic_exchange_explicit(&counter->nr_invisible, 0,
+                                 memory_order_relaxed);
+
+    // The interval is rolled over lazily (on the next frame), so the frames
+    // may have been counted over several intervals (e.g. after a pause)
+    sc_tick duration = now - (next - SC_FPS_COUNTER_INTERVAL);
+    display_fps(nr_rendered, nr_skipped, nr_invisible, duration);
 }
 
-static int
-run_fps_counter(void *data) {
-    struct sc_fps_counter *counter = data;
-
-    sc_mutex_lock(&counter->mutex);
-    while (!counter->interrupted) {
-        while (!counter->interrupted && !is_started(counter)) {
-            sc_cond_wait(&counter->state_cond, &counter->mutex);
-        }
-        while (!counter->interrupted && is_started(counter)) {
-            sc_tick now = sc_tick_now();
-            check_interval_expired(counter, now);
-
-            // ignore the reason (timeout or signaled), we just loop anyway
-            sc_cond_timedwait(&counter->state_cond, &counter->mutex,
-                              counter->next_timestamp);
-        }
+static void
+log_histogram(const char *name, const struct sc_histogram_stats *stats) {
+    if (!stats->count) {
+        return;
     }
-    sc_mutex_unlock(&counter->mutex);
-    return 0;
+
+    LOGI("%s: p50 %.1f ms, p95 %.1f ms, p99 %.1f ms, max %.1f ms", name,
+         stats->p50 / 1000.0, stats->p95 / 1000.0, stats->p99 / 1000.0,
+         stats->max / 1000.0);
 }
 
-bool
+void
 sc_fps_counter_start(struct sc_fps_counter *counter) {
-    sc_mutex_lock(&counter->mutex);
-    counter->interrupted = false;
-    counter->next_timestamp = sc_tick_now() + SC_FPS_COUNTER_INTERVAL;
-    counter->nr_rendered = 0;
-    counter->nr_skipped = 0;
-    sc_mutex_unlock(&counter->mutex);
+    atomic_store_explicit(&counter->nr_rendered, 0, memory_order_relaxed);
+    atomic_store_explicit(&counter->nr_skipped, 0, memory_order_relaxed);
+    atomic_store_explicit(&counter->nr_invisible, 0, memory_order_relaxed);
+    atomic_store_explicit(&counter->next_timestamp,
+                          sc_tick_now() + SC_FPS_COUNTER_INTERVAL,
+                          memory_order_relaxed);
 
     set_started(counter, true);
-    sc_cond_signal(&counter->state_cond);
-
-    // counter->thread_started and counter->thread are always accessed from the
-    // same thread, no need to lock
-    if (!counter->thread_started) {
-        bool ok = sc_thread_create(&counter->thread, run_fps_counter,
-                                   "scrcpy-fps", counter);
-        if (!ok) {
-            LOGE("Could not start FPS counter thread");
-            return false;
-        }
-
-        counter->thread_started = true;
-    }
-
     LOGI("FPS counter started");
-    return true;
 }
 
 void
 sc_fps_counter_stop(struct sc_fps_counter *counter) {
     set_started(counter, false);
-    sc_cond_signal(&counter->state_cond);
     LOGI("FPS counter stopped");
+
+    struct sc_fps_counter_stats stats;
+    sc_fps_counter_get_stats(counter, &stats);
+    log_histogram("Frame interval", &stats.interval);
+    log_histogram("Frame latency", &stats.latency);
 }
 
 bool
@@ -136,51 +125,61 @@ sc_fps_counter_is_started(struct sc_fps_counter *counter) {
 }
 
 void
-sc_fps_counter_interrupt(struct sc_fps_counter *counter) {
-    if (!counter->thread_started) {
-        return;
+sc_fps_counter_add_rendered_frame(struct sc_fps_counter *counter) {
+    sc_tick now = sc_tick_now();
+
+    atomic_fetch_add_explicit(&counter->rendered, 1, memory_order_relaxed);
+    sc_tick last = atomic_exchange_explicit(&counter->last_rendered, now,
+                                            memory_order_relaxed);
+    if (last && now >= last) {
+        sc_histogram_record(&counter->intervals, now - last);
     }
 
-    sc_mutex_lock(&counter->mutex);
-    counter->interrupted = true;
-    sc_mutex_unlock(&counter->mutex);
-    // wake up blocking wait
-    sc_cond_signal(&counter->state_cond);
+    if (is_started(counter)) {
+        check_interval_expired(counter, now);
+        atomic_fetch_add_explicit(&counter->nr_rendered, 1,
+                                  memory_order_relaxed);
+    }
 }
 
 void
-sc_fps_counter_join(struct sc_fps_counter *counter) {
-    if (counter->thread_started) {
-        // interrupted must be set by the thread calling join(), so no need to
-        // lock for the assertion
-        assert(counter->interrupted);
+sc_fps_counter_add_skipped_frame(struct sc_fps_counter *counter) {
+    atomic_fetch_add_explicit(&counter->skipped, 1, memory_order_relaxed);
 
-        sc_thread_join(&counter->thread, NULL);
+    if (is_started(counter)) {
+        check_interval_expired(counter, sc_tick_now());
+        atomic_fetch_add_explicit(&counter->nr_skipped, 1,
+                                  memory_order_relaxed);
     }
 }
 
 void
-sc_fps_counter_add_rendered_frame(struct sc_fps_counter *counter) {
-    if (!is_started(counter)) {
-        return;
-    }
+sc_fps_counter_add_invisible_frame(struct sc_fps_counter *counter) {
+    atomic_fetch_add_explicit(&counter->invisible, 1, memory_order_relaxed);
 
-    sc_mutex_lock(&counter->mutex);
-    sc_tick now = sc_tick_now();
-    check_interval_expired(counter, now);
-    ++counter->nr_rendered;
-    sc_mutex_unlock(&counter->mutex);
+    if (is_started(counter)) {
+        check_interval_expired(counter, sc_tick_now());
+        atomic_fetch_add_explicit(&counter->nr_invisible, 1,
+                                  memory_order_relaxed);
+    }
 }
 
 void
-sc_fps_counter_add_skipped_frame(struct sc_fps_counter *counter) {
-    if (!is_started(counter)) {
-        return;
-    }
+sc_fps_counter_add_latency(struct sc_fps_counter *counter, sc_tick latency) {
+    assert(latency >= 0);
+    sc_histogram_record(&counter->latencies, latency);
+}
 
-    sc_mutex_lock(&counter->mutex);
-    sc_tick now = sc_tick_now();
-    check_interval_expired(counter, now);
-    ++counter->nr_skipped;
-    sc_mutex_unlock(&counter->mutex);
+void
+sc_fps_counter_get_stats(struct sc_fps_counter *counter,
+                         struct sc_fps_counter_stats *stats) {
+    stats->started = is_started(counter);
+    stats->rendered =
+        atomic_load_explicit(&counter->rendered, memory_order_relaxed);
+    stats->skipped =
+        atomic_load_explicit(&counter->skipped, memory_order_relaxed);
+    stats->invisible =
+        atomic_load_explicit(&counter->invisible, memory_order_relaxed);
+    sc_histogram_get_stats(&counter->intervals, &stats->interval);
+    sc_histogram_get_stats(&counter->latencies, &stats->latency);
 }
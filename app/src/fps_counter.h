@@ -5,35 +5,52 @@
 
 #include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 
-#include "util/thread.h"
+#include "util/histogram.h"
 #include "util/tick.h"
 
+/**
+ * Frame rate and frame timing statistics
+ *
+ * All the functions may be called from any thread, without locking.
+ *
+ * The frame timings are always recorded. Once started, the frame rate is
+ * logged every second: the interval is rolled over by the first frame
+ * counted after it expired (there is no timer).
+ */
 struct sc_fps_counter {
-    sc_thread thread;
-    sc_mutex mutex;
-    sc_cond state_cond;
+    atomic_bool started;
 
-    bool thread_started;
+    // Counters of the current interval, reset by the rollover
+    atomic_uint nr_rendered;
+    atomic_uint nr_skipped;
+    atomic_uint nr_invisible;
+    atomic_int_least64_t next_timestamp; // end of the current interval
 
-    // atomic so that we can check without locking the mutex
-    // if the FPS counter is disabled, we don't want to lock unnecessarily
-    atomic_bool started;
+    // Totals, since the initialization
+    atomic_uint_least64_t rendered;
+    atomic_uint_least64_t skipped;
+    atomic_uint_least64_t invisible;
 
-    // the following fields are protected by the mutex
-    bool interrupted;
-    unsigned nr_rendered;
-    unsigned nr_skipped;
-    sc_tick next_timestamp;
+    atomic_int_least64_t last_rendered; // 0 if no frame has been rendered
+    struct sc_histogram intervals; // between two rendered frames
+    struct sc_histogram latencies; // from the frame push to its presentation
 };
 
-bool
-sc_fps_counter_init(struct sc_fps_counter *counter);
+struct sc_fps_counter_stats {
+    bool started;
+    uint64_t rendered;
+    uint64_t skipped;
+    uint64_t invisible;
+    struct sc_histogram_stats interval; // in microseconds
+    struct sc_histogram_stats latency; // in microseconds
+};
 
 void
-sc_fps_counter_destroy(struct sc_fps_counter *counter);
+sc_fps_counter_init(struct sc_fps_counter *counter);
 
-bool
+void
 sc_fps_counter_start(struct sc_fps_counter *counter);
 
 void
@@ -42,18 +59,22 @@ sc_fps_counter_stop(struct sc_fps_counter *counter);
 bool
 sc_fps_counter_is_started(struct sc_fps_counter *counter);
 
-// request to stop the thread (on quit)
-// must be called before sc_fps_counter_join()
 void
-sc_fps_counter_interrupt(struct sc_fps_counter *counter);
+sc_fps_counter_add_rendered_frame(struct sc_fps_counter *counter);
 
 void
-sc_fps_counter_join(struct sc_fps_counter *counter);
+sc_fps_counter_add_skipped_frame(struct sc_fps_counter *counter);
 
+// A frame consumed but not rendered because the window was not visible
 void
-sc_fps_counter_add_rendered_frame(struct sc_fps_counter *counter);
+sc_fps_counter_add_invisible_frame(struct sc_fps_counter *counter);
 
+// Record the delay between a frame push and its presentation
 void
-sc_fps_counter_add_skipped_frame(struct sc_fps_counter *counter);
+sc_fps_counter_add_latency(struct sc_fps_counter *counter, sc_tick latency);
+
+void
+sc_fps_counter_get_stats(struct sc_fps_counter *counter,
+                         struct sc_fps_counter_stats *stats);
 
 #endif
@@ -28,6 +28,8 @@ sc_frame_buffer_init(struct sc_frame_buffer *fb) {
 
     // there is initially no frame, so consider it has already been consumed
     fb->pending_frame_consumed = true;
+    fb->pending_push_date = 0;
+    fb->consumed_push_date = 0;
 
     return true;
 }
@@ -51,6 +53,7 @@ sc_frame_buffer_push(struct sc_frame_buffer *fb, const AVFrame *frame,
                      bool *previous_frame_skipped) {
     // Use a temporary frame to preserve pending_frame in case of error.
     // tmp_frame is an empty frame, no need to call av_frame_unref() beforehand.
+    sc_tick now = sc_tick_now();
     int r = av_frame_ref(fb->tmp_frame, frame);
     if (r) {
         LOGE("Could not ref frame: %d", r);
@@ -68,6 +71,7 @@ sc_frame_buffer_push(struct sc_frame_buffer *fb, const AVFrame *frame,
         *previous_frame_skipped = !fb->pending_frame_consumed;
     }
     fb->pending_frame_consumed = false;
+    fb->pending_push_date = now;
 
     sc_mutex_unlock(&fb->mutex);
 
@@ -79,6 +83,7 @@ sc_frame_buffer_consume(struct sc_frame_buffer *fb, AVFrame *dst) {
     sc_mutex_lock(&fb->mutex);
     assert(!fb->pending_frame_consumed);
     fb->pending_frame_consumed = true;
+    fb->consumed_push_date = fb->pending_push_date;
 
     av_frame_move_ref(dst, fb->pending_frame);
     // av_frame_move_ref() resets its source frame, so no need to call
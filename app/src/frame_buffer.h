@@ -7,6 +7,7 @@
 #include <libavutil/frame.h>
 
 #include "util/thread.h"
+#include "util/tick.h"
 
 // forward declarations
 typedef struct AVFrame AVFrame;
@@ -27,6 +28,10 @@ struct sc_frame_buffer {
     sc_mutex mutex;
 
     bool pending_frame_consumed;
+    sc_tick pending_push_date; // protected by the mutex
+
+    // The push date of the last consumed frame (only accessed by the consumer)
+    sc_tick consumed_push_date;
 };
 
 bool
@@ -0,0 +1,852 @@
+#include "hls.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+#include "util/strbuf.h"
+
+/** Downcast packet sinks to hls */
+#define DOWNCAST_VIDEO(SINK) \
+    container_of(SINK, struct sc_hls, video_packet_sink)
+#define DOWNCAST_AUDIO(SINK) \
+    container_of(SINK, struct sc_hls, audio_packet_sink)
+
+#define SC_HLS_IO_BUFFER_SIZE 4096
+#define SC_HLS_RING_SIZE (SC_HLS_SEGMENT_COUNT + 1)
+
+static const AVRational SCRCPY_TIME_BASE = {1, 1000000}; // timestamps in us
+
+static inline double
+sc_hls_tick_to_sec(sc_tick tick) {
+    return (double) tick / SC_TICK_FREQ;
+}
+
+static bool
+sc_hls_append(uint8_t **pdata, size_t *psize, size_t *pcap,
+              const uint8_t *buf, size_t len) {
+    if (*psize + len > *pcap) {
+        size_t cap = *pcap ? *pcap : SC_HLS_IO_BUFFER_SIZE;
+        while (cap < *psize + len) {
+            cap *= 2;
+        }
+
+        uint8_t *data = realloc(*pdata, cap);
+        if (!data) {
+            LOG_OOM();
+            return false;
+        }
+
+        *pdata = data;
+        *pcap = cap;
+    }
+
+    memcpy(*pdata + *psize, buf, len);
+    *psize += len;
+    return true;
+}
+
+static inline struct sc_hls_segment *
+sc_hls_get_segment(struct sc_hls *hls, unsigned i) {
+    assert(i < hls->count);
+    return &hls->segments[(hls->head + i) % SC_HLS_RING_SIZE];
+}
+
+static inline struct sc_hls_segment *
+sc_hls_get_current_segment(struct sc_hls *hls) {
+    return sc_hls_get_segment(hls, hls->count - 1);
+}
+
+static struct sc_hls_segment *
+sc_hls_find_segment(struct sc_hls *hls, uint64_t msn) {
+    if (!hls->count) {
+        return NULL;
+    }
+
+    uint64_t first_msn = sc_hls_get_segment(hls, 0)->msn;
+    if (msn < first_msn || msn >= first_msn + hls->count) {
+        return NULL;
+    }
+
+    return sc_hls_get_segment(hls, msn - first_msn);
+}
+
+static int
+#ifdef SCRCPY_LAVF_HAS_AVIO_WRITE_CONST
+sc_hls_write(void *opaque, const uint8_t *buf, int buf_size) {
+#else
+sc_hls_write(void *opaque, uint8_t *buf, int buf_size) {
+#endif
+    struct sc_hls *hls = opaque;
+    assert(buf_size >= 0);
+
+    bool ok;
+    if (hls->writing_init) {
+        struct sc_hls_init *init =
+            &hls->inits[hls->init_id % SC_HLS_RING_SIZE];
+        ok = sc_hls_append(&init->data, &init->size, &init->cap, buf,
+                           buf_size);
+    } else {
+        struct sc_hls_segment *segment = sc_hls_get_current_segment(hls);
+        ok = sc_hls_append(&segment->data, &segment->size, &segment->cap, buf,
+                           buf_size);
+    }
+
+    return ok ? buf_size : AVERROR(ENOMEM);
+}
+
+static void
+sc_hls_start_segment(struct sc_hls *hls) {
+    if (hls->count == SC_HLS_RING_SIZE) {
+        // Remove the oldest segment, its buffer will be reused
+        if (hls->segments[hls->head].discontinuity) {
+            ++hls->discontinuity_sequence;
+        }
+        hls->head = (hls->head + 1) % SC_HLS_RING_SIZE;
+        --hls->count;
+    }
+
+    struct sc_hls_segment *segment =
+        &hls->segments[(hls->head + hls->count) % SC_HLS_RING_SIZE];
+    ++hls->count;
+
+    segment->msn = hls->next_msn++;
+    segment->size = 0;
+    segment->part_count = 0;
+    segment->duration = 0;
+    segment->complete = false;
+    segment->init_id = hls->init_id;
+    segment->discontinuity = false;
+}
+
+static bool
+sc_hls_set_extradata(AVStream *ostream, const AVPacket *config) {
+    uint8_t *extradata =
+        av_mallocz(config->size + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (!extradata) {
+        LOG_OOM();
+        return false;
+    }
+
+    memcpy(extradata, config->data, config->size);
+
+    ostream->codecpar->extradata = extradata;
+    ostream->codecpar->extradata_size = config->size;
+    return true;
+}
+
+static AVStream *
+sc_hls_add_ostream(AVFormatContext *ctx, const AVCodecParameters *params,
+                   const AVPacket *config) {
+    AVStream *ostream = avformat_new_stream(ctx, NULL);
+    if (!ostream) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    if (avcodec_parameters_copy(ostream->codecpar, params) < 0) {
+        return NULL;
+    }
+
+    av_freep(&ostream->codecpar->extradata);
+    ostream->codecpar->extradata_size = 0;
+    if (config && !sc_hls_set_extradata(ostream, config)) {
+        return NULL;
+    }
+
+    ostream->time_base = SCRCPY_TIME_BASE;
+    return ostream;
+}
+
+static void
+sc_hls_close_muxer(struct sc_hls *hls) {
+    if (hls->ctx) {
+        if (hls->ctx->pb) {
+            av_freep(&hls->ctx->pb->buffer);
+            avio_context_free(&hls->ctx->pb);
+        }
+        avformat_free_context(hls->ctx);
+        hls->ctx = NULL;
+    }
+}
+
+// If discont is set, the fragments continue the timeline of the previous muxer
+static bool
+sc_hls_open_muxer(struct sc_hls *hls, bool discont) {
+    assert(!hls->ctx);
+    assert(hls->video_params);
+
+    int r = avformat_alloc_output_context2(&hls->ctx, NULL, "mp4", NULL);
+    if (r < 0) {
+        LOGE("HLS: could not create muxer");
+        return false;
+    }
+
+    AVFormatContext *ctx = hls->ctx;
+
+    AVStream *ostream = sc_hls_add_ostream(ctx, hls->video_params,
+                                           hls->video_config);
+    if (!ostream) {
+        goto error;
+    }
+    hls->video_index = ostream->index;
+
+    if (hls->audio_params) {
+        enum AVCodecID codec_id = hls->audio_params->codec_id;
+        if (avformat_query_codec(ctx->oformat, codec_id,
+                                 FF_COMPLIANCE_NORMAL) == 1) {
+            ostream = sc_hls_add_ostream(ctx, hls->audio_params,
+                                         hls->audio_config);
+            if (!ostream) {
+                goto error;
+            }
+            hls->audio_index = ostream->index;
+        } else {
+            LOGW("HLS: audio codec %s not supported, video only",
+                 avcodec_get_name(codec_id));
+        }
+    }
+
+    uint8_t *buffer = av_malloc(SC_HLS_IO_BUFFER_SIZE);
+    if (!buffer) {
+        LOG_OOM();
+        goto error;
+    }
+
+    ctx->pb = avio_alloc_context(buffer, SC_HLS_IO_BUFFER_SIZE, 1, hls, NULL,
+                                 sc_hls_write, NULL);
+    if (!ctx->pb) {
+        LOG_OOM();
+        av_free(buffer);
+        goto error;
+    }
+
+    ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+    // One fragment per part, cut explicitly by av_write_frame(ctx, NULL)
+    AVDictionary *opts = NULL;
+    av_dict_set(&opts, "movflags", discont
+                    ? "frag_custom+empty_moov+default_base_moof+frag_discont"
+                    : "frag_custom+empty_moov+default_base_moof", 0);
+
+    // The buffer of an initialization section not referenced anymore is
+    // reused
+    struct sc_hls_init *init = &hls->inits[hls->init_id % SC_HLS_RING_SIZE];
+    init->size = 0;
+
+    hls->writing_init = true;
+    r = avformat_write_header(ctx, &opts);
+    av_dict_free(&opts);
+    if (r >= 0) {
+        avio_flush(ctx->pb);
+    }
+    hls->writing_init = false;
+
+    if (r < 0 || !init->size) {
+        LOGE("HLS: could not write header");
+        goto error;
+    }
+
+    return true;
+
+error:
+    sc_hls_close_muxer(hls);
+    return false;
+}
+
+static bool
+sc_hls_write_packet(struct sc_hls *hls, const AVPacket *packet, int index) {
+    AVPacket *p = hls->packet;
+    if (av_packet_ref(p, packet)) {
+        LOG_OOM();
+        return false;
+    }
+
+    p->stream_index = index;
+    p->pts -= hls->pts_origin;
+    p->dts = p->pts;
+    av_packet_rescale_ts(p, SCRCPY_TIME_BASE,
+                         hls->ctx->streams[index]->time_base);
+
+    int r = av_write_frame(hls->ctx, p);
+    av_packet_unref(p);
+    return r >= 0;
+}
+
+static bool
+sc_hls_close_part(struct sc_hls *hls, int64_t pts) {
+    assert(!hls->part_empty);
+
+    // Write the pending packets as a new fragment
+    int r = av_write_frame(hls->ctx, NULL);
+    if (r < 0) {
+        return false;
+    }
+    avio_flush(hls->ctx->pb);
+
+    struct sc_hls_segment *segment = sc_hls_get_current_segment(hls);
+    assert(segment->part_count < SC_HLS_MAX_PARTS);
+
+    size_t offset = 0;
+    if (segment->part_count) {
+        struct sc_hls_part *prev = &segment->parts[segment->part_count - 1];
+        offset = prev->offset + prev->size;
+    }
+
+    struct sc_hls_part *part = &segment->parts[segment->part_count];
+    part->offset = offset;
+    part->size = segment->size - offset;
+    part->duration = pts - hls->part_start;
+    part->independent = hls->part_independent;
+    ++segment->part_count;
+
+    segment->duration += part->duration;
+
+    hls->part_start = pts;
+    hls->part_empty = true;
+    return true;
+}
+
+// Close the current segment and reopen the muxer with the new video config
+static bool
+sc_hls_restart_muxer(struct sc_hls *hls, int64_t pts) {
+    assert(hls->ctx);
+
+    if (!hls->part_empty && !sc_hls_close_part(hls, pts)) {
+        LOGE("HLS: could not write fragment");
+        return false;
+    }
+    sc_hls_get_current_segment(hls)->complete = true;
+
+    sc_hls_close_muxer(hls);
+    hls->config_changed = false;
+
+    ++hls->init_id;
+    if (!sc_hls_open_muxer(hls, true)) {
+        return false;
+    }
+
+    sc_hls_start_segment(hls);
+    sc_hls_get_current_segment(hls)->discontinuity = true;
+
+    hls->part_start = pts;
+    hls->segment_start = pts;
+    hls->part_independent = true;
+    return true;
+}
+
+// Return true if a new part is available
+static bool
+sc_hls_push_video(struct sc_hls *hls, const AVPacket *packet) {
+    bool is_key = packet->flags & AV_PKT_FLAG_KEY;
+
+    if (hls->ctx && hls->config_changed && is_key) {
+        LOGI("HLS: new video config, restarting the muxer");
+        if (!sc_hls_restart_muxer(hls, packet->pts - hls->pts_origin)) {
+            hls->failed = true;
+            return false;
+        }
+
+        // The new segment starts with this keyframe
+        if (!sc_hls_write_packet(hls, packet, hls->video_index)) {
+            LOGE("HLS: could not write video packet");
+            hls->failed = true;
+            return false;
+        }
+
+        hls->part_empty = false;
+        return true;
+    }
+
+    if (!hls->ctx) {
+        if (!is_key) {
+            // The first segment starts with a keyframe
+            return false;
+        }
+
+        if (!sc_hls_open_muxer(hls, false)) {
+            hls->failed = true;
+            return false;
+        }
+
+        hls->pts_origin = packet->pts;
+        hls->part_start = 0;
+        hls->segment_start = 0;
+        hls->part_independent = true;
+        hls->part_empty = true;
+        sc_hls_start_segment(hls);
+    }
+
+    int64_t pts = packet->pts - hls->pts_origin;
+    bool new_part = false;
+
+    if (!hls->part_empty) {
+        struct sc_hls_segment *segment = sc_hls_get_current_segment(hls);
+        int64_t segment_elapsed = pts - hls->segment_start;
+        bool split_segment =
+            (is_key && segment_elapsed >= SC_HLS_SEGMENT_DURATION)
+            || segment_elapsed >= SC_HLS_TARGET_DURATION
+            || segment->part_count + 1 >= SC_HLS_MAX_PARTS;
+
+        if (split_segment || pts - hls->part_start >= SC_HLS_PART_TARGET) {
+            if (!sc_hls_close_part(hls, pts)) {
+                LOGE("HLS: could not write fragment");
+                hls->failed = true;
+                return false;
+            }
+
+            if (split_segment) {
+                segment->complete = true;
+                sc_hls_start_segment(hls);
+                hls->segment_start = pts;
+            }
+
+            hls->part_independent = is_key;
+            new_part = true;
+        }
+    }
+
+    if (!sc_hls_write_packet(hls, packet, hls->video_index)) {
+        LOGE("HLS: could not write video packet");
+        hls->failed = true;
+        return false;
+    }
+
+    hls->part_empty = false;
+    return new_part;
+}
+
+static bool
+sc_hls_is_same_config(const AVPacket *config, const AVPacket *packet) {
+    return config && config->size == packet->size
+        && !memcmp(config->data, packet->data, packet->size);
+}
+
+static bool
+sc_hls_set_config(AVPacket **pconfig, const AVPacket *packet) {
+    if (!*pconfig) {
+        *pconfig = av_packet_alloc();
+        if (!*pconfig) {
+            LOG_OOM();
+            return false;
+        }
+    } else {
+        av_packet_unref(*pconfig);
+    }
+
+    if (av_packet_ref(*pconfig, packet)) {
+        LOG_OOM();
+        return false;
+    }
+
+    return true;
+}
+
+static bool
+sc_hls_open_params(AVCodecParameters **pparams, AVCodecContext *ctx) {
+    assert(!*pparams);
+
+    AVCodecParameters *params = avcodec_parameters_alloc();
+    if (!params) {
+        LOG_OOM();
+        return false;
+    }
+
+    if (avcodec_parameters_from_context(params, ctx) < 0) {
+        avcodec_parameters_free(&params);
+        return false;
+    }
+
+    *pparams = params;
+    return true;
+}
+
+static bool
+sc_hls_video_packet_sink_open(struct sc_packet_sink *sink,
+                              AVCodecContext *ctx) {
+    struct sc_hls *hls = DOWNCAST_VIDEO(sink);
+
+    sc_mutex_lock(&hls->mutex);
+    bool ok = sc_hls_open_params(&hls->video_params, ctx);
+    sc_mutex_unlock(&hls->mutex);
+
+    return ok;
+}
+
+static void
+sc_hls_video_packet_sink_close(struct sc_packet_sink *sink) {
+    struct sc_hls *hls = DOWNCAST_VIDEO(sink);
+
+    sc_mutex_lock(&hls->mutex);
+    if (hls->ctx && !hls->failed) {
+        if (!hls->part_empty) {
+            // The duration of the last part is unknown, use the target
+            int64_t end = hls->part_start + SC_HLS_PART_TARGET;
+            if (!sc_hls_close_part(hls, end)) {
+                LOGW("HLS: could not write the last fragment");
+            }
+        }
+        sc_hls_get_current_segment(hls)->complete = true;
+    }
+    hls->eos = true;
+    sc_mutex_unlock(&hls->mutex);
+
+    hls->cbs->on_part(hls, hls->cbs_userdata);
+}
+
+static bool
+sc_hls_video_packet_sink_push(struct sc_packet_sink *sink,
+                              const AVPacket *packet) {
+    struct sc_hls *hls = DOWNCAST_VIDEO(sink);
+
+    sc_mutex_lock(&hls->mutex);
+
+    if (packet->pts == AV_NOPTS_VALUE) {
+        // Config packets are not muxed, they provide the extradata
+        if (hls->ctx && !sc_hls_is_same_config(hls->video_config, packet)) {
+            // The encoder has been reset (for example on device rotation)
+            hls->config_changed = true;
+        }
+        bool ok = sc_hls_set_config(&hls->video_config, packet);
+        sc_mutex_unlock(&hls->mutex);
+        return ok;
+    }
+
+    bool new_part = false;
+    if (!hls->failed) {
+        new_part = sc_hls_push_video(hls, packet);
+    }
+
+    sc_mutex_unlock(&hls->mutex);
+
+    if (new_part) {
+        hls->cbs->on_part(hls, hls->cbs_userdata);
+    }
+
+    // Never fail, the HLS packager must not stop the other sinks
+    return true;
+}
+
+static bool
+sc_hls_audio_packet_sink_open(struct sc_packet_sink *sink,
+                              AVCodecContext *ctx) {
+    struct sc_hls *hls = DOWNCAST_AUDIO(sink);
+
+    sc_mutex_lock(&hls->mutex);
+    bool ok = sc_hls_open_params(&hls->audio_params, ctx);
+    sc_mutex_unlock(&hls->mutex);
+
+    return ok;
+}
+
+static void
+sc_hls_audio_packet_sink_close(struct sc_packet_sink *sink) {
+    (void) sink;
+    // Nothing to do, the stream ends with the video stream
+}
+
+static bool
+sc_hls_audio_packet_sink_push(struct sc_packet_sink *sink,
+                              const AVPacket *packet) {
+    struct sc_hls *hls = DOWNCAST_AUDIO(sink);
+
+    sc_mutex_lock(&hls->mutex);
+
+    if (packet->pts == AV_NOPTS_VALUE) {
+        bool ok = sc_hls_set_config(&hls->audio_config, packet);
+        sc_mutex_unlock(&hls->mutex);
+        return ok;
+    }
+
+    if (hls->ctx && !hls->failed && !hls->eos && hls->audio_index >= 0
+            && packet->pts >= hls->pts_origin) {
+        // The audio packets are muxed in the fragment of the current part
+        if (!sc_hls_write_packet(hls, packet, hls->audio_index)) {
+            LOGE("HLS: could not write audio packet");
+            hls->failed = true;
+        }
+    }
+
+    sc_mutex_unlock(&hls->mutex);
+
+    return true;
+}
+
+static void
+sc_hls_audio_packet_sink_disable(struct sc_packet_sink *sink) {
+    (void) sink;
+    // The segments will contain video only
+}
+
+bool
+sc_hls_init(struct sc_hls *hls, const struct sc_hls_callbacks *cbs,
+            void *cbs_userdata) {
+    bool ok = sc_mutex_init(&hls->mutex);
+    if (!ok) {
+        return false;
+    }
+
+    hls->packet = av_packet_alloc();
+    if (!hls->packet) {
+        LOG_OOM();
+        sc_mutex_destroy(&hls->mutex);
+        return false;
+    }
+
+    hls->video_params = NULL;
+    hls->audio_params = NULL;
+    hls->video_config = NULL;
+    hls->audio_config = NULL;
+
+    hls->ctx = NULL;
+    hls->video_index = -1;
+    hls->audio_index = -1;
+    hls->pts_origin = AV_NOPTS_VALUE;
+    hls->failed = false;
+    hls->eos = false;
+    hls->config_changed = false;
+
+    for (unsigned i = 0; i < SC_HLS_RING_SIZE; ++i) {
+        hls->inits[i].data = NULL;
+        hls->inits[i].size = 0;
+        hls->inits[i].cap = 0;
+    }
+    hls->init_id = 0;
+    hls->writing_init = false;
+
+    for (unsigned i = 0; i < SC_HLS_RING_SIZE; ++i) {
+        hls->segments[i].data = NULL;
+        hls->segments[i].cap = 0;
+    }
+    hls->head = 0;
+    hls->count = 0;
+    hls->next_msn = 0;
+    hls->discontinuity_sequence = 0;
+
+    assert(cbs && cbs->on_part);
+    hls->cbs = cbs;
+    hls->cbs_userdata = cbs_userdata;
+
+    static const struct sc_packet_sink_ops video_ops = {
+        .open = sc_hls_video_packet_sink_open,
+        .close = sc_hls_video_packet_sink_close,
+        .push = sc_hls_video_packet_sink_push,
+    };
+
+    hls->video_packet_sink.ops = &video_ops;
+
+    static const struct sc_packet_sink_ops audio_ops = {
+        .open = sc_hls_audio_packet_sink_open,
+        .close = sc_hls_audio_packet_sink_close,
+        .push = sc_hls_audio_packet_sink_push,
+        .disable = sc_hls_audio_packet_sink_disable,
+    };
+
+    hls->audio_packet_sink.ops = &audio_ops;
+
+    return true;
+}
+
+void
+sc_hls_destroy(struct sc_hls *hls) {
+    sc_hls_close_muxer(hls);
+
+    for (unsigned i = 0; i < SC_HLS_RING_SIZE; ++i) {
+        free(hls->segments[i].data);
+        free(hls->inits[i].data);
+    }
+
+    av_packet_free(&hls->video_config);
+    av_packet_free(&hls->audio_config);
+    av_packet_free(&hls->packet);
+    avcodec_parameters_free(&hls->video_params);
+    avcodec_parameters_free(&hls->audio_params);
+    sc_mutex_destroy(&hls->mutex);
+}
+
+static enum sc_hls_status
+sc_hls_check_locked(struct sc_hls *hls, uint64_t msn, int part) {
+    if (hls->failed) {
+        return SC_HLS_STATUS_NOT_FOUND;
+    }
+
+    struct sc_hls_segment *segment = sc_hls_find_segment(hls, msn);
+    if (!segment) {
+        // Only block for the next segment (or the one after, for a request
+        // for the part following the last part of the current segment)
+        bool soon = msn >= hls->next_msn && msn <= hls->next_msn + 1;
+        return soon && !hls->eos ? SC_HLS_STATUS_PENDING
+                                 : SC_HLS_STATUS_NOT_FOUND;
+    }
+
+    if (part < 0) {
+        return segment->complete ? SC_HLS_STATUS_OK : SC_HLS_STATUS_PENDING;
+    }
+
+    if ((unsigned) part < segment->part_count) {
+        return SC_HLS_STATUS_OK;
+    }
+
+    if (segment->complete || hls->eos || part >= SC_HLS_MAX_PARTS) {
+        return SC_HLS_STATUS_NOT_FOUND;
+    }
+
+    return SC_HLS_STATUS_PENDING;
+}
+
+enum sc_hls_status
+sc_hls_check(struct sc_hls *hls, uint64_t msn, int part) {
+    sc_mutex_lock(&hls->mutex);
+    enum sc_hls_status status = sc_hls_check_locked(hls, msn, part);
+    sc_mutex_unlock(&hls->mutex);
+
+    return status;
+}
+
+static bool
+sc_hls_append_line(struct sc_strbuf *buf, const char *fmt, ...) {
+    char line[256];
+
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+
+    assert(len >= 0 && (size_t) len < sizeof(line));
+    return sc_strbuf_append(buf, line, len);
+}
+
+char *
+sc_hls_get_playlist(struct sc_hls *hls) {
+    struct sc_strbuf buf;
+    if (!sc_strbuf_init(&buf, 4096)) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    sc_mutex_lock(&hls->mutex);
+
+    if (!hls->ctx || hls->failed || !hls->count) {
+        sc_mutex_unlock(&hls->mutex);
+        free(buf.s);
+        return NULL;
+    }
+
+    uint64_t first_msn = sc_hls_get_segment(hls, 0)->msn;
+    double part_target = sc_hls_tick_to_sec(SC_HLS_PART_TARGET);
+
+    bool ok = sc_strbuf_append_staticstr(&buf, "#EXTM3U\n")
+           && sc_hls_append_line(&buf, "#EXT-X-VERSION:9\n")
+           && sc_hls_append_line(&buf, "#EXT-X-TARGETDURATION:%d\n",
+                                 (int) SC_TICK_TO_SEC(SC_HLS_TARGET_DURATION))
+           && sc_hls_append_line(&buf, "#EXT-X-PART-INF:PART-TARGET=%.3f\n",
+                                 part_target)
+           && sc_hls_append_line(&buf, "#EXT-X-SERVER-CONTROL:"
+                                 "CAN-BLOCK-RELOAD=YES,PART-HOLD-BACK=%.3f\n",
+                                 3 * part_target)
+           && sc_hls_append_line(&buf, "#EXT-X-MEDIA-SEQUENCE:%" PRIu64 "\n",
+                                 first_msn)
+           && sc_hls_append_line(&buf, "#EXT-X-DISCONTINUITY-SEQUENCE:%" PRIu64
+                                 "\n", hls->discontinuity_sequence);
+
+    for (unsigned i = 0; ok && i < hls->count; ++i) {
+        struct sc_hls_segment *segment = sc_hls_get_segment(hls, i);
+
+        if (segment->discontinuity) {
+            ok = sc_strbuf_append_staticstr(&buf, "#EXT-X-DISCONTINUITY\n");
+        }
+
+        if (ok && (!i || segment->discontinuity)) {
+            ok = sc_hls_append_line(&buf, "#EXT-X-MAP:URI=\"init%u.mp4\"\n",
+                                    segment->init_id);
+        }
+
+        // Only list the parts of the most recent segments
+        if (i + 2 >= hls->count) {
+            for (unsigned j = 0; ok && j < segment->part_count; ++j) {
+                struct sc_hls_part *part = &segment->parts[j];
+                ok = sc_hls_append_line(&buf,
+                        "#EXT-X-PART:DURATION=%.3f,URI=\"part%" PRIu64 ".%u"
+                        ".m4s\"%s\n", sc_hls_tick_to_sec(part->duration),
+                        segment->msn, j,
+                        part->independent ? ",INDEPENDENT=YES" : "");
+            }
+        }
+
+        if (ok && segment->complete) {
+            ok = sc_hls_append_line(&buf, "#EXTINF:%.3f,\n"
+                                          "segment%" PRIu64 ".m4s\n",
+                                    sc_hls_tick_to_sec(segment->duration),
+                                    segment->msn);
+        }
+    }
+
+    if (ok) {
+        if (hls->eos) {
+            ok = sc_strbuf_append_staticstr(&buf, "#EXT-X-ENDLIST\n");
+        } else {
+            struct sc_hls_segment *current = sc_hls_get_current_segment(hls);
+            ok = sc_hls_append_line(&buf, "#EXT-X-PRELOAD-HINT:TYPE=PART,"
+                                    "URI=\"part%" PRIu64 ".%u.m4s\"\n",
+                                    current->msn, current->part_count);
+        }
+    }
+
+    sc_mutex_unlock(&hls->mutex);
+
+    if (!ok) {
+        LOG_OOM();
+        free(buf.s);
+        return NULL;
+    }
+
+    return buf.s;
+}
+
+bool
+sc_hls_write_init(struct sc_hls *hls, unsigned init_id, sc_hls_write_fn write,
+                  void *userdata) {
+    sc_mutex_lock(&hls->mutex);
+    bool ok = false;
+    if (hls->count) {
+        // Only serve the initialization sections referenced by the playlist
+        unsigned first_id = sc_hls_get_segment(hls, 0)->init_id;
+        ok = init_id >= first_id && init_id <= hls->init_id;
+    }
+    if (ok) {
+        struct sc_hls_init *init = &hls->inits[init_id % SC_HLS_RING_SIZE];
+        ok = init->size;
+        if (ok) {
+            write(userdata, init->data, init->size);
+        }
+    }
+    sc_mutex_unlock(&hls->mutex);
+
+    return ok;
+}
+
+enum sc_hls_status
+sc_hls_write_segment(struct sc_hls *hls, uint64_t msn, int part,
+                     sc_hls_write_fn write, void *userdata) {
+    sc_mutex_lock(&hls->mutex);
+
+    enum sc_hls_status status = sc_hls_check_locked(hls, msn, part);
+    if (status == SC_HLS_STATUS_OK) {
+        struct sc_hls_segment *segment = sc_hls_find_segment(hls, msn);
+        assert(segment);
+        if (part < 0) {
+            write(userdata, segment->data, segment->size);
+        } else {
+            struct sc_hls_part *p = &segment->parts[part];
+            write(userdata, segment->data + p->offset, p->size);
+        }
+    }
+
+    sc_mutex_unlock(&hls->mutex);
+
+    return status;
+}
@@ -0,0 +1,178 @@
+#ifndef SC_HLS_H
+#define SC_HLS_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+
+#include "trait/packet_sink.h"
+#include "util/thread.h"
+#include "util/tick.h"
+
+// Number of complete segments kept in memory
+#define SC_HLS_SEGMENT_COUNT 4
+#define SC_HLS_MAX_PARTS 32
+
+#define SC_HLS_PART_TARGET SC_TICK_FROM_MS(250)
+// A segment is split on the first keyframe after this duration...
+#define SC_HLS_SEGMENT_DURATION SC_TICK_FROM_SEC(2)
+// ... or on any frame after this duration (the keyframe interval of the
+// device encoder may be larger)
+#define SC_HLS_TARGET_DURATION SC_TICK_FROM_SEC(6)
+
+struct sc_hls_part {
+    size_t offset; // in the segment data
+    size_t size;
+    sc_tick duration;
+    bool independent; // starts with a keyframe
+};
+
+struct sc_hls_segment {
+    uint64_t msn; // media sequence number
+    // the data of all the parts, the buffer is reused for the next segments
+    uint8_t *data;
+    size_t size;
+    size_t cap;
+    struct sc_hls_part parts[SC_HLS_MAX_PARTS];
+    unsigned part_count; // number of complete parts
+    sc_tick duration;
+    bool complete;
+    // generation of the initialization section of the muxer which wrote it
+    unsigned init_id;
+    // first segment written by a new muxer (after a config change)
+    bool discontinuity;
+};
+
+// initialization section (ftyp + moov) of a muxer
+struct sc_hls_init {
+    uint8_t *data;
+    size_t size;
+    size_t cap;
+};
+
+enum sc_hls_status {
+    SC_HLS_STATUS_OK,
+    // the requested part is not available yet, but will be soon
+    SC_HLS_STATUS_PENDING,
+    // the requested part has been removed, or is too far in the future
+    SC_HLS_STATUS_NOT_FOUND,
+};
+
+/**
+ * In-memory low-latency HLS packager
+ *
+ * The packets are muxed once into fragmented MP4 segments and partial
+ * segments (one fragment per part), kept in a rolling window in memory and
+ * shared by all the viewers.
+ *
+ * On a new video config (for example after the device is rotated), the muxer
+ * is reopened on the next keyframe with a new initialization section, and the
+ * playlist signals a discontinuity.
+ */
+struct sc_hls {
+    struct sc_packet_sink video_packet_sink;
+    struct sc_packet_sink audio_packet_sink;
+
+    sc_mutex mutex;
+
+    // NULL until the corresponding sink is open
+    AVCodecParameters *video_params;
+    AVCodecParameters *audio_params;
+    AVPacket *video_config;
+    AVPacket *audio_config;
+
+    // NULL until the first video keyframe
+    AVFormatContext *ctx;
+    int video_index;
+    int audio_index; // -1 if the audio is not muxed
+    int64_t pts_origin;
+    AVPacket *packet; // reused for every write
+    bool failed;
+    bool eos;
+    // a new video config has been received, the muxer must be reopened on
+    // the next keyframe
+    bool config_changed;
+
+    // initialization sections, indexed by init_id % (SC_HLS_SEGMENT_COUNT + 1)
+    // (each muxer starts a new segment, so the segments in the window never
+    // reference more initialization sections than there are segments)
+    struct sc_hls_init inits[SC_HLS_SEGMENT_COUNT + 1];
+    unsigned init_id; // of the current muxer
+    bool writing_init;
+
+    // ring buffer of segments, the last one is in progress
+    struct sc_hls_segment segments[SC_HLS_SEGMENT_COUNT + 1];
+    unsigned head; // index of the oldest segment
+    unsigned count;
+    uint64_t next_msn;
+    // number of discontinuities removed from the window
+    uint64_t discontinuity_sequence;
+
+    // pts (relative to pts_origin) of the start of the current part/segment
+    int64_t part_start;
+    int64_t segment_start;
+    bool part_independent;
+    bool part_empty;
+
+    const struct sc_hls_callbacks *cbs;
+    void *cbs_userdata;
+};
+
+struct sc_hls_callbacks {
+    // called from the demuxer threads when a new part is available
+    void (*on_part)(struct sc_hls *hls, void *userdata);
+};
+
+typedef void (*sc_hls_write_fn)(void *userdata, const uint8_t *data,
+                                size_t len);
+
+bool
+sc_hls_init(struct sc_hls *hls, const struct sc_hls_callbacks *cbs,
+            void *cbs_userdata);
+
+void
+sc_hls_destroy(struct sc_hls *hls);
+
+/**
+ * Check whether a part (or the whole segment if part < 0) is available
+ *
+ * A part of the segment being written, or the first part of the next segment,
+ * is reported as pending (for blocking requests).
+ */
+enum sc_hls_status
+sc_hls_check(struct sc_hls *hls, uint64_t msn, int part);
+
+/**
+ * Generate the media playlist
+ *
+ * Return a newly allocated string (to be freed by the caller), or NULL if the
+ * stream is not started.
+ */
+char *
+sc_hls_get_playlist(struct sc_hls *hls);
+
+/**
+ * Write the initialization section referenced by the playlist as
+ * "init<init_id>.mp4"
+ *
+ * Return false if it is not available (not written yet, or no segment in the
+ * window references it anymore).
+ */
+bool
+sc_hls_write_init(struct sc_hls *hls, unsigned init_id, sc_hls_write_fn write,
+                  void *userdata);
+
+/**
+ * Write a part (or the whole segment if part < 0)
+ *
+ * Return SC_HLS_STATUS_OK if the data has been written.
+ */
+enum sc_hls_status
+sc_hls_write_segment(struct sc_hls *hls, uint64_t msn, int part,
+                     sc_hls_write_fn write, void *userdata);
+
+#endif
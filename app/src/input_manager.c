@@ -1079,6 +1079,12 @@ sc_input_manager_handle_event(struct sc_input_manager *im,
             if (!control) {
                 break;
             }
+            if (!im->fp) {
+                // No file pusher without adb (--no-adb)
+                LOGW("Could not push %s: adb is disabled", event->drop.file);
+                SDL_free(event->drop.file);
+                break;
+            }
             sc_input_manager_process_file(im, &event->drop);
         }
     }
@@ -0,0 +1,86 @@
+#include "jitter.h"
+
+#include <assert.h>
+#include <string.h>
+
+void
+sc_jitter_init(struct sc_jitter *jitter, sc_tick min_delay,
+               sc_tick max_delay) {
+    assert(min_delay >= 0);
+    assert(max_delay >= min_delay);
+
+    jitter->min_delay = min_delay;
+    jitter->max_delay = max_delay;
+    jitter->count = 0;
+    jitter->head = 0;
+    // Start conservatively, until the jitter is measured
+    jitter->delay = max_delay;
+}
+
+// Return the index of the first sorted value greater than or equal to value
+static unsigned
+sc_jitter_lower_bound(struct sc_jitter *jitter, sc_tick value) {
+    unsigned lo = 0;
+    unsigned hi = jitter->count;
+    while (lo < hi) {
+        unsigned mid = lo + (hi - lo) / 2;
+        if (jitter->sorted[mid] < value) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static void
+sc_jitter_remove_sorted(struct sc_jitter *jitter, sc_tick value) {
+    unsigned i = sc_jitter_lower_bound(jitter, value);
+    assert(i < jitter->count && jitter->sorted[i] == value);
+    memmove(&jitter->sorted[i], &jitter->sorted[i + 1],
+            (jitter->count - i - 1) * sizeof(jitter->sorted[0]));
+    --jitter->count;
+}
+
+static void
+sc_jitter_insert_sorted(struct sc_jitter *jitter, sc_tick value) {
+    assert(jitter->count < SC_JITTER_WINDOW);
+    unsigned i = sc_jitter_lower_bound(jitter, value);
+    memmove(&jitter->sorted[i + 1], &jitter->sorted[i],
+            (jitter->count - i) * sizeof(jitter->sorted[0]));
+    jitter->sorted[i] = value;
+    ++jitter->count;
+}
+
+sc_tick
+sc_jitter_push(struct sc_jitter *jitter, sc_tick deviation) {
+    if (jitter->count == SC_JITTER_WINDOW) {
+        // Replace the oldest sample
+        sc_jitter_remove_sorted(jitter, jitter->samples[jitter->head]);
+        jitter->samples[jitter->head] = deviation;
+        jitter->head = (jitter->head + 1) % SC_JITTER_WINDOW;
+    } else {
+        jitter->samples[jitter->count] = deviation;
+    }
+    sc_jitter_insert_sorted(jitter, deviation);
+
+    unsigned index = (jitter->count - 1) * SC_JITTER_PERCENTILE / 100;
+    sc_tick target = jitter->sorted[index];
+    if (target < jitter->min_delay) {
+        target = jitter->min_delay;
+    } else if (target > jitter->max_delay) {
+        target = jitter->max_delay;
+    }
+
+    if (target >= jitter->delay) {
+        // Grow fast
+        jitter->delay = target;
+    } else {
+        // Shrink slowly (by at least 1 tick, to eventually reach the target)
+        sc_tick excess = jitter->delay - target;
+        jitter->delay -= (excess + SC_JITTER_SHRINK_RATE - 1)
+                       / SC_JITTER_SHRINK_RATE;
+    }
+
+    return jitter->delay;
+}
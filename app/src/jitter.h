@@ -0,0 +1,50 @@
+#ifndef SC_JITTER_H
+#define SC_JITTER_H
+
+#include "common.h"
+
+#include "util/tick.h"
+
+// Number of (most recent) frames to estimate the jitter
+#define SC_JITTER_WINDOW 128
+// Percentile of the arrival deviations to absorb
+#define SC_JITTER_PERCENTILE 95
+// The delay decreases by 1/SC_JITTER_SHRINK_RATE of the excess on every frame
+#define SC_JITTER_SHRINK_RATE 64
+
+/**
+ * Estimate the buffering delay needed to absorb the arrival jitter
+ *
+ * For each frame, the deviation is the difference between its arrival time
+ * and its expected arrival time (estimated by sc_clock from its PTS). The
+ * target delay is a high percentile of the recent deviations, within the
+ * [min_delay, max_delay] bounds.
+ *
+ * The delay grows immediately (to avoid stuttering on congestion) but
+ * shrinks slowly (to avoid oscillations when the jitter is bursty).
+ */
+struct sc_jitter {
+    sc_tick min_delay;
+    sc_tick max_delay;
+
+    // Ring buffer of the recent deviations, in arrival order
+    sc_tick samples[SC_JITTER_WINDOW];
+    // The same values, sorted
+    sc_tick sorted[SC_JITTER_WINDOW];
+    unsigned count;
+    unsigned head; // index of the oldest sample when the window is full
+
+    sc_tick delay;
+};
+
+void
+sc_jitter_init(struct sc_jitter *jitter, sc_tick min_delay,
+               sc_tick max_delay);
+
+/**
+ * Add the deviation of a new frame, and return the updated delay
+ */
+sc_tick
+sc_jitter_push(struct sc_jitter *jitter, sc_tick deviation);
+
+#endif
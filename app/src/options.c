@@ -2,6 +2,8 @@
 
 #include <stddef.h>
 
+#include "util/net.h"
+
 const struct scrcpy_options scrcpy_options_default = {
     .serial = NULL,
     .crop = NULL,
@@ -47,6 +49,14 @@ const struct scrcpy_options scrcpy_options_default = {
     },
     .tunnel_host = 0,
     .tunnel_port = 0,
+    .rtp_host = IPV4_LOCALHOST,
+    .rtp_port = 0,
+    .rtp_mtu = SC_RTP_DEFAULT_MTU,
+    .rtp_sdp_filename = NULL,
+    .dump_streams_dir = NULL,
+    .replay_streams_dir = NULL,
+    .decoder_threads = 1,
+    .decoder_thread_type = SC_DECODER_THREAD_TYPE_AUTO,
     .shortcut_mods = SC_SHORTCUT_MOD_LALT | SC_SHORTCUT_MOD_LSUPER,
     .max_size = 0,
     .video_bit_rate = 0,
@@ -56,6 +66,7 @@ const struct scrcpy_options scrcpy_options_default = {
     .capture_orientation_lock = SC_ORIENTATION_UNLOCKED,
     .display_orientation = SC_ORIENTATION_0,
     .record_orientation = SC_ORIENTATION_0,
+    .record_tee_count = 0,
     .display_ime_policy = SC_DISPLAY_IME_POLICY_UNDEFINED,
     .window_x = SC_WINDOW_POSITION_UNDEFINED,
     .window_y = SC_WINDOW_POSITION_UNDEFINED,
@@ -63,6 +74,7 @@ const struct scrcpy_options scrcpy_options_default = {
     .window_height = 0,
     .display_id = 0,
     .video_buffer = 0,
+    .video_buffer_max = 0,
     .audio_buffer = -1, // depends on the audio format,
     .audio_output_buffer = SC_TICK_FROM_MS(5),
     .time_limit = 0,
@@ -84,6 +96,7 @@ const struct scrcpy_options scrcpy_options_default = {
     .key_inject_mode = SC_KEY_INJECT_MODE_MIXED,
     .window_borderless = false,
     .mipmaps = true,
+    .vsync = false,
     .stay_awake = false,
     .force_adb_forward = false,
     .disable_screensaver = false,
@@ -103,6 +116,7 @@ const struct scrcpy_options scrcpy_options_default = {
     .audio = true,
     .require_audio = false,
     .kill_adb_on_close = false,
+    .no_adb = false,
     .camera_high_speed = false,
     .list = 0,
     .window = true,
@@ -115,6 +129,10 @@ const struct scrcpy_options scrcpy_options_default = {
     .vd_system_decorations = true,
     .web_server_address = "0.0.0.0",
     .web_server_port = 4001,
+    .web_server_hls = false,
+    .web_server_thumbnail = false,
+    .web_server_thumbnail_interval = 0,
+    .replay_fast = false,
 };
 
 enum sc_orientation
@@ -39,6 +39,23 @@ sc_record_format_is_audio_only(enum sc_record_format fmt) {
         || fmt == SC_RECORD_FORMAT_WAV;
 }
 
+enum sc_record_streams {
+    SC_RECORD_STREAMS_ALL,
+    SC_RECORD_STREAMS_VIDEO,
+    SC_RECORD_STREAMS_AUDIO,
+};
+
+#define SC_MAX_RECORD_TEES 3
+
+#define SC_RTP_DEFAULT_MTU 1200
+
+// An additional recording output, fed by the same packets as --record
+struct sc_record_tee {
+    const char *filename;
+    enum sc_record_format format;
+    enum sc_record_streams streams;
+};
+
 enum sc_codec {
     SC_CODEC_H264,
     SC_CODEC_H265,
@@ -54,6 +71,12 @@ enum sc_video_source {
     SC_VIDEO_SOURCE_CAMERA,
 };
 
+enum sc_decoder_thread_type {
+    SC_DECODER_THREAD_TYPE_AUTO, // SLICE if supported by the decoder
+    SC_DECODER_THREAD_TYPE_SLICE,
+    SC_DECODER_THREAD_TYPE_FRAME,
+};
+
 enum sc_audio_source {
     SC_AUDIO_SOURCE_AUTO, // OUTPUT for video DISPLAY, MIC for video CAMERA
     SC_AUDIO_SOURCE_OUTPUT,
@@ -258,6 +281,14 @@ struct scrcpy_options {
     struct sc_port_range port_range;
     uint32_t tunnel_host;
     uint16_t tunnel_port;
+    uint32_t rtp_host;
+    uint16_t rtp_port; // 0 if RTP is disabled
+    uint16_t rtp_mtu;
+    const char *rtp_sdp_filename;
+    const char *dump_streams_dir;
+    const char *replay_streams_dir;
+    uint16_t decoder_threads; // 0 for auto
+    enum sc_decoder_thread_type decoder_thread_type;
     uint8_t shortcut_mods; // OR of enum sc_shortcut_mod values
     uint16_t max_size;
     uint32_t video_bit_rate;
@@ -268,6 +299,8 @@ struct scrcpy_options {
     enum sc_orientation_lock capture_orientation_lock;
     enum sc_orientation display_orientation;
     enum sc_orientation record_orientation;
+    struct sc_record_tee record_tees[SC_MAX_RECORD_TEES];
+    unsigned record_tee_count;
     enum sc_display_ime_policy display_ime_policy;
     int16_t window_x; // SC_WINDOW_POSITION_UNDEFINED for "auto"
     int16_t window_y; // SC_WINDOW_POSITION_UNDEFINED for "auto"
@@ -275,6 +308,7 @@ struct scrcpy_options {
     uint16_t window_height;
     uint32_t display_id;
     sc_tick video_buffer;
+    sc_tick video_buffer_max; // 0 for a fixed video buffer
     sc_tick audio_buffer;
     sc_tick audio_output_buffer;
     sc_tick time_limit;
@@ -296,6 +330,7 @@ struct scrcpy_options {
     enum sc_key_inject_mode key_inject_mode;
     bool window_borderless;
     bool mipmaps;
+    bool vsync;
     bool stay_awake;
     bool force_adb_forward;
     bool disable_screensaver;
@@ -315,6 +350,7 @@ struct scrcpy_options {
     bool audio;
     bool require_audio;
     bool kill_adb_on_close;
+    bool no_adb;
     bool camera_high_speed;
 #define SC_OPTION_LIST_ENCODERS 0x1
 #define SC_OPTION_LIST_DISPLAYS 0x2
@@ -329,6 +365,10 @@ struct scrcpy_options {
     const char *start_app;
     bool vd_destroy_content;
     bool vd_system_decorations;
+    bool web_server_hls;
+    bool web_server_thumbnail;
+    sc_tick web_server_thumbnail_interval; // 0 to never request key frames
+    bool replay_fast;
 };
 
 extern const struct scrcpy_options scrcpy_options_default;
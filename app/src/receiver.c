@@ -28,6 +28,7 @@ sc_receiver_init(struct sc_receiver *receiver, sc_socket control_socket,
     receiver->control_socket = control_socket;
     receiver->acksync = NULL;
     receiver->uhid_devices = NULL;
+    receiver->dump = NULL;
 
     assert(cbs && cbs->on_ended);
     receiver->cbs = cbs;
@@ -196,6 +197,10 @@ run_receiver(void *data) {
             break;
         }
 
+        if (receiver->dump) {
+            sc_stream_dump_write(receiver->dump, buf + head, r);
+        }
+
         head += r;
         ssize_t consumed = process_msgs(receiver, buf, head);
         if (consumed == -1) {
@@ -5,6 +5,7 @@
 
 #include <stdbool.h>
 
+#include "stream_dump.h"
 #include "uhid/uhid_output.h"
 #include "util/acksync.h"
 #include "util/net.h"
@@ -20,6 +21,9 @@ struct sc_receiver {
     struct sc_acksync *acksync;
     struct sc_uhid_devices *uhid_devices;
 
+    // if set, the received bytes are captured
+    struct sc_stream_dump *dump;
+
     const struct sc_receiver_callbacks *cbs;
     void *cbs_userdata;
 };
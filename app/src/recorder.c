@@ -104,9 +104,10 @@ sc_recorder_rescale_packet(AVStream *stream, AVPacket *packet) {
 }
 
 static bool
-sc_recorder_write_stream(struct sc_recorder *recorder,
-                         struct sc_recorder_stream *st, AVPacket *packet) {
-    AVStream *stream = recorder->ctx->streams[st->index];
+sc_recorder_output_write_stream(struct sc_recorder_output *output,
+                                struct sc_recorder_stream *st,
+                                AVPacket *packet) {
+    AVStream *stream = output->ctx->streams[st->index];
     sc_recorder_rescale_packet(stream, packet);
     if (st->last_pts != AV_NOPTS_VALUE && packet->pts <= st->last_pts) {
         LOGD("Fixing PTS non monotonically increasing in stream %d "
@@ -117,22 +118,26 @@ sc_recorder_write_stream(struct sc_recorder *recorder,
     } else {
         st->last_pts = packet->pts;
     }
-    return av_interleaved_write_frame(recorder->ctx, packet) >= 0;
+    return av_interleaved_write_frame(output->ctx, packet) >= 0;
 }
 
 static inline bool
-sc_recorder_write_video(struct sc_recorder *recorder, AVPacket *packet) {
-    return sc_recorder_write_stream(recorder, &recorder->video_stream, packet);
+sc_recorder_output_write_video(struct sc_recorder_output *output,
+                               AVPacket *packet) {
+    return sc_recorder_output_write_stream(output, &output->video_stream,
+                                           packet);
 }
 
 static inline bool
-sc_recorder_write_audio(struct sc_recorder *recorder, AVPacket *packet) {
-    return sc_recorder_write_stream(recorder, &recorder->audio_stream, packet);
+sc_recorder_output_write_audio(struct sc_recorder_output *output,
+                               AVPacket *packet) {
+    return sc_recorder_output_write_stream(output, &output->audio_stream,
+                                           packet);
 }
 
 static bool
-sc_recorder_open_output_file(struct sc_recorder *recorder) {
-    const char *format_name = sc_recorder_get_format_name(recorder->format);
+sc_recorder_output_open_file(struct sc_recorder_output *output) {
+    const char *format_name = sc_recorder_get_format_name(output->format);
     assert(format_name);
     const AVOutputFormat *format = find_muxer(format_name);
     if (!format) {
@@ -140,23 +145,23 @@ sc_recorder_open_output_file(struct sc_recorder *recorder) {
         return false;
     }
 
-    recorder->ctx = avformat_alloc_context();
-    if (!recorder->ctx) {
+    output->ctx = avformat_alloc_context();
+    if (!output->ctx) {
         LOG_OOM();
         return false;
     }
 
-    char *file_url = sc_str_concat("file:", recorder->filename);
+    char *file_url = sc_str_concat("file:", output->filename);
     if (!file_url) {
-        avformat_free_context(recorder->ctx);
+        avformat_free_context(output->ctx);
         return false;
     }
 
-    int ret = avio_open(&recorder->ctx->pb, file_url, AVIO_FLAG_WRITE);
+    int ret = avio_open(&output->ctx->pb, file_url, AVIO_FLAG_WRITE);
     free(file_url);
     if (ret < 0) {
-        LOGE("Failed to open output file: %s", recorder->filename);
-        avformat_free_context(recorder->ctx);
+        LOGE("Failed to open output file: %s", output->filename);
+        avformat_free_context(output->ctx);
         return false;
     }
 
@@ -164,30 +169,31 @@ sc_recorder_open_output_file(struct sc_recorder *recorder) {
     // returns (on purpose) a pointer-to-const, but AVFormatContext.oformat
     // still expects a pointer-to-non-const (it has not be updated accordingly)
     // <https://github.com/FFmpeg/FFmpeg/commit/0694d8702421e7aff1340038559c438b61bb30dd>
-    recorder->ctx->oformat = (AVOutputFormat *) format;
+    output->ctx->oformat = (AVOutputFormat *) format;
 
-    av_dict_set(&recorder->ctx->metadata, "comment",
+    av_dict_set(&output->ctx->metadata, "comment",
                 "Recorded by scrcpy " SCRCPY_VERSION, 0);
 
-    LOGI("Recording started to %s file: %s", format_name, recorder->filename);
+    LOGI("Recording started to %s file: %s", format_name, output->filename);
     return true;
 }
 
 static void
-sc_recorder_close_output_file(struct sc_recorder *recorder) {
-    avio_close(recorder->ctx->pb);
-    avformat_free_context(recorder->ctx);
+sc_recorder_output_close_file(struct sc_recorder_output *output) {
+    avio_close(output->ctx->pb);
+    avformat_free_context(output->ctx);
 }
 
 static inline bool
-sc_recorder_must_wait_for_config_packets(struct sc_recorder *recorder) {
-    if (recorder->video && sc_vecdeque_is_empty(&recorder->video_queue)) {
+sc_recorder_output_must_wait_for_config_packets(
+        struct sc_recorder_output *output) {
+    if (output->video && sc_vecdeque_is_empty(&output->video_queue)) {
         // The video queue is empty
         return true;
     }
 
-    if (recorder->audio && recorder->audio_expects_config_packet
-            && sc_vecdeque_is_empty(&recorder->audio_queue)) {
+    if (output->audio && output->audio_expects_config_packet
+            && sc_vecdeque_is_empty(&output->audio_queue)) {
         // The audio queue is empty (when audio is enabled)
         return true;
     }
@@ -197,38 +203,45 @@ sc_recorder_must_wait_for_config_packets(struct sc_recorder *recorder) {
 }
 
 static bool
-sc_recorder_process_header(struct sc_recorder *recorder) {
-    sc_mutex_lock(&recorder->mutex);
+sc_recorder_output_process_header(struct sc_recorder_output *output) {
+    sc_mutex_lock(&output->mutex);
 
-    while (!recorder->stopped &&
-              ((recorder->video && !recorder->video_init)
-            || (recorder->audio && !recorder->audio_init)
-            || sc_recorder_must_wait_for_config_packets(recorder))) {
-        sc_cond_wait(&recorder->cond, &recorder->mutex);
+    while (!output->stopped &&
+              ((output->video && !output->video_init)
+            || (output->audio && !output->audio_init)
+            || sc_recorder_output_must_wait_for_config_packets(output))) {
+        sc_cond_wait(&output->cond, &output->mutex);
     }
 
-    if (recorder->video && sc_vecdeque_is_empty(&recorder->video_queue)) {
-        assert(recorder->stopped);
-        // If the recorder is stopped, don't process anything if there are not
+    if (!output->video_init && !output->audio_init) {
+        assert(output->stopped);
+        // No stream could be opened (or none before the end of the stream)
+        sc_mutex_unlock(&output->mutex);
+        return false;
+    }
+
+    if (output->video && sc_vecdeque_is_empty(&output->video_queue)) {
+        assert(output->stopped);
+        // If the output is stopped, don't process anything if there are not
         // at least video packets
-        sc_mutex_unlock(&recorder->mutex);
+        sc_mutex_unlock(&output->mutex);
         return false;
     }
 
     AVPacket *video_pkt = NULL;
-    if (!sc_vecdeque_is_empty(&recorder->video_queue)) {
-        assert(recorder->video);
-        video_pkt = sc_vecdeque_pop(&recorder->video_queue);
+    if (!sc_vecdeque_is_empty(&output->video_queue)) {
+        assert(output->video);
+        video_pkt = sc_vecdeque_pop(&output->video_queue);
     }
 
     AVPacket *audio_pkt = NULL;
-    if (recorder->audio_expects_config_packet &&
-            !sc_vecdeque_is_empty(&recorder->audio_queue)) {
-        assert(recorder->audio);
-        audio_pkt = sc_vecdeque_pop(&recorder->audio_queue);
+    if (output->audio_expects_config_packet &&
+            !sc_vecdeque_is_empty(&output->audio_queue)) {
+        assert(output->audio);
+        audio_pkt = sc_vecdeque_pop(&output->audio_queue);
     }
 
-    sc_mutex_unlock(&recorder->mutex);
+    sc_mutex_unlock(&output->mutex);
 
     int ret = false;
 
@@ -238,9 +251,9 @@ sc_recorder_process_header(struct sc_recorder *recorder) {
             goto end;
         }
 
-        assert(recorder->video_stream.index >= 0);
+        assert(output->video_stream.index >= 0);
         AVStream *video_stream =
-            recorder->ctx->streams[recorder->video_stream.index];
+            output->ctx->streams[output->video_stream.index];
         bool ok = sc_recorder_set_extradata(video_stream, video_pkt);
         if (!ok) {
             goto end;
@@ -253,18 +266,18 @@ sc_recorder_process_header(struct sc_recorder *recorder) {
             goto end;
         }
 
-        assert(recorder->audio_stream.index >= 0);
+        assert(output->audio_stream.index >= 0);
         AVStream *audio_stream =
-            recorder->ctx->streams[recorder->audio_stream.index];
+            output->ctx->streams[output->audio_stream.index];
         bool ok = sc_recorder_set_extradata(audio_stream, audio_pkt);
         if (!ok) {
             goto end;
         }
     }
 
-    bool ok = avformat_write_header(recorder->ctx, NULL) >= 0;
+    bool ok = avformat_write_header(output->ctx, NULL) >= 0;
     if (!ok) {
-        LOGE("Failed to write header to %s", recorder->filename);
+        LOGE("Failed to write header to %s", output->filename);
         goto end;
     }
 
@@ -282,10 +295,10 @@ end:
 }
 
 static bool
-sc_recorder_process_packets(struct sc_recorder *recorder) {
+sc_recorder_output_process_packets(struct sc_recorder_output *output) {
     int64_t pts_origin = AV_NOPTS_VALUE;
 
-    bool header_written = sc_recorder_process_header(recorder);
+    bool header_written = sc_recorder_output_process_header(output);
     if (!header_written) {
         return false;
     }
@@ -300,20 +313,20 @@ sc_recorder_process_packets(struct sc_recorder *recorder) {
     bool error = false;
 
     for (;;) {
-        sc_mutex_lock(&recorder->mutex);
+        sc_mutex_lock(&output->mutex);
 
-        while (!recorder->stopped) {
-            if (recorder->video && !video_pkt &&
-                    !sc_vecdeque_is_empty(&recorder->video_queue)) {
+        while (!output->stopped) {
+            if (output->video && !video_pkt &&
+                    !sc_vecdeque_is_empty(&output->video_queue)) {
                 // A new packet may be assigned to video_pkt and be processed
                 break;
             }
-            if (recorder->audio && !audio_pkt
-                    && !sc_vecdeque_is_empty(&recorder->audio_queue)) {
+            if (output->audio && !audio_pkt
+                    && !sc_vecdeque_is_empty(&output->audio_queue)) {
                 // A new packet may be assigned to audio_pkt and be processed
                 break;
             }
-            sc_cond_wait(&recorder->cond, &recorder->mutex);
+            sc_cond_wait(&output->cond, &output->mutex);
         }
 
         // If stopped is set, continue to process the remaining events (to
@@ -321,32 +334,32 @@ sc_recorder_process_packets(struct sc_recorder *recorder) {
 
         // If there is no video, then the video_queue will remain empty forever
         // and video_pkt will always be NULL.
-        assert(recorder->video || (!video_pkt
-                && sc_vecdeque_is_empty(&recorder->video_queue)));
+        assert(output->video || (!video_pkt
+                && sc_vecdeque_is_empty(&output->video_queue)));
 
         // If there is no audio, then the audio_queue will remain empty forever
         // and audio_pkt will always be NULL.
-        assert(recorder->audio || (!audio_pkt
-                && sc_vecdeque_is_empty(&recorder->audio_queue)));
+        assert(output->audio || (!audio_pkt
+                && sc_vecdeque_is_empty(&output->audio_queue)));
 
-        if (!video_pkt && !sc_vecdeque_is_empty(&recorder->video_queue)) {
-            video_pkt = sc_vecdeque_pop(&recorder->video_queue);
+        if (!video_pkt && !sc_vecdeque_is_empty(&output->video_queue)) {
+            video_pkt = sc_vecdeque_pop(&output->video_queue);
         }
 
-        if (!audio_pkt && !sc_vecdeque_is_empty(&recorder->audio_queue)) {
-            audio_pkt = sc_vecdeque_pop(&recorder->audio_queue);
+        if (!audio_pkt && !sc_vecdeque_is_empty(&output->audio_queue)) {
+            audio_pkt = sc_vecdeque_pop(&output->audio_queue);
         }
 
-        if (recorder->stopped && !video_pkt && !audio_pkt) {
-            assert(sc_vecdeque_is_empty(&recorder->video_queue));
-            assert(sc_vecdeque_is_empty(&recorder->audio_queue));
-            sc_mutex_unlock(&recorder->mutex);
+        if (output->stopped && !video_pkt && !audio_pkt) {
+            assert(sc_vecdeque_is_empty(&output->video_queue));
+            assert(sc_vecdeque_is_empty(&output->audio_queue));
+            sc_mutex_unlock(&output->mutex);
             break;
         }
 
         assert(video_pkt || audio_pkt); // at least one
 
-        sc_mutex_unlock(&recorder->mutex);
+        sc_mutex_unlock(&output->mutex);
 
         // Ignore further config packets (e.g. on device orientation
         // change). The next non-config packet will have the config packet
@@ -362,17 +375,17 @@ sc_recorder_process_packets(struct sc_recorder *recorder) {
         }
 
         if (pts_origin == AV_NOPTS_VALUE) {
-            if (!recorder->audio) {
+            if (!output->audio) {
                 assert(video_pkt);
                 pts_origin = video_pkt->pts;
-            } else if (!recorder->video) {
+            } else if (!output->video) {
                 assert(audio_pkt);
                 pts_origin = audio_pkt->pts;
             } else if (video_pkt && audio_pkt) {
                 pts_origin = MIN(video_pkt->pts, audio_pkt->pts);
-            } else if (recorder->stopped) {
+            } else if (output->stopped) {
                 if (video_pkt) {
-                    // The recorder is stopped without audio, record the video
+                    // The output is stopped without audio, record the video
                     // packets
                     pts_origin = video_pkt->pts;
                 } else {
@@ -397,7 +410,8 @@ sc_recorder_process_packets(struct sc_recorder *recorder) {
                 video_pkt_previous->duration = video_pkt->pts
                                              - video_pkt_previous->pts;
 
-                bool ok = sc_recorder_write_video(recorder, video_pkt_previous);
+                bool ok = sc_recorder_output_write_video(output,
+                                                         video_pkt_previous);
                 av_packet_free(&video_pkt_previous);
                 if (!ok) {
                     LOGE("Could not record video packet");
@@ -414,7 +428,7 @@ sc_recorder_process_packets(struct sc_recorder *recorder) {
             audio_pkt->pts -= pts_origin;
             audio_pkt->dts = audio_pkt->pts;
 
-            bool ok = sc_recorder_write_audio(recorder, audio_pkt);
+            bool ok = sc_recorder_output_write_audio(output, audio_pkt);
             if (!ok) {
                 LOGE("Could not record audio packet");
                 error = true;
@@ -431,7 +445,7 @@ sc_recorder_process_packets(struct sc_recorder *recorder) {
     if (last) {
         // assign an arbitrary duration to the last packet
         last->duration = 100000;
-        bool ok = sc_recorder_write_video(recorder, last);
+        bool ok = sc_recorder_output_write_video(output, last);
         if (!ok) {
             // failing to write the last frame is not very serious, no
             // future frame may depend on it, so the resulting file
@@ -441,9 +455,9 @@ sc_recorder_process_packets(struct sc_recorder *recorder) {
         av_packet_free(&last);
     }
 
-    int ret = av_write_trailer(recorder->ctx);
+    int ret = av_write_trailer(output->ctx);
     if (ret < 0) {
-        LOGE("Failed to write trailer to %s", recorder->filename);
+        LOGE("Failed to write trailer to %s", output->filename);
         error = false;
     }
 
@@ -459,46 +473,48 @@ end:
 }
 
 static bool
-sc_recorder_record(struct sc_recorder *recorder) {
-    bool ok = sc_recorder_open_output_file(recorder);
+sc_recorder_output_record(struct sc_recorder_output *output) {
+    bool ok = sc_recorder_output_open_file(output);
     if (!ok) {
         return false;
     }
 
-    ok = sc_recorder_process_packets(recorder);
-    sc_recorder_close_output_file(recorder);
+    ok = sc_recorder_output_process_packets(output);
+    sc_recorder_output_close_file(output);
     return ok;
 }
 
 static int
 run_recorder(void *data) {
-    struct sc_recorder *recorder = data;
+    struct sc_recorder_output *output = data;
 
     // Recording is a background task
     bool ok = sc_thread_set_priority(SC_THREAD_PRIORITY_LOW);
     (void) ok; // We don't care if it worked
 
-    bool success = sc_recorder_record(recorder);
+    bool success = sc_recorder_output_record(output);
 
-    sc_mutex_lock(&recorder->mutex);
+    sc_mutex_lock(&output->mutex);
     // Prevent the producer to push any new packet
-    recorder->stopped = true;
+    output->stopped = true;
     // Discard pending packets
-    sc_recorder_queue_clear(&recorder->video_queue);
-    sc_recorder_queue_clear(&recorder->audio_queue);
-    sc_mutex_unlock(&recorder->mutex);
+    sc_recorder_queue_clear(&output->video_queue);
+    sc_recorder_queue_clear(&output->audio_queue);
+    sc_mutex_unlock(&output->mutex);
 
     if (success) {
-        const char *format_name = sc_recorder_get_format_name(recorder->format);
+        const char *format_name = sc_recorder_get_format_name(output->format);
         LOGI("Recording complete to %s file: %s", format_name,
-                                                  recorder->filename);
+                                                  output->filename);
     } else {
-        LOGE("Recording failed to %s", recorder->filename);
+        LOGE("Recording failed to %s", output->filename);
     }
 
     LOGD("Recorder thread ended");
 
-    recorder->cbs->on_ended(recorder, success, recorder->cbs_userdata);
+    struct sc_recorder *recorder = output->recorder;
+    unsigned index = output - recorder->outputs;
+    recorder->cbs->on_ended(recorder, index, success, recorder->cbs_userdata);
 
     return 0;
 }
@@ -540,35 +556,24 @@ sc_recorder_set_orientation(AVStream *stream, enum sc_orientation orientation) {
 }
 
 static bool
-sc_recorder_video_packet_sink_open(struct sc_packet_sink *sink,
-                                   AVCodecContext *ctx) {
-    struct sc_recorder *recorder = DOWNCAST_VIDEO(sink);
-    // only written from this thread, no need to lock
-    assert(!recorder->video_init);
+sc_recorder_output_open_video(struct sc_recorder_output *output,
+                              AVCodecContext *ctx) {
+    struct sc_recorder *recorder = output->recorder;
 
-    sc_mutex_lock(&recorder->mutex);
-    if (recorder->stopped) {
-        sc_mutex_unlock(&recorder->mutex);
-        return false;
-    }
-
-    AVStream *stream = avformat_new_stream(recorder->ctx, ctx->codec);
+    AVStream *stream = avformat_new_stream(output->ctx, ctx->codec);
     if (!stream) {
-        sc_mutex_unlock(&recorder->mutex);
         return false;
     }
 
     int r = avcodec_parameters_from_context(stream->codecpar, ctx);
     if (r < 0) {
-        sc_mutex_unlock(&recorder->mutex);
         return false;
     }
 
-    recorder->video_stream.index = stream->index;
+    output->video_stream.index = stream->index;
 
     if (recorder->orientation != SC_ORIENTATION_0) {
         if (!sc_recorder_set_orientation(stream, recorder->orientation)) {
-            sc_mutex_unlock(&recorder->mutex);
             return false;
         }
 
@@ -576,94 +581,197 @@ sc_recorder_video_packet_sink_open(struct sc_packet_sink *sink,
              sc_orientation_get_name(recorder->orientation));
     }
 
-    recorder->video_init = true;
-    sc_cond_signal(&recorder->cond);
-    sc_mutex_unlock(&recorder->mutex);
-
     return true;
 }
 
-static void
-sc_recorder_video_packet_sink_close(struct sc_packet_sink *sink) {
-    struct sc_recorder *recorder = DOWNCAST_VIDEO(sink);
-    // only written from this thread, no need to lock
-    assert(recorder->video_init);
+static bool
+sc_recorder_output_open_audio(struct sc_recorder_output *output,
+                              AVCodecContext *ctx) {
+    AVStream *stream = avformat_new_stream(output->ctx, ctx->codec);
+    if (!stream) {
+        return false;
+    }
+
+    int r = avcodec_parameters_from_context(stream->codecpar, ctx);
+    if (r < 0) {
+        return false;
+    }
 
-    sc_mutex_lock(&recorder->mutex);
-    // EOS also stops the recorder
-    recorder->stopped = true;
-    sc_cond_signal(&recorder->cond);
-    sc_mutex_unlock(&recorder->mutex);
+    output->audio_stream.index = stream->index;
+
+    // A config packet is provided for all supported formats except raw audio
+    output->audio_expects_config_packet =
+        ctx->codec_id != AV_CODEC_ID_PCM_S16LE;
+
+    return true;
 }
 
 static bool
-sc_recorder_video_packet_sink_push(struct sc_packet_sink *sink,
-                                   const AVPacket *packet) {
-    struct sc_recorder *recorder = DOWNCAST_VIDEO(sink);
-    // only written from this thread, no need to lock
-    assert(recorder->video_init);
-
-    sc_mutex_lock(&recorder->mutex);
+sc_recorder_output_push(struct sc_recorder_output *output,
+                        struct sc_recorder_queue *queue, int stream_index,
+                        const AVPacket *packet) {
+    sc_mutex_lock(&output->mutex);
 
-    if (recorder->stopped) {
+    if (output->stopped) {
         // reject any new packet
-        sc_mutex_unlock(&recorder->mutex);
+        sc_mutex_unlock(&output->mutex);
         return false;
     }
 
+    // The packet data is shared by reference between all the outputs
     AVPacket *rec = sc_recorder_packet_ref(packet);
     if (!rec) {
         LOG_OOM();
-        sc_mutex_unlock(&recorder->mutex);
+        sc_mutex_unlock(&output->mutex);
         return false;
     }
 
-    rec->stream_index = recorder->video_stream.index;
+    rec->stream_index = stream_index;
 
-    bool ok = sc_vecdeque_push(&recorder->video_queue, rec);
+    bool ok = sc_vecdeque_push(queue, rec);
     if (!ok) {
         LOG_OOM();
-        sc_mutex_unlock(&recorder->mutex);
+        av_packet_free(&rec);
+        sc_mutex_unlock(&output->mutex);
         return false;
     }
 
-    sc_cond_signal(&recorder->cond);
+    sc_cond_signal(&output->cond);
 
-    sc_mutex_unlock(&recorder->mutex);
+    sc_mutex_unlock(&output->mutex);
     return true;
 }
 
+static void
+sc_recorder_output_stop(struct sc_recorder_output *output) {
+    sc_mutex_lock(&output->mutex);
+    output->stopped = true;
+    sc_cond_signal(&output->cond);
+    sc_mutex_unlock(&output->mutex);
+}
+
+static bool
+sc_recorder_video_packet_sink_open(struct sc_packet_sink *sink,
+                                   AVCodecContext *ctx) {
+    struct sc_recorder *recorder = DOWNCAST_VIDEO(sink);
+    assert(recorder->video);
+
+    bool opened = false;
+    for (unsigned i = 0; i < recorder->output_count; ++i) {
+        struct sc_recorder_output *output = &recorder->outputs[i];
+        if (!output->video) {
+            continue;
+        }
+
+        // only written from this thread, no need to lock
+        assert(!output->video_init);
+
+        sc_mutex_lock(&output->mutex);
+        if (output->stopped) {
+            sc_mutex_unlock(&output->mutex);
+            continue;
+        }
+
+        if (!sc_recorder_output_open_video(output, ctx)) {
+            LOGE("Could not open video stream for %s", output->filename);
+            if (!i) {
+                // The primary output is required
+                sc_mutex_unlock(&output->mutex);
+                return false;
+            }
+
+            // Stop only this output, its thread reports the failure
+            output->stopped = true;
+            sc_cond_signal(&output->cond);
+            sc_mutex_unlock(&output->mutex);
+            continue;
+        }
+
+        output->video_init = true;
+        sc_cond_signal(&output->cond);
+        sc_mutex_unlock(&output->mutex);
+
+        opened = true;
+    }
+
+    return opened;
+}
+
+static void
+sc_recorder_video_packet_sink_close(struct sc_packet_sink *sink) {
+    struct sc_recorder *recorder = DOWNCAST_VIDEO(sink);
+    assert(recorder->video);
+
+    for (unsigned i = 0; i < recorder->output_count; ++i) {
+        struct sc_recorder_output *output = &recorder->outputs[i];
+        if (output->video) {
+            // EOS also stops the output
+            sc_recorder_output_stop(output);
+        }
+    }
+}
+
+static bool
+sc_recorder_video_packet_sink_push(struct sc_packet_sink *sink,
+                                   const AVPacket *packet) {
+    struct sc_recorder *recorder = DOWNCAST_VIDEO(sink);
+    assert(recorder->video);
+
+    bool accepted = false;
+    for (unsigned i = 0; i < recorder->output_count; ++i) {
+        struct sc_recorder_output *output = &recorder->outputs[i];
+        // only written from this thread, no need to lock
+        if (output->video && output->video_init) {
+            accepted |= sc_recorder_output_push(output, &output->video_queue,
+                                                output->video_stream.index,
+                                                packet);
+        }
+    }
+
+    // Only fail if no output is able to record the packet anymore
+    return accepted;
+}
+
 static bool
 sc_recorder_audio_packet_sink_open(struct sc_packet_sink *sink,
                                    AVCodecContext *ctx) {
     struct sc_recorder *recorder = DOWNCAST_AUDIO(sink);
     assert(recorder->audio);
-    // only written from this thread, no need to lock
-    assert(!recorder->audio_init);
 
-    sc_mutex_lock(&recorder->mutex);
+    for (unsigned i = 0; i < recorder->output_count; ++i) {
+        struct sc_recorder_output *output = &recorder->outputs[i];
+        if (!output->audio) {
+            continue;
+        }
 
-    AVStream *stream = avformat_new_stream(recorder->ctx, ctx->codec);
-    if (!stream) {
-        sc_mutex_unlock(&recorder->mutex);
-        return false;
-    }
+        // only written from this thread, no need to lock
+        assert(!output->audio_init);
 
-    int r = avcodec_parameters_from_context(stream->codecpar, ctx);
-    if (r < 0) {
-        sc_mutex_unlock(&recorder->mutex);
-        return false;
-    }
+        sc_mutex_lock(&output->mutex);
+        if (output->stopped) {
+            sc_mutex_unlock(&output->mutex);
+            continue;
+        }
 
-    recorder->audio_stream.index = stream->index;
+        if (!sc_recorder_output_open_audio(output, ctx)) {
+            LOGE("Could not open audio stream for %s", output->filename);
+            if (!i) {
+                // The primary output is required
+                sc_mutex_unlock(&output->mutex);
+                return false;
+            }
 
-    // A config packet is provided for all supported formats except raw audio
-    recorder->audio_expects_config_packet =
-        ctx->codec_id != AV_CODEC_ID_PCM_S16LE;
+            // Stop only this output, its thread reports the failure
+            output->stopped = true;
+            sc_cond_signal(&output->cond);
+            sc_mutex_unlock(&output->mutex);
+            continue;
+        }
 
-    recorder->audio_init = true;
-    sc_cond_signal(&recorder->cond);
-    sc_mutex_unlock(&recorder->mutex);
+        output->audio_init = true;
+        sc_cond_signal(&output->cond);
+        sc_mutex_unlock(&output->mutex);
+    }
 
     return true;
 }
@@ -672,14 +780,14 @@ static void
 sc_recorder_audio_packet_sink_close(struct sc_packet_sink *sink) {
     struct sc_recorder *recorder = DOWNCAST_AUDIO(sink);
     assert(recorder->audio);
-    // only written from this thread, no need to lock
-    assert(recorder->audio_init);
 
-    sc_mutex_lock(&recorder->mutex);
-    // EOS also stops the recorder
-    recorder->stopped = true;
-    sc_cond_signal(&recorder->cond);
-    sc_mutex_unlock(&recorder->mutex);
+    for (unsigned i = 0; i < recorder->output_count; ++i) {
+        struct sc_recorder_output *output = &recorder->outputs[i];
+        if (output->audio) {
+            // EOS also stops the output
+            sc_recorder_output_stop(output);
+        }
+    }
 }
 
 static bool
@@ -687,53 +795,44 @@ sc_recorder_audio_packet_sink_push(struct sc_packet_sink *sink,
                                    const AVPacket *packet) {
     struct sc_recorder *recorder = DOWNCAST_AUDIO(sink);
     assert(recorder->audio);
-    // only written from this thread, no need to lock
-    assert(recorder->audio_init);
-
-    sc_mutex_lock(&recorder->mutex);
-
-    if (recorder->stopped) {
-        // reject any new packet
-        sc_mutex_unlock(&recorder->mutex);
-        return false;
-    }
-
-    AVPacket *rec = sc_recorder_packet_ref(packet);
-    if (!rec) {
-        LOG_OOM();
-        sc_mutex_unlock(&recorder->mutex);
-        return false;
-    }
-
-    rec->stream_index = recorder->audio_stream.index;
 
-    bool ok = sc_vecdeque_push(&recorder->audio_queue, rec);
-    if (!ok) {
-        LOG_OOM();
-        sc_mutex_unlock(&recorder->mutex);
-        return false;
+    bool accepted = false;
+    for (unsigned i = 0; i < recorder->output_count; ++i) {
+        struct sc_recorder_output *output = &recorder->outputs[i];
+        // only written from this thread, no need to lock
+        if (output->audio && output->audio_init) {
+            accepted |= sc_recorder_output_push(output, &output->audio_queue,
+                                                output->audio_stream.index,
+                                                packet);
+        }
     }
 
-    sc_cond_signal(&recorder->cond);
-
-    sc_mutex_unlock(&recorder->mutex);
-    return true;
+    // Only fail if no output is able to record the packet anymore
+    return accepted;
 }
 
 static void
 sc_recorder_audio_packet_sink_disable(struct sc_packet_sink *sink) {
     struct sc_recorder *recorder = DOWNCAST_AUDIO(sink);
     assert(recorder->audio);
-    // only written from this thread, no need to lock
-    assert(!recorder->audio_init);
 
     LOGW("Audio stream recording disabled");
 
-    sc_mutex_lock(&recorder->mutex);
-    recorder->audio = false;
-    recorder->audio_init = true;
-    sc_cond_signal(&recorder->cond);
-    sc_mutex_unlock(&recorder->mutex);
+    for (unsigned i = 0; i < recorder->output_count; ++i) {
+        struct sc_recorder_output *output = &recorder->outputs[i];
+        if (!output->audio) {
+            continue;
+        }
+
+        // only written from this thread, no need to lock
+        assert(!output->audio_init);
+
+        sc_mutex_lock(&output->mutex);
+        output->audio = false;
+        output->audio_init = true;
+        sc_cond_signal(&output->cond);
+        sc_mutex_unlock(&output->mutex);
+    }
 }
 
 static void
@@ -742,48 +841,82 @@ sc_recorder_stream_init(struct sc_recorder_stream *stream) {
     stream->last_pts = AV_NOPTS_VALUE;
 }
 
-bool
-sc_recorder_init(struct sc_recorder *recorder, const char *filename,
-                 enum sc_record_format format, bool video, bool audio,
-                 enum sc_orientation orientation,
-                 const struct sc_recorder_callbacks *cbs, void *cbs_userdata) {
-    assert(!sc_orientation_is_mirror(orientation));
-
-    recorder->filename = strdup(filename);
-    if (!recorder->filename) {
+static bool
+sc_recorder_output_init(struct sc_recorder_output *output,
+                        struct sc_recorder *recorder, const char *filename,
+                        enum sc_record_format format, bool video, bool audio) {
+    output->filename = strdup(filename);
+    if (!output->filename) {
         LOG_OOM();
         return false;
     }
 
-    bool ok = sc_mutex_init(&recorder->mutex);
+    bool ok = sc_mutex_init(&output->mutex);
     if (!ok) {
         goto error_free_filename;
     }
 
-    ok = sc_cond_init(&recorder->cond);
+    ok = sc_cond_init(&output->cond);
     if (!ok) {
         goto error_mutex_destroy;
     }
 
     assert(video || audio);
-    recorder->video = video;
-    recorder->audio = audio;
+    output->recorder = recorder;
+    output->video = video;
+    output->audio = audio;
 
-    recorder->orientation = orientation;
+    sc_vecdeque_init(&output->video_queue);
+    sc_vecdeque_init(&output->audio_queue);
+    output->stopped = false;
+
+    output->video_init = false;
+    output->audio_init = false;
 
-    sc_vecdeque_init(&recorder->video_queue);
-    sc_vecdeque_init(&recorder->audio_queue);
-    recorder->stopped = false;
+    output->audio_expects_config_packet = false;
 
-    recorder->video_init = false;
-    recorder->audio_init = false;
+    sc_recorder_stream_init(&output->video_stream);
+    sc_recorder_stream_init(&output->audio_stream);
 
-    recorder->audio_expects_config_packet = false;
+    output->format = format;
 
-    sc_recorder_stream_init(&recorder->video_stream);
-    sc_recorder_stream_init(&recorder->audio_stream);
+    return true;
+
+error_mutex_destroy:
+    sc_mutex_destroy(&output->mutex);
+error_free_filename:
+    free(output->filename);
 
-    recorder->format = format;
+    return false;
+}
+
+static void
+sc_recorder_output_destroy(struct sc_recorder_output *output) {
+    sc_cond_destroy(&output->cond);
+    sc_mutex_destroy(&output->mutex);
+    free(output->filename);
+}
+
+bool
+sc_recorder_init(struct sc_recorder *recorder, const char *filename,
+                 enum sc_record_format format, bool video, bool audio,
+                 enum sc_orientation orientation,
+                 const struct sc_recorder_callbacks *cbs, void *cbs_userdata) {
+    assert(!sc_orientation_is_mirror(orientation));
+
+    bool ok = sc_recorder_output_init(&recorder->outputs[0], recorder,
+                                      filename, format, video, audio);
+    if (!ok) {
+        return false;
+    }
+
+    recorder->output_count = 1;
+    recorder->started_count = 0;
+
+    recorder->video = video;
+    recorder->audio = audio;
+
+    recorder->orientation = orientation;
 
     assert(cbs && cbs->on_ended);
     recorder->cbs = cbs;
@@ -811,43 +944,77 @@ sc_recorder_init(struct sc_recorder *recorder, const char *filename,
     }
 
     return true;
+}
 
-error_mutex_destroy:
-    sc_mutex_destroy(&recorder->mutex);
-error_free_filename:
-    free(recorder->filename);
+bool
+sc_recorder_add_output(struct sc_recorder *recorder, const char *filename,
+                       enum sc_record_format format, bool video, bool audio) {
+    assert(!recorder->started_count);
+    // the streams of an additional output must be provided by the sinks
+    assert(!video || recorder->video);
+    assert(!audio || recorder->audio);
+
+    if (recorder->output_count == SC_RECORDER_MAX_OUTPUTS) {
+        LOGE("Too many record outputs (max %d)", SC_RECORDER_MAX_OUTPUTS);
+        return false;
+    }
 
-    return false;
+    struct sc_recorder_output *output =
+        &recorder->outputs[recorder->output_count];
+    bool ok = sc_recorder_output_init(output, recorder, filename, format,
+                                      video, audio);
+    if (!ok) {
+        return false;
+    }
+
+    ++recorder->output_count;
+    return true;
 }
 
 bool
 sc_recorder_start(struct sc_recorder *recorder) {
-    bool ok = sc_thread_create(&recorder->thread, run_recorder,
-                               "scrcpy-recorder", recorder);
-    if (!ok) {
-        LOGE("Could not start recorder thread");
-        return false;
+    assert(!recorder->started_count);
+
+    for (unsigned i = 0; i < recorder->output_count; ++i) {
+        struct sc_recorder_output *output = &recorder->outputs[i];
+        bool ok = sc_thread_create(&output->thread, run_recorder,
+                                   "scrcpy-recorder", output);
+        if (!ok) {
+            LOGE("Could not start recorder thread");
+            goto error;
+        }
+
+        ++recorder->started_count;
     }
 
     return true;
+
+error:
+    // The caller will not join the outputs already started
+    sc_recorder_stop(recorder);
+    sc_recorder_join(recorder);
+    recorder->started_count = 0;
+
+    return false;
 }
 
 void
 sc_recorder_stop(struct sc_recorder *recorder) {
-    sc_mutex_lock(&recorder->mutex);
-    recorder->stopped = true;
-    sc_cond_signal(&recorder->cond);
-    sc_mutex_unlock(&recorder->mutex);
+    for (unsigned i = 0; i < recorder->output_count; ++i) {
+        sc_recorder_output_stop(&recorder->outputs[i]);
+    }
 }
 
 void
 sc_recorder_join(struct sc_recorder *recorder) {
-    sc_thread_join(&recorder->thread, NULL);
+    for (unsigned i = 0; i < recorder->started_count; ++i) {
+        sc_thread_join(&recorder->outputs[i].thread, NULL);
+    }
 }
 
 void
 sc_recorder_destroy(struct sc_recorder *recorder) {
-    sc_cond_destroy(&recorder->cond);
-    sc_mutex_destroy(&recorder->mutex);
-    free(recorder->filename);
+    for (unsigned i = 0; i < recorder->output_count; ++i) {
+        sc_recorder_output_destroy(&recorder->outputs[i]);
+    }
 }
@@ -20,23 +20,32 @@ struct sc_recorder_stream {
     int64_t last_pts;
 };
 
-struct sc_recorder {
-    struct sc_packet_sink video_packet_sink;
-    struct sc_packet_sink audio_packet_sink;
+#define SC_RECORDER_MAX_OUTPUTS 4
+
+struct sc_recorder;
+
+/**
+ * A single recording destination.
+ *
+ * Each output owns its muxer, its queues and its writer thread, so that a
+ * slow or failing output does not block the others. The packets are shared
+ * between all the outputs by reference.
+ */
+struct sc_recorder_output {
+    struct sc_recorder *recorder;
 
     /* The audio flag is unprotected:
-     *  - it is initialized from sc_recorder_init() from the main thread;
-     *  - it may be reset once from the recorder thread if the audio is
-     *    disabled dynamically.
+     *  - it is initialized from the main thread before the recorder is
+     *    started;
+     *  - it may be reset once from the demuxer thread if the audio is
+     *    disabled dynamically, before the audio init flag is set.
      *
-     * Therefore, once the recorder thread is started, only the recorder thread
-     * may access it without data races.
+     * Therefore, once the audio init flag is set, the output thread may
+     * access it without data races.
      */
     bool audio;
     bool video;
 
-    enum sc_orientation orientation;
-
     char *filename;
     enum sc_record_format format;
     AVFormatContext *ctx;
@@ -49,7 +58,7 @@ struct sc_recorder {
     struct sc_recorder_queue video_queue;
     struct sc_recorder_queue audio_queue;
 
-    // wake up the recorder thread once the video or audio codec is known
+    // wake up the output thread once the video or audio codec is known
     bool video_init;
     bool audio_init;
 
@@ -57,14 +66,34 @@ struct sc_recorder {
 
     struct sc_recorder_stream video_stream;
     struct sc_recorder_stream audio_stream;
+};
+
+struct sc_recorder {
+    struct sc_packet_sink video_packet_sink;
+    struct sc_packet_sink audio_packet_sink;
+
+    // whether at least one output records the video (resp. audio) stream
+    bool video;
+    bool audio;
+
+    enum sc_orientation orientation;
+
+    // the first output is the one passed to sc_recorder_init()
+    struct sc_recorder_output outputs[SC_RECORDER_MAX_OUTPUTS];
+    unsigned output_count;
+    // number of output threads started
+    unsigned started_count;
 
     const struct sc_recorder_callbacks *cbs;
     void *cbs_userdata;
 };
 
 struct sc_recorder_callbacks {
-    void (*on_ended)(struct sc_recorder *recorder, bool success,
-                     void *userdata);
+    // called once per output, from its own thread (the index 0 is the output
+    // passed to sc_recorder_init(), the others are the additional outputs in
+    // the order they were added)
+    void (*on_ended)(struct sc_recorder *recorder, unsigned index,
+                     bool success, void *userdata);
 };
 
 bool
@@ -73,6 +102,18 @@ sc_recorder_init(struct sc_recorder *recorder, const char *filename,
                  enum sc_orientation orientation,
                  const struct sc_recorder_callbacks *cbs, void *cbs_userdata);
 
+/**
+ * Add an additional output, recording the same packets to another file
+ *
+ * The video and audio flags select the streams to record to this output. They
+ * must be a subset of the streams passed to sc_recorder_init().
+ *
+ * Must be called before sc_recorder_start().
+ */
+bool
+sc_recorder_add_output(struct sc_recorder *recorder, const char *filename,
+                       enum sc_record_format format, bool video, bool audio);
+
 bool
 sc_recorder_start(struct sc_recorder *recorder);
 
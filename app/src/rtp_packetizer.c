@@ -0,0 +1,260 @@
+#include "rtp_packetizer.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/binary.h"
+#include "util/log.h"
+
+#define SC_RTP_INITIAL_CAP 64
+
+#define SC_RTP_H264_FU_A 28
+#define SC_RTP_H265_FU 49
+
+bool
+sc_rtp_packetizer_init(struct sc_rtp_packetizer *p,
+                       enum sc_rtp_payload payload, uint8_t payload_type,
+                       uint32_t ssrc, uint16_t seq, uint32_t timestamp_offset,
+                       size_t mtu) {
+    // Enough for the RTP header, the FU headers and some payload
+    assert(mtu > SC_RTP_HEADER_SIZE + 3);
+    assert(payload_type < 128);
+
+    p->buf = malloc(SC_RTP_INITIAL_CAP * mtu);
+    if (!p->buf) {
+        LOG_OOM();
+        return false;
+    }
+
+    p->sizes = malloc(SC_RTP_INITIAL_CAP * sizeof(*p->sizes));
+    if (!p->sizes) {
+        LOG_OOM();
+        free(p->buf);
+        return false;
+    }
+
+    p->payload = payload;
+    p->payload_type = payload_type;
+    p->clock_rate = payload == SC_RTP_PAYLOAD_OPUS ? 48000 : 90000;
+    p->ssrc = ssrc;
+    p->seq = seq;
+    p->timestamp_offset = timestamp_offset;
+    p->mtu = mtu;
+    p->count = 0;
+    p->cap = SC_RTP_INITIAL_CAP;
+
+    return true;
+}
+
+void
+sc_rtp_packetizer_destroy(struct sc_rtp_packetizer *p) {
+    free(p->buf);
+    free(p->sizes);
+}
+
+static bool
+sc_rtp_packetizer_reserve(struct sc_rtp_packetizer *p) {
+    if (p->count < p->cap) {
+        return true;
+    }
+
+    // A large keyframe may not fit, grow the buffers once and for all
+    size_t cap = p->cap * 2;
+    uint8_t *buf = realloc(p->buf, cap * p->mtu);
+    if (!buf) {
+        LOG_OOM();
+        return false;
+    }
+    p->buf = buf;
+
+    size_t *sizes = realloc(p->sizes, cap * sizeof(*sizes));
+    if (!sizes) {
+        LOG_OOM();
+        return false;
+    }
+    p->sizes = sizes;
+
+    p->cap = cap;
+    return true;
+}
+
+// Start a new datagram and return a pointer to its payload
+static uint8_t *
+sc_rtp_packetizer_next(struct sc_rtp_packetizer *p, uint32_t timestamp) {
+    if (!sc_rtp_packetizer_reserve(p)) {
+        return NULL;
+    }
+
+    uint8_t *d = &p->buf[p->count * p->mtu];
+    d[0] = 0x80; // version 2, no padding, no extension, no CSRC
+    d[1] = p->payload_type; // the marker bit is set afterwards
+    sc_write16be(&d[2], p->seq++);
+    sc_write32be(&d[4], timestamp);
+    sc_write32be(&d[8], p->ssrc);
+
+    ++p->count;
+    return &d[SC_RTP_HEADER_SIZE];
+}
+
+static inline void
+sc_rtp_packetizer_end(struct sc_rtp_packetizer *p, size_t payload_size) {
+    assert(p->count);
+    assert(SC_RTP_HEADER_SIZE + payload_size <= p->mtu);
+    p->sizes[p->count - 1] = SC_RTP_HEADER_SIZE + payload_size;
+}
+
+static bool
+sc_rtp_packetizer_push_nal(struct sc_rtp_packetizer *p, const uint8_t *nal,
+                           size_t len, uint32_t timestamp) {
+    size_t max_payload = p->mtu - SC_RTP_HEADER_SIZE;
+
+    if (len <= max_payload) {
+        // Single NAL unit packet
+        uint8_t *payload = sc_rtp_packetizer_next(p, timestamp);
+        if (!payload) {
+            return false;
+        }
+        memcpy(payload, nal, len);
+        sc_rtp_packetizer_end(p, len);
+        return true;
+    }
+
+    // Fragmentation units: the NAL header is replaced by the FU headers
+    uint8_t fu_headers[3];
+    size_t fu_headers_size;
+    size_t nal_header_size;
+    if (p->payload == SC_RTP_PAYLOAD_H264) {
+        fu_headers[0] = (nal[0] & 0xE0) | SC_RTP_H264_FU_A; // FU indicator
+        fu_headers[1] = nal[0] & 0x1F; // FU header (type)
+        fu_headers_size = 2;
+        nal_header_size = 1;
+    } else {
+        assert(p->payload == SC_RTP_PAYLOAD_H265);
+        // Payload header (layer id and tid copied from the NAL header)
+        fu_headers[0] = (nal[0] & 0x81) | (SC_RTP_H265_FU << 1);
+        fu_headers[1] = nal[1];
+        fu_headers[2] = (nal[0] >> 1) & 0x3F; // FU header (type)
+        fu_headers_size = 3;
+        nal_header_size = 2;
+    }
+
+    const uint8_t *data = nal + nal_header_size;
+    size_t remaining = len - nal_header_size;
+    size_t max_chunk = max_payload - fu_headers_size;
+    bool first = true;
+
+    while (remaining) {
+        size_t chunk = remaining < max_chunk ? remaining : max_chunk;
+        bool last = chunk == remaining;
+
+        uint8_t *payload = sc_rtp_packetizer_next(p, timestamp);
+        if (!payload) {
+            return false;
+        }
+
+        memcpy(payload, fu_headers, fu_headers_size);
+        uint8_t *fu_header = &payload[fu_headers_size - 1];
+        if (first) {
+            *fu_header |= 0x80; // S bit
+        }
+        if (last) {
+            *fu_header |= 0x40; // E bit
+        }
+        memcpy(&payload[fu_headers_size], data, chunk);
+        sc_rtp_packetizer_end(p, fu_headers_size + chunk);
+
+        data += chunk;
+        remaining -= chunk;
+        first = false;
+    }
+
+    return true;
+}
+
+// Return a pointer to the next start code (00 00 01), or end if not found
+static const uint8_t *
+sc_rtp_find_start_code(const uint8_t *data, const uint8_t *end) {
+    while (end - data >= 3) {
+        if (!data[0] && !data[1] && data[2] == 1) {
+            return data;
+        }
+        ++data;
+    }
+    return end;
+}
+
+static bool
+sc_rtp_packetizer_packetize_nals(struct sc_rtp_packetizer *p,
+                                 const uint8_t *data, size_t len,
+                                 uint32_t timestamp) {
+    const uint8_t *end = data + len;
+    const uint8_t *start = sc_rtp_find_start_code(data, end);
+    if (start == end) {
+        // Not in Annex B format, consider the whole packet as a single NAL
+        return sc_rtp_packetizer_push_nal(p, data, len, timestamp);
+    }
+
+    while (start != end) {
+        const uint8_t *nal = start + 3;
+        const uint8_t *next = sc_rtp_find_start_code(nal, end);
+
+        // The zero byte of a 4-byte start code is not part of the NAL
+        const uint8_t *nal_end = next;
+        while (nal_end > nal && !nal_end[-1]) {
+            --nal_end;
+        }
+
+        size_t nal_len = nal_end - nal;
+        size_t min_len = p->payload == SC_RTP_PAYLOAD_H264 ? 1 : 2;
+        if (nal_len >= min_len) {
+            if (!sc_rtp_packetizer_push_nal(p, nal, nal_len, timestamp)) {
+                return false;
+            }
+        }
+
+        start = next;
+    }
+
+    return true;
+}
+
+bool
+sc_rtp_packetizer_packetize(struct sc_rtp_packetizer *p, const uint8_t *data,
+                            size_t len, int64_t pts) {
+    p->count = 0;
+
+    // pts in microseconds
+    uint32_t timestamp = p->timestamp_offset
+                       + (uint32_t) (pts * p->clock_rate / 1000000);
+
+    if (p->payload == SC_RTP_PAYLOAD_OPUS) {
+        // One Opus packet per datagram
+        if (SC_RTP_HEADER_SIZE + len > p->mtu) {
+            LOGW("RTP: Opus packet too large (%" PRIu64 " bytes), dropped",
+                 (uint64_t) len);
+            return true;
+        }
+
+        uint8_t *payload = sc_rtp_packetizer_next(p, timestamp);
+        if (!payload) {
+            return false;
+        }
+        memcpy(payload, data, len);
+        sc_rtp_packetizer_end(p, len);
+        return true;
+    }
+
+    if (!sc_rtp_packetizer_packetize_nals(p, data, len, timestamp)) {
+        p->count = 0;
+        return false;
+    }
+
+    if (p->count) {
+        // The marker bit is set on the last datagram of the access unit
+        p->buf[(p->count - 1) * p->mtu + 1] |= 0x80;
+    }
+
+    return true;
+}
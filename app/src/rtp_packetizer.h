@@ -0,0 +1,66 @@
+#ifndef SC_RTP_PACKETIZER_H
+#define SC_RTP_PACKETIZER_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SC_RTP_HEADER_SIZE 12
+
+enum sc_rtp_payload {
+    SC_RTP_PAYLOAD_H264, // RFC 6184
+    SC_RTP_PAYLOAD_H265, // RFC 7798
+    SC_RTP_PAYLOAD_OPUS, // RFC 7587
+};
+
+/**
+ * RTP packetizer
+ *
+ * Split a media packet (an access unit in Annex B format for H.26x, or an
+ * Opus packet) into RTP datagrams, written into a single buffer reused for
+ * every packet.
+ */
+struct sc_rtp_packetizer {
+    enum sc_rtp_payload payload;
+    uint8_t payload_type;
+    uint32_t clock_rate;
+    uint32_t ssrc;
+    uint16_t seq; // sequence number of the next datagram
+    uint32_t timestamp_offset;
+    size_t mtu; // maximum datagram size
+
+    // the datagrams of the last packet, datagram i is stored at buf + i * mtu
+    uint8_t *buf;
+    size_t *sizes;
+    size_t count;
+    size_t cap; // number of datagrams buf can hold
+};
+
+bool
+sc_rtp_packetizer_init(struct sc_rtp_packetizer *p,
+                       enum sc_rtp_payload payload, uint8_t payload_type,
+                       uint32_t ssrc, uint16_t seq, uint32_t timestamp_offset,
+                       size_t mtu);
+
+void
+sc_rtp_packetizer_destroy(struct sc_rtp_packetizer *p);
+
+/**
+ * Packetize a media packet
+ *
+ * The previous datagrams are discarded. On success, the datagrams are
+ * available via sc_rtp_packetizer_get().
+ */
+bool
+sc_rtp_packetizer_packetize(struct sc_rtp_packetizer *p, const uint8_t *data,
+                            size_t len, int64_t pts);
+
+static inline const uint8_t *
+sc_rtp_packetizer_get(struct sc_rtp_packetizer *p, size_t i, size_t *len) {
+    *len = p->sizes[i];
+    return &p->buf[i * p->mtu];
+}
+
+#endif
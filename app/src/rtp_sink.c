@@ -0,0 +1,287 @@
+#include "rtp_sink.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <libavcodec/avcodec.h>
+
+#include "util/log.h"
+#include "util/rand.h"
+
+/** Downcast packet sinks to rtp sink */
+#define DOWNCAST_VIDEO(SINK) \
+    container_of(SINK, struct sc_rtp_sink, video_packet_sink)
+#define DOWNCAST_AUDIO(SINK) \
+    container_of(SINK, struct sc_rtp_sink, audio_packet_sink)
+
+#define SC_RTP_VIDEO_PAYLOAD_TYPE 96
+#define SC_RTP_AUDIO_PAYLOAD_TYPE 97
+
+static void
+sc_rtp_sink_stream_close(struct sc_rtp_sink_stream *stream) {
+    if (stream->socket != SC_SOCKET_NONE) {
+        net_close(stream->socket);
+        stream->socket = SC_SOCKET_NONE;
+    }
+    if (stream->packetizer_initialized) {
+        sc_rtp_packetizer_destroy(&stream->packetizer);
+        stream->packetizer_initialized = false;
+    }
+}
+
+static bool
+sc_rtp_sink_stream_open(struct sc_rtp_sink *sink,
+                        struct sc_rtp_sink_stream *stream,
+                        enum AVCodecID codec_id) {
+    enum sc_rtp_payload payload;
+    uint8_t payload_type;
+    switch (codec_id) {
+        case AV_CODEC_ID_H264:
+            payload = SC_RTP_PAYLOAD_H264;
+            payload_type = SC_RTP_VIDEO_PAYLOAD_TYPE;
+            break;
+        case AV_CODEC_ID_HEVC:
+            payload = SC_RTP_PAYLOAD_H265;
+            payload_type = SC_RTP_VIDEO_PAYLOAD_TYPE;
+            break;
+        case AV_CODEC_ID_OPUS:
+            payload = SC_RTP_PAYLOAD_OPUS;
+            payload_type = SC_RTP_AUDIO_PAYLOAD_TYPE;
+            break;
+        default:
+            LOGW("RTP: codec %s not supported, stream not sent",
+                 avcodec_get_name(codec_id));
+            // Do not fail, the other sinks must not be impacted
+            return true;
+    }
+
+    struct sc_rand rand;
+    sc_rand_init(&rand);
+
+    bool ok = sc_rtp_packetizer_init(&stream->packetizer, payload,
+                                     payload_type, sc_rand_u32(&rand),
+                                     (uint16_t) sc_rand_u32(&rand),
+                                     sc_rand_u32(&rand), sink->mtu);
+    if (!ok) {
+        return false;
+    }
+    stream->packetizer_initialized = true;
+
+    stream->socket = net_udp_socket();
+    if (stream->socket == SC_SOCKET_NONE) {
+        LOGE("RTP: could not create socket");
+        sc_rtp_sink_stream_close(stream);
+        return false;
+    }
+
+    // Connect the UDP socket, so that the datagrams are sent without address
+    if (!net_connect(stream->socket, sink->addr, stream->port)) {
+        LOGE("RTP: could not set the destination port %" PRIu16,
+             stream->port);
+        sc_rtp_sink_stream_close(stream);
+        return false;
+    }
+
+    return true;
+}
+
+static bool
+sc_rtp_sink_stream_push(struct sc_rtp_sink_stream *stream,
+                        const AVPacket *packet) {
+    if (stream->socket == SC_SOCKET_NONE) {
+        // Disabled
+        return true;
+    }
+
+    if (packet->pts == AV_NOPTS_VALUE) {
+        // Config packets are not sent: the H.26x parameter sets are merged
+        // with the next keyframe, and the Opus header is described by the SDP
+        return true;
+    }
+
+    struct sc_rtp_packetizer *p = &stream->packetizer;
+    if (!sc_rtp_packetizer_packetize(p, packet->data, packet->size,
+                                     packet->pts)) {
+        return false;
+    }
+
+    if (p->count > stream->datagram_cap) {
+        size_t cap = p->cap; // the packetizer capacity is never reduced
+        struct sc_net_datagram *datagrams =
+            realloc(stream->datagrams, cap * sizeof(*datagrams));
+        if (!datagrams) {
+            LOG_OOM();
+            return false;
+        }
+        stream->datagrams = datagrams;
+        stream->datagram_cap = cap;
+    }
+
+    for (size_t i = 0; i < p->count; ++i) {
+        stream->datagrams[i].data =
+            sc_rtp_packetizer_get(p, i, &stream->datagrams[i].len);
+    }
+
+    ssize_t r = net_send_datagrams(stream->socket, stream->datagrams,
+                                   p->count);
+    if (r < (ssize_t) p->count) {
+        // The receiver may not be started yet (the kernel reports
+        // ECONNREFUSED on connected UDP sockets), keep going
+        if (!stream->send_error_logged) {
+            LOGW("RTP: could not send to port %" PRIu16, stream->port);
+            stream->send_error_logged = true;
+        }
+    } else {
+        stream->send_error_logged = false;
+    }
+
+    return true;
+}
+
+static bool
+sc_rtp_sink_video_packet_sink_open(struct sc_packet_sink *sink,
+                                   AVCodecContext *ctx) {
+    struct sc_rtp_sink *rtp = DOWNCAST_VIDEO(sink);
+    return sc_rtp_sink_stream_open(rtp, &rtp->video, ctx->codec_id);
+}
+
+static void
+sc_rtp_sink_video_packet_sink_close(struct sc_packet_sink *sink) {
+    struct sc_rtp_sink *rtp = DOWNCAST_VIDEO(sink);
+    sc_rtp_sink_stream_close(&rtp->video);
+}
+
+static bool
+sc_rtp_sink_video_packet_sink_push(struct sc_packet_sink *sink,
+                                   const AVPacket *packet) {
+    struct sc_rtp_sink *rtp = DOWNCAST_VIDEO(sink);
+    return sc_rtp_sink_stream_push(&rtp->video, packet);
+}
+
+static bool
+sc_rtp_sink_audio_packet_sink_open(struct sc_packet_sink *sink,
+                                   AVCodecContext *ctx) {
+    struct sc_rtp_sink *rtp = DOWNCAST_AUDIO(sink);
+    return sc_rtp_sink_stream_open(rtp, &rtp->audio, ctx->codec_id);
+}
+
+static void
+sc_rtp_sink_audio_packet_sink_close(struct sc_packet_sink *sink) {
+    struct sc_rtp_sink *rtp = DOWNCAST_AUDIO(sink);
+    sc_rtp_sink_stream_close(&rtp->audio);
+}
+
+static bool
+sc_rtp_sink_audio_packet_sink_push(struct sc_packet_sink *sink,
+                                   const AVPacket *packet) {
+    struct sc_rtp_sink *rtp = DOWNCAST_AUDIO(sink);
+    return sc_rtp_sink_stream_push(&rtp->audio, packet);
+}
+
+static void
+sc_rtp_sink_audio_packet_sink_disable(struct sc_packet_sink *sink) {
+    (void) sink;
+    // Nothing to do, the audio stream is just not sent
+}
+
+static bool
+sc_rtp_sink_write_sdp(const struct sc_rtp_sink_params *params) {
+    FILE *file = fopen(params->sdp_filename, "w");
+    if (!file) {
+        LOGE("Could not open SDP file: %s", params->sdp_filename);
+        return false;
+    }
+
+    uint32_t a = params->addr;
+    char addr[16];
+    snprintf(addr, sizeof(addr), "%u.%u.%u.%u", (unsigned) (a >> 24) & 0xFF,
+             (unsigned) (a >> 16) & 0xFF, (unsigned) (a >> 8) & 0xFF,
+             (unsigned) a & 0xFF);
+
+    fprintf(file, "v=0\n"
+                  "o=- 0 0 IN IP4 %s\n"
+                  "s=scrcpy\n"
+                  "c=IN IP4 %s\n"
+                  "t=0 0\n", addr, addr);
+
+    if (params->video) {
+        int pt = SC_RTP_VIDEO_PAYLOAD_TYPE;
+        fprintf(file, "m=video %" PRIu16 " RTP/AVP %d\n", params->port, pt);
+        if (params->video_codec == SC_CODEC_H264) {
+            fprintf(file, "a=rtpmap:%d H264/90000\n"
+                          "a=fmtp:%d packetization-mode=1\n", pt, pt);
+        } else {
+            assert(params->video_codec == SC_CODEC_H265);
+            fprintf(file, "a=rtpmap:%d H265/90000\n", pt);
+        }
+    }
+
+    if (params->audio && params->audio_codec == SC_CODEC_OPUS) {
+        int pt = SC_RTP_AUDIO_PAYLOAD_TYPE;
+        fprintf(file, "m=audio %" PRIu16 " RTP/AVP %d\n"
+                      "a=rtpmap:%d opus/48000/2\n"
+                      "a=fmtp:%d sprop-stereo=1\n",
+                      (uint16_t) (params->port + 2), pt, pt, pt);
+    }
+
+    bool ok = !ferror(file);
+    if (fclose(file) || !ok) {
+        LOGE("Could not write SDP file: %s", params->sdp_filename);
+        return false;
+    }
+
+    LOGI("RTP session description written to %s", params->sdp_filename);
+    return true;
+}
+
+static void
+sc_rtp_sink_stream_init(struct sc_rtp_sink_stream *stream, uint16_t port) {
+    stream->socket = SC_SOCKET_NONE;
+    stream->port = port;
+    stream->packetizer_initialized = false;
+    stream->datagrams = NULL;
+    stream->datagram_cap = 0;
+    stream->send_error_logged = false;
+}
+
+bool
+sc_rtp_sink_init(struct sc_rtp_sink *sink,
+                 const struct sc_rtp_sink_params *params) {
+    if (params->sdp_filename && !sc_rtp_sink_write_sdp(params)) {
+        return false;
+    }
+
+    sink->addr = params->addr;
+    sink->mtu = params->mtu;
+    sc_rtp_sink_stream_init(&sink->video, params->port);
+    sc_rtp_sink_stream_init(&sink->audio, params->port + 2);
+
+    static const struct sc_packet_sink_ops video_ops = {
+        .open = sc_rtp_sink_video_packet_sink_open,
+        .close = sc_rtp_sink_video_packet_sink_close,
+        .push = sc_rtp_sink_video_packet_sink_push,
+    };
+
+    sink->video_packet_sink.ops = &video_ops;
+
+    static const struct sc_packet_sink_ops audio_ops = {
+        .open = sc_rtp_sink_audio_packet_sink_open,
+        .close = sc_rtp_sink_audio_packet_sink_close,
+        .push = sc_rtp_sink_audio_packet_sink_push,
+        .disable = sc_rtp_sink_audio_packet_sink_disable,
+    };
+
+    sink->audio_packet_sink.ops = &audio_ops;
+
+    return true;
+}
+
+void
+sc_rtp_sink_destroy(struct sc_rtp_sink *sink) {
+    // The streams are closed by the demuxers
+    assert(sink->video.socket == SC_SOCKET_NONE);
+    assert(sink->audio.socket == SC_SOCKET_NONE);
+    free(sink->video.datagrams);
+    free(sink->audio.datagrams);
+}
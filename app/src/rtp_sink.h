@@ -0,0 +1,62 @@
+#ifndef SC_RTP_SINK_H
+#define SC_RTP_SINK_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "options.h"
+#include "rtp_packetizer.h"
+#include "trait/packet_sink.h"
+#include "util/net.h"
+
+struct sc_rtp_sink_stream {
+    sc_socket socket; // connected UDP socket, SC_SOCKET_NONE if disabled
+    uint16_t port;
+    struct sc_rtp_packetizer packetizer;
+    bool packetizer_initialized;
+
+    // datagrams to send, pointing to the packetizer buffer
+    struct sc_net_datagram *datagrams;
+    size_t datagram_cap;
+
+    bool send_error_logged;
+};
+
+/**
+ * RTP sender
+ *
+ * The video stream is sent to <addr>:<port> and the audio stream to
+ * <addr>:<port + 2> (the odd ports are left for RTCP).
+ */
+struct sc_rtp_sink {
+    struct sc_packet_sink video_packet_sink;
+    struct sc_packet_sink audio_packet_sink;
+
+    uint32_t addr;
+    uint16_t mtu;
+    struct sc_rtp_sink_stream video;
+    struct sc_rtp_sink_stream audio;
+};
+
+struct sc_rtp_sink_params {
+    uint32_t addr; // IPv4
+    uint16_t port;
+    uint16_t mtu;
+    bool video;
+    enum sc_codec video_codec;
+    bool audio;
+    enum sc_codec audio_codec;
+    const char *sdp_filename; // may be NULL
+};
+
+bool
+sc_rtp_sink_init(struct sc_rtp_sink *sink,
+                 const struct sc_rtp_sink_params *params);
+
+void
+sc_rtp_sink_destroy(struct sc_rtp_sink *sink);
+
+#endif
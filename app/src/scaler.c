@@ -0,0 +1,544 @@
+#include "scaler.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+
+#if defined(__SSE2__)
+# define SC_SCALER_SSE2
+# include <emmintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# define SC_SCALER_NEON
+# include <arm_neon.h>
+#endif
+
+/*
+ * Fixed-point arithmetic
+ *
+ * The weights of each output pixel are in Q14, and their sum is exactly
+ * 1 << 14. The vertical pass outputs values in Q7 (at most 255 << 7, which
+ * fits in an int16_t), and the horizontal pass rounds them to 8 bits:
+ *
+ *     row[x] = (sum(src[k][x] * vw[k]) + (1 << 6)) >> 7
+ *     dst[x] = (sum(row[offset + k] * hw[k]) + (1 << 20)) >> 21
+ *
+ * All the products and sums fit in 32 bits (the weights are not negative),
+ * so the SIMD implementations compute exactly the same values.
+ */
+#define SC_SCALER_WEIGHT_BITS 14
+#define SC_SCALER_ROW_BITS 7
+#define SC_SCALER_OUT_SHIFT (2 * SC_SCALER_WEIGHT_BITS - SC_SCALER_ROW_BITS)
+
+// The horizontal filters are padded with zero weights to a multiple of 4 taps
+#define SC_SCALER_HFILTER_ALIGN 4
+
+static void
+sc_scaler_filter_destroy(struct sc_scaler_filter *filter) {
+    free(filter->offsets);
+    free(filter->weights);
+    filter->offsets = NULL;
+    filter->weights = NULL;
+    filter->size = 0;
+}
+
+// If clamp is true, the taps never exceed the source (the offset is moved
+// back and the weights shifted accordingly). Otherwise, the source must be
+// readable (with any value) up to src + size.
+static bool
+sc_scaler_filter_init(struct sc_scaler_filter *filter, unsigned src,
+                      unsigned dst, unsigned align, bool clamp) {
+    assert(dst && dst <= src);
+
+    // In units of 1/dst source pixel, the output pixel i covers
+    // [i * src, (i + 1) * src) and the source pixel j covers
+    // [j * dst, (j + 1) * dst).
+    unsigned size = 0;
+    for (unsigned i = 0; i < dst; ++i) {
+        uint64_t first = (uint64_t) i * src / dst;
+        uint64_t end = ((uint64_t) (i + 1) * src + dst - 1) / dst;
+        unsigned taps = end - first;
+        if (taps > size) {
+            size = taps;
+        }
+    }
+    size = (size + align - 1) / align * align;
+    assert(!clamp || size <= src);
+
+    filter->offsets = malloc(dst * sizeof(*filter->offsets));
+    filter->weights = calloc((size_t) dst * size, sizeof(*filter->weights));
+    if (!filter->offsets || !filter->weights) {
+        LOG_OOM();
+        sc_scaler_filter_destroy(filter);
+        return false;
+    }
+    filter->size = size;
+
+    for (unsigned i = 0; i < dst; ++i) {
+        uint64_t start = (uint64_t) i * src;
+        uint64_t end = start + src;
+        unsigned first = start / dst;
+        unsigned last = (end + dst - 1) / dst; // exclusive
+
+        unsigned offset = first;
+        if (clamp && offset + size > src) {
+            offset = src - size;
+        }
+        filter->offsets[i] = offset;
+
+        int16_t *weights = &filter->weights[(size_t) i * size];
+
+        // Round the cumulative coverage, so that the sum is exact
+        uint64_t covered = 0;
+        unsigned prev = 0;
+        for (unsigned j = first; j < last; ++j) {
+            uint64_t lo = (uint64_t) j * dst;
+            uint64_t hi = lo + dst;
+            if (lo < start) {
+                lo = start;
+            }
+            if (hi > end) {
+                hi = end;
+            }
+            covered += hi - lo;
+
+            unsigned cur = (covered << SC_SCALER_WEIGHT_BITS) / src;
+            weights[j - offset] = cur - prev;
+            prev = cur;
+        }
+        assert(prev == 1 << SC_SCALER_WEIGHT_BITS);
+    }
+
+    return true;
+}
+
+static bool
+sc_scaler_plane_init(struct sc_scaler_plane *plane, unsigned src_width,
+                     unsigned src_height, unsigned dst_width,
+                     unsigned dst_height) {
+    plane->src_width = src_width;
+    plane->src_height = src_height;
+    plane->dst_width = dst_width;
+    plane->dst_height = dst_height;
+
+    bool ok = sc_scaler_filter_init(&plane->hfilter, src_width, dst_width,
+                                    SC_SCALER_HFILTER_ALIGN, false);
+    if (!ok) {
+        return false;
+    }
+
+    ok = sc_scaler_filter_init(&plane->vfilter, src_height, dst_height, 1,
+                               true);
+    if (!ok) {
+        sc_scaler_filter_destroy(&plane->hfilter);
+        return false;
+    }
+
+    return true;
+}
+
+static void
+sc_scaler_plane_destroy(struct sc_scaler_plane *plane) {
+    sc_scaler_filter_destroy(&plane->hfilter);
+    sc_scaler_filter_destroy(&plane->vfilter);
+}
+
+static void
+sc_scaler_vpass_scalar(const uint8_t *src, ptrdiff_t linesize, unsigned x,
+                       unsigned width, const int16_t *weights,
+                       unsigned taps, int16_t *row) {
+    for (; x < width; ++x) {
+        int32_t acc = 1 << (SC_SCALER_ROW_BITS - 1);
+        for (unsigned k = 0; k < taps; ++k) {
+            acc += src[(ptrdiff_t) k * linesize + x] * weights[k];
+        }
+        row[x] = acc >> SC_SCALER_ROW_BITS;
+    }
+}
+
+static void
+sc_scaler_hpass_scalar(const int16_t *row,
+                       const struct sc_scaler_filter *filter, unsigned x,
+                       unsigned width, uint8_t *dst, const uint8_t *lut) {
+    const int32_t round = 1 << (SC_SCALER_OUT_SHIFT - 1);
+    unsigned size = filter->size;
+
+    for (; x < width; ++x) {
+        const int16_t *p = row + filter->offsets[x];
+        const int16_t *weights = &filter->weights[(size_t) x * size];
+        int32_t acc = round;
+        for (unsigned k = 0; k < size; ++k) {
+            acc += p[k] * weights[k];
+        }
+        // The weights are normalized, the result is at most 255
+        uint8_t value = acc >> SC_SCALER_OUT_SHIFT;
+        dst[x] = lut ? lut[value] : value;
+    }
+}
+
+#ifdef SC_SCALER_SSE2
+static void
+sc_scaler_vpass(const uint8_t *src, ptrdiff_t linesize, unsigned width,
+                const int16_t *weights, unsigned taps, int16_t *row) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(1 << (SC_SCALER_ROW_BITS - 1));
+
+    unsigned x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i lo = round;
+        __m128i hi = round;
+
+        // Two source rows per iteration, interleaved for _mm_madd_epi16()
+        for (unsigned k = 0; k < taps; k += 2) {
+            const uint8_t *p = src + (ptrdiff_t) k * linesize + x;
+            __m128i a = _mm_loadl_epi64((const __m128i *) p);
+            a = _mm_unpacklo_epi8(a, zero);
+
+            __m128i b = zero;
+            uint16_t wb = 0;
+            if (k + 1 < taps) {
+                b = _mm_loadl_epi64((const __m128i *) (p + linesize));
+                b = _mm_unpacklo_epi8(b, zero);
+                wb = weights[k + 1];
+            }
+
+            __m128i w = _mm_set1_epi32((uint32_t) wb << 16
+                                           | (uint16_t) weights[k]);
+            lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w));
+            hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w));
+        }
+
+        lo = _mm_srai_epi32(lo, SC_SCALER_ROW_BITS);
+        hi = _mm_srai_epi32(hi, SC_SCALER_ROW_BITS);
+        _mm_storeu_si128((__m128i *) (row + x), _mm_packs_epi32(lo, hi));
+    }
+
+    sc_scaler_vpass_scalar(src, linesize, x, width, weights, taps, row);
+}
+
+static void
+sc_scaler_hpass(const int16_t *row, const struct sc_scaler_filter *filter,
+                unsigned width, uint8_t *dst, const uint8_t *lut) {
+    const __m128i round = _mm_set1_epi32(1 << (SC_SCALER_OUT_SHIFT - 1));
+    unsigned size = filter->size;
+    assert(!(size % 4));
+
+    unsigned x = 0;
+    for (; x + 4 <= width; x += 4) {
+        const int16_t *p[4];
+        const int16_t *w[4];
+        for (int i = 0; i < 4; ++i) {
+            p[i] = row + filter->offsets[x + i];
+            w[i] = &filter->weights[(size_t) (x + i) * size];
+        }
+
+        // Two output pixels per register (4 taps each)
+        __m128i acc01 = _mm_setzero_si128();
+        __m128i acc23 = _mm_setzero_si128();
+        for (unsigned k = 0; k < size; k += 4) {
+            __m128i p01 = _mm_unpacklo_epi64(
+                    _mm_loadl_epi64((const __m128i *) (p[0] + k)),
+                    _mm_loadl_epi64((const __m128i *) (p[1] + k)));
+            __m128i p23 = _mm_unpacklo_epi64(
+                    _mm_loadl_epi64((const __m128i *) (p[2] + k)),
+                    _mm_loadl_epi64((const __m128i *) (p[3] + k)));
+            __m128i w01 = _mm_unpacklo_epi64(
+                    _mm_loadl_epi64((const __m128i *) (w[0] + k)),
+                    _mm_loadl_epi64((const __m128i *) (w[1] + k)));
+            __m128i w23 = _mm_unpacklo_epi64(
+                    _mm_loadl_epi64((const __m128i *) (w[2] + k)),
+                    _mm_loadl_epi64((const __m128i *) (w[3] + k)));
+            acc01 = _mm_add_epi32(acc01, _mm_madd_epi16(p01, w01));
+            acc23 = _mm_add_epi32(acc23, _mm_madd_epi16(p23, w23));
+        }
+
+        // Sum the two partial sums of each output pixel
+        __m128 a = _mm_castsi128_ps(acc01);
+        __m128 b = _mm_castsi128_ps(acc23);
+        __m128i even = _mm_castps_si128(_mm_shuffle_ps(a, b, 0x88));
+        __m128i odd = _mm_castps_si128(_mm_shuffle_ps(a, b, 0xDD));
+        __m128i sum = _mm_add_epi32(_mm_add_epi32(even, odd), round);
+        sum = _mm_srai_epi32(sum, SC_SCALER_OUT_SHIFT);
+
+        __m128i out = _mm_packs_epi32(sum, sum);
+        out = _mm_packus_epi16(out, out);
+        uint32_t values = _mm_cvtsi128_si32(out);
+        memcpy(&dst[x], &values, 4);
+
+        if (lut) {
+            for (int i = 0; i < 4; ++i) {
+                dst[x + i] = lut[dst[x + i]];
+            }
+        }
+    }
+
+    sc_scaler_hpass_scalar(row, filter, x, width, dst, lut);
+}
+#elif defined(SC_SCALER_NEON)
+static void
+sc_scaler_vpass(const uint8_t *src, ptrdiff_t linesize, unsigned width,
+                const int16_t *weights, unsigned taps, int16_t *row) {
+    unsigned x = 0;
+    for (; x + 8 <= width; x += 8) {
+        int32x4_t lo = vdupq_n_s32(1 << (SC_SCALER_ROW_BITS - 1));
+        int32x4_t hi = lo;
+
+        for (unsigned k = 0; k < taps; ++k) {
+            uint8x8_t p8 = vld1_u8(src + (ptrdiff_t) k * linesize + x);
+            int16x8_t p = vreinterpretq_s16_u16(vmovl_u8(p8));
+            lo = vmlal_n_s16(lo, vget_low_s16(p), weights[k]);
+            hi = vmlal_n_s16(hi, vget_high_s16(p), weights[k]);
+        }
+
+        vst1q_s16(row + x, vcombine_s16(vshrn_n_s32(lo, SC_SCALER_ROW_BITS),
+                                        vshrn_n_s32(hi, SC_SCALER_ROW_BITS)));
+    }
+
+    sc_scaler_vpass_scalar(src, linesize, x, width, weights, taps, row);
+}
+#else
+static void
+sc_scaler_vpass(const uint8_t *src, ptrdiff_t linesize, unsigned width,
+                const int16_t *weights, unsigned taps, int16_t *row) {
+    sc_scaler_vpass_scalar(src, linesize, 0, width, weights, taps, row);
+}
+#endif
+
+#ifndef SC_SCALER_SSE2
+static void
+sc_scaler_hpass(const int16_t *row, const struct sc_scaler_filter *filter,
+                unsigned width, uint8_t *dst, const uint8_t *lut) {
+    sc_scaler_hpass_scalar(row, filter, 0, width, dst, lut);
+}
+#endif
+
+static void
+sc_scaler_scale_plane(const struct sc_scaler_plane *plane, int16_t *row,
+                      const uint8_t *src, int src_linesize, uint8_t *dst,
+                      int dst_linesize, const uint8_t *lut) {
+    const struct sc_scaler_filter *vfilter = &plane->vfilter;
+
+    for (unsigned y = 0; y < plane->dst_height; ++y) {
+        const uint8_t *first = src
+                             + (ptrdiff_t) vfilter->offsets[y] * src_linesize;
+        const int16_t *weights = &vfilter->weights[(size_t) y * vfilter->size];
+        sc_scaler_vpass(first, src_linesize, plane->src_width, weights,
+                        vfilter->size, row);
+        sc_scaler_hpass(row, &plane->hfilter, plane->dst_width,
+                        dst + (ptrdiff_t) y * dst_linesize, lut);
+    }
+}
+
+static inline uint8_t
+sc_scaler_clamp(double value) {
+    return value < 0 ? 0 : value > 255 ? 255 : (uint8_t) (value + 0.5);
+}
+
+void
+sc_scaler_init(struct sc_scaler *scaler) {
+    memset(scaler, 0, sizeof(*scaler));
+
+    for (int i = 0; i < 256; ++i) {
+        scaler->range_luts[0][i] = sc_scaler_clamp((i - 16) * 255.0 / 219);
+        scaler->range_luts[1][i] =
+            sc_scaler_clamp((i - 128) * 255.0 / 224 + 128);
+    }
+}
+
+static void
+sc_scaler_release(struct sc_scaler *scaler) {
+    sc_scaler_plane_destroy(&scaler->luma);
+    sc_scaler_plane_destroy(&scaler->chroma);
+    free(scaler->row);
+    scaler->row = NULL;
+    scaler->src_width = 0;
+    scaler->src_height = 0;
+    scaler->dst_width = 0;
+    scaler->dst_height = 0;
+}
+
+void
+sc_scaler_destroy(struct sc_scaler *scaler) {
+    sc_scaler_release(scaler);
+}
+
+bool
+sc_scaler_prepare(struct sc_scaler *scaler, unsigned src_width,
+                  unsigned src_height, unsigned dst_width,
+                  unsigned dst_height) {
+    assert(dst_width && dst_height);
+    assert(dst_width <= src_width && dst_height <= src_height);
+
+    if (scaler->row && scaler->src_width == src_width
+            && scaler->src_height == src_height
+            && scaler->dst_width == dst_width
+            && scaler->dst_height == dst_height) {
+        // Reuse the filters
+        return true;
+    }
+
+    sc_scaler_release(scaler);
+
+    bool ok = sc_scaler_plane_init(&scaler->luma, src_width, src_height,
+                                   dst_width, dst_height);
+    if (!ok) {
+        return false;
+    }
+
+    ok = sc_scaler_plane_init(&scaler->chroma, (src_width + 1) / 2,
+                              (src_height + 1) / 2, (dst_width + 1) / 2,
+                              (dst_height + 1) / 2);
+    if (!ok) {
+        sc_scaler_plane_destroy(&scaler->luma);
+        return false;
+    }
+
+    // The horizontal filters may read up to size values after the row
+    size_t len = src_width + scaler->luma.hfilter.size;
+    size_t chroma_len = scaler->chroma.src_width + scaler->chroma.hfilter.size;
+    if (chroma_len > len) {
+        len = chroma_len;
+    }
+
+    // Zero-initialized, the padding values are multiplied by zero weights
+    scaler->row = calloc(len, sizeof(*scaler->row));
+    if (!scaler->row) {
+        LOG_OOM();
+        sc_scaler_plane_destroy(&scaler->luma);
+        sc_scaler_plane_destroy(&scaler->chroma);
+        return false;
+    }
+
+    scaler->src_width = src_width;
+    scaler->src_height = src_height;
+    scaler->dst_width = dst_width;
+    scaler->dst_height = dst_height;
+
+    return true;
+}
+
+void
+sc_scaler_scale(const struct sc_scaler *scaler,
+                const struct sc_yuv_image *src, bool full_range,
+                uint8_t *const dst_planes[3], const int dst_linesizes[3]) {
+    assert(scaler->row);
+    assert(src->width == scaler->src_width);
+    assert(src->height == scaler->src_height);
+
+    bool expand = full_range && !src->full_range;
+
+    for (int i = 0; i < 3; ++i) {
+        const struct sc_scaler_plane *plane = i ? &scaler->chroma
+                                                : &scaler->luma;
+        const uint8_t *lut = expand ? scaler->range_luts[i ? 1 : 0] : NULL;
+        sc_scaler_scale_plane(plane, scaler->row, src->planes[i],
+                              src->linesizes[i], dst_planes[i],
+                              dst_linesizes[i], lut);
+    }
+}
+
+void
+sc_scaler_cache_init(struct sc_scaler_cache *cache) {
+    for (size_t i = 0; i < ARRAY_LEN(cache->entries); ++i) {
+        struct sc_scaler_cache_entry *entry = &cache->entries[i];
+        sc_scaler_init(&entry->scaler);
+        entry->data = NULL;
+        entry->last_use = 0;
+    }
+    cache->uses = 0;
+}
+
+void
+sc_scaler_cache_destroy(struct sc_scaler_cache *cache) {
+    for (size_t i = 0; i < ARRAY_LEN(cache->entries); ++i) {
+        struct sc_scaler_cache_entry *entry = &cache->entries[i];
+        sc_scaler_destroy(&entry->scaler);
+        free(entry->data);
+    }
+}
+
+static struct sc_scaler_cache_entry *
+sc_scaler_cache_get(struct sc_scaler_cache *cache, unsigned src_width,
+                    unsigned src_height, unsigned dst_width,
+                    unsigned dst_height) {
+    struct sc_scaler_cache_entry *lru = &cache->entries[0];
+
+    for (size_t i = 0; i < ARRAY_LEN(cache->entries); ++i) {
+        struct sc_scaler_cache_entry *entry = &cache->entries[i];
+        const struct sc_scaler *scaler = &entry->scaler;
+        if (entry->data && scaler->src_width == src_width
+                && scaler->src_height == src_height
+                && scaler->dst_width == dst_width
+                && scaler->dst_height == dst_height) {
+            return entry;
+        }
+
+        // The unused entries have never been used (last_use == 0)
+        if (entry->last_use < lru->last_use) {
+            lru = entry;
+        }
+    }
+
+    free(lru->data);
+    lru->data = NULL;
+    lru->last_use = 0;
+
+    bool ok = sc_scaler_prepare(&lru->scaler, src_width, src_height,
+                                dst_width, dst_height);
+    if (!ok) {
+        return NULL;
+    }
+
+    unsigned chroma_width = (dst_width + 1) / 2;
+    unsigned chroma_height = (dst_height + 1) / 2;
+    size_t luma_size = (size_t) dst_width * dst_height;
+    size_t chroma_size = (size_t) chroma_width * chroma_height;
+
+    lru->data = malloc(luma_size + 2 * chroma_size);
+    if (!lru->data) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    struct sc_yuv_image *image = &lru->image;
+    image->planes[0] = lru->data;
+    image->planes[1] = lru->data + luma_size;
+    image->planes[2] = lru->data + luma_size + chroma_size;
+    image->linesizes[0] = dst_width;
+    image->linesizes[1] = chroma_width;
+    image->linesizes[2] = chroma_width;
+    image->width = dst_width;
+    image->height = dst_height;
+
+    return lru;
+}
+
+const struct sc_yuv_image *
+sc_scaler_cache_scale(struct sc_scaler_cache *cache,
+                      const struct sc_yuv_image *src, unsigned dst_width,
+                      unsigned dst_height) {
+    struct sc_scaler_cache_entry *entry =
+        sc_scaler_cache_get(cache, src->width, src->height, dst_width,
+                            dst_height);
+    if (!entry) {
+        return NULL;
+    }
+
+    entry->last_use = ++cache->uses;
+
+    struct sc_yuv_image *image = &entry->image;
+    image->matrix = src->matrix;
+    image->full_range = src->full_range;
+
+    uint8_t *const planes[3] = {
+        entry->data,
+        entry->data + (image->planes[1] - image->planes[0]),
+        entry->data + (image->planes[2] - image->planes[0]),
+    };
+    sc_scaler_scale(&entry->scaler, src, false, planes, image->linesizes);
+
+    return image;
+}
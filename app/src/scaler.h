@@ -0,0 +1,121 @@
+#ifndef SC_SCALER_H
+#define SC_SCALER_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "yuv2rgb.h"
+
+// Number of sizes kept in a scaler cache
+#define SC_SCALER_CACHE_SIZE 4
+
+/**
+ * Area-averaging downscaler for YUV 4:2:0 planar images
+ *
+ * Each output pixel is the average of the source area it covers, weighted by
+ * the coverage. The filter is separable: each output row is first computed
+ * vertically (at the source width), then horizontally.
+ *
+ * The filter coefficients and the temporary row are computed once per
+ * (source size, destination size); scaling an image does not allocate.
+ */
+
+struct sc_scaler_filter {
+    unsigned size; // number of taps per output pixel
+    unsigned *offsets; // first source pixel, for each output pixel
+    int16_t *weights; // size weights per output pixel, in Q14
+};
+
+struct sc_scaler_plane {
+    unsigned src_width;
+    unsigned src_height;
+    unsigned dst_width;
+    unsigned dst_height;
+    struct sc_scaler_filter hfilter;
+    struct sc_scaler_filter vfilter;
+};
+
+struct sc_scaler {
+    unsigned src_width;
+    unsigned src_height;
+    unsigned dst_width;
+    unsigned dst_height;
+
+    struct sc_scaler_plane luma;
+    struct sc_scaler_plane chroma;
+
+    // Result of the vertical pass, in Q7
+    int16_t *row;
+
+    // Limited to full range conversion tables (Y, then U and V)
+    uint8_t range_luts[2][256];
+};
+
+void
+sc_scaler_init(struct sc_scaler *scaler);
+
+void
+sc_scaler_destroy(struct sc_scaler *scaler);
+
+/**
+ * Prepare the scaler for the given sizes
+ *
+ * The destination must not be larger than the source. Nothing is done if the
+ * sizes did not change.
+ *
+ * Return false on allocation failure (the scaler is then unprepared).
+ */
+bool
+sc_scaler_prepare(struct sc_scaler *scaler, unsigned src_width,
+                  unsigned src_height, unsigned dst_width,
+                  unsigned dst_height);
+
+/**
+ * Scale an image (of the prepared source size) to the destination planes
+ *
+ * If full_range is true and the source is limited range, the values are
+ * expanded to full range. Otherwise, they keep the source range.
+ */
+void
+sc_scaler_scale(const struct sc_scaler *scaler,
+                const struct sc_yuv_image *src, bool full_range,
+                uint8_t *const dst_planes[3], const int dst_linesizes[3]);
+
+/**
+ * Cache of scalers (and their output image) for the last used sizes
+ *
+ * Not thread-safe.
+ */
+struct sc_scaler_cache {
+    struct sc_scaler_cache_entry {
+        struct sc_scaler scaler;
+        uint8_t *data; // the scaled image, NULL if the entry is unused
+        struct sc_yuv_image image;
+        uint64_t last_use;
+    } entries[SC_SCALER_CACHE_SIZE];
+    uint64_t uses;
+};
+
+void
+sc_scaler_cache_init(struct sc_scaler_cache *cache);
+
+void
+sc_scaler_cache_destroy(struct sc_scaler_cache *cache);
+
+/**
+ * Scale an image to dst_width x dst_height, with the scaler cached for these
+ * sizes (the least recently used one is replaced)
+ *
+ * The returned image is owned by the cache, and is valid until the next call.
+ * It keeps the range and the matrix of the source.
+ *
+ * Return NULL on allocation failure.
+ */
+const struct sc_yuv_image *
+sc_scaler_cache_scale(struct sc_scaler_cache *cache,
+                      const struct sc_yuv_image *src, unsigned dst_width,
+                      unsigned dst_height);
+
+#endif
@@ -14,6 +14,7 @@
 # include <windows.h>
 #endif
 
+#include "async_sink.h"
 #include "audio_player.h"
 #include "controller.h"
 #include "decoder.h"
@@ -26,6 +27,7 @@
 #include "recorder.h"
 #include "screen.h"
 #include "server.h"
+#include "stream_dump.h"
 #include "uhid/gamepad_uhid.h"
 #include "uhid/keyboard_uhid.h"
 #include "uhid/mouse_uhid.h"
@@ -38,6 +40,9 @@
 #endif
 #include "util/acksync.h"
 #include "util/log.h"
+#ifdef HAVE_IO_URING
+# include "util/net_uring.h"
+#endif
 #include "util/rand.h"
 #include "util/timeout.h"
 #include "util/tick.h"
@@ -45,6 +50,10 @@
 # include "v4l2_sink.h"
 #endif
 #include "web_server.h"
+#include "web_stream.h"
+#include "hls.h"
+#include "thumbnailer.h"
+#include "rtp_sink.h"
 
 extern struct sc_web_server web_server;
 
@@ -56,11 +65,31 @@ struct scrcpy {
     struct sc_demuxer audio_demuxer;
     struct sc_decoder video_decoder;
     struct sc_decoder audio_decoder;
+    // decouples the frames served by the web server from the video decoder
+    struct sc_async_frame_sink web_frame_queue;
     struct sc_recorder recorder;
+    struct sc_web_stream web_stream;
+    struct sc_hls hls;
+    struct sc_thumbnailer thumbnailer;
+    // decouples the thumbnail encoding from the demuxer thread
+    struct sc_async_packet_sink thumbnailer_queue;
+    struct sc_rtp_sink rtp_sink;
+    struct sc_stream_dump video_dump;
+    struct sc_stream_dump audio_dump;
+    struct sc_stream_dump control_dump;
+    struct sc_stream_replay video_replay;
+    struct sc_stream_replay audio_replay;
+#ifdef HAVE_IO_URING
+    struct sc_net_uring uring;
+    struct sc_net_uring_stream video_uring_stream;
+    struct sc_net_uring_stream audio_uring_stream;
+#endif
     struct sc_delay_buffer video_buffer;
 #ifdef HAVE_V4L2
     struct sc_v4l2_sink v4l2_sink;
     struct sc_delay_buffer v4l2_buffer;
+    // decouples the v4l2 device from the video decoder
+    struct sc_async_frame_sink v4l2_queue;
 #endif
     struct sc_controller controller;
     struct sc_file_pusher file_pusher;
@@ -252,14 +281,40 @@ await_for_server(bool *connected) {
 }
 
 static void
-sc_recorder_on_ended(struct sc_recorder *recorder, bool success,
-                     void *userdata) {
+sc_recorder_on_ended(struct sc_recorder *recorder, unsigned index,
+                     bool success, void *userdata) {
     (void) recorder;
     (void) userdata;
 
-    if (!success) {
-        sc_push_event(SC_EVENT_RECORDER_ERROR);
+    if (success) {
+        return;
+    }
+
+    if (index) {
+        // An additional output (--record-tee) failed, the other recordings
+        // continue
+        LOGW("Additional recording %u stopped, continuing", index);
+        return;
     }
+
+    sc_push_event(SC_EVENT_RECORDER_ERROR);
+}
+
+static void
+sc_hls_on_part(struct sc_hls *hls, void *userdata) {
+    (void) hls;
+    (void) userdata;
+
+    // Answer the pending blocking requests
+    sc_web_server_wakeup(&web_server);
+}
+
+static void
+sc_web_stream_on_data(struct sc_web_stream *stream, void *userdata) {
+    (void) stream;
+    (void) userdata;
+
+    sc_web_server_wakeup(&web_server);
 }
 
 static void
@@ -296,6 +351,51 @@ sc_audio_demuxer_on_ended(struct sc_demuxer *demuxer,
     }
 }
 
+static void
+sc_video_decoder_on_key_frame_needed(struct sc_decoder *decoder,
+                                     void *userdata) {
+    (void) decoder;
+    struct sc_controller *controller = userdata;
+
+    struct sc_control_msg msg;
+    msg.type = SC_CONTROL_MSG_TYPE_RESET_VIDEO;
+
+    if (!sc_controller_push_msg(controller, &msg)) {
+        LOGW("Could not request a key frame");
+    }
+}
+
+// Return an upper bound of the frame rate (0 if unknown), to size the buffers
+static unsigned
+sc_get_max_fps_bound(const char *max_fps) {
+    if (!max_fps) {
+        return 0;
+    }
+
+    // The value is only parsed by the server, ignore it if it is invalid
+    char *endptr;
+    float value = strtof(max_fps, &endptr);
+    if (*endptr || !(value > 0) || value > 1000) {
+        return 0;
+    }
+
+    return (unsigned) value + 1;
+}
+
+static void
+sc_thumbnailer_on_key_frame_needed(struct sc_thumbnailer *thumbnailer,
+                                   void *userdata) {
+    (void) thumbnailer;
+    struct sc_controller *controller = userdata;
+
+    struct sc_control_msg msg;
+    msg.type = SC_CONTROL_MSG_TYPE_RESET_VIDEO;
+
+    if (!sc_controller_push_msg(controller, &msg)) {
+        LOGW("Could not request a key frame");
+    }
+}
+
 static void
 sc_controller_on_ended(struct sc_controller *controller, bool error,
                        void *userdata) {
@@ -389,12 +489,30 @@ scrcpy(struct scrcpy_options *options) {
     enum scrcpy_exit_code ret = SCRCPY_EXIT_FAILURE;
 
     bool server_started = false;
+    bool video_decoder_initialized = false;
+    bool web_frame_queue_initialized = false;
     bool file_pusher_initialized = false;
     bool recorder_initialized = false;
     bool recorder_started = false;
+    bool web_stream_initialized = false;
+    bool hls_initialized = false;
+    bool thumbnailer_initialized = false;
+    bool rtp_sink_initialized = false;
+    bool video_dump_opened = false;
+    bool audio_dump_opened = false;
+    bool control_dump_opened = false;
+    bool video_replay_opened = false;
+    bool audio_replay_opened = false;
+#ifdef HAVE_IO_URING
+    bool uring_initialized = false;
+    bool video_uring_stream_opened = false;
+    bool audio_uring_stream_opened = false;
+#endif
 #ifdef HAVE_V4L2
     bool v4l2_sink_initialized = false;
 #endif
+    bool video_demuxer_initialized = false;
+    bool audio_demuxer_initialized = false;
     bool video_demuxer_started = false;
     bool audio_demuxer_started = false;
 #ifdef HAVE_USB
@@ -462,6 +580,7 @@ scrcpy(struct scrcpy_options *options) {
         .cleanup = options->cleanup,
         .power_on = options->power_on,
         .kill_adb_on_close = options->kill_adb_on_close,
+        .no_adb = options->no_adb,
         .camera_high_speed = options->camera_high_speed,
         .vd_destroy_content = options->vd_destroy_content,
         .vd_system_decorations = options->vd_system_decorations,
@@ -483,7 +602,10 @@ scrcpy(struct scrcpy_options *options) {
         sdl_set_hints(options->render_driver);
     }
 
-    if (!sc_server_start(&s->server)) {
+    // On replay, the streams are read from the dump files, there is no device
+    bool replay = options->replay_streams_dir;
+
+    if (!replay && !sc_server_start(&s->server)) {
         goto end;
     }    // Initialize web server with configured address and port
     char web_server_addr[128];
@@ -492,7 +614,7 @@ scrcpy(struct scrcpy_options *options) {
     sc_web_server_init(&web_server, web_server_addr);
     sc_web_server_start(&web_server);
 
-    server_started = true;
+    server_started = !replay;
 
     if (options->list) {
         bool ok = await_for_server(NULL);
@@ -537,31 +659,34 @@ scrcpy(struct scrcpy_options *options) {
 
     sdl_configure(options->video_playback, options->disable_screensaver);
 
-    // Await for server without blocking Ctrl+C handling
-    bool connected;
-    if (!await_for_server(&connected)) {
-        LOGE("Server connection failed");
-        goto end;
-    }
+    if (!replay) {
+        // Await for server without blocking Ctrl+C handling
+        bool connected;
+        if (!await_for_server(&connected)) {
+            LOGE("Server connection failed");
+            goto end;
+        }
 
-    if (!connected) {
-        // This is not an error, user requested to quit
-        LOGD("User requested to quit");
-        ret = SCRCPY_EXIT_SUCCESS;
-        goto end;
-    }
+        if (!connected) {
+            // This is not an error, user requested to quit
+            LOGD("User requested to quit");
+            ret = SCRCPY_EXIT_SUCCESS;
+            goto end;
+        }
 
-    LOGD("Server connected");
+        LOGD("Server connected");
+    }
 
-    // It is necessarily initialized here, since the device is connected
-    struct sc_server_info *info = &s->server.info;
+    // It is necessarily initialized here if the device is connected
+    struct sc_server_info *info = replay ? NULL : &s->server.info;
 
     const char *serial = s->server.serial;
-    assert(serial);
+    assert(replay || serial);
 
     struct sc_file_pusher *fp = NULL;
 
-    if (options->video_playback && options->control) {
+    // The files are pushed through adb
+    if (options->video_playback && options->control && !options->no_adb) {
         if (!sc_file_pusher_init(&s->file_pusher, serial,
                                  options->push_target)) {
             goto end;
@@ -570,31 +695,108 @@ scrcpy(struct scrcpy_options *options) {
         file_pusher_initialized = true;
     }
 
+    // Shared by all the streams, to capture or replay them in sync
+    sc_tick dump_start = sc_tick_now();
+    const char *replay_dir = options->replay_streams_dir;
+    const char *dump_dir = options->dump_streams_dir;
+    bool realtime = !options->replay_fast;
+
     if (options->video) {
         static const struct sc_demuxer_callbacks video_demuxer_cbs = {
             .on_ended = sc_video_demuxer_on_ended,
         };
-        sc_demuxer_init(&s->video_demuxer, "video", s->server.video_socket,
-                        &video_demuxer_cbs, NULL);
+        if (replay) {
+            if (!sc_stream_replay_open(&s->video_replay, replay_dir, "video",
+                                       realtime, dump_start)) {
+                LOGE("No video stream dump in %s (try with --no-video)",
+                     replay_dir);
+                goto end;
+            }
+            video_replay_opened = true;
+            sc_demuxer_init_replay(&s->video_demuxer, "video",
+                                   &s->video_replay, &video_demuxer_cbs, NULL);
+        } else {
+            sc_demuxer_init(&s->video_demuxer, "video", s->server.video_socket,
+                            &video_demuxer_cbs, NULL);
+        }
+        video_demuxer_initialized = true;
+        s->video_demuxer.decoder_threads = options->decoder_threads;
+        s->video_demuxer.decoder_thread_type = options->decoder_thread_type;
+
+        if (dump_dir) {
+            if (!sc_stream_dump_open(&s->video_dump, dump_dir, "video",
+                                     dump_start)) {
+                goto end;
+            }
+            video_dump_opened = true;
+            s->video_demuxer.dump = &s->video_dump;
+        }
     }
 
     if (options->audio) {
         static const struct sc_demuxer_callbacks audio_demuxer_cbs = {
             .on_ended = sc_audio_demuxer_on_ended,
         };
-        sc_demuxer_init(&s->audio_demuxer, "audio", s->server.audio_socket,
-                        &audio_demuxer_cbs, options);
+        if (replay) {
+            if (!sc_stream_replay_open(&s->audio_replay, replay_dir, "audio",
+                                       realtime, dump_start)) {
+                LOGE("No audio stream dump in %s (try with --no-audio)",
+                     replay_dir);
+                goto end;
+            }
+            audio_replay_opened = true;
+            sc_demuxer_init_replay(&s->audio_demuxer, "audio",
+                                   &s->audio_replay, &audio_demuxer_cbs,
+                                   options);
+        } else {
+            sc_demuxer_init(&s->audio_demuxer, "audio", s->server.audio_socket,
+                            &audio_demuxer_cbs, options);
+        }
+        audio_demuxer_initialized = true;
+
+        if (dump_dir) {
+            if (!sc_stream_dump_open(&s->audio_dump, dump_dir, "audio",
+                                     dump_start)) {
+                goto end;
+            }
+            audio_dump_opened = true;
+            s->audio_demuxer.dump = &s->audio_dump;
+        }
     }
 
+    unsigned max_fps = sc_get_max_fps_bound(options->max_fps);
+
     bool needs_video_decoder = options->video_playback;
     bool needs_audio_decoder = options->audio_playback;
 #ifdef HAVE_V4L2
     needs_video_decoder |= !!options->v4l2_device;
 #endif
+    // Sinks of the video demuxer: decoder, recorder, web stream, HLS and RTP
+    // (the thumbnailer is attached at runtime)
+    static_assert(SC_PACKET_SOURCE_MAX_SINKS >= 5,
+                  "Too many sinks for the video demuxer");
+
     if (needs_video_decoder) {
         sc_decoder_init(&s->video_decoder, "video");
+        video_decoder_initialized = true;
         sc_packet_source_add_sink(&s->video_demuxer.packet_source,
                                   &s->video_decoder.packet_sink);
+        sc_web_server_set_video_decoder(&web_server, &s->video_decoder);
+
+        // Keep the latest frame for the web server, without contending with
+        // the /frame requests on the decoder thread
+        sc_async_frame_sink_init(&s->web_frame_queue, "web-frame",
+                                 SC_ASYNC_FRAME_POLICY_LATEST, 0);
+        sc_frame_source_add_sink(&s->web_frame_queue.frame_source,
+                                 &web_server.frame_sink);
+        web_frame_queue_initialized = true;
+        // Attached rather than added: if it fails, the stream continues
+        // without frames for the web server
+        if (!sc_frame_source_attach_sink(&s->video_decoder.frame_source,
+                                         &s->web_frame_queue.frame_sink)) {
+            goto end;
+        }
+        sc_web_server_set_frame_queue(&web_server, &s->web_frame_queue);
     }
     if (needs_audio_decoder) {
         sc_decoder_init(&s->audio_decoder, "audio");
@@ -614,6 +816,16 @@ scrcpy(struct scrcpy_options *options) {
         }
         recorder_initialized = true;
 
+        for (unsigned i = 0; i < options->record_tee_count; ++i) {
+            const struct sc_record_tee *tee = &options->record_tees[i];
+            bool video = tee->streams != SC_RECORD_STREAMS_AUDIO;
+            bool audio = tee->streams != SC_RECORD_STREAMS_VIDEO;
+            if (!sc_recorder_add_output(&s->recorder, tee->filename,
+                                        tee->format, video, audio)) {
+                goto end;
+            }
+        }
+
         if (!sc_recorder_start(&s->recorder)) {
             goto end;
         }
@@ -629,6 +841,100 @@ scrcpy(struct scrcpy_options *options) {
         }
     }
 
+    if (options->video) {
+        // Live stream served over HTTP by the web server
+        static const struct sc_web_stream_callbacks web_stream_cbs = {
+            .on_data = sc_web_stream_on_data,
+        };
+        if (!sc_web_stream_init(&s->web_stream, &web_stream_cbs, NULL)) {
+            goto end;
+        }
+        web_stream_initialized = true;
+
+        sc_packet_source_add_sink(&s->video_demuxer.packet_source,
+                                  &s->web_stream.video_packet_sink);
+        if (options->audio) {
+            sc_packet_source_add_sink(&s->audio_demuxer.packet_source,
+                                      &s->web_stream.audio_packet_sink);
+        }
+
+        sc_web_server_set_stream(&web_server, &s->web_stream);
+    }
+
+    if (options->video && options->web_server_hls) {
+        static const struct sc_hls_callbacks hls_cbs = {
+            .on_part = sc_hls_on_part,
+        };
+        if (!sc_hls_init(&s->hls, &hls_cbs, NULL)) {
+            goto end;
+        }
+        hls_initialized = true;
+
+        sc_packet_source_add_sink(&s->video_demuxer.packet_source,
+                                  &s->hls.video_packet_sink);
+        if (options->audio) {
+            sc_packet_source_add_sink(&s->audio_demuxer.packet_source,
+                                      &s->hls.audio_packet_sink);
+        }
+
+        sc_web_server_set_hls(&web_server, &s->hls);
+    }
+
+    if (options->web_server_thumbnail) {
+        assert(options->video);
+        static const struct sc_thumbnailer_callbacks thumbnailer_cbs = {
+            .on_key_frame_needed = sc_thumbnailer_on_key_frame_needed,
+        };
+        if (!sc_thumbnailer_init(&s->thumbnailer,
+                                 options->web_server_thumbnail_interval,
+                                 &thumbnailer_cbs, &s->controller)) {
+            goto end;
+        }
+        thumbnailer_initialized = true;
+
+        // Decoding and encoding a thumbnail takes time, do not delay the
+        // other sinks of the video stream
+        sc_async_packet_sink_init(&s->thumbnailer_queue, "thumbnailer",
+                                  SC_THUMBNAILER_QUEUE_CAPACITY);
+        sc_packet_source_add_sink(&s->thumbnailer_queue.packet_source,
+                                  &s->thumbnailer.packet_sink);
+        // Attached rather than added: if the thumbnails fail, the stream
+        // continues without them
+        if (!sc_packet_source_attach_sink(&s->video_demuxer.packet_source,
+                                          &s->thumbnailer_queue.packet_sink)) {
+            goto end;
+        }
+
+        sc_web_server_set_thumbnailer(&web_server, &s->thumbnailer);
+        sc_web_server_set_thumbnailer_queue(&web_server, &s->thumbnailer_queue);
+    }
+
+    if (options->rtp_port) {
+        struct sc_rtp_sink_params rtp_params = {
+            .addr = options->rtp_host,
+            .port = options->rtp_port,
+            .mtu = options->rtp_mtu,
+            .video = options->video,
+            .video_codec = options->video_codec,
+            .audio = options->audio,
+            .audio_codec = options->audio_codec,
+            .sdp_filename = options->rtp_sdp_filename,
+        };
+        if (!sc_rtp_sink_init(&s->rtp_sink, &rtp_params)) {
+            goto end;
+        }
+        rtp_sink_initialized = true;
+
+        if (options->video) {
+            sc_packet_source_add_sink(&s->video_demuxer.packet_source,
+                                      &s->rtp_sink.video_packet_sink);
+        }
+        if (options->audio) {
+            sc_packet_source_add_sink(&s->audio_demuxer.packet_source,
+                                      &s->rtp_sink.audio_packet_sink);
+        }
+    }
+
     struct sc_controller *controller = NULL;
     struct sc_key_processor *kp = NULL;
     struct sc_mouse_processor *mp = NULL;
@@ -645,8 +951,28 @@ scrcpy(struct scrcpy_options *options) {
         }
         controller_initialized = true;
 
+        if (dump_dir) {
+            if (!sc_stream_dump_open(&s->control_dump, dump_dir, "control",
+                                     dump_start)) {
+                goto end;
+            }
+            control_dump_opened = true;
+            s->controller.receiver.dump = &s->control_dump;
+        }
+
         controller = &s->controller;
 
+        if (needs_video_decoder) {
+            // A new key frame can be requested, so the video may be decoded
+            // only when there is a frame consumer, and recover quickly from
+            // decoding errors
+            static const struct sc_decoder_callbacks video_decoder_cbs = {
+                .on_key_frame_needed = sc_video_decoder_on_key_frame_needed,
+            };
+            sc_decoder_set_callbacks(&s->video_decoder, &video_decoder_cbs,
+                                     &s->controller);
+        }
+
 #ifdef HAVE_USB
         bool use_keyboard_aoa =
             options->keyboard_input_mode == SC_KEYBOARD_INPUT_MODE_AOA;
@@ -797,10 +1123,12 @@ aoa_complete:
 
     if (options->window) {
         const char *window_title =
-            options->window_title ? options->window_title : info->device_name;
+            options->window_title ? options->window_title
+                                  : info ? info->device_name : "scrcpy";
 
         struct sc_screen_params screen_params = {
             .video = options->video_playback,
+            .decoder = options->video_playback ? &s->video_decoder : NULL,
             .controller = controller,
             .fp = fp,
             .kp = kp,
@@ -819,6 +1147,7 @@ aoa_complete:
             .window_borderless = options->window_borderless,
             .orientation = options->display_orientation,
             .mipmaps = options->mipmaps,
+            .vsync = options->vsync,
             .fullscreen = options->fullscreen,
             .start_fps_counter = options->start_fps_counter,
         };
@@ -830,14 +1159,28 @@ aoa_complete:
 
         if (options->video_playback) {
             struct sc_frame_source *src = &s->video_decoder.frame_source;
-            if (options->video_buffer) {
-                sc_delay_buffer_init(&s->video_buffer,
-                                     options->video_buffer, true);
+            if (options->video_buffer_max) {
+                sc_delay_buffer_init_adaptive(&s->video_buffer,
+                                              options->video_buffer,
+                                              options->video_buffer_max,
+                                              max_fps, true);
+            } else if (options->video_buffer) {
+                sc_delay_buffer_init(&s->video_buffer, options->video_buffer,
+                                     max_fps, true);
+            }
+            if (options->video_buffer || options->video_buffer_max) {
                 sc_frame_source_add_sink(src, &s->video_buffer.frame_sink);
                 src = &s->video_buffer.frame_source;
+                sc_web_server_set_video_buffer(&web_server, &s->video_buffer);
             }
 
             sc_frame_source_add_sink(src, &s->screen.frame_sink);
+            sc_web_server_set_fps_counter(&web_server, &s->screen.fps_counter);
+
+            if (options->vsync) {
+                sc_web_server_set_vsync_scheduler(&web_server,
+                                                  &s->screen.vsync_scheduler);
+            }
         }
     }
 
@@ -854,14 +1197,29 @@ aoa_complete:
             goto end;
         }
 
+        // Push the frames to the v4l2 sink (and its delay buffer) from a
+        // separate thread, so that they never delay the screen. Keep them in
+        // order for the delay buffer, otherwise only the latest one.
         struct sc_frame_source *src = &s->video_decoder.frame_source;
+        enum sc_async_frame_policy policy = options->v4l2_buffer
+                                          ? SC_ASYNC_FRAME_POLICY_FIFO
+                                          : SC_ASYNC_FRAME_POLICY_LATEST;
+        sc_async_frame_sink_init(&s->v4l2_queue, "v4l2", policy,
+                                 SC_V4L2_QUEUE_CAPACITY);
+        sc_frame_source_add_sink(src, &s->v4l2_queue.frame_sink);
+        src = &s->v4l2_queue.frame_source;
+        sc_web_server_set_v4l2_queue(&web_server, &s->v4l2_queue);
+
         if (options->v4l2_buffer) {
-            sc_delay_buffer_init(&s->v4l2_buffer, options->v4l2_buffer, true);
+            sc_delay_buffer_init(&s->v4l2_buffer, options->v4l2_buffer,
+                                 max_fps, true);
             sc_frame_source_add_sink(src, &s->v4l2_buffer.frame_sink);
             src = &s->v4l2_buffer.frame_source;
         }
 
         sc_frame_source_add_sink(src, &s->v4l2_sink.frame_sink);
+        // The v4l2 device always consumes the frames
+        sc_decoder_add_consumer(&s->video_decoder);
 
         v4l2_sink_initialized = true;
     }
@@ -870,6 +1228,31 @@ aoa_complete:
     // Now that the header values have been consumed, the socket(s) will
     // receive the stream(s). Start the demuxer(s).
 
+#ifdef HAVE_IO_URING
+    if (!replay && (options->video || options->audio)) {
+        // On failure, fall back to blocking reads on the demuxer threads
+        uring_initialized = sc_net_uring_init(&s->uring);
+    }
+
+    if (uring_initialized && options->video) {
+        video_uring_stream_opened =
+            sc_net_uring_stream_open(&s->video_uring_stream, &s->uring,
+                                     s->server.video_socket);
+        if (video_uring_stream_opened) {
+            s->video_demuxer.uring_stream = &s->video_uring_stream;
+        }
+    }
+
+    if (uring_initialized && options->audio) {
+        audio_uring_stream_opened =
+            sc_net_uring_stream_open(&s->audio_uring_stream, &s->uring,
+                                     s->server.audio_socket);
+        if (audio_uring_stream_opened) {
+            s->audio_demuxer.uring_stream = &s->audio_uring_stream;
+        }
+    }
+#endif
+
     if (options->video) {
         if (!sc_demuxer_start(&s->video_demuxer)) {
             goto end;
@@ -998,6 +1381,13 @@ end:
         sc_server_stop(&s->server);
     }
 
+    if (video_replay_opened) {
+        sc_stream_replay_interrupt(&s->video_replay);
+    }
+    if (audio_replay_opened) {
+        sc_stream_replay_interrupt(&s->audio_replay);
+    }
+
     if (timeout_started) {
         sc_timeout_join(&s->timeout);
     }
@@ -1015,8 +1405,79 @@ end:
         sc_demuxer_join(&s->audio_demuxer);
     }
 
+    if (video_demuxer_initialized) {
+        sc_demuxer_destroy(&s->video_demuxer);
+    }
+
+    // The decoder thread (the video demuxer thread) is terminated
+    if (video_decoder_initialized) {
+        sc_decoder_destroy(&s->video_decoder);
+    }
+    if (web_frame_queue_initialized) {
+        sc_web_server_set_frame_queue(&web_server, NULL);
+        sc_async_frame_sink_destroy(&s->web_frame_queue);
+    }
+
+    if (audio_demuxer_initialized) {
+        sc_demuxer_destroy(&s->audio_demuxer);
+    }
+
+#ifdef HAVE_IO_URING
+    if (video_uring_stream_opened) {
+        sc_net_uring_stream_close(&s->video_uring_stream);
+    }
+    if (audio_uring_stream_opened) {
+        sc_net_uring_stream_close(&s->audio_uring_stream);
+    }
+    if (uring_initialized) {
+        sc_net_uring_destroy(&s->uring);
+    }
+#endif
+
+    if (video_replay_opened) {
+        sc_stream_replay_close(&s->video_replay);
+    }
+    if (audio_replay_opened) {
+        sc_stream_replay_close(&s->audio_replay);
+    }
+    if (video_dump_opened) {
+        sc_stream_dump_close(&s->video_dump);
+    }
+    if (audio_dump_opened) {
+        sc_stream_dump_close(&s->audio_dump);
+    }
+
+    if (web_stream_initialized || hls_initialized || thumbnailer_initialized) {
+        // The web server thread may still reference the stream clients and
+        // the HLS segments
+        sc_web_server_stop(&web_server);
+    }
+
+    if (web_stream_initialized) {
+        sc_web_server_set_stream(&web_server, NULL);
+        sc_web_stream_destroy(&s->web_stream);
+    }
+
+    if (hls_initialized) {
+        sc_web_server_set_hls(&web_server, NULL);
+        sc_hls_destroy(&s->hls);
+    }
+
+    if (thumbnailer_initialized) {
+        sc_web_server_set_thumbnailer(&web_server, NULL);
+        sc_web_server_set_thumbnailer_queue(&web_server, NULL);
+        sc_async_packet_sink_destroy(&s->thumbnailer_queue);
+        sc_thumbnailer_destroy(&s->thumbnailer);
+    }
+
+    if (rtp_sink_initialized) {
+        sc_rtp_sink_destroy(&s->rtp_sink);
+    }
+
 #ifdef HAVE_V4L2
     if (v4l2_sink_initialized) {
+        sc_web_server_set_v4l2_queue(&web_server, NULL);
+        sc_async_frame_sink_destroy(&s->v4l2_queue);
         sc_v4l2_sink_destroy(&s->v4l2_sink);
     }
 #endif
@@ -1046,6 +1507,10 @@ end:
         sc_controller_destroy(&s->controller);
     }
 
+    if (control_dump_opened) {
+        sc_stream_dump_close(&s->control_dump);
+    }
+
     if (recorder_started) {
         sc_recorder_join(&s->recorder);
     }
@@ -13,8 +13,6 @@
 
 #define DOWNCAST(SINK) container_of(SINK, struct sc_screen, frame_sink)
 
-extern struct sc_web_server web_server;
-
 static inline struct sc_size
 get_oriented_size(struct sc_size size, enum sc_orientation orientation) {
     struct sc_size oriented_size;
@@ -171,6 +169,7 @@ sc_screen_update_content_rect(struct sc_screen *screen) {
     int dw;
     int dh;
     SDL_GL_GetDrawableSize(screen->window, &dw, &dh);
+    screen->empty = dw <= 0 || dh <= 0;
 
     struct sc_size content_size = screen->content_size;
     // The drawable size is the window size * the HiDPI scale
@@ -203,6 +202,16 @@ sc_screen_update_content_rect(struct sc_screen *screen) {
     }
 }
 
+// Return false if the window content cannot be seen, so that uploading and
+// rendering the frames would be useless
+//
+// SDL 2 does not report occlusion by other windows, only the minimized and
+// hidden states and the drawable size are tracked.
+static inline bool
+sc_screen_is_visible(struct sc_screen *screen) {
+    return !screen->minimized && !screen->hidden && !screen->empty;
+}
+
 // render the texture to the renderer
 //
 // Set the update_content_rect flag if the window or content size may have
@@ -215,6 +224,10 @@ sc_screen_render(struct sc_screen *screen, bool update_content_rect) {
         sc_screen_update_content_rect(screen);
     }
 
+    if (!sc_screen_is_visible(screen)) {
+        return;
+    }
+
     enum sc_display_result res =
         sc_display_render(&screen->display, &screen->rect, screen->orientation);
     (void) res; // any error already logged
@@ -303,6 +316,12 @@ sc_screen_frame_sink_push(struct sc_frame_sink *sink, const AVFrame *frame) {
     struct sc_screen *screen = DOWNCAST(sink);
     assert(screen->video);
 
+    if (sc_frame_is_unchanged(frame)) {
+        // The previous frame (pending or already displayed) has the same
+        // content: no texture upload, no render
+        return true;
+    }
+
     bool previous_skipped;
     bool ok = sc_frame_buffer_push(&screen->fb, frame, &previous_skipped);
     if (!ok) {
@@ -311,6 +330,13 @@ sc_screen_frame_sink_push(struct sc_frame_sink *sink, const AVFrame *frame) {
 
     if (previous_skipped) {
         sc_fps_counter_add_skipped_frame(&screen->fps_counter);
+    }
+
+    if (screen->vsync) {
+        // The scheduler will post SC_EVENT_NEW_FRAME before the next vblank
+        sc_vsync_scheduler_notify_frame(&screen->vsync_scheduler,
+                                        previous_skipped);
+    } else if (previous_skipped) {
         // The SC_EVENT_NEW_FRAME triggered for the previous frame will consume
         // this new frame instead
     } else {
@@ -324,6 +350,53 @@ sc_screen_frame_sink_push(struct sc_frame_sink *sink, const AVFrame *frame) {
     return true;
 }
 
+static void
+sc_screen_on_present(struct sc_vsync_scheduler *scheduler, void *userdata) {
+    (void) scheduler;
+    (void) userdata;
+
+    // Consume and render the latest frame on the UI thread
+    bool ok = sc_push_event(SC_EVENT_NEW_FRAME);
+    (void) ok; // any error already logged
+}
+
+// Synchronize the presentation with the refresh rate of the display containing
+// the window
+static void
+sc_screen_update_refresh_rate(struct sc_screen *screen) {
+    if (!screen->vsync) {
+        return;
+    }
+
+    unsigned refresh_rate = SC_VSYNC_DEFAULT_REFRESH_RATE;
+
+    int index = SDL_GetWindowDisplayIndex(screen->window);
+    SDL_DisplayMode mode;
+    if (index >= 0 && !SDL_GetCurrentDisplayMode(index, &mode)
+            && mode.refresh_rate > 0) {
+        refresh_rate = mode.refresh_rate;
+    } else {
+        LOGD("Unknown display refresh rate, assuming %u Hz", refresh_rate);
+    }
+
+    sc_vsync_scheduler_set_refresh_rate(&screen->vsync_scheduler,
+                                        refresh_rate);
+}
+
+static void
+sc_screen_set_consuming(struct sc_screen *screen, bool consuming) {
+    if (!screen->decoder || screen->consuming == consuming) {
+        return;
+    }
+
+    if (consuming) {
+        sc_decoder_add_consumer(screen->decoder);
+    } else {
+        sc_decoder_remove_consumer(screen->decoder);
+    }
+    screen->consuming = consuming;
+}
+
 bool
 sc_screen_init(struct sc_screen *screen,
                const struct sc_screen_params *params) {
@@ -332,11 +405,17 @@ sc_screen_init(struct sc_screen *screen,
     screen->fullscreen = false;
     screen->maximized = false;
     screen->minimized = false;
+    screen->hidden = false;
+    screen->empty = false;
+    screen->frame_pending = false;
+    screen->frame_push_date = 0;
     screen->paused = false;
     screen->resume_frame = NULL;
     screen->orientation = SC_ORIENTATION_0;
 
     screen->video = params->video;
+    screen->decoder = params->decoder;
+    screen->consuming = false;
 
     screen->req.x = params->window_x;
     screen->req.y = params->window_y;
@@ -350,8 +429,18 @@ sc_screen_init(struct sc_screen *screen,
         return false;
     }
 
-    if (!sc_fps_counter_init(&screen->fps_counter)) {
-        goto error_destroy_frame_buffer;
+    sc_fps_counter_init(&screen->fps_counter);
+
+    screen->vsync = params->video && params->vsync;
+    if (screen->vsync) {
+        static const struct sc_vsync_scheduler_callbacks cbs = {
+            .on_present = sc_screen_on_present,
+        };
+
+        ok = sc_vsync_scheduler_init(&screen->vsync_scheduler, &cbs, NULL);
+        if (!ok) {
+            goto error_destroy_frame_buffer;
+        }
     }
 
     if (screen->video) {
@@ -399,7 +488,7 @@ sc_screen_init(struct sc_screen *screen,
     screen->window = SDL_CreateWindow(title, x, y, width, height, window_flags);
     if (!screen->window) {
         LOGE("Could not create window: %s", SDL_GetError());
-        goto error_destroy_fps_counter;
+        goto error_destroy_vsync_scheduler;
     }
 
     SDL_Surface *icon = scrcpy_icon_load();
@@ -411,13 +500,13 @@ sc_screen_init(struct sc_screen *screen,
     } else {
         // without video, the icon is used as window content, it must be present
         LOGE("Could not load icon");
-        goto error_destroy_fps_counter;
+        goto error_destroy_window;
     }
 
     SDL_Surface *icon_novideo = params->video ? NULL : icon;
     bool mipmaps = params->video && params->mipmaps;
     ok = sc_display_init(&screen->display, screen->window, icon_novideo,
-                         mipmaps);
+                         mipmaps, screen->vsync);
     if (icon) {
         scrcpy_icon_destroy(icon);
     }
@@ -431,6 +520,14 @@ sc_screen_init(struct sc_screen *screen,
         goto error_destroy_display;
     }
 
+    if (screen->vsync) {
+        sc_screen_update_refresh_rate(screen);
+        ok = sc_vsync_scheduler_start(&screen->vsync_scheduler);
+        if (!ok) {
+            goto error_free_frame;
+        }
+    }
+
     struct sc_input_manager_params im_params = {
         .controller = params->controller,
         .fp = params->fp,
@@ -467,6 +564,11 @@ sc_screen_init(struct sc_screen *screen,
     screen->open = false;
 #endif
 
+    if (screen->video) {
+        // The window is shown on the first frame
+        sc_screen_set_consuming(screen, true);
+    }
+
     if (!screen->video && sc_screen_is_relative_mode(screen)) {
         // Capture mouse immediately if video mirroring is disabled
         sc_mouse_capture_set_active(&screen->mc, true);
@@ -474,12 +576,16 @@ sc_screen_init(struct sc_screen *screen,
 
     return true;
 
+error_free_frame:
+    av_frame_free(&screen->frame);
 error_destroy_display:
     sc_display_destroy(&screen->display);
 error_destroy_window:
     SDL_DestroyWindow(screen->window);
-error_destroy_fps_counter:
-    sc_fps_counter_destroy(&screen->fps_counter);
+error_destroy_vsync_scheduler:
+    if (screen->vsync) {
+        sc_vsync_scheduler_destroy(&screen->vsync_scheduler);
+    }
 error_destroy_frame_buffer:
     sc_frame_buffer_destroy(&screen->fb);
 
@@ -519,12 +625,16 @@ sc_screen_hide_window(struct sc_screen *screen) {
 
 void
 sc_screen_interrupt(struct sc_screen *screen) {
-    sc_fps_counter_interrupt(&screen->fps_counter);
+    if (screen->vsync) {
+        sc_vsync_scheduler_stop(&screen->vsync_scheduler);
+    }
 }
 
 void
 sc_screen_join(struct sc_screen *screen) {
-    sc_fps_counter_join(&screen->fps_counter);
+    if (screen->vsync) {
+        sc_vsync_scheduler_join(&screen->vsync_scheduler);
+    }
 }
 
 void
@@ -533,9 +643,12 @@ sc_screen_destroy(struct sc_screen *screen) {
     assert(!screen->open);
 #endif
     sc_display_destroy(&screen->display);
+    sc_screen_set_consuming(screen, false);
     av_frame_free(&screen->frame);
     SDL_DestroyWindow(screen->window);
-    sc_fps_counter_destroy(&screen->fps_counter);
+    if (screen->vsync) {
+        sc_vsync_scheduler_destroy(&screen->vsync_scheduler);
+    }
     sc_frame_buffer_destroy(&screen->fb);
 }
 
@@ -647,6 +760,18 @@ static bool
 sc_screen_apply_frame(struct sc_screen *screen) {
     assert(screen->video);
 
+    // The very first frame is always applied, it shows the window
+    if (screen->has_frame && !sc_screen_is_visible(screen)) {
+        // Do not upload a frame nobody can see: only the latest one will be
+        // uploaded once visible
+        sc_fps_counter_add_invisible_frame(&screen->fps_counter);
+        screen->frame_pending = true;
+        // Not presented now, its latency is not meaningful
+        screen->frame_push_date = 0;
+        return true;
+    }
+
+    screen->frame_pending = false;
     sc_fps_counter_add_rendered_frame(&screen->fps_counter);
 
     AVFrame *frame = screen->frame;
@@ -660,9 +785,6 @@ sc_screen_apply_frame(struct sc_screen *screen) {
         return true;
     }
 
-    // Update web server frame
-    sc_web_server_set_frame(&web_server, screen->frame);
-
     res = sc_display_update_texture(&screen->display, frame);
     if (res == SC_DISPLAY_RESULT_ERROR) {
         return false;
@@ -684,9 +806,29 @@ sc_screen_apply_frame(struct sc_screen *screen) {
     } 
 
     sc_screen_render(screen, false);
+    if (screen->vsync) {
+        sc_vsync_scheduler_on_presented(&screen->vsync_scheduler);
+    }
+
+    if (screen->frame_push_date) {
+        sc_tick latency = sc_tick_now() - screen->frame_push_date;
+        sc_fps_counter_add_latency(&screen->fps_counter, latency);
+        screen->frame_push_date = 0;
+    }
     return true;
 }
 
+// Upload the latest frame received while the window was not visible, if any
+static bool
+sc_screen_apply_pending_frame(struct sc_screen *screen) {
+    if (!screen->frame_pending || !sc_screen_is_visible(screen)) {
+        return true;
+    }
+
+    LOGD("Window visible again, applying the latest frame");
+    return sc_screen_apply_frame(screen);
+}
+
 static bool
 sc_screen_update_frame(struct sc_screen *screen) {
     assert(screen->video);
@@ -708,6 +850,7 @@ sc_screen_update_frame(struct sc_screen *screen) {
 
     av_frame_unref(screen->frame);
     sc_frame_buffer_consume(&screen->fb, screen->frame);
+    screen->frame_push_date = screen->fb.consumed_push_date;
     
     return sc_screen_apply_frame(screen);
 }
@@ -727,6 +870,8 @@ sc_screen_set_paused(struct sc_screen *screen, bool paused) {
         av_frame_free(&screen->frame);
         screen->frame = screen->resume_frame;
         screen->resume_frame = NULL;
+        // Held while paused, its latency is not meaningful
+        screen->frame_push_date = 0;
         sc_screen_apply_frame(screen);
     }
 
@@ -844,13 +989,40 @@ sc_screen_handle_event(struct sc_screen *screen, const SDL_Event *event) {
                 case SDL_WINDOWEVENT_SIZE_CHANGED:
                     sc_screen_render(screen, true);
                     break;
+                case SDL_WINDOWEVENT_MOVED:
+                    // The window may have been moved to another display
+                    sc_screen_update_refresh_rate(screen);
+                    break;
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+                case SDL_WINDOWEVENT_DISPLAY_CHANGED:
+                    sc_screen_update_refresh_rate(screen);
+                    break;
+#endif
+                case SDL_WINDOWEVENT_SHOWN:
+                    screen->hidden = false;
+                    sc_screen_set_consuming(screen, !screen->minimized);
+                    sc_screen_update_content_rect(screen);
+                    break;
+                case SDL_WINDOWEVENT_HIDDEN:
+                    screen->hidden = true;
+                    // Nothing is visible, the frames need not be decoded
+                    sc_screen_set_consuming(screen, false);
+                    break;
                 case SDL_WINDOWEVENT_MAXIMIZED:
                     screen->maximized = true;
+                    // It may be restored directly from minimized to maximized
+                    screen->minimized = false;
+                    sc_screen_set_consuming(screen, !screen->hidden);
+                    sc_screen_update_content_rect(screen);
                     break;
                 case SDL_WINDOWEVENT_MINIMIZED:
                     screen->minimized = true;
+                    // Nothing is visible, the frames need not be decoded
+                    sc_screen_set_consuming(screen, false);
                     break;
                 case SDL_WINDOWEVENT_RESTORED:
+                    screen->minimized = false;
+                    sc_screen_set_consuming(screen, !screen->hidden);
                     if (screen->fullscreen) {
                         // On Windows, in maximized+fullscreen, disabling
                         // fullscreen mode unexpectedly triggers the "restored"
@@ -860,11 +1032,15 @@ sc_screen_handle_event(struct sc_screen *screen, const SDL_Event *event) {
                         break;
                     }
                     screen->maximized = false;
-                    screen->minimized = false;
                     apply_pending_resize(screen);
                     sc_screen_render(screen, true);
                     break;
             }
+
+            if (!sc_screen_apply_pending_frame(screen)) {
+                LOGE("Frame update failed");
+                return false;
+            }
             return true;
     }
 
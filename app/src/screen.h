@@ -12,6 +12,7 @@
 
 #include "controller.h"
 #include "coords.h"
+#include "decoder.h"
 #include "display.h"
 #include "fps_counter.h"
 #include "frame_buffer.h"
@@ -21,6 +22,7 @@
 #include "trait/key_processor.h"
 #include "trait/frame_sink.h"
 #include "trait/mouse_processor.h"
+#include "vsync_scheduler.h"
 
 struct sc_screen {
     struct sc_frame_sink frame_sink; // frame sink trait
@@ -36,6 +38,9 @@ struct sc_screen {
     struct sc_mouse_capture mc; // only used in mouse relative mode
     struct sc_frame_buffer fb;
     struct sc_fps_counter fps_counter;
+    // Present the frames on the display refresh (if vsync is enabled)
+    struct sc_vsync_scheduler vsync_scheduler;
+    bool vsync;
 
     // The initial requested window properties
     struct {
@@ -64,8 +69,21 @@ struct sc_screen {
     bool fullscreen;
     bool maximized;
     bool minimized;
+    bool hidden; // hidden after having been shown (not by scrcpy on closing)
+    bool empty; // the drawable area is empty (zero width or height)
+    // A frame has been received while the window was not visible, it must be
+    // uploaded once the window becomes visible again
+    bool frame_pending;
 
     AVFrame *frame;
+    // Push date of the frame, to measure its latency once presented (0 if
+    // not measured)
+    sc_tick frame_push_date;
+
+    // The video decoder, to pause decoding while the window is minimized (may
+    // be NULL)
+    struct sc_decoder *decoder;
+    bool consuming; // registered as a frame consumer of the decoder
 
     bool paused;
     AVFrame *resume_frame;
@@ -73,6 +91,7 @@ struct sc_screen {
 
 struct sc_screen_params {
     bool video;
+    struct sc_decoder *decoder; // may be NULL
 
     struct sc_controller *controller;
     struct sc_file_pusher *fp;
@@ -97,6 +116,7 @@ struct sc_screen_params {
 
     enum sc_orientation orientation;
     bool mipmaps;
+    bool vsync;
 
     bool fullscreen;
     bool start_fps_counter;
@@ -589,7 +589,9 @@ static bool
 sc_server_connect_to(struct sc_server *server, struct sc_server_info *info) {
     struct sc_adb_tunnel *tunnel = &server->tunnel;
 
-    assert(tunnel->enabled);
+    // Without adb, there is no tunnel: connect directly to the server
+    bool no_adb = server->params.no_adb;
+    assert(no_adb || tunnel->enabled);
 
     const char *serial = server->serial;
     assert(serial);
@@ -601,7 +603,7 @@ sc_server_connect_to(struct sc_server *server, struct sc_server_info *info) {
     sc_socket video_socket = SC_SOCKET_NONE;
     sc_socket audio_socket = SC_SOCKET_NONE;
     sc_socket control_socket = SC_SOCKET_NONE;
-    if (!tunnel->forward) {
+    if (!no_adb && !tunnel->forward) {
         if (video) {
             video_socket =
                 net_accept_intr(&server->intr, tunnel->server_socket);
@@ -633,6 +635,7 @@ sc_server_connect_to(struct sc_server *server, struct sc_server_info *info) {
 
         uint16_t tunnel_port = server->params.tunnel_port;
         if (!tunnel_port) {
+            assert(!no_adb);
             tunnel_port = tunnel->local_port;
         }
 
@@ -689,9 +692,11 @@ sc_server_connect_to(struct sc_server *server, struct sc_server_info *info) {
         (void) ok; // error already logged
     }
 
-    // we don't need the adb tunnel anymore
-    sc_adb_tunnel_close(tunnel, &server->intr, serial,
-                        server->device_socket_name);
+    if (tunnel->enabled) {
+        // we don't need the adb tunnel anymore
+        sc_adb_tunnel_close(tunnel, &server->intr, serial,
+                            server->device_socket_name);
+    }
 
     sc_socket first_socket = video ? video_socket
                            : audio ? audio_socket
@@ -937,12 +942,73 @@ sc_server_kill_adb_if_requested(struct sc_server *server) {
     }
 }
 
+static void
+sc_server_wait_stopped(struct sc_server *server) {
+    // Wait for server_stop()
+    sc_mutex_lock(&server->mutex);
+    while (!server->stopped) {
+        sc_cond_wait(&server->cond_stopped, &server->mutex);
+    }
+    sc_mutex_unlock(&server->mutex);
+
+    // Interrupt sockets to wake up socket blocking calls on the server
+
+    if (server->video_socket != SC_SOCKET_NONE) {
+        // There is no video_socket if --no-video is set
+        net_interrupt(server->video_socket);
+    }
+
+    if (server->audio_socket != SC_SOCKET_NONE) {
+        // There is no audio_socket if --no-audio is set
+        net_interrupt(server->audio_socket);
+    }
+
+    if (server->control_socket != SC_SOCKET_NONE) {
+        // There is no control_socket if --no-control is set
+        net_interrupt(server->control_socket);
+    }
+}
+
+static int
+run_server_no_adb(struct sc_server *server) {
+    // The server (typically scrcpy-fake-device) is already listening on the
+    // tunnel port, there is nothing to push nor to execute
+    uint16_t port = server->params.tunnel_port;
+    assert(port);
+
+    int r = asprintf(&server->serial, "no-adb:%" PRIu16, port);
+    if (r == -1) {
+        LOG_OOM();
+        goto error_connection_failed;
+    }
+
+    bool ok = sc_server_connect_to(server, &server->info);
+    if (!ok) {
+        goto error_connection_failed;
+    }
+
+    // Now connected
+    server->cbs->on_connected(server, server->cbs_userdata);
+
+    sc_server_wait_stopped(server);
+
+    return 0;
+
+error_connection_failed:
+    server->cbs->on_connection_failed(server, server->cbs_userdata);
+    return -1;
+}
+
 static int
 run_server(void *data) {
     struct sc_server *server = data;
 
     const struct sc_server_params *params = &server->params;
 
+    if (params->no_adb) {
+        return run_server_no_adb(server);
+    }
+
     // Execute "adb start-server" before "adb devices" so that daemon starting
     // output/errors is correctly printed in the console ("adb devices" output
     // is parsed, so it is not output)
@@ -1097,29 +1163,7 @@ run_server(void *data) {
     // Now connected
     server->cbs->on_connected(server, server->cbs_userdata);
 
-    // Wait for server_stop()
-    sc_mutex_lock(&server->mutex);
-    while (!server->stopped) {
-        sc_cond_wait(&server->cond_stopped, &server->mutex);
-    }
-    sc_mutex_unlock(&server->mutex);
-
-    // Interrupt sockets to wake up socket blocking calls on the server
-
-    if (server->video_socket != SC_SOCKET_NONE) {
-        // There is no video_socket if --no-video is set
-        net_interrupt(server->video_socket);
-    }
-
-    if (server->audio_socket != SC_SOCKET_NONE) {
-        // There is no audio_socket if --no-audio is set
-        net_interrupt(server->audio_socket);
-    }
-
-    if (server->control_socket != SC_SOCKET_NONE) {
-        // There is no control_socket if --no-control is set
-        net_interrupt(server->control_socket);
-    }
+    sc_server_wait_stopped(server);
 
     // Give some delay for the server to terminate properly
 #define WATCHDOG_DELAY SC_TICK_FROM_SEC(1)
@@ -67,6 +67,7 @@ struct sc_server_params {
     bool cleanup;
     bool power_on;
     bool kill_adb_on_close;
+    bool no_adb;
     bool camera_high_speed;
     bool vd_destroy_content;
     bool vd_system_decorations;
@@ -0,0 +1,167 @@
+#include "snapshot.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libavutil/frame.h>
+#include <libavutil/pixfmt.h>
+
+#include "yuv2rgb.h"
+#include "util/binary.h"
+#include "util/log.h"
+
+// BMP file header (14 bytes) + BITMAPINFOHEADER (40 bytes)
+#define SC_BMP_HEADER_SIZE 54
+
+static void
+sc_snapshot_init_yuv_image(struct sc_yuv_image *image, const AVFrame *frame) {
+    assert(frame->format == AV_PIX_FMT_YUV420P);
+
+    for (int i = 0; i < 3; ++i) {
+        image->planes[i] = frame->data[i];
+        image->linesizes[i] = frame->linesize[i];
+    }
+    image->width = frame->width;
+    image->height = frame->height;
+
+    // Like sc_display (SDL), use BT.709 for HD content if not specified
+    switch (frame->colorspace) {
+        case AVCOL_SPC_BT709:
+            image->matrix = SC_YUV_MATRIX_BT709;
+            break;
+        case AVCOL_SPC_BT470BG:
+        case AVCOL_SPC_SMPTE170M:
+            image->matrix = SC_YUV_MATRIX_BT601;
+            break;
+        default:
+            image->matrix = sc_yuv_matrix_guess(frame->height);
+            break;
+    }
+    image->full_range = frame->color_range == AVCOL_RANGE_JPEG;
+}
+
+static void
+sc_snapshot_write_bmp_header(uint8_t *buf, size_t file_size, uint32_t width,
+                             uint32_t height, size_t image_size) {
+    // BITMAPFILEHEADER
+    buf[0] = 'B';
+    buf[1] = 'M';
+    sc_write32le(&buf[2], file_size);
+    sc_write32le(&buf[6], 0); // reserved
+    sc_write32le(&buf[10], SC_BMP_HEADER_SIZE); // pixel data offset
+
+    // BITMAPINFOHEADER
+    sc_write32le(&buf[14], 40); // header size
+    sc_write32le(&buf[18], width);
+    sc_write32le(&buf[22], height); // positive: bottom-up rows
+    sc_write16le(&buf[26], 1); // planes
+    sc_write16le(&buf[28], 24); // bits per pixel
+    sc_write32le(&buf[30], 0); // BI_RGB (no compression)
+    sc_write32le(&buf[34], image_size);
+    sc_write32le(&buf[38], 2835); // 72 DPI, in pixels per meter
+    sc_write32le(&buf[42], 2835);
+    sc_write32le(&buf[46], 0); // colors in the palette
+    sc_write32le(&buf[50], 0); // important colors
+}
+
+// Write the image, downscaled by 2^scale_shift, as a BMP file
+static bool
+sc_snapshot_encode_bmp(const struct sc_yuv_image *image, unsigned scale_shift,
+                       uint8_t **out_buffer, size_t *out_size) {
+    unsigned width = image->width >> scale_shift;
+    unsigned height = image->height >> scale_shift;
+    assert(width && height);
+
+    // The BMP rows are padded to 4 bytes
+    size_t row_size = ((size_t) width * 3 + 3) & ~(size_t) 3;
+    size_t image_size = row_size * height;
+    size_t size = SC_BMP_HEADER_SIZE + image_size;
+    uint8_t *buffer = malloc(size);
+    if (!buffer) {
+        LOG_OOM();
+        return false;
+    }
+
+    sc_snapshot_write_bmp_header(buffer, size, width, height, image_size);
+
+    uint8_t *pixels = buffer + SC_BMP_HEADER_SIZE;
+    size_t padding = row_size - (size_t) width * 3;
+    if (padding) {
+        for (unsigned y = 0; y < height; ++y) {
+            memset(pixels + y * row_size + row_size - padding, 0, padding);
+        }
+    }
+
+    // Convert directly to BGR, bottom-up, in the BMP pixel data
+    uint8_t *last_row = pixels + (height - 1) * row_size;
+    bool ok = sc_yuv2rgb_convert(image, scale_shift, SC_RGB_FORMAT_BGR24,
+                                 last_row, -(ptrdiff_t) row_size);
+    if (!ok) {
+        free(buffer);
+        return false;
+    }
+
+    *out_buffer = buffer;
+    *out_size = size;
+    return true;
+}
+
+static bool
+sc_snapshot_check(const AVFrame *frame, const char *format) {
+    if (strcmp(format, "bmp")) {
+        // TODO: PNG/JPG saving (requires SDL_image)
+        return false;
+    }
+
+    if (frame->format != AV_PIX_FMT_YUV420P) {
+        LOGE("Unsupported frame format for snapshot: %d", frame->format);
+        return false;
+    }
+
+    return true;
+}
+
+bool
+sc_snapshot_encode(const AVFrame *frame, const char *format,
+                   uint8_t **out_buffer, size_t *out_size) {
+    if (!sc_snapshot_check(frame, format)) {
+        return false;
+    }
+
+    struct sc_yuv_image image;
+    sc_snapshot_init_yuv_image(&image, frame);
+
+    return sc_snapshot_encode_bmp(&image, 0, out_buffer, out_size);
+}
+
+bool
+sc_snapshot_encode_scaled(const AVFrame *frame, const char *format,
+                          unsigned width, unsigned height,
+                          struct sc_scaler_cache *scalers,
+                          uint8_t **out_buffer, size_t *out_size) {
+    assert(width && height);
+    assert(width <= (unsigned) frame->width);
+    assert(height <= (unsigned) frame->height);
+
+    if (!sc_snapshot_check(frame, format)) {
+        return false;
+    }
+
+    struct sc_yuv_image image;
+    sc_snapshot_init_yuv_image(&image, frame);
+
+    // Downscaling by 1, 2 or 4 is fused with the color conversion
+    for (unsigned shift = 0; shift <= 2; ++shift) {
+        if (width == image.width >> shift && height == image.height >> shift) {
+            return sc_snapshot_encode_bmp(&image, shift, out_buffer, out_size);
+        }
+    }
+
+    const struct sc_yuv_image *scaled =
+        sc_scaler_cache_scale(scalers, &image, width, height);
+    if (!scaled) {
+        return false;
+    }
+
+    return sc_snapshot_encode_bmp(scaled, 0, out_buffer, out_size);
+}
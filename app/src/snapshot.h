@@ -0,0 +1,38 @@
+#ifndef SC_SNAPSHOT_H
+#define SC_SNAPSHOT_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "scaler.h"
+
+// forward declarations
+typedef struct AVFrame AVFrame;
+
+/**
+ * Convert a decoded frame to an image file in memory
+ *
+ * Only "bmp" is currently supported.
+ *
+ * On success, the caller must free() the output buffer.
+ */
+bool
+sc_snapshot_encode(const AVFrame *frame, const char *format,
+                   uint8_t **out_buffer, size_t *out_size);
+
+/**
+ * Same as sc_snapshot_encode(), with the frame downscaled to width x height
+ *
+ * The size must not exceed the frame size. The scalers are kept in the cache
+ * for the next snapshots of the same size.
+ */
+bool
+sc_snapshot_encode_scaled(const AVFrame *frame, const char *format,
+                          unsigned width, unsigned height,
+                          struct sc_scaler_cache *scalers,
+                          uint8_t **out_buffer, size_t *out_size);
+
+#endif
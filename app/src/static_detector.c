@@ -0,0 +1,168 @@
+#include "static_detector.h"
+
+#include <assert.h>
+#include <string.h>
+
+// Duration without any change for the screen to be considered static
+#define SC_STATIC_DETECTOR_DELAY SC_TICK_FROM_SEC(1)
+
+#define SC_STATIC_DETECTOR_HASH_PRIME UINT64_C(0x9E3779B97F4A7C15)
+// Independent hash lanes, so that the multiplications are pipelined
+#define SC_STATIC_DETECTOR_LANES 8
+
+void
+sc_static_detector_init(struct sc_static_detector *sd) {
+    for (unsigned i = 0; i < SC_STATIC_DETECTOR_PACKETS; ++i) {
+        sd->packets[i].pts = INT64_MIN;
+        sd->packets[i].size = 0;
+        sd->packets[i].key_frame = false;
+    }
+    sd->packet_index = 0;
+
+    sd->has_hash = false;
+    sd->hash = 0;
+    sd->width = 0;
+    sd->height = 0;
+
+    sd->last_change = 0;
+    sd->is_static = false;
+}
+
+void
+sc_static_detector_push_packet(struct sc_static_detector *sd, int64_t pts,
+                               size_t size, bool key_frame) {
+    unsigned i = sd->packet_index;
+    sd->packets[i].pts = pts;
+    sd->packets[i].size = size;
+    sd->packets[i].key_frame = key_frame;
+    sd->packet_index = (i + 1) % SC_STATIC_DETECTOR_PACKETS;
+}
+
+// Return true if the frame may be a repetition of the previous one, according
+// to the size of its packet
+static bool
+sc_static_detector_is_candidate(struct sc_static_detector *sd, int64_t pts,
+                                unsigned width, unsigned height) {
+    // A repeated frame only contains skipped blocks: a few bytes per slice,
+    // while a change (even a blinking cursor) is typically larger
+    size_t max_size = 64 + (size_t) width * height / 4096;
+
+    // Search from the most recent packet
+    for (unsigned k = 1; k <= SC_STATIC_DETECTOR_PACKETS; ++k) {
+        unsigned i = (sd->packet_index + SC_STATIC_DETECTOR_PACKETS - k)
+                   % SC_STATIC_DETECTOR_PACKETS;
+        if (sd->packets[i].pts == pts) {
+            return !sd->packets[i].key_frame && sd->packets[i].size <= max_size;
+        }
+    }
+
+    // Unknown packet
+    return false;
+}
+
+static inline uint64_t
+sc_static_detector_mix(uint64_t hash, uint64_t value) {
+    hash = (hash ^ value) * SC_STATIC_DETECTOR_HASH_PRIME;
+    // Propagate the high bits to the low bits
+    return hash ^ (hash >> 29);
+}
+
+static inline uint64_t
+sc_static_detector_load64(const uint8_t *data) {
+    uint64_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static void
+sc_static_detector_hash_plane(uint64_t state[SC_STATIC_DETECTOR_LANES],
+                              const uint8_t *data,
+                              int linesize, unsigned width, unsigned height) {
+    // Local copy, which the compiler can keep in registers (the writes to
+    // state could alias the data)
+    uint64_t lanes[SC_STATIC_DETECTOR_LANES];
+    memcpy(lanes, state, sizeof(lanes));
+
+    for (unsigned y = 0; y < height; ++y) {
+        const uint8_t *row = data + (ptrdiff_t) y * linesize;
+
+        unsigned x = 0;
+        for (; x + 8 * SC_STATIC_DETECTOR_LANES <= width;
+                x += 8 * SC_STATIC_DETECTOR_LANES) {
+            for (unsigned k = 0; k < SC_STATIC_DETECTOR_LANES; ++k) {
+                uint64_t value = sc_static_detector_load64(row + x + 8 * k);
+                lanes[k] = sc_static_detector_mix(lanes[k], value);
+            }
+        }
+        for (; x + 8 <= width; x += 8) {
+            uint64_t value = sc_static_detector_load64(row + x);
+            lanes[0] = sc_static_detector_mix(lanes[0], value);
+        }
+        for (; x < width; ++x) {
+            lanes[1] = sc_static_detector_mix(lanes[1], row[x]);
+        }
+    }
+
+    memcpy(state, lanes, sizeof(lanes));
+}
+
+// Hash all the pixels: a sparse sample would miss small changes (a blinking
+// cursor), which would then never be displayed
+static uint64_t
+sc_static_detector_hash(const uint8_t *const planes[3], const int linesizes[3],
+                        unsigned width, unsigned height) {
+    uint64_t lanes[SC_STATIC_DETECTOR_LANES];
+    for (unsigned k = 0; k < SC_STATIC_DETECTOR_LANES; ++k) {
+        lanes[k] = k + 1;
+    }
+
+    unsigned chroma_width = (width + 1) / 2;
+    unsigned chroma_height = (height + 1) / 2;
+    sc_static_detector_hash_plane(lanes, planes[0], linesizes[0], width,
+                                  height);
+    sc_static_detector_hash_plane(lanes, planes[1], linesizes[1], chroma_width,
+                                  chroma_height);
+    sc_static_detector_hash_plane(lanes, planes[2], linesizes[2], chroma_width,
+                                  chroma_height);
+
+    uint64_t hash = 0;
+    for (unsigned k = 0; k < SC_STATIC_DETECTOR_LANES; ++k) {
+        hash = sc_static_detector_mix(hash, lanes[k]);
+    }
+    return hash;
+}
+
+bool
+sc_static_detector_check_frame(struct sc_static_detector *sd, int64_t pts,
+                               const uint8_t *const planes[3],
+                               const int linesizes[3], unsigned width,
+                               unsigned height, sc_tick now) {
+    assert(width && height);
+
+    bool unchanged = false;
+    if (sc_static_detector_is_candidate(sd, pts, width, height)) {
+        uint64_t hash =
+            sc_static_detector_hash(planes, linesizes, width, height);
+        unchanged = sd->has_hash && hash == sd->hash
+                 && width == sd->width && height == sd->height;
+        sd->has_hash = true;
+        sd->hash = hash;
+    } else {
+        // Not hashed, the next frame could not be compared to this one
+        sd->has_hash = false;
+    }
+
+    sd->width = width;
+    sd->height = height;
+
+    if (unchanged) {
+        if (now - sd->last_change >= SC_STATIC_DETECTOR_DELAY) {
+            sd->is_static = true;
+        }
+    } else {
+        sd->last_change = now;
+        sd->is_static = false;
+    }
+
+    return unchanged;
+}
@@ -0,0 +1,67 @@
+#ifndef SC_STATIC_DETECTOR_H
+#define SC_STATIC_DETECTOR_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "util/tick.h"
+
+// Number of packets remembered to find the packet of a decoded frame (the
+// decoder may output a frame several packets later, with frame threading)
+#define SC_STATIC_DETECTOR_PACKETS 32
+
+/**
+ * Detection of the decoded frames identical to the previous one
+ *
+ * While its screen does not change, the device repeats its last frame every
+ * 100 ms. Such a frame is encoded as a tiny inter frame, so only the frames
+ * decoded from a small non-key packet are candidates: their content is then
+ * hashed and compared to the previous frame.
+ *
+ * The screen is considered static once no frame has changed for
+ * SC_STATIC_DETECTOR_DELAY.
+ *
+ * It is not thread-safe: it is used only from the decoder thread.
+ */
+struct sc_static_detector {
+    struct {
+        int64_t pts;
+        size_t size;
+        bool key_frame;
+    } packets[SC_STATIC_DETECTOR_PACKETS];
+    unsigned packet_index; // next entry to write
+
+    // The previous frame
+    bool has_hash; // false if the previous frame was not hashed
+    uint64_t hash;
+    unsigned width;
+    unsigned height;
+
+    sc_tick last_change; // date of the last changed frame, 0 if none
+    bool is_static;
+};
+
+void
+sc_static_detector_init(struct sc_static_detector *sd);
+
+// Register a packet sent to the decoder
+void
+sc_static_detector_push_packet(struct sc_static_detector *sd, int64_t pts,
+                               size_t size, bool key_frame);
+
+/**
+ * Check a decoded YUV 4:2:0 frame, return true if it is identical to the
+ * previous one
+ *
+ * The pts must be the pts of the packet the frame was decoded from.
+ */
+bool
+sc_static_detector_check_frame(struct sc_static_detector *sd, int64_t pts,
+                               const uint8_t *const planes[3],
+                               const int linesizes[3], unsigned width,
+                               unsigned height, sc_tick now);
+
+#endif
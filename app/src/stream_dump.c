@@ -0,0 +1,210 @@
+#include "stream_dump.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/binary.h"
+#include "util/file.h"
+#include "util/log.h"
+
+static char *
+sc_stream_dump_get_path(const char *dir, const char *name) {
+    size_t dirlen = strlen(dir);
+    size_t namelen = strlen(name);
+    static const char ext[] = ".dump";
+
+    // <dir>/<name>.dump
+    char *path = malloc(dirlen + 1 + namelen + sizeof(ext));
+    if (!path) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    memcpy(path, dir, dirlen);
+    path[dirlen] = SC_PATH_SEPARATOR;
+    memcpy(&path[dirlen + 1], name, namelen);
+    memcpy(&path[dirlen + 1 + namelen], ext, sizeof(ext));
+    return path;
+}
+
+static FILE *
+sc_stream_dump_fopen(const char *dir, const char *name, const char *mode) {
+    char *path = sc_stream_dump_get_path(dir, name);
+    if (!path) {
+        return NULL;
+    }
+
+    FILE *file = fopen(path, mode);
+    if (!file && *mode == 'w') {
+        LOGE("Could not open dump file: %s", path);
+    }
+
+    free(path);
+    return file;
+}
+
+bool
+sc_stream_dump_open(struct sc_stream_dump *dump, const char *dir,
+                    const char *name, sc_tick start) {
+    dump->file = sc_stream_dump_fopen(dir, name, "wb");
+    if (!dump->file) {
+        return false;
+    }
+
+    dump->start = start;
+    dump->failed = false;
+    return true;
+}
+
+void
+sc_stream_dump_close(struct sc_stream_dump *dump) {
+    if (fclose(dump->file) && !dump->failed) {
+        LOGE("Could not write stream dump");
+    }
+}
+
+void
+sc_stream_dump_write(struct sc_stream_dump *dump, const void *data,
+                     size_t len) {
+    if (dump->failed) {
+        return;
+    }
+
+    assert(len <= UINT32_MAX);
+
+    uint8_t header[SC_STREAM_DUMP_RECORD_HEADER_SIZE];
+    sc_write64be(header, sc_tick_now() - dump->start);
+    sc_write32be(&header[8], len);
+
+    // The FILE is buffered, the records are written by large chunks
+    if (fwrite(header, sizeof(header), 1, dump->file) != 1
+            || fwrite(data, len, 1, dump->file) != 1) {
+        LOGE("Could not write stream dump, capture stopped");
+        dump->failed = true;
+    }
+}
+
+bool
+sc_stream_replay_open(struct sc_stream_replay *replay, const char *dir,
+                      const char *name, bool realtime, sc_tick start) {
+    bool ok = sc_mutex_init(&replay->mutex);
+    if (!ok) {
+        return false;
+    }
+
+    ok = sc_cond_init(&replay->cond);
+    if (!ok) {
+        sc_mutex_destroy(&replay->mutex);
+        return false;
+    }
+
+    replay->file = sc_stream_dump_fopen(dir, name, "rb");
+    if (!replay->file) {
+        sc_cond_destroy(&replay->cond);
+        sc_mutex_destroy(&replay->mutex);
+        return false;
+    }
+
+    replay->realtime = realtime;
+    replay->start = start;
+    replay->interrupted = false;
+    replay->data = NULL;
+    replay->len = 0;
+    replay->cap = 0;
+    replay->pos = 0;
+
+    return true;
+}
+
+void
+sc_stream_replay_close(struct sc_stream_replay *replay) {
+    fclose(replay->file);
+    free(replay->data);
+    sc_cond_destroy(&replay->cond);
+    sc_mutex_destroy(&replay->mutex);
+}
+
+// Wait until the deadline, return false if interrupted
+static bool
+sc_stream_replay_wait(struct sc_stream_replay *replay, sc_tick deadline) {
+    sc_mutex_lock(&replay->mutex);
+    bool timed_out = false;
+    while (!replay->interrupted && !timed_out) {
+        timed_out = !sc_cond_timedwait(&replay->cond, &replay->mutex, deadline);
+    }
+    bool interrupted = replay->interrupted;
+    sc_mutex_unlock(&replay->mutex);
+
+    return !interrupted;
+}
+
+static bool
+sc_stream_replay_next_record(struct sc_stream_replay *replay) {
+    uint8_t header[SC_STREAM_DUMP_RECORD_HEADER_SIZE];
+    if (fread(header, sizeof(header), 1, replay->file) != 1) {
+        // End of stream
+        return false;
+    }
+
+    sc_tick time = sc_read64be(header);
+    uint32_t len = sc_read32be(&header[8]);
+
+    if (len > replay->cap) {
+        uint8_t *data = realloc(replay->data, len);
+        if (!data) {
+            LOG_OOM();
+            return false;
+        }
+        replay->data = data;
+        replay->cap = len;
+    }
+
+    if (len && fread(replay->data, len, 1, replay->file) != 1) {
+        LOGW("Truncated stream dump");
+        return false;
+    }
+
+    replay->len = len;
+    replay->pos = 0;
+
+    if (replay->realtime) {
+        return sc_stream_replay_wait(replay, replay->start + time);
+    }
+
+    sc_mutex_lock(&replay->mutex);
+    bool interrupted = replay->interrupted;
+    sc_mutex_unlock(&replay->mutex);
+
+    return !interrupted;
+}
+
+ssize_t
+sc_stream_replay_read_all(struct sc_stream_replay *replay, void *buf,
+                          size_t len) {
+    size_t copied = 0;
+    while (copied < len) {
+        if (replay->pos == replay->len) {
+            if (!sc_stream_replay_next_record(replay)) {
+                break;
+            }
+            continue;
+        }
+
+        size_t remaining = replay->len - replay->pos;
+        size_t n = len - copied < remaining ? len - copied : remaining;
+        memcpy((uint8_t *) buf + copied, &replay->data[replay->pos], n);
+        replay->pos += n;
+        copied += n;
+    }
+
+    return copied;
+}
+
+void
+sc_stream_replay_interrupt(struct sc_stream_replay *replay) {
+    sc_mutex_lock(&replay->mutex);
+    replay->interrupted = true;
+    sc_cond_signal(&replay->cond);
+    sc_mutex_unlock(&replay->mutex);
+}
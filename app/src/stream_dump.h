@@ -0,0 +1,97 @@
+#ifndef SC_STREAM_DUMP_H
+#define SC_STREAM_DUMP_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#include "util/thread.h"
+#include "util/tick.h"
+
+/**
+ * Capture and replay of the raw bytes received on the device sockets
+ *
+ * A dump file contains one record per recv() call:
+ *
+ *     [8 bytes] receive time in microseconds, relative to the capture start
+ *     [4 bytes] length
+ *     [length bytes] data
+ *
+ * All the values are big-endian.
+ */
+
+#define SC_STREAM_DUMP_RECORD_HEADER_SIZE 12
+
+struct sc_stream_dump {
+    FILE *file;
+    sc_tick start;
+    bool failed;
+};
+
+/**
+ * Open <dir>/<name>.dump for writing
+ *
+ * The start time should be shared by all the streams, so that they can be
+ * replayed in sync.
+ */
+bool
+sc_stream_dump_open(struct sc_stream_dump *dump, const char *dir,
+                    const char *name, sc_tick start);
+
+void
+sc_stream_dump_close(struct sc_stream_dump *dump);
+
+// Write a record (a failure is logged once, and does not stop the stream)
+void
+sc_stream_dump_write(struct sc_stream_dump *dump, const void *data,
+                     size_t len);
+
+struct sc_stream_replay {
+    FILE *file;
+    bool realtime; // if false, replay as fast as possible
+    sc_tick start;
+
+    sc_mutex mutex;
+    sc_cond cond;
+    bool interrupted;
+
+    // current record
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+    size_t pos;
+};
+
+/**
+ * Open <dir>/<name>.dump for reading
+ *
+ * Return false if the file does not exist (the stream was not captured).
+ */
+bool
+sc_stream_replay_open(struct sc_stream_replay *replay, const char *dir,
+                      const char *name, bool realtime, sc_tick start);
+
+void
+sc_stream_replay_close(struct sc_stream_replay *replay);
+
+/**
+ * Read exactly len bytes (like net_recv_all())
+ *
+ * In realtime mode, a record is not delivered before its receive time.
+ *
+ * Return the number of bytes read, which is less than len on end of stream,
+ * error or interruption.
+ */
+ssize_t
+sc_stream_replay_read_all(struct sc_stream_replay *replay, void *buf,
+                          size_t len);
+
+// Wake up and stop the reader
+void
+sc_stream_replay_interrupt(struct sc_stream_replay *replay);
+
+#endif
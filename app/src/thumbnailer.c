@@ -0,0 +1,433 @@
+#include "thumbnailer.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libavutil/pixfmt.h>
+
+#include "util/log.h"
+
+/** Downcast packet_sink to thumbnailer */
+#define DOWNCAST(SINK) container_of(SINK, struct sc_thumbnailer, packet_sink)
+
+// JPEG quality, from 2 (best) to 31 (worst)
+#define SC_THUMBNAILER_QSCALE 6
+
+static bool
+sc_thumbnailer_set_config(struct sc_thumbnailer *thumbnailer,
+                          const AVPacket *packet) {
+    if (!thumbnailer->config) {
+        thumbnailer->config = av_packet_alloc();
+        if (!thumbnailer->config) {
+            LOG_OOM();
+            return false;
+        }
+    } else {
+        av_packet_unref(thumbnailer->config);
+    }
+
+    if (av_packet_ref(thumbnailer->config, packet)) {
+        LOG_OOM();
+        return false;
+    }
+
+    // The decoder will be recreated with the new config on the next key frame
+    avcodec_free_context(&thumbnailer->dec_ctx);
+    return true;
+}
+
+static bool
+sc_thumbnailer_open_decoder(struct sc_thumbnailer *thumbnailer) {
+    assert(!thumbnailer->dec_ctx);
+
+    AVCodecContext *ctx = avcodec_alloc_context3(thumbnailer->codec);
+    if (!ctx) {
+        LOG_OOM();
+        return false;
+    }
+
+    ctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+
+    const AVPacket *config = thumbnailer->config;
+    if (config) {
+        ctx->extradata = av_mallocz(config->size
+                                        + AV_INPUT_BUFFER_PADDING_SIZE);
+        if (!ctx->extradata) {
+            LOG_OOM();
+            avcodec_free_context(&ctx);
+            return false;
+        }
+        memcpy(ctx->extradata, config->data, config->size);
+        ctx->extradata_size = config->size;
+    }
+
+    if (avcodec_open2(ctx, thumbnailer->codec, NULL) < 0) {
+        LOGE("Thumbnailer: could not open codec");
+        avcodec_free_context(&ctx);
+        return false;
+    }
+
+    thumbnailer->dec_ctx = ctx;
+    return true;
+}
+
+static void
+sc_thumbnailer_compute_size(int width, int height, int *out_width,
+                            int *out_height) {
+    // Keep the aspect ratio, with even dimensions (for YUV 4:2:0)
+    if (width >= height) {
+        int w = width < SC_THUMBNAILER_MAX_SIZE ? width
+                                                : SC_THUMBNAILER_MAX_SIZE;
+        *out_width = w & ~1;
+        *out_height = ((int64_t) height * w / width) & ~1;
+    } else {
+        int h = height < SC_THUMBNAILER_MAX_SIZE ? height
+                                                 : SC_THUMBNAILER_MAX_SIZE;
+        *out_height = h & ~1;
+        *out_width = ((int64_t) width * h / height) & ~1;
+    }
+
+    if (*out_width < 2) {
+        *out_width = 2;
+    }
+    if (*out_height < 2) {
+        *out_height = 2;
+    }
+}
+
+static bool
+sc_thumbnailer_prepare_encoder(struct sc_thumbnailer *thumbnailer, int width,
+                               int height) {
+    AVCodecContext *enc_ctx = thumbnailer->enc_ctx;
+    if (enc_ctx && enc_ctx->width == width && enc_ctx->height == height) {
+        // Reuse the encoder
+        return true;
+    }
+
+    avcodec_free_context(&thumbnailer->enc_ctx);
+    av_frame_unref(thumbnailer->scaled);
+
+    const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+    if (!codec) {
+        LOGE("Thumbnailer: MJPEG encoder not found");
+        return false;
+    }
+
+    enc_ctx = avcodec_alloc_context3(codec);
+    if (!enc_ctx) {
+        LOG_OOM();
+        return false;
+    }
+
+    enc_ctx->width = width;
+    enc_ctx->height = height;
+    // Full range YUV, like the (deprecated) YUVJ formats
+    enc_ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+    enc_ctx->color_range = AVCOL_RANGE_JPEG;
+    enc_ctx->time_base = (AVRational) {1, 1};
+    enc_ctx->flags |= AV_CODEC_FLAG_QSCALE;
+    // Required by old FFmpeg versions for YUV420P input
+    enc_ctx->strict_std_compliance = FF_COMPLIANCE_UNOFFICIAL;
+
+    if (avcodec_open2(enc_ctx, codec, NULL) < 0) {
+        LOGE("Thumbnailer: could not open MJPEG encoder");
+        avcodec_free_context(&enc_ctx);
+        return false;
+    }
+
+    AVFrame *scaled = thumbnailer->scaled;
+    scaled->format = AV_PIX_FMT_YUV420P;
+    scaled->width = width;
+    scaled->height = height;
+    scaled->color_range = AVCOL_RANGE_JPEG;
+    if (av_frame_get_buffer(scaled, 0) < 0) {
+        LOG_OOM();
+        avcodec_free_context(&enc_ctx);
+        return false;
+    }
+
+    thumbnailer->enc_ctx = enc_ctx;
+    return true;
+}
+
+static bool
+sc_thumbnailer_publish(struct sc_thumbnailer *thumbnailer,
+                       const AVPacket *jpeg) {
+    uint8_t *data = malloc(jpeg->size);
+    if (!data) {
+        LOG_OOM();
+        return false;
+    }
+    memcpy(data, jpeg->data, jpeg->size);
+
+    sc_mutex_lock(&thumbnailer->mutex);
+    uint8_t *old = thumbnailer->data;
+    thumbnailer->data = data;
+    thumbnailer->size = jpeg->size;
+    sc_mutex_unlock(&thumbnailer->mutex);
+
+    free(old);
+    return true;
+}
+
+static bool
+sc_thumbnailer_encode(struct sc_thumbnailer *thumbnailer,
+                      const AVFrame *frame) {
+    int width;
+    int height;
+    sc_thumbnailer_compute_size(frame->width, frame->height, &width, &height);
+
+    if (frame->format != AV_PIX_FMT_YUV420P) {
+        LOGE("Thumbnailer: unsupported frame format: %d", frame->format);
+        return false;
+    }
+
+    if (width > frame->width || height > frame->height) {
+        LOGW("Thumbnailer: frame too small");
+        return false;
+    }
+
+    if (!sc_thumbnailer_prepare_encoder(thumbnailer, width, height)) {
+        return false;
+    }
+
+    // The filters are reused as long as the sizes do not change
+    bool ok = sc_scaler_prepare(&thumbnailer->scaler, frame->width,
+                                frame->height, width, height);
+    if (!ok) {
+        return false;
+    }
+
+    AVFrame *scaled = thumbnailer->scaled;
+    if (av_frame_make_writable(scaled) < 0) {
+        LOG_OOM();
+        return false;
+    }
+
+    struct sc_yuv_image image = {
+        .planes = {frame->data[0], frame->data[1], frame->data[2]},
+        .linesizes = {frame->linesize[0], frame->linesize[1],
+                      frame->linesize[2]},
+        .width = frame->width,
+        .height = frame->height,
+        .matrix = SC_YUV_MATRIX_BT601, // unused by the scaler
+        .full_range = frame->color_range == AVCOL_RANGE_JPEG,
+    };
+
+    // The JPEG is full range
+    sc_scaler_scale(&thumbnailer->scaler, &image, true, scaled->data,
+                    scaled->linesize);
+
+    scaled->quality = FF_QP2LAMBDA * SC_THUMBNAILER_QSCALE;
+    scaled->pts = 0;
+
+    AVCodecContext *enc_ctx = thumbnailer->enc_ctx;
+    int ret = avcodec_send_frame(enc_ctx, scaled);
+    if (ret < 0) {
+        LOGE("Thumbnailer: could not encode frame: %d", ret);
+        return false;
+    }
+
+    // The MJPEG encoder outputs one packet per frame, immediately
+    ret = avcodec_receive_packet(enc_ctx, thumbnailer->jpeg);
+    if (ret < 0) {
+        LOGE("Thumbnailer: could not receive JPEG: %d", ret);
+        return false;
+    }
+
+    ok = sc_thumbnailer_publish(thumbnailer, thumbnailer->jpeg);
+    av_packet_unref(thumbnailer->jpeg);
+    return ok;
+}
+
+static bool
+sc_thumbnailer_process_key_frame(struct sc_thumbnailer *thumbnailer,
+                                 const AVPacket *packet) {
+    if (!thumbnailer->dec_ctx && !sc_thumbnailer_open_decoder(thumbnailer)) {
+        return false;
+    }
+
+    int ret = avcodec_send_packet(thumbnailer->dec_ctx, packet);
+    if (ret < 0 && ret != AVERROR(EAGAIN)) {
+        LOGE("Thumbnailer: could not send packet: %d", ret);
+        // Recreate the decoder on the next key frame
+        avcodec_free_context(&thumbnailer->dec_ctx);
+        return false;
+    }
+
+    ret = avcodec_receive_frame(thumbnailer->dec_ctx, thumbnailer->frame);
+    if (ret == AVERROR(EAGAIN)) {
+        // No frame yet
+        return true;
+    }
+    if (ret < 0) {
+        LOGE("Thumbnailer: could not receive frame: %d", ret);
+        avcodec_free_context(&thumbnailer->dec_ctx);
+        return false;
+    }
+
+    bool ok = sc_thumbnailer_encode(thumbnailer, thumbnailer->frame);
+    av_frame_unref(thumbnailer->frame);
+    return ok;
+}
+
+static bool
+sc_thumbnailer_packet_sink_open(struct sc_packet_sink *sink,
+                                AVCodecContext *ctx) {
+    struct sc_thumbnailer *thumbnailer = DOWNCAST(sink);
+
+    thumbnailer->codec = avcodec_find_decoder(ctx->codec_id);
+    if (!thumbnailer->codec) {
+        LOGE("Thumbnailer: decoder not found");
+        return false;
+    }
+
+    thumbnailer->frame = av_frame_alloc();
+    if (!thumbnailer->frame) {
+        LOG_OOM();
+        return false;
+    }
+
+    thumbnailer->scaled = av_frame_alloc();
+    if (!thumbnailer->scaled) {
+        LOG_OOM();
+        goto error_free_frame;
+    }
+
+    thumbnailer->jpeg = av_packet_alloc();
+    if (!thumbnailer->jpeg) {
+        LOG_OOM();
+        goto error_free_scaled;
+    }
+
+    thumbnailer->config = NULL;
+    thumbnailer->dec_ctx = NULL;
+    sc_scaler_init(&thumbnailer->scaler);
+    thumbnailer->enc_ctx = NULL;
+    thumbnailer->last_thumbnail = 0;
+    // The stream starts with a key frame
+    thumbnailer->last_key_frame = sc_tick_now();
+    thumbnailer->last_request = 0;
+
+    return true;
+
+error_free_scaled:
+    av_frame_free(&thumbnailer->scaled);
+error_free_frame:
+    av_frame_free(&thumbnailer->frame);
+
+    return false;
+}
+
+static void
+sc_thumbnailer_packet_sink_close(struct sc_packet_sink *sink) {
+    struct sc_thumbnailer *thumbnailer = DOWNCAST(sink);
+
+    avcodec_free_context(&thumbnailer->enc_ctx);
+    sc_scaler_destroy(&thumbnailer->scaler);
+    avcodec_free_context(&thumbnailer->dec_ctx);
+    av_packet_free(&thumbnailer->config);
+    av_packet_free(&thumbnailer->jpeg);
+    av_frame_free(&thumbnailer->scaled);
+    av_frame_free(&thumbnailer->frame);
+}
+
+static bool
+sc_thumbnailer_packet_sink_push(struct sc_packet_sink *sink,
+                                const AVPacket *packet) {
+    struct sc_thumbnailer *thumbnailer = DOWNCAST(sink);
+
+    if (packet->pts == AV_NOPTS_VALUE) {
+        // A config packet
+        return sc_thumbnailer_set_config(thumbnailer, packet);
+    }
+
+    sc_tick now = sc_tick_now();
+
+    if (!(packet->flags & AV_PKT_FLAG_KEY)) {
+        sc_tick interval = thumbnailer->key_frame_interval;
+        if (interval && now - thumbnailer->last_key_frame >= interval
+                && now - thumbnailer->last_request >= interval) {
+            // The device encoder key frame interval is too long
+            thumbnailer->last_request = now;
+            thumbnailer->cbs->on_key_frame_needed(thumbnailer,
+                                                  thumbnailer->cbs_userdata);
+        }
+        return true;
+    }
+
+    thumbnailer->last_key_frame = now;
+
+    if (thumbnailer->last_thumbnail
+            && now - thumbnailer->last_thumbnail < SC_THUMBNAILER_MIN_INTERVAL) {
+        // Too soon
+        return true;
+    }
+    thumbnailer->last_thumbnail = now;
+
+    // A thumbnail failure must not stop the other sinks (the error is
+    // already logged)
+    (void) sc_thumbnailer_process_key_frame(thumbnailer, packet);
+    return true;
+}
+
+bool
+sc_thumbnailer_init(struct sc_thumbnailer *thumbnailer,
+                    sc_tick key_frame_interval,
+                    const struct sc_thumbnailer_callbacks *cbs,
+                    void *cbs_userdata) {
+    bool ok = sc_mutex_init(&thumbnailer->mutex);
+    if (!ok) {
+        return false;
+    }
+
+    thumbnailer->data = NULL;
+    thumbnailer->size = 0;
+    thumbnailer->key_frame_interval = key_frame_interval;
+
+    // The callbacks are only required to request key frames
+    assert(!key_frame_interval || (cbs && cbs->on_key_frame_needed));
+    thumbnailer->cbs = cbs;
+    thumbnailer->cbs_userdata = cbs_userdata;
+
+    static const struct sc_packet_sink_ops ops = {
+        .open = sc_thumbnailer_packet_sink_open,
+        .close = sc_thumbnailer_packet_sink_close,
+        .push = sc_thumbnailer_packet_sink_push,
+    };
+
+    thumbnailer->packet_sink.ops = &ops;
+
+    return true;
+}
+
+void
+sc_thumbnailer_destroy(struct sc_thumbnailer *thumbnailer) {
+    free(thumbnailer->data);
+    sc_mutex_destroy(&thumbnailer->mutex);
+}
+
+bool
+sc_thumbnailer_get(struct sc_thumbnailer *thumbnailer, uint8_t **data,
+                   size_t *size) {
+    sc_mutex_lock(&thumbnailer->mutex);
+
+    if (!thumbnailer->data) {
+        sc_mutex_unlock(&thumbnailer->mutex);
+        return false;
+    }
+
+    uint8_t *copy = malloc(thumbnailer->size);
+    if (!copy) {
+        sc_mutex_unlock(&thumbnailer->mutex);
+        LOG_OOM();
+        return false;
+    }
+
+    memcpy(copy, thumbnailer->data, thumbnailer->size);
+    *data = copy;
+    *size = thumbnailer->size;
+
+    sc_mutex_unlock(&thumbnailer->mutex);
+    return true;
+}
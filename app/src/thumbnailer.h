@@ -0,0 +1,84 @@
+#ifndef SC_THUMBNAILER_H
+#define SC_THUMBNAILER_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <libavcodec/avcodec.h>
+
+#include "scaler.h"
+#include "trait/packet_sink.h"
+#include "util/thread.h"
+#include "util/tick.h"
+
+// Maximum width and height of the thumbnails
+#define SC_THUMBNAILER_MAX_SIZE 320
+// Key frames received sooner after the last thumbnail are ignored
+#define SC_THUMBNAILER_MIN_INTERVAL SC_TICK_FROM_MS(500)
+// Packets queued for the thumbnailer (when it runs behind an asynchronous
+// sink) before they are dropped until the next key frame
+#define SC_THUMBNAILER_QUEUE_CAPACITY 64
+
+/**
+ * Video packet sink producing small JPEG thumbnails
+ *
+ * Only the key frames are decoded (with a separate codec context), so a
+ * thumbnail costs one key frame decoding, whatever the frame rate.
+ */
+struct sc_thumbnailer {
+    struct sc_packet_sink packet_sink; // packet sink trait
+
+    // Request a key frame if none has been received for this duration (0 to
+    // never request)
+    sc_tick key_frame_interval;
+
+    // Accessed only from the thread pushing the packets
+    const AVCodec *codec;
+    AVPacket *config; // the latest config packet, NULL if none
+    AVCodecContext *dec_ctx; // NULL until the next key frame
+    AVFrame *frame;
+    struct sc_scaler scaler; // for the current frame and thumbnail sizes
+    AVFrame *scaled;
+    AVCodecContext *enc_ctx; // for the current thumbnail size
+    AVPacket *jpeg;
+    sc_tick last_thumbnail;
+    sc_tick last_key_frame;
+    sc_tick last_request;
+
+    sc_mutex mutex;
+    // The current JPEG thumbnail, protected by the mutex
+    uint8_t *data;
+    size_t size;
+
+    const struct sc_thumbnailer_callbacks *cbs;
+    void *cbs_userdata;
+};
+
+struct sc_thumbnailer_callbacks {
+    // Called from the thread pushing the packets to request a key frame
+    void (*on_key_frame_needed)(struct sc_thumbnailer *thumbnailer,
+                                void *userdata);
+};
+
+bool
+sc_thumbnailer_init(struct sc_thumbnailer *thumbnailer,
+                    sc_tick key_frame_interval,
+                    const struct sc_thumbnailer_callbacks *cbs,
+                    void *cbs_userdata);
+
+void
+sc_thumbnailer_destroy(struct sc_thumbnailer *thumbnailer);
+
+/**
+ * Copy the current JPEG thumbnail (may be called from any thread)
+ *
+ * The caller must free() the buffer. Return false if there is no thumbnail
+ * yet.
+ */
+bool
+sc_thumbnailer_get(struct sc_thumbnailer *thumbnailer, uint8_t **data,
+                   size_t *size);
+
+#endif
@@ -4,6 +4,7 @@
 #include "common.h"
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <libavcodec/avcodec.h>
 
 /**
@@ -22,4 +23,25 @@ struct sc_frame_sink_ops {
     bool (*push)(struct sc_frame_sink *sink, const AVFrame *frame);
 };
 
+/**
+ * A video frame identical to the previous one pushed by the source is marked
+ * (in AVFrame.opaque) as unchanged: the device repeats its last frame while its
+ * screen does not change.
+ *
+ * Such frames are still pushed (they carry the timings), but the sinks may
+ * skip the work that depends only on the content (a sink which did not receive
+ * the previous frame must not skip it).
+ */
+#define SC_FRAME_UNCHANGED ((void *) (uintptr_t) 1)
+
+static inline bool
+sc_frame_is_unchanged(const AVFrame *frame) {
+    return frame->opaque == SC_FRAME_UNCHANGED;
+}
+
+static inline void
+sc_frame_set_unchanged(AVFrame *frame, bool unchanged) {
+    frame->opaque = unchanged ? SC_FRAME_UNCHANGED : NULL;
+}
+
 #endif
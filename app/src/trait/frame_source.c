@@ -1,10 +1,29 @@
 #include "frame_source.h"
 
 #include <assert.h>
+#include <stdlib.h>
+
+#include "util/log.h"
 
 void
 sc_frame_source_init(struct sc_frame_source *source) {
     source->sink_count = 0;
+    atomic_init(&source->dynamic_sinks, NULL);
+    sc_epoch_init(&source->epoch);
+    source->ctx = NULL;
+}
+
+void
+sc_frame_source_destroy(struct sc_frame_source *source) {
+    struct sc_frame_source_sinks *sinks =
+        atomic_load_explicit(&source->dynamic_sinks, memory_order_relaxed);
+    if (sinks) {
+        for (unsigned i = 0; i < sinks->count; ++i) {
+            // Including the detached entries which could not be removed
+            free(sinks->entries[i]);
+        }
+        free(sinks);
+    }
 }
 
 void
@@ -16,6 +35,123 @@ sc_frame_source_add_sink(struct sc_frame_source *source,
     source->sinks[source->sink_count++] = sink;
 }
 
+static struct sc_frame_source_sinks *
+sc_frame_source_sinks_new(unsigned count) {
+    struct sc_frame_source_sinks *sinks =
+        malloc(sizeof(*sinks) + count * sizeof(sinks->entries[0]));
+    if (!sinks) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    sinks->count = count;
+    return sinks;
+}
+
+bool
+sc_frame_source_attach_sink(struct sc_frame_source *source,
+                            struct sc_frame_sink *sink) {
+    assert(sink);
+    assert(sink->ops);
+
+    struct sc_frame_source_entry *entry = malloc(sizeof(*entry));
+    if (!entry) {
+        LOG_OOM();
+        return false;
+    }
+
+    entry->sink = sink;
+    atomic_init(&entry->detached, false);
+    entry->state = SC_FRAME_SOURCE_SINK_PENDING;
+
+    sc_epoch_writer_lock(&source->epoch);
+
+    struct sc_frame_source_sinks *old =
+        atomic_load_explicit(&source->dynamic_sinks, memory_order_relaxed);
+    unsigned count = old ? old->count : 0;
+
+    struct sc_frame_source_sinks *sinks = sc_frame_source_sinks_new(count + 1);
+    if (!sinks) {
+        sc_epoch_writer_unlock(&source->epoch);
+        free(entry);
+        return false;
+    }
+
+    for (unsigned i = 0; i < count; ++i) {
+        // A detached entry may remain (see sc_frame_source_detach_sink())
+        assert(old->entries[i]->sink != sink
+                || atomic_load(&old->entries[i]->detached));
+        sinks->entries[i] = old->entries[i];
+    }
+    sinks->entries[count] = entry;
+
+    atomic_store(&source->dynamic_sinks, sinks);
+    sc_epoch_synchronize(&source->epoch);
+
+    sc_epoch_writer_unlock(&source->epoch);
+
+    free(old);
+    return true;
+}
+
+static void
+sc_frame_source_entry_close(struct sc_frame_source_entry *entry) {
+    if (entry->state == SC_FRAME_SOURCE_SINK_OPEN) {
+        entry->sink->ops->close(entry->sink);
+        entry->state = SC_FRAME_SOURCE_SINK_CLOSED;
+    }
+}
+
+void
+sc_frame_source_detach_sink(struct sc_frame_source *source,
+                            struct sc_frame_sink *sink) {
+    sc_epoch_writer_lock(&source->epoch);
+
+    struct sc_frame_source_sinks *old =
+        atomic_load_explicit(&source->dynamic_sinks, memory_order_relaxed);
+    assert(old);
+
+    unsigned index = 0;
+    while (old->entries[index]->sink != sink
+            || atomic_load(&old->entries[index]->detached)) {
+        ++index;
+        assert(index < old->count);
+    }
+    struct sc_frame_source_entry *entry = old->entries[index];
+
+    struct sc_frame_source_sinks *sinks = NULL;
+    if (old->count > 1) {
+        sinks = sc_frame_source_sinks_new(old->count - 1);
+        if (!sinks) {
+            // The entry cannot be removed, the source thread will skip it
+            atomic_store(&entry->detached, true);
+            sc_epoch_synchronize(&source->epoch);
+            sc_epoch_writer_unlock(&source->epoch);
+
+            sc_frame_source_entry_close(entry);
+            // The entry is freed by sc_frame_source_destroy()
+            return;
+        }
+
+        unsigned j = 0;
+        for (unsigned i = 0; i < old->count; ++i) {
+            if (i != index) {
+                sinks->entries[j++] = old->entries[i];
+            }
+        }
+    }
+
+    atomic_store(&source->dynamic_sinks, sinks);
+    sc_epoch_synchronize(&source->epoch);
+
+    sc_epoch_writer_unlock(&source->epoch);
+
+    // The source thread does not use the entry anymore
+    sc_frame_source_entry_close(entry);
+    free(entry);
+    free(old);
+}
+
 static void
 sc_frame_source_sinks_close_firsts(struct sc_frame_source *source,
                                     unsigned count) {
@@ -28,7 +164,6 @@ sc_frame_source_sinks_close_firsts(struct sc_frame_source *source,
 bool
 sc_frame_source_sinks_open(struct sc_frame_source *source,
                            const AVCodecContext *ctx) {
-    assert(source->sink_count);
     for (unsigned i = 0; i < source->sink_count; ++i) {
         struct sc_frame_sink *sink = source->sinks[i];
         if (!sink->ops->open(sink, ctx)) {
@@ -37,19 +172,90 @@ sc_frame_source_sinks_open(struct sc_frame_source *source,
         }
     }
 
+    // The attached sinks will be opened on the first frame
+    source->ctx = ctx;
     return true;
 }
 
 void
 sc_frame_source_sinks_close(struct sc_frame_source *source) {
-    assert(source->sink_count);
+    sc_epoch_enter(&source->epoch);
+
+    struct sc_frame_source_sinks *sinks = atomic_load(&source->dynamic_sinks);
+    if (sinks) {
+        for (unsigned i = sinks->count; i; --i) {
+            struct sc_frame_source_entry *entry = sinks->entries[i - 1];
+            if (!atomic_load(&entry->detached)) {
+                sc_frame_source_entry_close(entry);
+            }
+        }
+    }
+
+    sc_epoch_exit(&source->epoch);
+
     sc_frame_source_sinks_close_firsts(source, source->sink_count);
+
+    source->ctx = NULL;
+}
+
+// Push the first frame to a sink which has just been opened
+static bool
+sc_frame_source_push_first(struct sc_frame_sink *sink, const AVFrame *frame) {
+    if (!sc_frame_is_unchanged(frame)) {
+        return sink->ops->push(sink, frame);
+    }
+
+    // The sink has never received the previous frame, so this one is not
+    // unchanged for it
+    AVFrame *first = av_frame_alloc();
+    if (!first) {
+        LOG_OOM();
+        return false;
+    }
+
+    if (av_frame_ref(first, frame)) {
+        LOG_OOM();
+        av_frame_free(&first);
+        return false;
+    }
+
+    sc_frame_set_unchanged(first, false);
+    bool ok = sink->ops->push(sink, first);
+    av_frame_free(&first);
+    return ok;
+}
+
+static void
+sc_frame_source_entry_push(struct sc_frame_source *source,
+                           struct sc_frame_source_entry *entry,
+                           const AVFrame *frame) {
+    struct sc_frame_sink *sink = entry->sink;
+
+    bool ok;
+    if (entry->state == SC_FRAME_SOURCE_SINK_PENDING) {
+        assert(source->ctx);
+        if (!sink->ops->open(sink, source->ctx)) {
+            entry->state = SC_FRAME_SOURCE_SINK_FAILED;
+            return;
+        }
+        entry->state = SC_FRAME_SOURCE_SINK_OPEN;
+        ok = sc_frame_source_push_first(sink, frame);
+    } else if (entry->state == SC_FRAME_SOURCE_SINK_OPEN) {
+        ok = sink->ops->push(sink, frame);
+    } else {
+        return;
+    }
+
+    if (!ok) {
+        LOGW("A frame sink failed, detaching it");
+        sc_frame_source_entry_close(entry);
+        entry->state = SC_FRAME_SOURCE_SINK_FAILED;
+    }
 }
 
 bool
 sc_frame_source_sinks_push(struct sc_frame_source *source,
-                            const AVFrame *frame) {
-    assert(source->sink_count);
+                           const AVFrame *frame) {
     for (unsigned i = 0; i < source->sink_count; ++i) {
         struct sc_frame_sink *sink = source->sinks[i];
         if (!sink->ops->push(sink, frame)) {
@@ -57,5 +263,19 @@ sc_frame_source_sinks_push(struct sc_frame_source *source,
         }
     }
 
+    sc_epoch_enter(&source->epoch);
+
+    struct sc_frame_source_sinks *sinks = atomic_load(&source->dynamic_sinks);
+    if (sinks) {
+        for (unsigned i = 0; i < sinks->count; ++i) {
+            struct sc_frame_source_entry *entry = sinks->entries[i];
+            if (!atomic_load(&entry->detached)) {
+                sc_frame_source_entry_push(source, entry, frame);
+            }
+        }
+    }
+
+    sc_epoch_exit(&source->epoch);
+
     return true;
 }
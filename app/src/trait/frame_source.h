@@ -3,29 +3,96 @@
 
 #include "common.h"
 
+#include <stdatomic.h>
 #include <stdbool.h>
 
 #include "trait/frame_sink.h"
+#include "util/epoch.h"
 
 #define SC_FRAME_SOURCE_MAX_SINKS 2
 
+enum sc_frame_source_sink_state {
+    SC_FRAME_SOURCE_SINK_PENDING, // not opened yet
+    SC_FRAME_SOURCE_SINK_OPEN,
+    SC_FRAME_SOURCE_SINK_FAILED, // open() or push() failed, closed
+    SC_FRAME_SOURCE_SINK_CLOSED,
+};
+
+// A sink attached at runtime
+struct sc_frame_source_entry {
+    struct sc_frame_sink *sink;
+    // Set if the entry could not be removed from the list (on allocation
+    // failure), so that the source thread skips it
+    atomic_bool detached;
+    // Accessed only from the source thread (or after the entry has been
+    // removed from the list and the source thread has been synchronized)
+    enum sc_frame_source_sink_state state;
+};
+
+// Immutable once published, replaced on every attach or detach
+struct sc_frame_source_sinks {
+    unsigned count;
+    struct sc_frame_source_entry *entries[];
+};
+
 /**
  * Frame source trait
  *
  * Component able to send AVFrames should implement this trait.
+ *
+ * The sinks added by sc_frame_source_add_sink() before the stream starts are
+ * part of the pipeline: if one of them fails, the stream fails.
+ *
+ * Other sinks may be attached and detached at any time from other threads,
+ * without blocking the source thread. They are opened on the source thread,
+ * on the first frame after they are attached. If one of them fails, it is
+ * closed and does not receive any frames anymore, but the stream continues.
  */
 struct sc_frame_source {
     struct sc_frame_sink *sinks[SC_FRAME_SOURCE_MAX_SINKS];
     unsigned sink_count;
+
+    // Sinks attached at runtime, NULL if none
+    struct sc_frame_source_sinks *_Atomic dynamic_sinks;
+    struct sc_epoch epoch;
+
+    // Accessed only from the source thread
+    const AVCodecContext *ctx; // non-NULL while open
 };
 
 void
 sc_frame_source_init(struct sc_frame_source *source);
 
+/**
+ * Release the sinks still attached at runtime (without closing them)
+ *
+ * The source thread must be terminated.
+ */
+void
+sc_frame_source_destroy(struct sc_frame_source *source);
+
 void
 sc_frame_source_add_sink(struct sc_frame_source *source,
                          struct sc_frame_sink *sink);
 
+/**
+ * Attach a sink at runtime (may be called from any thread but the source
+ * thread, even while streaming)
+ */
+bool
+sc_frame_source_attach_sink(struct sc_frame_source *source,
+                            struct sc_frame_sink *sink);
+
+/**
+ * Detach a sink attached by sc_frame_source_attach_sink()
+ *
+ * On return, the sink is closed (if it was open) and will never be called
+ * anymore by the source. It must not be called from the source thread.
+ */
+void
+sc_frame_source_detach_sink(struct sc_frame_source *source,
+                            struct sc_frame_sink *sink);
+
 bool
 sc_frame_source_sinks_open(struct sc_frame_source *source,
                            const AVCodecContext *ctx);
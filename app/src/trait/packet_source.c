@@ -1,10 +1,30 @@
 #include "packet_source.h"
 
 #include <assert.h>
+#include <stdlib.h>
+
+#include "util/log.h"
 
 void
 sc_packet_source_init(struct sc_packet_source *source) {
     source->sink_count = 0;
+    atomic_init(&source->dynamic_sinks, NULL);
+    sc_epoch_init(&source->epoch);
+    source->ctx = NULL;
+    source->config = NULL;
+}
+
+void
+sc_packet_source_destroy(struct sc_packet_source *source) {
+    struct sc_packet_source_sinks *sinks =
+        atomic_load_explicit(&source->dynamic_sinks, memory_order_relaxed);
+    if (sinks) {
+        for (unsigned i = 0; i < sinks->count; ++i) {
+            // Including the detached entries which could not be removed
+            free(sinks->entries[i]);
+        }
+        free(sinks);
+    }
 }
 
 void
@@ -16,6 +36,124 @@ sc_packet_source_add_sink(struct sc_packet_source *source,
     source->sinks[source->sink_count++] = sink;
 }
 
+static struct sc_packet_source_sinks *
+sc_packet_source_sinks_new(unsigned count) {
+    struct sc_packet_source_sinks *sinks =
+        malloc(sizeof(*sinks) + count * sizeof(sinks->entries[0]));
+    if (!sinks) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    sinks->count = count;
+    return sinks;
+}
+
+bool
+sc_packet_source_attach_sink(struct sc_packet_source *source,
+                             struct sc_packet_sink *sink) {
+    assert(sink);
+    assert(sink->ops);
+
+    struct sc_packet_source_entry *entry = malloc(sizeof(*entry));
+    if (!entry) {
+        LOG_OOM();
+        return false;
+    }
+
+    entry->sink = sink;
+    atomic_init(&entry->detached, false);
+    entry->state = SC_PACKET_SOURCE_SINK_PENDING;
+
+    sc_epoch_writer_lock(&source->epoch);
+
+    struct sc_packet_source_sinks *old =
+        atomic_load_explicit(&source->dynamic_sinks, memory_order_relaxed);
+    unsigned count = old ? old->count : 0;
+
+    struct sc_packet_source_sinks *sinks =
+        sc_packet_source_sinks_new(count + 1);
+    if (!sinks) {
+        sc_epoch_writer_unlock(&source->epoch);
+        free(entry);
+        return false;
+    }
+
+    for (unsigned i = 0; i < count; ++i) {
+        // A detached entry may remain (see sc_packet_source_detach_sink())
+        assert(old->entries[i]->sink != sink
+                || atomic_load(&old->entries[i]->detached));
+        sinks->entries[i] = old->entries[i];
+    }
+    sinks->entries[count] = entry;
+
+    atomic_store(&source->dynamic_sinks, sinks);
+    sc_epoch_synchronize(&source->epoch);
+
+    sc_epoch_writer_unlock(&source->epoch);
+
+    free(old);
+    return true;
+}
+
+static void
+sc_packet_source_entry_close(struct sc_packet_source_entry *entry) {
+    if (entry->state == SC_PACKET_SOURCE_SINK_OPEN) {
+        entry->sink->ops->close(entry->sink);
+        entry->state = SC_PACKET_SOURCE_SINK_CLOSED;
+    }
+}
+
+void
+sc_packet_source_detach_sink(struct sc_packet_source *source,
+                             struct sc_packet_sink *sink) {
+    sc_epoch_writer_lock(&source->epoch);
+
+    struct sc_packet_source_sinks *old =
+        atomic_load_explicit(&source->dynamic_sinks, memory_order_relaxed);
+    assert(old);
+
+    unsigned index = 0;
+    while (old->entries[index]->sink != sink
+            || atomic_load(&old->entries[index]->detached)) {
+        ++index;
+        assert(index < old->count);
+    }
+    struct sc_packet_source_entry *entry = old->entries[index];
+
+    struct sc_packet_source_sinks *sinks = NULL;
+    if (old->count > 1) {
+        sinks = sc_packet_source_sinks_new(old->count - 1);
+        if (!sinks) {
+            // The entry cannot be removed, the source thread will skip it
+            atomic_store(&entry->detached, true);
+            sc_epoch_synchronize(&source->epoch);
+            sc_epoch_writer_unlock(&source->epoch);
+
+            sc_packet_source_entry_close(entry);
+            // The entry is freed by sc_packet_source_destroy()
+            return;
+        }
+
+        unsigned j = 0;
+        for (unsigned i = 0; i < old->count; ++i) {
+            if (i != index) {
+                sinks->entries[j++] = old->entries[i];
+            }
+        }
+    }
+
+    atomic_store(&source->dynamic_sinks, sinks);
+    sc_epoch_synchronize(&source->epoch);
+
+    sc_epoch_writer_unlock(&source->epoch);
+
+    // The source thread does not use the entry anymore
+    sc_packet_source_entry_close(entry);
+    free(entry);
+    free(old);
+}
+
 static void
 sc_packet_source_sinks_close_firsts(struct sc_packet_source *source,
                                     unsigned count) {
@@ -28,7 +166,6 @@ sc_packet_source_sinks_close_firsts(struct sc_packet_source *source,
 bool
 sc_packet_source_sinks_open(struct sc_packet_source *source,
                             AVCodecContext *ctx) {
-    assert(source->sink_count);
     for (unsigned i = 0; i < source->sink_count; ++i) {
         struct sc_packet_sink *sink = source->sinks[i];
         if (!sink->ops->open(sink, ctx)) {
@@ -37,19 +174,96 @@ sc_packet_source_sinks_open(struct sc_packet_source *source,
         }
     }
 
+    // The attached sinks will be opened on the first packet
+    source->ctx = ctx;
     return true;
 }
 
 void
 sc_packet_source_sinks_close(struct sc_packet_source *source) {
-    assert(source->sink_count);
+    sc_epoch_enter(&source->epoch);
+
+    struct sc_packet_source_sinks *sinks =
+        atomic_load(&source->dynamic_sinks);
+    if (sinks) {
+        for (unsigned i = sinks->count; i; --i) {
+            struct sc_packet_source_entry *entry = sinks->entries[i - 1];
+            if (!atomic_load(&entry->detached)) {
+                sc_packet_source_entry_close(entry);
+            }
+        }
+    }
+
+    sc_epoch_exit(&source->epoch);
+
     sc_packet_source_sinks_close_firsts(source, source->sink_count);
+
+    source->ctx = NULL;
+    if (source->config) {
+        av_packet_free(&source->config);
+    }
+}
+
+static void
+sc_packet_source_entry_fail(struct sc_packet_source_entry *entry) {
+    LOGW("A packet sink failed, detaching it");
+    sc_packet_source_entry_close(entry);
+    entry->state = SC_PACKET_SOURCE_SINK_FAILED;
+}
+
+static void
+sc_packet_source_entry_push(struct sc_packet_source *source,
+                            struct sc_packet_source_entry *entry,
+                            const AVPacket *packet) {
+    struct sc_packet_sink *sink = entry->sink;
+
+    if (entry->state == SC_PACKET_SOURCE_SINK_PENDING) {
+        assert(source->ctx);
+        if (!sink->ops->open(sink, source->ctx)) {
+            entry->state = SC_PACKET_SOURCE_SINK_FAILED;
+            return;
+        }
+        entry->state = SC_PACKET_SOURCE_SINK_OPEN;
+
+        // The sink may need the last config packet to decode the stream
+        if (source->config && packet->pts != AV_NOPTS_VALUE
+                && !sink->ops->push(sink, source->config)) {
+            sc_packet_source_entry_fail(entry);
+            return;
+        }
+    }
+
+    if (entry->state == SC_PACKET_SOURCE_SINK_OPEN
+            && !sink->ops->push(sink, packet)) {
+        sc_packet_source_entry_fail(entry);
+    }
+}
+
+static bool
+sc_packet_source_keep_config(struct sc_packet_source *source,
+                             const AVPacket *packet) {
+    if (!source->config) {
+        source->config = av_packet_alloc();
+        if (!source->config) {
+            LOG_OOM();
+            return false;
+        }
+    } else {
+        av_packet_unref(source->config);
+    }
+
+    if (av_packet_ref(source->config, packet)) {
+        LOG_OOM();
+        av_packet_free(&source->config);
+        return false;
+    }
+
+    return true;
 }
 
 bool
 sc_packet_source_sinks_push(struct sc_packet_source *source,
                             const AVPacket *packet) {
-    assert(source->sink_count);
     for (unsigned i = 0; i < source->sink_count; ++i) {
         struct sc_packet_sink *sink = source->sinks[i];
         if (!sink->ops->push(sink, packet)) {
@@ -57,16 +271,58 @@ sc_packet_source_sinks_push(struct sc_packet_source *source,
         }
     }
 
+    sc_epoch_enter(&source->epoch);
+
+    struct sc_packet_source_sinks *sinks =
+        atomic_load(&source->dynamic_sinks);
+    if (sinks) {
+        for (unsigned i = 0; i < sinks->count; ++i) {
+            struct sc_packet_source_entry *entry = sinks->entries[i];
+            if (!atomic_load(&entry->detached)) {
+                sc_packet_source_entry_push(source, entry, packet);
+            }
+        }
+    }
+
+    sc_epoch_exit(&source->epoch);
+
+    if (packet->pts == AV_NOPTS_VALUE) {
+        // Keep the config packet for the sinks attached later
+        if (!sc_packet_source_keep_config(source, packet)) {
+            return false;
+        }
+    }
+
     return true;
 }
 
 void
 sc_packet_source_sinks_disable(struct sc_packet_source *source) {
-    assert(source->sink_count);
     for (unsigned i = 0; i < source->sink_count; ++i) {
         struct sc_packet_sink *sink = source->sinks[i];
         if (sink->ops->disable) {
             sink->ops->disable(sink);
         }
     }
+
+    sc_epoch_enter(&source->epoch);
+
+    struct sc_packet_source_sinks *sinks =
+        atomic_load(&source->dynamic_sinks);
+    if (sinks) {
+        for (unsigned i = 0; i < sinks->count; ++i) {
+            struct sc_packet_source_entry *entry = sinks->entries[i];
+            if (!atomic_load(&entry->detached)
+                    && entry->state == SC_PACKET_SOURCE_SINK_PENDING) {
+                struct sc_packet_sink *sink = entry->sink;
+                if (sink->ops->disable) {
+                    sink->ops->disable(sink);
+                }
+                // Never open it
+                entry->state = SC_PACKET_SOURCE_SINK_CLOSED;
+            }
+        }
+    }
+
+    sc_epoch_exit(&source->epoch);
 }
@@ -0,0 +1,43 @@
+#include "epoch.h"
+
+#include <assert.h>
+
+#include "util/thread.h"
+
+#define SC_EPOCH_POLL_INTERVAL SC_TICK_FROM_MS(1)
+
+void
+sc_epoch_init(struct sc_epoch *epoch) {
+    atomic_init(&epoch->seq, 0);
+    atomic_flag_clear(&epoch->writer_lock);
+}
+
+void
+sc_epoch_writer_lock(struct sc_epoch *epoch) {
+    while (atomic_flag_test_and_set_explicit(&epoch->writer_lock,
+                                             memory_order_acquire)) {
+        sc_thread_sleep(SC_EPOCH_POLL_INTERVAL);
+    }
+}
+
+void
+sc_epoch_writer_unlock(struct sc_epoch *epoch) {
+    atomic_flag_clear_explicit(&epoch->writer_lock, memory_order_release);
+}
+
+void
+sc_epoch_synchronize(struct sc_epoch *epoch) {
+    // seq_cst: the previous store of the new pointer must not be reordered
+    // after this load
+    uint_least64_t seq = atomic_load(&epoch->seq);
+    if (!(seq & 1)) {
+        // The reader was not in a critical section, any future critical
+        // section will see the new pointer
+        return;
+    }
+
+    // Wait for the reader to leave the current critical section
+    while (atomic_load_explicit(&epoch->seq, memory_order_acquire) == seq) {
+        sc_thread_sleep(SC_EPOCH_POLL_INTERVAL);
+    }
+}
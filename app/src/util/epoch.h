@@ -0,0 +1,64 @@
+#ifndef SC_EPOCH_H
+#define SC_EPOCH_H
+
+#include "common.h"
+
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+/**
+ * Epoch-based reclamation between a single reader thread and writers
+ *
+ * The reader never blocks: it only marks the beginning and the end of its
+ * critical sections (two atomic increments). A writer replaces a shared
+ * pointer, then calls sc_epoch_synchronize() to wait until the reader cannot
+ * use the previous value anymore, so that it can be released.
+ *
+ * Writers are serialized by a spinlock: they are expected to be rare and
+ * short.
+ */
+struct sc_epoch {
+    // Odd while the reader is in a critical section
+    atomic_uint_least64_t seq;
+    atomic_flag writer_lock;
+};
+
+void
+sc_epoch_init(struct sc_epoch *epoch);
+
+// Must only be called from the reader thread
+static inline void
+sc_epoch_enter(struct sc_epoch *epoch) {
+    // seq_cst: the following loads of the shared pointers must not be
+    // reordered before the increment
+    uint_least64_t seq = atomic_fetch_add(&epoch->seq, 1);
+    assert(!(seq & 1));
+    (void) seq;
+}
+
+// Must only be called from the reader thread
+static inline void
+sc_epoch_exit(struct sc_epoch *epoch) {
+    uint_least64_t seq =
+        atomic_fetch_add_explicit(&epoch->seq, 1, memory_order_release);
+    assert(seq & 1);
+    (void) seq;
+}
+
+void
+sc_epoch_writer_lock(struct sc_epoch *epoch);
+
+void
+sc_epoch_writer_unlock(struct sc_epoch *epoch);
+
+/**
+ * Wait until the reader has left the critical section it was in (if any)
+ *
+ * Must be called by a writer after it has published a new pointer. It must
+ * never be called from the reader thread (it would wait forever).
+ */
+void
+sc_epoch_synchronize(struct sc_epoch *epoch);
+
+#endif
@@ -0,0 +1,110 @@
+#include "histogram.h"
+
+#include <assert.h>
+
+#define SC_HISTOGRAM_SUB_COUNT (1 << SC_HISTOGRAM_SUB_BITS)
+#define SC_HISTOGRAM_MAX_VALUE ((UINT64_C(1) << SC_HISTOGRAM_MAX_BITS) - 1)
+
+void
+sc_histogram_init(struct sc_histogram *hist) {
+    for (unsigned i = 0; i < SC_HISTOGRAM_BUCKETS; ++i) {
+        atomic_init(&hist->buckets[i], 0);
+    }
+    atomic_init(&hist->max, 0);
+}
+
+static unsigned
+sc_histogram_get_index(uint64_t value) {
+    if (value > SC_HISTOGRAM_MAX_VALUE) {
+        value = SC_HISTOGRAM_MAX_VALUE;
+    }
+
+    if (value < SC_HISTOGRAM_SUB_COUNT) {
+        return value;
+    }
+
+    unsigned msb = SC_HISTOGRAM_SUB_BITS;
+    while (value >> (msb + 1)) {
+        ++msb;
+    }
+
+    // The SC_HISTOGRAM_SUB_BITS bits following the most significant bit
+    // select the bucket within the power of 2
+    unsigned shift = msb - SC_HISTOGRAM_SUB_BITS;
+    unsigned sub = (value >> shift) & (SC_HISTOGRAM_SUB_COUNT - 1);
+    unsigned index = ((shift + 1) << SC_HISTOGRAM_SUB_BITS) + sub;
+    assert(index < SC_HISTOGRAM_BUCKETS);
+    return index;
+}
+
+// Return the highest value recorded in the bucket
+static uint64_t
+sc_histogram_get_bucket_value(unsigned index) {
+    if (index < SC_HISTOGRAM_SUB_COUNT) {
+        return index;
+    }
+
+    unsigned shift = (index >> SC_HISTOGRAM_SUB_BITS) - 1;
+    uint64_t sub = index & (SC_HISTOGRAM_SUB_COUNT - 1);
+    uint64_t lowest = (SC_HISTOGRAM_SUB_COUNT + sub) << shift;
+    return lowest + (UINT64_C(1) << shift) - 1;
+}
+
+void
+sc_histogram_record(struct sc_histogram *hist, uint64_t value) {
+    unsigned index = sc_histogram_get_index(value);
+    atomic_fetch_add_explicit(&hist->buckets[index], 1, memory_order_relaxed);
+
+    uint64_t max = atomic_load_explicit(&hist->max, memory_order_relaxed);
+    while (value > max) {
+        // On failure, max is updated with the current value
+        if (atomic_compare_exchange_weak_explicit(&hist->max, &max, value,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+            break;
+        }
+    }
+}
+
+void
+sc_histogram_get_stats(struct sc_histogram *hist,
+                       struct sc_histogram_stats *stats) {
+    // Work on a copy, so that the percentiles are consistent even if values
+    // are recorded concurrently
+    uint64_t buckets[SC_HISTOGRAM_BUCKETS];
+    uint64_t count = 0;
+    for (unsigned i = 0; i < SC_HISTOGRAM_BUCKETS; ++i) {
+        buckets[i] = atomic_load_explicit(&hist->buckets[i],
+                                          memory_order_relaxed);
+        count += buckets[i];
+    }
+
+    uint64_t max = atomic_load_explicit(&hist->max, memory_order_relaxed);
+
+    static const unsigned percents[] = {50, 95, 99};
+    uint64_t *values[] = {&stats->p50, &stats->p95, &stats->p99};
+    static_assert(ARRAY_LEN(percents) == ARRAY_LEN(values), "Invalid sizes");
+
+    unsigned p = 0;
+    uint64_t cumulated = 0;
+    for (unsigned i = 0; i < SC_HISTOGRAM_BUCKETS && p < ARRAY_LEN(percents);
+            ++i) {
+        cumulated += buckets[i];
+        // The percentile is the value of rank ceil(count * percent / 100)
+        while (p < ARRAY_LEN(percents)
+                && cumulated * 100 >= count * percents[p]) {
+            uint64_t value = sc_histogram_get_bucket_value(i);
+            // The bucket may contain values higher than the max
+            *values[p] = value < max ? value : max;
+            ++p;
+        }
+    }
+
+    if (!count) {
+        // A value may be being recorded (the max is updated after its bucket)
+        max = 0;
+    }
+
+    stats->count = count;
+    stats->max = max;
+}
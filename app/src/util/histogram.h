@@ -0,0 +1,57 @@
+#ifndef SC_HISTOGRAM_H
+#define SC_HISTOGRAM_H
+
+#include "common.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+// Each power of 2 is divided into 2^SC_HISTOGRAM_SUB_BITS buckets, so the
+// relative error of the reported values is at most 1/16
+#define SC_HISTOGRAM_SUB_BITS 4
+// Larger values are recorded as 2^SC_HISTOGRAM_MAX_BITS - 1
+#define SC_HISTOGRAM_MAX_BITS 32
+#define SC_HISTOGRAM_BUCKETS \
+    ((SC_HISTOGRAM_MAX_BITS - SC_HISTOGRAM_SUB_BITS + 1) \
+        << SC_HISTOGRAM_SUB_BITS)
+
+/**
+ * Histogram of non-negative values, with a bounded relative error (like
+ * HdrHistogram)
+ *
+ * The values smaller than 16 are recorded exactly. Above, the bucket width
+ * doubles with each power of 2.
+ *
+ * Values may be recorded from any thread without locking.
+ */
+struct sc_histogram {
+    atomic_uint_least64_t buckets[SC_HISTOGRAM_BUCKETS];
+    atomic_uint_least64_t max;
+};
+
+struct sc_histogram_stats {
+    uint64_t count;
+    // The highest value of the bucket containing the percentile (never more
+    // than the max)
+    uint64_t p50;
+    uint64_t p95;
+    uint64_t p99;
+    uint64_t max;
+};
+
+void
+sc_histogram_init(struct sc_histogram *hist);
+
+void
+sc_histogram_record(struct sc_histogram *hist, uint64_t value);
+
+/**
+ * Compute the percentiles of the values recorded so far
+ *
+ * If no value has been recorded, all the fields are 0.
+ */
+void
+sc_histogram_get_stats(struct sc_histogram *hist,
+                       struct sc_histogram_stats *stats);
+
+#endif
@@ -2,6 +2,7 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
 
 #ifdef _WIN32
 # include <ws2tcpip.h>
@@ -116,12 +117,12 @@ net_perror(const char *s) {
 #endif
 }
 
-sc_socket
-net_socket(void) {
+static sc_socket
+net_socket_type(int type) {
 #ifdef HAVE_SOCK_CLOEXEC
-    sc_raw_socket raw_sock = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sc_raw_socket raw_sock = socket(AF_INET, type | SOCK_CLOEXEC, 0);
 #else
-    sc_raw_socket raw_sock = socket(AF_INET, SOCK_STREAM, 0);
+    sc_raw_socket raw_sock = socket(AF_INET, type, 0);
     if (raw_sock != SC_RAW_SOCKET_NONE && !set_cloexec_flag(raw_sock)) {
         sc_raw_socket_close(raw_sock);
         return SC_SOCKET_NONE;
@@ -135,6 +136,16 @@ net_socket(void) {
     return sock;
 }
 
+sc_socket
+net_socket(void) {
+    return net_socket_type(SOCK_STREAM);
+}
+
+sc_socket
+net_udp_socket(void) {
+    return net_socket_type(SOCK_DGRAM);
+}
+
 bool
 net_connect(sc_socket socket, uint32_t addr, uint16_t port) {
     sc_raw_socket raw_sock = unwrap(socket);
@@ -235,6 +246,53 @@ net_send_all(sc_socket socket, const void *buf, size_t len) {
     return copied;
 }
 
+ssize_t
+net_send_datagrams(sc_socket socket, const struct sc_net_datagram *datagrams,
+                   size_t count) {
+#ifdef HAVE_SENDMMSG
+    sc_raw_socket raw_sock = unwrap(socket);
+
+    // Send by batches, to keep the message headers on the stack
+# define SC_NET_DATAGRAM_BATCH 32
+    struct mmsghdr msgs[SC_NET_DATAGRAM_BATCH];
+    struct iovec iovs[SC_NET_DATAGRAM_BATCH];
+
+    size_t sent = 0;
+    while (sent < count) {
+        size_t batch = count - sent;
+        if (batch > SC_NET_DATAGRAM_BATCH) {
+            batch = SC_NET_DATAGRAM_BATCH;
+        }
+
+        memset(msgs, 0, batch * sizeof(*msgs));
+        for (size_t i = 0; i < batch; ++i) {
+            iovs[i].iov_base = (void *) datagrams[sent + i].data;
+            iovs[i].iov_len = datagrams[sent + i].len;
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int r = sendmmsg(raw_sock, msgs, batch, 0);
+        if (r <= 0) {
+            return sent ? (ssize_t) sent : -1;
+        }
+        sent += r;
+    }
+# undef SC_NET_DATAGRAM_BATCH
+
+    return sent;
+#else
+    for (size_t i = 0; i < count; ++i) {
+        ssize_t w = net_send(socket, datagrams[i].data, datagrams[i].len);
+        if (w == -1) {
+            return i ? (ssize_t) i : -1;
+        }
+    }
+
+    return count;
+#endif
+}
+
 bool
 net_interrupt(sc_socket socket) {
     assert(socket != SC_SOCKET_NONE);
@@ -51,6 +51,9 @@ net_cleanup(void);
 sc_socket
 net_socket(void);
 
+sc_socket
+net_udp_socket(void);
+
 bool
 net_connect(sc_socket socket, uint32_t addr, uint16_t port);
 
@@ -73,6 +76,18 @@ net_send(sc_socket socket, const void *buf, size_t len);
 ssize_t
 net_send_all(sc_socket socket, const void *buf, size_t len);
 
+struct sc_net_datagram {
+    const void *data;
+    size_t len;
+};
+
+// Send several datagrams on a connected UDP socket, in as few system calls as
+// possible (using sendmmsg() if available).
+// Return the number of datagrams sent, or -1 on error.
+ssize_t
+net_send_datagrams(sc_socket socket, const struct sc_net_datagram *datagrams,
+                   size_t count);
+
 // Shutdown the socket (or close on Windows) so that any blocking send() or
 // recv() are interrupted.
 bool
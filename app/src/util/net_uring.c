@@ -0,0 +1,386 @@
+#include "net_uring.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+
+#define SC_NET_URING_ENTRIES 64
+
+static inline uint8_t *
+sc_net_uring_buf(struct sc_net_uring_stream *stream, uint16_t bid) {
+    return &stream->bufs[(size_t) bid * SC_NET_URING_BUF_SIZE];
+}
+
+// Must be called with the mutex locked
+static struct io_uring_sqe *
+sc_net_uring_get_sqe(struct sc_net_uring *uring) {
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&uring->ring);
+    if (!sqe) {
+        // The submission queue is full, flush it
+        io_uring_submit(&uring->ring);
+        sqe = io_uring_get_sqe(&uring->ring);
+    }
+    return sqe;
+}
+
+// Must be called with the mutex locked
+static bool
+sc_net_uring_stream_arm(struct sc_net_uring_stream *stream) {
+    struct sc_net_uring *uring = stream->uring;
+
+    struct io_uring_sqe *sqe = sc_net_uring_get_sqe(uring);
+    if (!sqe) {
+        LOGE("io_uring: no submission entry available");
+        return false;
+    }
+
+    // Receive continuously into the buffers provided by the buffer ring
+    io_uring_prep_recv_multishot(sqe, stream->socket, NULL, 0, 0);
+    sqe->flags |= IOSQE_BUFFER_SELECT;
+    sqe->buf_group = stream->buf_group;
+    io_uring_sqe_set_data(sqe, stream);
+
+    int r = io_uring_submit(&uring->ring);
+    if (r < 0) {
+        LOGE("io_uring: could not submit receive: %s", strerror(-r));
+        return false;
+    }
+
+    stream->armed = true;
+    stream->starved = false;
+    return true;
+}
+
+// Must be called with the mutex locked
+static void
+sc_net_uring_return_buf(struct sc_net_uring_stream *stream, uint16_t bid) {
+    io_uring_buf_ring_add(stream->buf_ring, sc_net_uring_buf(stream, bid),
+                          SC_NET_URING_BUF_SIZE, bid,
+                          io_uring_buf_ring_mask(SC_NET_URING_BUF_COUNT), 0);
+    io_uring_buf_ring_advance(stream->buf_ring, 1);
+
+    // A buffer is available, resume the stream if it was starved (the other
+    // streams have their own buffers)
+    if (stream->starved && !stream->closing
+            && !sc_net_uring_stream_arm(stream)) {
+        stream->eos = true;
+        sc_cond_signal(&stream->cond);
+    }
+}
+
+// Must be called with the mutex locked
+static uint16_t
+sc_net_uring_alloc_buf_group(struct sc_net_uring *uring) {
+    // The smallest group id not used by any open stream
+    uint16_t group = 0;
+    struct sc_net_uring_stream *s = uring->streams;
+    while (s) {
+        if (s->buf_group == group) {
+            ++group;
+            // Restart the search
+            s = uring->streams;
+        } else {
+            s = s->next;
+        }
+    }
+    return group;
+}
+
+// Must be called with the mutex locked
+static void
+sc_net_uring_process_cqe(struct sc_net_uring_stream *stream,
+                         const struct io_uring_cqe *cqe) {
+    if (cqe->res > 0) {
+        assert(cqe->flags & IORING_CQE_F_BUFFER);
+        uint16_t bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        struct sc_net_uring_chunk chunk = {
+            .bid = bid,
+            .len = cqe->res,
+        };
+        if (stream->closing) {
+            sc_net_uring_return_buf(stream, bid);
+        } else if (!sc_vecdeque_push(&stream->chunks, chunk)) {
+            LOG_OOM();
+            sc_net_uring_return_buf(stream, bid);
+            stream->eos = true;
+        }
+    } else if (cqe->res == 0) {
+        // end of stream
+        stream->eos = true;
+    } else if (cqe->res == -ENOBUFS) {
+        // The completions of the stream are processed in order, so all the
+        // buffers filled before are already queued
+        if (sc_vecdeque_size(&stream->chunks) == SC_NET_URING_BUF_COUNT) {
+            // Resumed as soon as the reader returns a buffer
+            stream->starved = true;
+        }
+        // Otherwise the reader has returned some buffers meanwhile (while the
+        // stream was not starved yet), the receive is re-armed below
+    } else if (cqe->res != -ECANCELED) {
+        LOGE("io_uring: receive error: %s", strerror(-cqe->res));
+        stream->eos = true;
+    }
+
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        // The multishot receive is terminated
+        stream->armed = false;
+        if (!stream->eos && !stream->starved && !stream->closing) {
+            // Terminated for another reason (e.g. the completion queue
+            // overflowed), re-arm it
+            if (!sc_net_uring_stream_arm(stream)) {
+                stream->eos = true;
+            }
+        }
+    }
+
+    sc_cond_signal(&stream->cond);
+}
+
+static int
+run_net_uring(void *data) {
+    struct sc_net_uring *uring = data;
+
+    bool stopped = false;
+    while (!stopped) {
+        struct io_uring_cqe *cqe;
+        int r = io_uring_wait_cqe(&uring->ring, &cqe);
+        if (r == -EINTR) {
+            continue;
+        }
+
+        sc_mutex_lock(&uring->mutex);
+
+        if (r < 0) {
+            LOGE("io_uring: could not wait for completion: %s", strerror(-r));
+            for (struct sc_net_uring_stream *s = uring->streams; s;
+                    s = s->next) {
+                s->eos = true;
+                s->armed = false;
+                sc_cond_signal(&s->cond);
+            }
+            sc_mutex_unlock(&uring->mutex);
+            break;
+        }
+
+        // Process all the available completions at once
+        unsigned head;
+        unsigned count = 0;
+        io_uring_for_each_cqe(&uring->ring, head, cqe) {
+            ++count;
+            void *userdata = io_uring_cqe_get_data(cqe);
+            if (userdata == uring) {
+                // stop request
+                stopped = true;
+            } else if (userdata) {
+                sc_net_uring_process_cqe(userdata, cqe);
+            } // else completion of a cancel request, ignore it
+        }
+        io_uring_cq_advance(&uring->ring, count);
+
+        sc_mutex_unlock(&uring->mutex);
+    }
+
+    return 0;
+}
+
+bool
+sc_net_uring_init(struct sc_net_uring *uring) {
+    int r = io_uring_queue_init(SC_NET_URING_ENTRIES, &uring->ring, 0);
+    if (r < 0) {
+        LOGW("io_uring not available: %s", strerror(-r));
+        return false;
+    }
+
+    bool ok = sc_mutex_init(&uring->mutex);
+    if (!ok) {
+        goto error_queue_exit;
+    }
+
+    uring->streams = NULL;
+
+    ok = sc_thread_create(&uring->thread, run_net_uring, "scrcpy-uring",
+                          uring);
+    if (!ok) {
+        LOGE("Could not start io_uring thread");
+        goto error_destroy_mutex;
+    }
+
+    return true;
+
+error_destroy_mutex:
+    sc_mutex_destroy(&uring->mutex);
+error_queue_exit:
+    io_uring_queue_exit(&uring->ring);
+
+    return false;
+}
+
+void
+sc_net_uring_destroy(struct sc_net_uring *uring) {
+    sc_mutex_lock(&uring->mutex);
+    assert(!uring->streams);
+    struct io_uring_sqe *sqe = sc_net_uring_get_sqe(uring);
+    assert(sqe);
+    // An empty request, to wake up the completion thread
+    io_uring_prep_nop(sqe);
+    io_uring_sqe_set_data(sqe, uring);
+    io_uring_submit(&uring->ring);
+    sc_mutex_unlock(&uring->mutex);
+
+    sc_thread_join(&uring->thread, NULL);
+
+    sc_mutex_destroy(&uring->mutex);
+    io_uring_queue_exit(&uring->ring);
+}
+
+bool
+sc_net_uring_stream_open(struct sc_net_uring_stream *stream,
+                         struct sc_net_uring *uring, sc_socket socket) {
+    bool ok = sc_cond_init(&stream->cond);
+    if (!ok) {
+        return false;
+    }
+
+    stream->bufs = malloc(SC_NET_URING_BUF_COUNT * SC_NET_URING_BUF_SIZE);
+    if (!stream->bufs) {
+        LOG_OOM();
+        sc_cond_destroy(&stream->cond);
+        return false;
+    }
+
+    stream->uring = uring;
+    stream->socket = socket;
+    sc_vecdeque_init(&stream->chunks);
+    stream->pos = 0;
+    stream->armed = false;
+    stream->starved = false;
+    stream->eos = false;
+    stream->closing = false;
+
+    sc_mutex_lock(&uring->mutex);
+
+    stream->buf_group = sc_net_uring_alloc_buf_group(uring);
+
+    int r;
+    stream->buf_ring = io_uring_setup_buf_ring(&uring->ring,
+                                               SC_NET_URING_BUF_COUNT,
+                                               stream->buf_group, 0, &r);
+    if (!stream->buf_ring) {
+        // Requires Linux >= 5.19
+        LOGW("io_uring buffer ring not available: %s", strerror(-r));
+        goto error_unlock;
+    }
+
+    int mask = io_uring_buf_ring_mask(SC_NET_URING_BUF_COUNT);
+    for (unsigned i = 0; i < SC_NET_URING_BUF_COUNT; ++i) {
+        io_uring_buf_ring_add(stream->buf_ring, sc_net_uring_buf(stream, i),
+                              SC_NET_URING_BUF_SIZE, i, mask, i);
+    }
+    io_uring_buf_ring_advance(stream->buf_ring, SC_NET_URING_BUF_COUNT);
+
+    ok = sc_net_uring_stream_arm(stream);
+    if (!ok) {
+        goto error_free_buf_ring;
+    }
+
+    stream->next = uring->streams;
+    uring->streams = stream;
+
+    sc_mutex_unlock(&uring->mutex);
+
+    return true;
+
+error_free_buf_ring:
+    io_uring_free_buf_ring(&uring->ring, stream->buf_ring,
+                           SC_NET_URING_BUF_COUNT, stream->buf_group);
+error_unlock:
+    sc_mutex_unlock(&uring->mutex);
+    free(stream->bufs);
+    sc_cond_destroy(&stream->cond);
+
+    return false;
+}
+
+void
+sc_net_uring_stream_close(struct sc_net_uring_stream *stream) {
+    struct sc_net_uring *uring = stream->uring;
+
+    sc_mutex_lock(&uring->mutex);
+    stream->closing = true;
+
+    if (stream->armed) {
+        struct io_uring_sqe *sqe = sc_net_uring_get_sqe(uring);
+        if (sqe) {
+            io_uring_prep_cancel(sqe, stream, 0);
+            io_uring_sqe_set_data(sqe, NULL);
+            io_uring_submit(&uring->ring);
+        }
+
+        // The stream must not be referenced by any pending request once
+        // closed
+        while (stream->armed) {
+            sc_cond_wait(&stream->cond, &uring->mutex);
+        }
+    }
+
+    while (!sc_vecdeque_is_empty(&stream->chunks)) {
+        struct sc_net_uring_chunk chunk = sc_vecdeque_pop(&stream->chunks);
+        sc_net_uring_return_buf(stream, chunk.bid);
+    }
+
+    struct sc_net_uring_stream **pnext = &uring->streams;
+    while (*pnext != stream) {
+        pnext = &(*pnext)->next;
+    }
+    *pnext = stream->next;
+
+    // No request references the buffers anymore
+    io_uring_free_buf_ring(&uring->ring, stream->buf_ring,
+                           SC_NET_URING_BUF_COUNT, stream->buf_group);
+
+    sc_mutex_unlock(&uring->mutex);
+
+    free(stream->bufs);
+    sc_vecdeque_destroy(&stream->chunks);
+    sc_cond_destroy(&stream->cond);
+}
+
+ssize_t
+sc_net_uring_stream_recv_all(struct sc_net_uring_stream *stream, void *buf,
+                             size_t len) {
+    struct sc_net_uring *uring = stream->uring;
+    uint8_t *out = buf;
+    size_t copied = 0;
+
+    sc_mutex_lock(&uring->mutex);
+    while (copied < len) {
+        if (sc_vecdeque_is_empty(&stream->chunks)) {
+            if (stream->eos) {
+                break;
+            }
+            sc_cond_wait(&stream->cond, &uring->mutex);
+            continue;
+        }
+
+        struct sc_net_uring_chunk *chunk = sc_vecdeque_peekref(&stream->chunks);
+        size_t n = MIN(len - copied, chunk->len - stream->pos);
+        memcpy(out + copied, sc_net_uring_buf(stream, chunk->bid) + stream->pos,
+               n);
+        copied += n;
+        stream->pos += n;
+
+        if (stream->pos == chunk->len) {
+            // The chunk is consumed, give the buffer back to the kernel
+            uint16_t bid = chunk->bid;
+            (void) sc_vecdeque_popref(&stream->chunks);
+            stream->pos = 0;
+            sc_net_uring_return_buf(stream, bid);
+        }
+    }
+    sc_mutex_unlock(&uring->mutex);
+
+    return copied;
+}
@@ -0,0 +1,108 @@
+#ifndef SC_NET_URING_H
+#define SC_NET_URING_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <liburing.h>
+
+#include "util/net.h"
+#include "util/thread.h"
+#include "util/vecdeque.h"
+
+/**
+ * io_uring receive engine (Linux only)
+ *
+ * A single ring, with a single completion thread, receives the data of
+ * several sockets (possibly of several sessions). Each socket is read by a
+ * multishot receive into buffers registered to the kernel (a buffer ring), so
+ * that a continuous stream does not require any syscall to be received.
+ *
+ * The filled buffers are queued for the reader of each socket, and returned to
+ * the kernel once consumed.
+ *
+ * Each socket has its own buffer ring (like its own kernel receive buffer): a
+ * reader which does not consume its data (e.g. blocked by a slow sink) only
+ * stops the receive of its own socket, not the others.
+ */
+
+#define SC_NET_URING_BUF_COUNT 64 // per stream, must be a power of 2
+#define SC_NET_URING_BUF_SIZE 16384
+
+struct sc_net_uring_chunk {
+    uint16_t bid; // buffer id
+    uint32_t len;
+};
+
+struct sc_net_uring_chunk_queue SC_VECDEQUE(struct sc_net_uring_chunk);
+
+struct sc_net_uring_stream {
+    struct sc_net_uring *uring;
+    sc_socket socket;
+    sc_cond cond;
+
+    struct io_uring_buf_ring *buf_ring;
+    uint8_t *bufs;
+    uint16_t buf_group; // buffer group id, unique among the open streams
+
+    // all the fields below are protected by uring->mutex
+
+    struct sc_net_uring_chunk_queue chunks;
+    uint32_t pos; // read position in the first chunk
+
+    bool armed; // a multishot receive is pending
+    bool starved; // the receive stopped because no buffer was available
+    bool eos;
+    bool closing;
+
+    struct sc_net_uring_stream *next;
+};
+
+struct sc_net_uring {
+    struct io_uring ring;
+
+    sc_thread thread;
+    sc_mutex mutex;
+    struct sc_net_uring_stream *streams; // linked list
+};
+
+/**
+ * Initialize the ring and start its completion thread
+ *
+ * Return false if io_uring is not available (the caller should fall back to
+ * blocking reads).
+ */
+bool
+sc_net_uring_init(struct sc_net_uring *uring);
+
+// All the streams must be closed
+void
+sc_net_uring_destroy(struct sc_net_uring *uring);
+
+/**
+ * Start receiving from the socket
+ *
+ * Return false if it fails, in particular if buffer rings are not supported
+ * (Linux < 5.19): the caller should fall back to blocking reads.
+ */
+bool
+sc_net_uring_stream_open(struct sc_net_uring_stream *stream,
+                         struct sc_net_uring *uring, sc_socket socket);
+
+void
+sc_net_uring_stream_close(struct sc_net_uring_stream *stream);
+
+/**
+ * Read exactly len bytes (like net_recv_all())
+ *
+ * Return the number of bytes read, which is less than len on end of stream or
+ * error.
+ */
+ssize_t
+sc_net_uring_stream_recv_all(struct sc_net_uring_stream *stream, void *buf,
+                             size_t len);
+
+#endif
@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <SDL2/SDL_thread.h>
+#include <SDL2/SDL_timer.h>
 
 #include "util/log.h"
 
@@ -60,11 +61,22 @@ sc_thread_set_priority(enum sc_thread_priority priority) {
     return true;
 }
 
+void
+sc_thread_sleep(sc_tick duration) {
+    assert(duration >= 0);
+    SDL_Delay(SC_TICK_TO_MS(duration));
+}
+
 void
 sc_thread_join(sc_thread *thread, int *status) {
     SDL_WaitThread(thread->thread, status);
 }
 
+void
+sc_thread_detach(sc_thread *thread) {
+    SDL_DetachThread(thread->thread);
+}
+
 bool
 sc_mutex_init(sc_mutex *mutex) {
     SDL_mutex *sdl_mutex = SDL_CreateMutex();
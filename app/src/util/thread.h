@@ -48,9 +48,18 @@ sc_thread_create(sc_thread *thread, sc_thread_fn fn, const char *name,
 void
 sc_thread_join(sc_thread *thread, int *status);
 
+// The thread resources are released on exit, it must not be joined
+void
+sc_thread_detach(sc_thread *thread);
+
 bool
 sc_thread_set_priority(enum sc_thread_priority priority);
 
+// Suspend the current thread for (at least) the given duration (rounded to
+// milliseconds)
+void
+sc_thread_sleep(sc_tick duration);
+
 bool
 sc_mutex_init(sc_mutex *mutex);
 
@@ -14,6 +14,10 @@
 
 static const AVRational SCRCPY_TIME_BASE = {1, 1000000}; // timestamps in us
 
+// Unchanged frames are skipped, but still written at this interval for the
+// readers expecting a minimal frame rate
+#define SC_V4L2_UNCHANGED_FRAME_INTERVAL SC_TICK_FROM_SEC(1)
+
 static const AVOutputFormat *
 find_muxer(const char *name) {
 #ifdef SCRCPY_LAVF_HAS_NEW_MUXER_ITERATOR_API
@@ -255,6 +259,7 @@ sc_v4l2_sink_open(struct sc_v4l2_sink *vs, const AVCodecContext *ctx) {
 
     vs->has_frame = false;
     vs->header_written = false;
+    vs->last_push = 0;
     vs->stopped = false;
 
     LOGD("Starting v4l2 thread");
@@ -309,6 +314,14 @@ sc_v4l2_sink_close(struct sc_v4l2_sink *vs) {
 
 static bool
 sc_v4l2_sink_push(struct sc_v4l2_sink *vs, const AVFrame *frame) {
+    sc_tick now = sc_tick_now();
+    if (sc_frame_is_unchanged(frame) && vs->last_push
+            && now - vs->last_push < SC_V4L2_UNCHANGED_FRAME_INTERVAL) {
+        // Nothing new to encode and write
+        return true;
+    }
+    vs->last_push = now;
+
     bool previous_skipped;
     bool ok = sc_frame_buffer_push(&vs->fb, frame, &previous_skipped);
     if (!ok) {
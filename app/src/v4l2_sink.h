@@ -10,6 +10,11 @@
 #include "frame_buffer.h"
 #include "trait/frame_sink.h"
 #include "util/thread.h"
+#include "util/tick.h"
+
+// Frames queued for the v4l2 delay buffer (when it runs behind an asynchronous
+// sink) before the oldest ones are dropped
+#define SC_V4L2_QUEUE_CAPACITY 8
 
 struct sc_v4l2_sink {
     struct sc_frame_sink frame_sink; // frame sink trait
@@ -26,6 +31,7 @@ struct sc_v4l2_sink {
     bool has_frame;
     bool stopped;
     bool header_written;
+    sc_tick last_push; // accessed only from the frame source thread
 
     AVFrame *frame;
     AVPacket *packet;
@@ -0,0 +1,240 @@
+#include "vsync_scheduler.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stddef.h>
+
+#include "util/log.h"
+
+// The presentation is requested this fraction of the refresh period before the
+// vblank, to leave time to upload and render the frame
+#define SC_VSYNC_MARGIN_DIVISOR 4
+
+// Presentations farther apart mean that the stream was idle, they are not
+// counted as repeated frames
+#define SC_VSYNC_MAX_REPEAT_INTERVAL SC_TICK_FROM_SEC(1)
+
+bool
+sc_vsync_scheduler_init(struct sc_vsync_scheduler *scheduler,
+                        const struct sc_vsync_scheduler_callbacks *cbs,
+                        void *cbs_userdata) {
+    bool ok = sc_mutex_init(&scheduler->mutex);
+    if (!ok) {
+        return false;
+    }
+
+    ok = sc_cond_init(&scheduler->cond);
+    if (!ok) {
+        sc_mutex_destroy(&scheduler->mutex);
+        return false;
+    }
+
+    scheduler->thread_started = false;
+    scheduler->stopped = false;
+    scheduler->frame_available = false;
+    scheduler->refresh_rate = SC_VSYNC_DEFAULT_REFRESH_RATE;
+    scheduler->period = SC_TICK_FREQ / SC_VSYNC_DEFAULT_REFRESH_RATE;
+    scheduler->last_vblank = 0;
+    scheduler->target_vblank = 0;
+    scheduler->last_present = 0;
+
+    atomic_init(&scheduler->presented, 0);
+    atomic_init(&scheduler->late, 0);
+    atomic_init(&scheduler->dropped, 0);
+    atomic_init(&scheduler->repeated, 0);
+
+    assert(cbs && cbs->on_present);
+    scheduler->cbs = cbs;
+    scheduler->cbs_userdata = cbs_userdata;
+
+    return true;
+}
+
+void
+sc_vsync_scheduler_destroy(struct sc_vsync_scheduler *scheduler) {
+    sc_cond_destroy(&scheduler->cond);
+    sc_mutex_destroy(&scheduler->mutex);
+}
+
+// Return the vblank to target for a frame available at "now"
+//
+// Must be called with the mutex locked.
+static sc_tick
+sc_vsync_scheduler_next_vblank(struct sc_vsync_scheduler *scheduler,
+                               sc_tick now) {
+    sc_tick period = scheduler->period;
+    sc_tick margin = period / SC_VSYNC_MARGIN_DIVISOR;
+
+    if (!scheduler->last_vblank) {
+        // Unknown phase, present immediately
+        return now + margin;
+    }
+
+    sc_tick vblank = scheduler->last_vblank + period;
+    if (vblank < now + margin) {
+        // Skip the vblanks too close (or already passed)
+        vblank += ((now + margin - vblank) / period + 1) * period;
+    }
+
+    return vblank;
+}
+
+static int
+run_vsync_scheduler(void *data) {
+    struct sc_vsync_scheduler *scheduler = data;
+
+    sc_mutex_lock(&scheduler->mutex);
+    for (;;) {
+        while (!scheduler->stopped && !scheduler->frame_available) {
+            sc_cond_wait(&scheduler->cond, &scheduler->mutex);
+        }
+
+        if (scheduler->stopped) {
+            break;
+        }
+
+        sc_tick vblank =
+            sc_vsync_scheduler_next_vblank(scheduler, sc_tick_now());
+        sc_tick deadline =
+            vblank - scheduler->period / SC_VSYNC_MARGIN_DIVISOR;
+
+        bool timed_out = false;
+        while (!scheduler->stopped && !timed_out) {
+            timed_out = !sc_cond_timedwait(&scheduler->cond,
+                                           &scheduler->mutex, deadline);
+        }
+
+        if (scheduler->stopped) {
+            break;
+        }
+
+        // The frames received meanwhile replaced the available one, the
+        // latest one will be presented
+        scheduler->frame_available = false;
+        scheduler->target_vblank = vblank;
+
+        sc_mutex_unlock(&scheduler->mutex);
+        scheduler->cbs->on_present(scheduler, scheduler->cbs_userdata);
+        sc_mutex_lock(&scheduler->mutex);
+    }
+    sc_mutex_unlock(&scheduler->mutex);
+
+    return 0;
+}
+
+bool
+sc_vsync_scheduler_start(struct sc_vsync_scheduler *scheduler) {
+    bool ok = sc_thread_create(&scheduler->thread, run_vsync_scheduler,
+                               "scrcpy-vsync", scheduler);
+    if (!ok) {
+        LOGE("Could not start vsync scheduler thread");
+        return false;
+    }
+
+    scheduler->thread_started = true;
+    return true;
+}
+
+void
+sc_vsync_scheduler_stop(struct sc_vsync_scheduler *scheduler) {
+    sc_mutex_lock(&scheduler->mutex);
+    scheduler->stopped = true;
+    sc_cond_signal(&scheduler->cond);
+    sc_mutex_unlock(&scheduler->mutex);
+}
+
+void
+sc_vsync_scheduler_join(struct sc_vsync_scheduler *scheduler) {
+    if (!scheduler->thread_started) {
+        return;
+    }
+
+    sc_thread_join(&scheduler->thread, NULL);
+
+    struct sc_vsync_stats stats;
+    sc_vsync_scheduler_get_stats(scheduler, &stats);
+    LOGD("Vsync: %" PRIu64 " frames presented, %" PRIu64 " late, %" PRIu64
+         " dropped, %" PRIu64 " repeated", stats.presented, stats.late,
+         stats.dropped, stats.repeated);
+}
+
+void
+sc_vsync_scheduler_set_refresh_rate(struct sc_vsync_scheduler *scheduler,
+                                    unsigned refresh_rate) {
+    assert(refresh_rate);
+
+    sc_mutex_lock(&scheduler->mutex);
+    if (refresh_rate != scheduler->refresh_rate) {
+        scheduler->refresh_rate = refresh_rate;
+        scheduler->period = SC_TICK_FREQ / refresh_rate;
+        // The phase must be measured again
+        scheduler->last_vblank = 0;
+        LOGI("Presentation synchronized to %u Hz", refresh_rate);
+    }
+    sc_mutex_unlock(&scheduler->mutex);
+}
+
+void
+sc_vsync_scheduler_notify_frame(struct sc_vsync_scheduler *scheduler,
+                                bool previous_dropped) {
+    if (previous_dropped) {
+        atomic_fetch_add_explicit(&scheduler->dropped, 1,
+                                  memory_order_relaxed);
+        // A presentation is already requested (or pending), it will present
+        // this new frame instead
+        return;
+    }
+
+    sc_mutex_lock(&scheduler->mutex);
+    scheduler->frame_available = true;
+    sc_cond_signal(&scheduler->cond);
+    sc_mutex_unlock(&scheduler->mutex);
+}
+
+void
+sc_vsync_scheduler_on_presented(struct sc_vsync_scheduler *scheduler) {
+    sc_tick now = sc_tick_now();
+
+    sc_mutex_lock(&scheduler->mutex);
+    sc_tick period = scheduler->period;
+    sc_tick target_vblank = scheduler->target_vblank;
+    // With vsync, the presentation returns just after the vblank
+    scheduler->last_vblank = now;
+    scheduler->target_vblank = 0;
+    sc_mutex_unlock(&scheduler->mutex);
+
+    atomic_fetch_add_explicit(&scheduler->presented, 1, memory_order_relaxed);
+
+    if (target_vblank && now > target_vblank + period / 2) {
+        atomic_fetch_add_explicit(&scheduler->late, 1, memory_order_relaxed);
+    }
+
+    if (scheduler->last_present) {
+        sc_tick elapsed = now - scheduler->last_present;
+        if (elapsed < SC_VSYNC_MAX_REPEAT_INTERVAL) {
+            // Number of vblanks since the previous presentation (rounded)
+            uint64_t vblanks = (elapsed + period / 2) / period;
+            if (vblanks > 1) {
+                atomic_fetch_add_explicit(&scheduler->repeated, vblanks - 1,
+                                          memory_order_relaxed);
+            }
+        }
+    }
+    scheduler->last_present = now;
+}
+
+void
+sc_vsync_scheduler_get_stats(struct sc_vsync_scheduler *scheduler,
+                             struct sc_vsync_stats *stats) {
+    sc_mutex_lock(&scheduler->mutex);
+    stats->refresh_rate = scheduler->refresh_rate;
+    sc_mutex_unlock(&scheduler->mutex);
+
+    stats->presented =
+        atomic_load_explicit(&scheduler->presented, memory_order_relaxed);
+    stats->late = atomic_load_explicit(&scheduler->late, memory_order_relaxed);
+    stats->dropped =
+        atomic_load_explicit(&scheduler->dropped, memory_order_relaxed);
+    stats->repeated =
+        atomic_load_explicit(&scheduler->repeated, memory_order_relaxed);
+}
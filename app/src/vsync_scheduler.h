@@ -0,0 +1,109 @@
+#ifndef SC_VSYNC_SCHEDULER_H
+#define SC_VSYNC_SCHEDULER_H
+
+#include "common.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "util/thread.h"
+#include "util/tick.h"
+
+// Refresh rate assumed if the display does not report it
+#define SC_VSYNC_DEFAULT_REFRESH_RATE 60
+
+/**
+ * Presentation scheduler, to render at most one frame per display refresh
+ *
+ * Instead of rendering each frame as soon as it is decoded, the screen
+ * notifies the scheduler, which requests a presentation just before the next
+ * vertical blank. The latest frame is then rendered, and presented with vsync.
+ *
+ * The vblank phase is estimated from the time the (vsync) presentation
+ * returns.
+ */
+struct sc_vsync_scheduler {
+    sc_thread thread;
+    sc_mutex mutex;
+    sc_cond cond;
+    bool thread_started;
+
+    // protected by the mutex
+    bool stopped;
+    bool frame_available;
+    unsigned refresh_rate;
+    sc_tick period;
+    sc_tick last_vblank; // estimated, 0 if unknown
+    sc_tick target_vblank; // targeted by the requested presentation, or 0
+
+    // accessed only from the presenting thread
+    sc_tick last_present;
+
+    // statistics, readable from any thread
+    atomic_uint_least64_t presented;
+    atomic_uint_least64_t late;
+    atomic_uint_least64_t dropped;
+    atomic_uint_least64_t repeated;
+
+    const struct sc_vsync_scheduler_callbacks *cbs;
+    void *cbs_userdata;
+};
+
+struct sc_vsync_scheduler_callbacks {
+    // Called from the scheduler thread when the latest frame must be rendered
+    // and presented
+    void (*on_present)(struct sc_vsync_scheduler *scheduler, void *userdata);
+};
+
+struct sc_vsync_stats {
+    unsigned refresh_rate;
+    uint64_t presented;
+    uint64_t late; // presented after the targeted vblank
+    uint64_t dropped; // replaced by a newer frame before being presented
+    uint64_t repeated; // vblanks presenting the previous frame again
+};
+
+bool
+sc_vsync_scheduler_init(struct sc_vsync_scheduler *scheduler,
+                        const struct sc_vsync_scheduler_callbacks *cbs,
+                        void *cbs_userdata);
+
+void
+sc_vsync_scheduler_destroy(struct sc_vsync_scheduler *scheduler);
+
+bool
+sc_vsync_scheduler_start(struct sc_vsync_scheduler *scheduler);
+
+void
+sc_vsync_scheduler_stop(struct sc_vsync_scheduler *scheduler);
+
+void
+sc_vsync_scheduler_join(struct sc_vsync_scheduler *scheduler);
+
+void
+sc_vsync_scheduler_set_refresh_rate(struct sc_vsync_scheduler *scheduler,
+                                    unsigned refresh_rate);
+
+/**
+ * Notify that a new frame is available (from the producer thread)
+ *
+ * If the previous frame has not been presented, it has been replaced and is
+ * counted as dropped, and a presentation is already requested.
+ */
+void
+sc_vsync_scheduler_notify_frame(struct sc_vsync_scheduler *scheduler,
+                                bool previous_dropped);
+
+/**
+ * Notify that a requested frame has been presented, once the presentation
+ * call returned
+ */
+void
+sc_vsync_scheduler_on_presented(struct sc_vsync_scheduler *scheduler);
+
+void
+sc_vsync_scheduler_get_stats(struct sc_vsync_scheduler *scheduler,
+                             struct sc_vsync_stats *stats);
+
+#endif
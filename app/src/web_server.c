@@ -1,19 +1,24 @@
 #include "web_server.h"
 #include "input_manager.h"
 #include "control_msg.h"
+#include "snapshot.h"
 #include "util/log.h"
 
+#include <assert.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <libavcodec/avcodec.h>
-#include <libswscale/swscale.h>
 #include <SDL2/SDL.h>
 #include "mongoose.h"
 #include "util/intmap.h"
 
 #define API_PREFIX "/api/v1"
 
+// Duration of decoding requested by a /frame request
+#define SC_WEB_SERVER_FRAME_DEMAND SC_TICK_FROM_SEC(10)
+
 struct sc_web_server web_server;
 
 void 
@@ -263,106 +268,21 @@ static void send_error_response(struct mg_connection *nc, int status_code, const
     send_json_response(nc, status_code, json);
 }
 
-// Convert AVFrame to RGB and write to BMP/PNG/JPG
-static bool write_frame_to_memory(const AVFrame *frame, const char *format, 
-                                uint8_t **out_buffer, size_t *out_size) {
-    struct SwsContext *sws_ctx = sws_getContext(
-        frame->width, frame->height, frame->format,
-        frame->width, frame->height, AV_PIX_FMT_RGB24,
-        SWS_BILINEAR, NULL, NULL, NULL);
-    
-    if (!sws_ctx) {
-        LOGE("Could not create sws context");
-        return false;
-    }
-
-    // Allocate RGB frame
-    AVFrame *rgb_frame = av_frame_alloc();
-    if (!rgb_frame) {
-        sws_freeContext(sws_ctx);
-        return false;
-    }
-
-    rgb_frame->width = frame->width;
-    rgb_frame->height = frame->height;
-    rgb_frame->format = AV_PIX_FMT_RGB24;
-    
-    int buffer_size = av_image_get_buffer_size(AV_PIX_FMT_RGB24, 
-        frame->width, frame->height, 1);
-    uint8_t *rgb_buffer = av_malloc(buffer_size);
-    
-    av_image_fill_arrays(rgb_frame->data, rgb_frame->linesize, rgb_buffer,
-        AV_PIX_FMT_RGB24, frame->width, frame->height, 1);
-    
-    // Convert to RGB
-    sws_scale(sws_ctx, (const uint8_t * const*)frame->data, frame->linesize,
-        0, frame->height, rgb_frame->data, rgb_frame->linesize);
-
-    // Create SDL surface from RGB data
-    SDL_Surface *surface = SDL_CreateRGBSurfaceFrom(rgb_buffer,
-        frame->width, frame->height, 24, frame->width * 3,
-        0x0000FF, 0x00FF00, 0xFF0000, 0);
-    
-    if (!surface) {
-        LOGE("Could not create SDL surface: %s", SDL_GetError());
-        goto error;
-    }
-
-    // Create RWops for memory output
-    size_t rw_buffer_size;
-    if (strcmp(format, "bmp") == 0) {
-        rw_buffer_size = surface->h * surface->pitch + 54; // BMP header size + pixel data
-    } else if (strcmp(format, "png") == 0 || strcmp(format, "jpg") == 0) {
-        rw_buffer_size = surface->h * surface->pitch; // Rough estimate, actual size may vary
-    }
-    uint8_t *rw_buffer = malloc(rw_buffer_size);
-    SDL_RWops *rw = SDL_RWFromMem(rw_buffer, rw_buffer_size);
-    if (!rw) {
-        LOGE("Could not create SDL_RWops: %s", SDL_GetError());
-        SDL_FreeSurface(surface);
-        goto error;
-    }
-    
-    // Save to memory in requested format
-    bool success;
-    if (strcmp(format, "bmp") == 0) {
-        success = SDL_SaveBMP_RW(surface, rw, 0) == 0;
-    // TODO: Uncomment and implement PNG/JPG saving when available
-    // } else if (strcmp(format, "png") == 0) {
-    //     success = IMG_SavePNG_RW(surface, rw) == 0;
-    // } else if (strcmp(format, "jpg") == 0 || strcmp(format, "jpeg") == 0) {
-    //     success = IMG_SaveJPG_RW(surface, rw, 90) == 0;
-    } else {
-        success = false;
-    }
-
-    if (success) {
-        *out_size = SDL_RWsize(rw);
-        *out_buffer = malloc(*out_size);
-        memcpy(*out_buffer, rw_buffer, *out_size);
-
-        // For unknown reasons, SDL_RWread does not return the data
-        // SDL_RWread(rw, *out_buffer, *out_size, 1);
+// Route handler for /api/v1/frame
+static void handle_frame(struct mg_connection *nc, struct mg_http_message *hm, struct sc_web_server *server) {
+    if (server->video_decoder) {
+        // Keep the video decoded for the next requests (the first request after
+        // an idle period may return an older frame)
+        sc_decoder_request_frames(server->video_decoder, SC_WEB_SERVER_FRAME_DEMAND);
     }
 
-    SDL_RWclose(rw);
-    free(rw_buffer);
-    SDL_FreeSurface(surface);
-    av_free(rgb_buffer);
-    av_frame_free(&rgb_frame);
-    sws_freeContext(sws_ctx);
-    return success;
-    
-error:
-    av_free(rgb_buffer);
-    av_frame_free(&rgb_frame);
-    sws_freeContext(sws_ctx);
-    return false;
-}
+    // Encode a reference, the current frame may be replaced meanwhile
+    sc_mutex_lock(&server->frame_mutex);
+    AVFrame *frame = server->current_frame
+                   ? av_frame_clone(server->current_frame) : NULL;
+    sc_mutex_unlock(&server->frame_mutex);
 
-// Route handler for /api/v1/frame
-static void handle_frame(struct mg_connection *nc, struct mg_http_message *hm, struct sc_web_server *server) {
-    if (!server->current_frame) {
+    if (!frame) {
         send_error_response(nc, 503, "No frame available");
         return;
     }
@@ -377,25 +297,410 @@ static void handle_frame(struct mg_connection *nc, struct mg_http_message *hm, s
         }
     }
 
+    // Optional downscaling: ?w=...&h=... (if only one is provided, the aspect
+    // ratio is kept)
+    int width = 0;
+    int height = 0;
+    char size_var[12];
+    if (mg_http_get_var(&hm->query, "w", size_var, sizeof(size_var)) > 0) {
+        width = atoi(size_var);
+        if (width <= 0 || width > frame->width) {
+            send_error_response(nc, 400, "Invalid width");
+            goto end;
+        }
+    }
+    if (mg_http_get_var(&hm->query, "h", size_var, sizeof(size_var)) > 0) {
+        height = atoi(size_var);
+        if (height <= 0 || height > frame->height) {
+            send_error_response(nc, 400, "Invalid height");
+            goto end;
+        }
+    }
+    if (width && !height) {
+        height = (int64_t) frame->height * width / frame->width;
+        height = height ? height : 1;
+    } else if (height && !width) {
+        width = (int64_t) frame->width * height / frame->height;
+        width = width ? width : 1;
+    }
+
     uint8_t *buffer;
     size_t size;
-    if (!write_frame_to_memory(server->current_frame, format, &buffer, &size)) {
+    bool ok;
+    if (width) {
+        ok = sc_snapshot_encode_scaled(frame, format, width, height,
+                                       &server->scalers, &buffer, &size);
+    } else {
+        ok = sc_snapshot_encode(frame, format, &buffer, &size);
+    }
+    if (!ok) {
         send_error_response(nc, 500, "Could not convert frame");
-        return;
+        goto end;
     }
     const char *content_type = strcmp(format, "jpg") == 0 ? "image/jpeg" :
                               strcmp(format, "bmp") == 0 ? "image/bmp" :
                               "image/png";
 
-    LOGI("Frame size: %u", size);
+    LOGI("Frame size: %lu", (unsigned long) size);
 
-    mg_printf(nc, "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %u\r\n\r\n",
-              200, mgx_http_status_code_str(200), content_type, size);
+    mg_printf(nc, "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %lu\r\n\r\n",
+              200, mgx_http_status_code_str(200), content_type,
+              (unsigned long) size);
     mg_send(nc, buffer, size);
     mg_send(nc, "\r\n", 2);
     nc->is_draining = 1;
     
     free(buffer);
+
+end:
+    av_frame_free(&frame);
+}
+
+// Route handler for /api/v1/thumbnail
+static void handle_thumbnail(struct mg_connection *nc, struct mg_http_message *hm, struct sc_web_server *server) {
+    (void) hm;
+
+    if (!server->thumbnailer) {
+        send_error_response(nc, 404, "Thumbnails not enabled");
+        return;
+    }
+
+    uint8_t *buffer;
+    size_t size;
+    if (!sc_thumbnailer_get(server->thumbnailer, &buffer, &size)) {
+        send_error_response(nc, 503, "No thumbnail available");
+        return;
+    }
+
+    mg_printf(nc, "HTTP/1.1 %d %s\r\nContent-Type: image/jpeg\r\nCache-Control: no-cache\r\nContent-Length: %lu\r\n\r\n",
+              200, mgx_http_status_code_str(200), (unsigned long) size);
+    mg_send(nc, buffer, size);
+    nc->is_draining = 1;
+
+    free(buffer);
+}
+
+static void format_histogram_json(char *buf, size_t size, const struct sc_histogram_stats *stats) {
+    snprintf(buf, size,
+             "{\"count\": %" PRIu64 ", \"p50\": %" PRIu64 ", \"p95\": %" PRIu64
+             ", \"p99\": %" PRIu64 ", \"max\": %" PRIu64 "}",
+             stats->count, stats->p50, stats->p95, stats->p99, stats->max);
+}
+
+static void format_async_sink_json(char *buf, size_t size, const struct sc_async_sink_stats *stats) {
+    snprintf(buf, size,
+             "{\"pushed\": %" PRIu64 ", \"delivered\": %" PRIu64
+             ", \"dropped\": %" PRIu64 ", \"queued\": %" PRIu32
+             ", \"max_queued\": %" PRIu32 ", \"avg_lag_us\": %" PRId64
+             ", \"max_lag_us\": %" PRId64 "}",
+             stats->pushed, stats->delivered, stats->dropped, stats->queued,
+             stats->max_queued, stats->avg_lag, stats->max_lag);
+}
+
+// Route handler for /api/v1/stats
+static void handle_stats(struct mg_connection *nc, struct mg_http_message *hm, struct sc_web_server *server) {
+    (void) hm;
+
+    char decoder_json[768] = "null";
+    if (server->video_decoder) {
+        struct sc_decoder_stats stats;
+        sc_decoder_get_stats(server->video_decoder, &stats);
+
+        snprintf(decoder_json, sizeof(decoder_json),
+                 "{\"packets\": %" PRIu64 ", \"frames\": %" PRIu64
+                 ", \"skipped_frames\": %" PRIu64 ", \"pending_frames\": %" PRIu64
+                 ", \"avg_decode_time_us\": %" PRId64 ", \"max_decode_time_us\": %" PRId64
+                 ", \"threads\": %d, \"frame_threading\": %s, \"degradation_level\": %d"
+                 ", \"idle\": %s, \"unchanged_frames\": %" PRIu64
+                 ", \"static_screen\": %s, \"errors\": %" PRIu64 ", \"dropped_packets\": %" PRIu64
+                 ", \"recoveries\": %" PRIu64 ", \"last_recovery_time_us\": %" PRId64
+                 ", \"max_recovery_time_us\": %" PRId64 "}",
+                 stats.packets, stats.frames, stats.skipped_frames, stats.pending_frames,
+                 stats.avg_decode_time, stats.max_decode_time, stats.threads,
+                 stats.frame_threading ? "true" : "false", (int) stats.degradation,
+                 stats.idle ? "true" : "false", stats.unchanged_frames,
+                 stats.static_screen ? "true" : "false", stats.errors, stats.dropped_packets,
+                 stats.recoveries, stats.last_recovery_time, stats.max_recovery_time);
+    }
+
+    char queue_json[256] = "null";
+    if (server->thumbnailer_queue) {
+        struct sc_async_sink_stats stats;
+        sc_async_packet_sink_get_stats(server->thumbnailer_queue, &stats);
+        format_async_sink_json(queue_json, sizeof(queue_json), &stats);
+    }
+
+    char frame_queue_json[256] = "null";
+    if (server->frame_queue) {
+        struct sc_async_sink_stats stats;
+        sc_async_frame_sink_get_stats(server->frame_queue, &stats);
+        format_async_sink_json(frame_queue_json, sizeof(frame_queue_json), &stats);
+    }
+
+    char v4l2_queue_json[256] = "null";
+    if (server->v4l2_queue) {
+        struct sc_async_sink_stats stats;
+        sc_async_frame_sink_get_stats(server->v4l2_queue, &stats);
+        format_async_sink_json(v4l2_queue_json, sizeof(v4l2_queue_json), &stats);
+    }
+
+    char buffer_json[96] = "null";
+    if (server->video_buffer) {
+        snprintf(buffer_json, sizeof(buffer_json),
+                 "{\"adaptive\": %s, \"delay_us\": %" PRId64
+                 ", \"dropped\": %" PRIu64 "}",
+                 server->video_buffer->adaptive ? "true" : "false",
+                 sc_delay_buffer_get_delay(server->video_buffer),
+                 sc_delay_buffer_get_dropped(server->video_buffer));
+    }
+
+    char vsync_json[160] = "null";
+    if (server->vsync_scheduler) {
+        struct sc_vsync_stats stats;
+        sc_vsync_scheduler_get_stats(server->vsync_scheduler, &stats);
+
+        snprintf(vsync_json, sizeof(vsync_json),
+                 "{\"refresh_rate\": %u, \"presented\": %" PRIu64
+                 ", \"late\": %" PRIu64 ", \"dropped\": %" PRIu64
+                 ", \"repeated\": %" PRIu64 "}",
+                 stats.refresh_rate, stats.presented, stats.late,
+                 stats.dropped, stats.repeated);
+    }
+
+    char frames_json[448] = "null";
+    if (server->fps_counter) {
+        struct sc_fps_counter_stats stats;
+        sc_fps_counter_get_stats(server->fps_counter, &stats);
+
+        char interval_json[160];
+        char latency_json[160];
+        format_histogram_json(interval_json, sizeof(interval_json), &stats.interval);
+        format_histogram_json(latency_json, sizeof(latency_json), &stats.latency);
+
+        snprintf(frames_json, sizeof(frames_json),
+                 "{\"started\": %s, \"rendered\": %" PRIu64 ", \"skipped\": %" PRIu64
+                 ", \"invisible\": %" PRIu64 ", \"interval_us\": %s"
+                 ", \"latency_us\": %s}",
+                 stats.started ? "true" : "false", stats.rendered,
+                 stats.skipped, stats.invisible, interval_json, latency_json);
+    }
+
+    char json[2304];
+    snprintf(json, sizeof(json),
+             "{\"video_decoder\": %s, \"video_buffer\": %s, \"thumbnailer_queue\": %s"
+             ", \"frame_queue\": %s, \"v4l2_queue\": %s, \"vsync\": %s, \"frames\": %s}",
+             decoder_json, buffer_json, queue_json, frame_queue_json,
+             v4l2_queue_json, vsync_json, frames_json);
+    send_json_response(nc, 200, json);
+}
+
+enum hls_request {
+    HLS_REQUEST_NONE,
+    HLS_REQUEST_PLAYLIST,  // Blocking playlist reload
+    HLS_REQUEST_SEGMENT,   // Segment or part not available yet
+};
+
+// Per-connection state, stored in the connection data
+struct conn_state {
+    struct sc_web_stream_client *stream_client;
+    uint64_t hls_deadline;  // mg_millis() timeout of a pending HLS request
+    uint64_t hls_msn;
+    int hls_part;  // -1 for the whole segment
+    enum hls_request hls_request;
+};
+
+static_assert(sizeof(struct conn_state) <= MG_DATA_SIZE, "conn_state too large");
+
+static struct conn_state *get_conn_state(struct mg_connection *nc) {
+    // The connection data is zero-initialized by mongoose
+    return (struct conn_state *)(void *)nc->data;
+}
+
+static struct sc_web_stream_client *get_stream_client(struct mg_connection *nc) {
+    return get_conn_state(nc)->stream_client;
+}
+
+static void set_stream_client(struct mg_connection *nc, struct sc_web_stream_client *client) {
+    get_conn_state(nc)->stream_client = client;
+}
+
+// Route handler for /api/v1/stream.ts and /api/v1/stream.mp4
+static void handle_stream(struct mg_connection *nc, struct sc_web_server *server,
+                          enum sc_web_stream_format format) {
+    if (!server->stream) {
+        send_error_response(nc, 503, "No stream available");
+        return;
+    }
+
+    struct sc_web_stream_client *client = sc_web_stream_add_client(server->stream, format);
+    if (!client) {
+        send_error_response(nc, 503, "Stream not available (ended or too many clients)");
+        return;
+    }
+
+    const char *content_type = format == SC_WEB_STREAM_FORMAT_MPEGTS ? "video/mp2t" : "video/mp4";
+
+    // The connection is kept open, the muxed data is sent as HTTP chunks
+    mg_printf(nc, "HTTP/1.1 200 OK\r\nContent-Type: %s\r\nCache-Control: no-cache\r\n"
+              "Transfer-Encoding: chunked\r\n\r\n", content_type);
+    set_stream_client(nc, client);
+}
+
+static void write_stream_chunk(void *userdata, const uint8_t *data, size_t len) {
+    struct mg_connection *nc = (struct mg_connection *)userdata;
+    mg_http_write_chunk(nc, (const char *)data, len);
+}
+
+static void release_stream_client(struct mg_connection *nc, struct sc_web_server *server) {
+    struct sc_web_stream_client *client = get_stream_client(nc);
+    if (client && server->stream) {
+        sc_web_stream_remove_client(server->stream, client);
+    }
+    set_stream_client(nc, NULL);
+}
+
+// Move the muxed data of a stream client to its connection
+static void flush_stream_client(struct mg_connection *nc, struct sc_web_server *server) {
+    struct sc_web_stream_client *client = get_stream_client(nc);
+    if (!client || !server->stream) {
+        return;
+    }
+
+    if (!sc_web_stream_client_flush(server->stream, client, nc->send.len, write_stream_chunk, nc)) {
+        // End of stream, or client too slow
+        release_stream_client(nc, server);
+        mg_http_write_chunk(nc, "", 0);  // Last chunk
+        nc->is_draining = 1;
+    }
+}
+
+// Response to an HLS request, written with the HLS lock held
+struct hls_response {
+    struct mg_connection *nc;
+    const char *content_type;
+};
+
+static void write_hls_response(void *userdata, const uint8_t *data, size_t len) {
+    struct hls_response *resp = (struct hls_response *)userdata;
+    mg_printf(resp->nc, "HTTP/1.1 200 OK\r\nContent-Type: %s\r\nCache-Control: no-cache\r\n"
+              "Content-Length: %lu\r\n\r\n", resp->content_type, (unsigned long) len);
+    mg_send(resp->nc, data, len);
+    resp->nc->is_draining = 1;
+}
+
+// Try to answer a (possibly pending) HLS request, return false if it is still pending
+static bool try_hls_request(struct mg_connection *nc, struct sc_web_server *server) {
+    struct conn_state *state = get_conn_state(nc);
+    assert(state->hls_request != HLS_REQUEST_NONE);
+
+    enum sc_hls_status status;
+    if (state->hls_request == HLS_REQUEST_PLAYLIST) {
+        status = sc_hls_check(server->hls, state->hls_msn, state->hls_part);
+        if (status != SC_HLS_STATUS_PENDING) {
+            // The requested part is available (or will never be), send the current playlist
+            char *playlist = sc_hls_get_playlist(server->hls);
+            if (playlist) {
+                struct hls_response resp = {nc, "application/vnd.apple.mpegurl"};
+                write_hls_response(&resp, (const uint8_t *)playlist, strlen(playlist));
+                free(playlist);
+            } else {
+                send_error_response(nc, 503, "Stream not started");
+            }
+            status = SC_HLS_STATUS_OK;
+        }
+    } else {
+        struct hls_response resp = {nc, "video/mp4"};
+        status = sc_hls_write_segment(server->hls, state->hls_msn, state->hls_part,
+                                      write_hls_response, &resp);
+        if (status == SC_HLS_STATUS_NOT_FOUND) {
+            send_error_response(nc, 404, "Segment not found");
+        }
+    }
+
+    if (status == SC_HLS_STATUS_PENDING) {
+        return false;
+    }
+
+    state->hls_request = HLS_REQUEST_NONE;
+    return true;
+}
+
+// Retry a pending HLS request, on new data or on timeout
+static void retry_hls_request(struct mg_connection *nc, struct sc_web_server *server) {
+    struct conn_state *state = get_conn_state(nc);
+    if (state->hls_request == HLS_REQUEST_NONE || !server->hls) {
+        return;
+    }
+
+    if (!try_hls_request(nc, server) && mg_millis() >= state->hls_deadline) {
+        state->hls_request = HLS_REQUEST_NONE;
+        send_error_response(nc, 503, "Timeout");
+    }
+}
+
+// Route handler for /api/v1/hls/*
+static void handle_hls(struct mg_connection *nc, struct mg_http_message *hm, struct sc_web_server *server) {
+    if (!server->hls) {
+        send_error_response(nc, 503, "HLS not enabled");
+        return;
+    }
+
+    const size_t prefix_len = sizeof(API_PREFIX "/hls/") - 1;
+    char name[64];
+    size_t len = hm->uri.len - prefix_len;
+    if (len >= sizeof(name)) {
+        send_error_response(nc, 404, "Not found");
+        return;
+    }
+    memcpy(name, hm->uri.ptr + prefix_len, len);
+    name[len] = '\0';
+
+    struct conn_state *state = get_conn_state(nc);
+    uint64_t msn;
+    unsigned init_id;
+    int part;
+    int n = 0;
+
+    if (!strcmp(name, "index.m3u8")) {
+        char msn_var[24];
+        char part_var[12];
+        if (mg_http_get_var(&hm->query, "_HLS_msn", msn_var, sizeof(msn_var)) > 0) {
+            // Blocking playlist reload: wait for the requested segment or part
+            state->hls_msn = strtoull(msn_var, NULL, 10);
+            state->hls_part = -1;
+            if (mg_http_get_var(&hm->query, "_HLS_part", part_var, sizeof(part_var)) > 0) {
+                state->hls_part = atoi(part_var);
+            }
+        } else {
+            // Any segment makes the playlist available
+            state->hls_msn = 0;
+            state->hls_part = 0;
+        }
+        state->hls_request = HLS_REQUEST_PLAYLIST;
+    } else if (sscanf(name, "init%u.mp4%n", &init_id, &n) == 1 && name[n] == '\0' && n) {
+        struct hls_response resp = {nc, "video/mp4"};
+        if (!sc_hls_write_init(server->hls, init_id, write_hls_response, &resp)) {
+            send_error_response(nc, 404, "Not found");
+        }
+        return;
+    } else if (sscanf(name, "segment%" SCNu64 ".m4s%n", &msn, &n) == 1 && name[n] == '\0' && n) {
+        state->hls_msn = msn;
+        state->hls_part = -1;
+        state->hls_request = HLS_REQUEST_SEGMENT;
+    } else if (sscanf(name, "part%" SCNu64 ".%d.m4s%n", &msn, &part, &n) == 2 && name[n] == '\0' && n
+               && part >= 0) {
+        state->hls_msn = msn;
+        state->hls_part = part;
+        state->hls_request = HLS_REQUEST_SEGMENT;
+    } else {
+        send_error_response(nc, 404, "Not found");
+        return;
+    }
+
+    if (!try_hls_request(nc, server)) {
+        // Hold the request until the data is available (or timeout)
+        state->hls_deadline = mg_millis() + 3 * SC_TICK_TO_MS(SC_HLS_TARGET_DURATION);
+    }
 }
 
 // Route handler for /api/v1/keycode
@@ -659,6 +964,33 @@ static void ev_handler(struct mg_connection *nc, int ev, void *ev_data, void *us
             }
         }
         
+        if (get_stream_client(nc) || get_conn_state(nc)->hls_request != HLS_REQUEST_NONE) {
+            // Ignore pipelined requests on a streaming or pending connection
+            return;
+        }
+
+        // Handle live stream endpoints
+        bool stream_ts = mg_vcmp(&hm->uri, API_PREFIX "/stream.ts") == 0;
+        if (stream_ts || mg_vcmp(&hm->uri, API_PREFIX "/stream.mp4") == 0) {
+            if (mg_vcmp(&hm->method, "GET") == 0) {
+                handle_stream(nc, server, stream_ts ? SC_WEB_STREAM_FORMAT_MPEGTS
+                                                    : SC_WEB_STREAM_FORMAT_FMP4);
+                return;
+            }
+            send_error_response(nc, 405, "Method not allowed");
+            return;
+        }
+
+        // Handle low-latency HLS endpoints
+        if (mg_match(hm->uri, mg_str(API_PREFIX "/hls/*"), NULL)) {
+            if (mg_vcmp(&hm->method, "GET") == 0) {
+                handle_hls(nc, hm, server);
+                return;
+            }
+            send_error_response(nc, 405, "Method not allowed");
+            return;
+        }
+
         // Handle frame endpoints
         if (mg_vcmp(&hm->uri, API_PREFIX "/frame") == 0) {
             if (mg_vcmp(&hm->method, "GET") == 0) {
@@ -671,6 +1003,24 @@ static void ev_handler(struct mg_connection *nc, int ev, void *ev_data, void *us
             return;
         }
         
+        if (mg_vcmp(&hm->uri, API_PREFIX "/thumbnail") == 0) {
+            if (mg_vcmp(&hm->method, "GET") == 0) {
+                handle_thumbnail(nc, hm, server);
+                return;
+            }
+            send_error_response(nc, 405, "Method not allowed");
+            return;
+        }
+
+        if (mg_vcmp(&hm->uri, API_PREFIX "/stats") == 0) {
+            if (mg_vcmp(&hm->method, "GET") == 0) {
+                handle_stats(nc, hm, server);
+                return;
+            }
+            send_error_response(nc, 405, "Method not allowed");
+            return;
+        }
+
         // Handle other routes
         if (mg_vcmp(&hm->uri, API_PREFIX "/clipboard") == 0) {
             if (mg_vcmp(&hm->method, "GET") == 0 || mg_vcmp(&hm->method, "PUT") == 0) {
@@ -705,23 +1055,83 @@ static void ev_handler(struct mg_connection *nc, int ev, void *ev_data, void *us
         send_error_response(nc, 404, "Not found");
         nc->is_draining = 1;  // Mark connection for closing after sending
 
+    } else if (ev == MG_EV_POLL || ev == MG_EV_WRITE) {
+        // Send the stream data (if any) muxed since the last flush
+        flush_stream_client(nc, server);
+        retry_hls_request(nc, server);
+    } else if (ev == MG_EV_CLOSE) {
+        release_stream_client(nc, server);
     } else if (ev == MG_EV_ERROR) {
         // Handle connection error
         LOGE("Connection error: %s", (char *)ev_data);
     }
 }
 
-void
-sc_web_server_set_frame(struct sc_web_server *server, const AVFrame *frame) {
-    if (server->current_frame) {
-        av_frame_free(&server->current_frame);
-    }
-    
-    if (frame) {
+static bool
+sc_web_server_frame_sink_open(struct sc_frame_sink *sink,
+                              const AVCodecContext *ctx) {
+    (void) sink;
+    (void) ctx;
+    return true;
+}
+
+static void
+sc_web_server_frame_sink_close(struct sc_frame_sink *sink) {
+    (void) sink;
+    // Keep the last frame, it may still be requested
+}
+
+static bool
+sc_web_server_frame_sink_push(struct sc_frame_sink *sink,
+                              const AVFrame *frame) {
+    struct sc_web_server *server =
+        container_of(sink, struct sc_web_server, frame_sink);
+
+    sc_mutex_lock(&server->frame_mutex);
+    if (!server->current_frame) {
         server->current_frame = av_frame_alloc();
-        av_frame_ref(server->current_frame, frame);
+        if (!server->current_frame) {
+            sc_mutex_unlock(&server->frame_mutex);
+            LOG_OOM();
+            return false;
+        }
     } else {
-        server->current_frame = NULL;
+        av_frame_unref(server->current_frame);
+    }
+
+    int r = av_frame_ref(server->current_frame, frame);
+    sc_mutex_unlock(&server->frame_mutex);
+
+    if (r) {
+        LOG_OOM();
+        return false;
+    }
+
+    return true;
+}
+
+// Handler for the wakeup pipe, to flush the stream clients and answer pending
+// HLS requests without delay
+static void wakeup_handler(struct mg_connection *nc, int ev, void *ev_data, void *user_data) {
+    (void) ev_data;
+    struct sc_web_server *server = (struct sc_web_server *)user_data;
+
+    if (ev == MG_EV_READ) {
+        nc->recv.len = 0;  // The content does not matter
+        for (struct mg_connection *c = nc->mgr->conns; c; c = c->next) {
+            if (c->fn == ev_handler) {
+                flush_stream_client(c, server);
+                retry_hls_request(c, server);
+            }
+        }
+    }
+}
+
+void
+sc_web_server_wakeup(struct sc_web_server *server) {
+    int fd = server->wakeup_fd;
+    if (fd >= 0) {
+        send((MG_SOCKET_TYPE) fd, "", 1, 0);
     }
 }
 
@@ -732,10 +1142,34 @@ bool sc_web_server_init(struct sc_web_server *server,
         LOGE("Invalid parameters passed to web_server_init");
         return false;
     }
+    if (!sc_mutex_init(&server->frame_mutex)) {
+        return false;
+    }
+
+    static const struct sc_frame_sink_ops frame_sink_ops = {
+        .open = sc_web_server_frame_sink_open,
+        .close = sc_web_server_frame_sink_close,
+        .push = sc_web_server_frame_sink_push,
+    };
+    server->frame_sink.ops = &frame_sink_ops;
+
     server->listening_addr = listening_addr;
     server->running = false;
     server->mongoose_ctx = NULL;
     server->current_frame = NULL;
+    server->stream = NULL;
+    server->hls = NULL;
+    server->video_decoder = NULL;
+    server->video_buffer = NULL;
+    server->vsync_scheduler = NULL;
+    server->fps_counter = NULL;
+    server->thumbnailer = NULL;
+    server->thumbnailer_queue = NULL;
+    server->frame_queue = NULL;
+    server->v4l2_queue = NULL;
+    server->thread = NULL;
+    server->wakeup_fd = -1;
+    sc_scaler_cache_init(&server->scalers);
     
     LOGI("Web server initialized successfully");
     return true;
@@ -748,6 +1182,76 @@ void sc_web_server_set_input_manager(struct sc_web_server *server,
     }
 }
 
+void sc_web_server_set_stream(struct sc_web_server *server,
+                              struct sc_web_stream *stream) {
+    if (server) {
+        server->stream = stream;
+    }
+}
+
+void sc_web_server_set_hls(struct sc_web_server *server,
+                           struct sc_hls *hls) {
+    if (server) {
+        server->hls = hls;
+    }
+}
+
+void sc_web_server_set_thumbnailer(struct sc_web_server *server,
+                                   struct sc_thumbnailer *thumbnailer) {
+    if (server) {
+        server->thumbnailer = thumbnailer;
+    }
+}
+
+void sc_web_server_set_thumbnailer_queue(struct sc_web_server *server,
+                                         struct sc_async_packet_sink *queue) {
+    if (server) {
+        server->thumbnailer_queue = queue;
+    }
+}
+
+void sc_web_server_set_frame_queue(struct sc_web_server *server,
+                                   struct sc_async_frame_sink *queue) {
+    if (server) {
+        server->frame_queue = queue;
+    }
+}
+
+void sc_web_server_set_v4l2_queue(struct sc_web_server *server,
+                                  struct sc_async_frame_sink *queue) {
+    if (server) {
+        server->v4l2_queue = queue;
+    }
+}
+
+void sc_web_server_set_video_decoder(struct sc_web_server *server,
+                                     struct sc_decoder *decoder) {
+    if (server) {
+        server->video_decoder = decoder;
+    }
+}
+
+void sc_web_server_set_video_buffer(struct sc_web_server *server,
+                                    struct sc_delay_buffer *buffer) {
+    if (server) {
+        server->video_buffer = buffer;
+    }
+}
+
+void sc_web_server_set_vsync_scheduler(struct sc_web_server *server,
+                                       struct sc_vsync_scheduler *scheduler) {
+    if (server) {
+        server->vsync_scheduler = scheduler;
+    }
+}
+
+void sc_web_server_set_fps_counter(struct sc_web_server *server,
+                                   struct sc_fps_counter *fps_counter) {
+    if (server) {
+        server->fps_counter = fps_counter;
+    }
+}
+
 int mongoose_poll_thread(void *arg) {
     struct sc_web_server *server = (struct sc_web_server *)arg;
     if (!server || server->mongoose_ctx) {
@@ -775,7 +1279,13 @@ int mongoose_poll_thread(void *arg) {
     }
 
     server->mongoose_ctx = mgr;
-    server->running = true;
+
+    // Allow other threads to interrupt mg_mgr_poll() when stream data is ready
+    int wakeup_fd = mg_mkpipe(mgr, wakeup_handler, server, true);
+    if (wakeup_fd < 0) {
+        LOGW("Could not create wakeup pipe, stream data will be polled");
+    }
+    server->wakeup_fd = wakeup_fd;
     
     LOGI("Starting mongoose poll loop");
     while (server->running) {
@@ -793,6 +1303,8 @@ bool sc_web_server_start(struct sc_web_server *server) {
     }
 
     LOGI("Starting web server thread");
+    // Set before the thread is started, so that a stop request is never lost
+    server->running = true;
     SDL_Thread *thread = SDL_CreateThread(mongoose_poll_thread, "web_server", server);
     if (!thread) {
         LOGE("Could not create web server thread: %s", SDL_GetError());
@@ -801,6 +1313,7 @@ bool sc_web_server_start(struct sc_web_server *server) {
         free(server->mongoose_ctx);
         return false;
     }
+    server->thread = thread;
 
     return true;
 }
@@ -808,6 +1321,11 @@ bool sc_web_server_start(struct sc_web_server *server) {
 void sc_web_server_stop(struct sc_web_server *server) {
     LOGI("Stopping web server...");
     server->running = false;
+    if (server->thread) {
+        sc_web_server_wakeup(server);
+        SDL_WaitThread(server->thread, NULL);
+        server->thread = NULL;
+    }
 }
 
 void sc_web_server_destroy(struct sc_web_server *server) {
@@ -818,4 +1336,7 @@ void sc_web_server_destroy(struct sc_web_server *server) {
         free(mgr);
         server->mongoose_ctx = NULL;
     }
+    sc_scaler_cache_destroy(&server->scalers);
+    av_frame_free(&server->current_frame);
+    sc_mutex_destroy(&server->frame_mutex);
 }
@@ -3,14 +3,41 @@
 
 #include <stdbool.h>
 #include <libavcodec/avcodec.h>
+#include <SDL2/SDL_thread.h>
+#include "async_sink.h"
+#include "decoder.h"
+#include "delay_buffer.h"
+#include "fps_counter.h"
 #include "input_manager.h"
+#include "hls.h"
+#include "scaler.h"
+#include "thumbnailer.h"
+#include "trait/frame_sink.h"
+#include "util/thread.h"
+#include "vsync_scheduler.h"
+#include "web_stream.h"
 
 struct sc_web_server {
+    struct sc_frame_sink frame_sink;  // Receives the frames served by /frame
     struct sc_input_manager *input_manager;
+    struct sc_web_stream *stream;  // Live A/V stream (may be NULL)
+    struct sc_hls *hls;  // Low-latency HLS packager (may be NULL)
+    struct sc_decoder *video_decoder;  // For the statistics (may be NULL)
+    struct sc_delay_buffer *video_buffer;  // For the statistics (may be NULL)
+    struct sc_thumbnailer *thumbnailer;  // (may be NULL)
+    struct sc_async_packet_sink *thumbnailer_queue;  // For the statistics (may be NULL)
+    struct sc_async_frame_sink *frame_queue;  // For the statistics (may be NULL)
+    struct sc_async_frame_sink *v4l2_queue;  // For the statistics (may be NULL)
+    struct sc_vsync_scheduler *vsync_scheduler;  // For the statistics (may be NULL)
+    struct sc_fps_counter *fps_counter;  // For the statistics (may be NULL)
     void *mongoose_ctx;  // mongoose context (opaque)
     const char *listening_addr;
     bool running;
-    AVFrame *current_frame;  // Store the current frame
+    SDL_Thread *thread;
+    int wakeup_fd;  // Write end of the mongoose pipe, -1 if not created
+    sc_mutex frame_mutex;
+    AVFrame *current_frame;  // Latest frame, protected by frame_mutex
+    struct sc_scaler_cache scalers;  // For the scaled frames (server thread only)
 };
 
 // Initialize the web server
@@ -23,11 +50,64 @@ void
 sc_web_server_set_input_manager(struct sc_web_server *server,
                                 struct sc_input_manager *input_manager);
 
+// Set the live stream for the web server
+void
+sc_web_server_set_stream(struct sc_web_server *server,
+                         struct sc_web_stream *stream);
+
+// Set the HLS packager for the web server
+void
+sc_web_server_set_hls(struct sc_web_server *server, struct sc_hls *hls);
+
+// Set the thumbnailer for the web server
+void
+sc_web_server_set_thumbnailer(struct sc_web_server *server,
+                              struct sc_thumbnailer *thumbnailer);
+
+// Set the queue feeding the thumbnailer, to expose its statistics
+void
+sc_web_server_set_thumbnailer_queue(struct sc_web_server *server,
+                                    struct sc_async_packet_sink *queue);
+
+// Set the queue feeding the frame sink, to expose its statistics
+void
+sc_web_server_set_frame_queue(struct sc_web_server *server,
+                              struct sc_async_frame_sink *queue);
+
+// Set the queue feeding the V4L2 sink, to expose its statistics
+void
+sc_web_server_set_v4l2_queue(struct sc_web_server *server,
+                             struct sc_async_frame_sink *queue);
+
+// Set the video decoder, to expose its statistics
+void
+sc_web_server_set_video_decoder(struct sc_web_server *server,
+                                struct sc_decoder *decoder);
+
+// Set the video buffer, to expose its current delay
+void
+sc_web_server_set_video_buffer(struct sc_web_server *server,
+                               struct sc_delay_buffer *buffer);
+
+// Set the screen presentation scheduler, to expose its statistics
+void
+sc_web_server_set_vsync_scheduler(struct sc_web_server *server,
+                                  struct sc_vsync_scheduler *scheduler);
+
+// Set the screen frame counter, to expose the frame timings
+void
+sc_web_server_set_fps_counter(struct sc_web_server *server,
+                              struct sc_fps_counter *fps_counter);
+
+// Wake up the web server thread (may be called from any thread)
+void
+sc_web_server_wakeup(struct sc_web_server *server);
+
 // Start the web server (non-blocking)
 bool
 sc_web_server_start(struct sc_web_server *server);
 
-// Stop the web server
+// Stop the web server and wait for its thread
 void
 sc_web_server_stop(struct sc_web_server *server);
 
@@ -35,8 +115,4 @@ sc_web_server_stop(struct sc_web_server *server);
 void
 sc_web_server_destroy(struct sc_web_server *server);
 
-// Update the current frame
-void
-sc_web_server_set_frame(struct sc_web_server *server, const AVFrame *frame);
-
 #endif  // SC_WEB_SERVER_H
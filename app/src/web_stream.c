@@ -0,0 +1,662 @@
+#include "web_stream.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+
+/** Downcast packet sinks to web stream */
+#define DOWNCAST_VIDEO(SINK) \
+    container_of(SINK, struct sc_web_stream, video_packet_sink)
+#define DOWNCAST_AUDIO(SINK) \
+    container_of(SINK, struct sc_web_stream, audio_packet_sink)
+
+#define SC_WEB_STREAM_IO_BUFFER_SIZE 4096
+
+// Above this amount of data not sent yet, skip packets until the next keyframe
+#define SC_WEB_STREAM_MAX_LAG (2 * 1024 * 1024)
+// Only resume on a keyframe once the lag is below this amount
+#define SC_WEB_STREAM_RESUME_LAG (512 * 1024)
+// Disconnect a client which could not resume during this delay
+#define SC_WEB_STREAM_MAX_SKIP_DURATION SC_TICK_FROM_SEC(10)
+
+static const AVRational SCRCPY_TIME_BASE = {1, 1000000}; // timestamps in us
+
+static const char *
+sc_web_stream_get_format_name(enum sc_web_stream_format format) {
+    switch (format) {
+        case SC_WEB_STREAM_FORMAT_MPEGTS:
+            return "mpegts";
+        case SC_WEB_STREAM_FORMAT_FMP4:
+            return "mp4";
+        default:
+            assert(!"unexpected format");
+            return NULL;
+    }
+}
+
+static int
+#ifdef SCRCPY_LAVF_HAS_AVIO_WRITE_CONST
+sc_web_stream_client_write(void *opaque, const uint8_t *buf, int buf_size) {
+#else
+sc_web_stream_client_write(void *opaque, uint8_t *buf, int buf_size) {
+#endif
+    struct sc_web_stream_client *client = opaque;
+    assert(buf_size >= 0);
+
+    size_t size = buf_size;
+    if (client->len + size > client->cap) {
+        size_t cap = client->cap ? client->cap : SC_WEB_STREAM_IO_BUFFER_SIZE;
+        while (cap < client->len + size) {
+            cap *= 2;
+        }
+
+        uint8_t *data = realloc(client->data, cap);
+        if (!data) {
+            LOG_OOM();
+            return AVERROR(ENOMEM);
+        }
+
+        client->data = data;
+        client->cap = cap;
+    }
+
+    memcpy(client->data + client->len, buf, size);
+    client->len += size;
+    return buf_size;
+}
+
+static bool
+sc_web_stream_set_extradata(AVStream *ostream, const AVPacket *config) {
+    uint8_t *extradata =
+        av_mallocz(config->size + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (!extradata) {
+        LOG_OOM();
+        return false;
+    }
+
+    memcpy(extradata, config->data, config->size);
+
+    ostream->codecpar->extradata = extradata;
+    ostream->codecpar->extradata_size = config->size;
+    return true;
+}
+
+static AVStream *
+sc_web_stream_add_ostream(AVFormatContext *ctx, const AVCodecParameters *params,
+                          const AVPacket *config) {
+    AVStream *ostream = avformat_new_stream(ctx, NULL);
+    if (!ostream) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    if (avcodec_parameters_copy(ostream->codecpar, params) < 0) {
+        return NULL;
+    }
+
+    // the extradata of the encoder (if any) are provided by the config packet
+    av_freep(&ostream->codecpar->extradata);
+    ostream->codecpar->extradata_size = 0;
+    if (config && !sc_web_stream_set_extradata(ostream, config)) {
+        return NULL;
+    }
+
+    ostream->time_base = SCRCPY_TIME_BASE;
+    return ostream;
+}
+
+static void
+sc_web_stream_client_close_muxer(struct sc_web_stream_client *client) {
+    if (client->ctx) {
+        if (client->ctx->pb) {
+            av_freep(&client->ctx->pb->buffer);
+            avio_context_free(&client->ctx->pb);
+        }
+        avformat_free_context(client->ctx);
+        client->ctx = NULL;
+    }
+}
+
+// If discont is set, the fragments continue the timeline of the previous muxer
+// of the client
+static bool
+sc_web_stream_client_open_muxer(struct sc_web_stream *stream,
+                                struct sc_web_stream_client *client,
+                                bool discont) {
+    assert(!client->ctx);
+    assert(stream->video_params);
+
+    const char *format_name = sc_web_stream_get_format_name(client->format);
+    AVFormatContext *ctx = NULL;
+    int r = avformat_alloc_output_context2(&ctx, NULL, format_name, NULL);
+    if (r < 0) {
+        LOGE("Web stream: could not create %s muxer", format_name);
+        return false;
+    }
+
+    client->ctx = ctx;
+
+    enum AVCodecID video_codec_id = stream->video_params->codec_id;
+    if (avformat_query_codec(ctx->oformat, video_codec_id,
+                             FF_COMPLIANCE_NORMAL) != 1) {
+        LOGE("Web stream: video codec %s not supported in %s",
+             avcodec_get_name(video_codec_id), format_name);
+        goto error;
+    }
+
+    AVStream *ostream = sc_web_stream_add_ostream(ctx, stream->video_params,
+                                                  stream->video_config);
+    if (!ostream) {
+        goto error;
+    }
+    client->video_index = ostream->index;
+
+    if (stream->audio_params) {
+        enum AVCodecID audio_codec_id = stream->audio_params->codec_id;
+        if (avformat_query_codec(ctx->oformat, audio_codec_id,
+                                 FF_COMPLIANCE_NORMAL) == 1) {
+            ostream = sc_web_stream_add_ostream(ctx, stream->audio_params,
+                                                stream->audio_config);
+            if (!ostream) {
+                goto error;
+            }
+            client->audio_index = ostream->index;
+        } else {
+            LOGW("Web stream: audio codec %s not supported in %s, streaming "
+                 "video only", avcodec_get_name(audio_codec_id), format_name);
+        }
+    }
+
+    uint8_t *buffer = av_malloc(SC_WEB_STREAM_IO_BUFFER_SIZE);
+    if (!buffer) {
+        LOG_OOM();
+        goto error;
+    }
+
+    ctx->pb = avio_alloc_context(buffer, SC_WEB_STREAM_IO_BUFFER_SIZE, 1,
+                                 client, NULL, sc_web_stream_client_write,
+                                 NULL);
+    if (!ctx->pb) {
+        LOG_OOM();
+        av_free(buffer);
+        goto error;
+    }
+
+    // Write every packet to the client immediately
+    ctx->flags |= AVFMT_FLAG_CUSTOM_IO | AVFMT_FLAG_FLUSH_PACKETS;
+
+    AVDictionary *opts = NULL;
+    if (client->format == SC_WEB_STREAM_FORMAT_FMP4) {
+        // Fragmented MP4, which can be played while it is written
+        av_dict_set(&opts, "movflags", discont
+                ? "empty_moov+default_base_moof+frag_keyframe+frag_discont"
+                : "empty_moov+default_base_moof+frag_keyframe", 0);
+        // Do not wait for the next keyframe to send a fragment
+        av_dict_set(&opts, "frag_duration", "100000", 0); // in us
+    }
+
+    r = avformat_write_header(ctx, &opts);
+    av_dict_free(&opts);
+    if (r < 0) {
+        LOGE("Web stream: could not write %s header", format_name);
+        goto error;
+    }
+
+    return true;
+
+error:
+    sc_web_stream_client_close_muxer(client);
+    return false;
+}
+
+static bool
+sc_web_stream_client_write_packet(struct sc_web_stream *stream,
+                                  struct sc_web_stream_client *client,
+                                  const AVPacket *packet, int index) {
+    AVPacket *p = stream->packet;
+    if (av_packet_ref(p, packet)) {
+        LOG_OOM();
+        return false;
+    }
+
+    p->stream_index = index;
+    p->pts -= client->pts_origin;
+    p->dts = p->pts;
+    av_packet_rescale_ts(p, SCRCPY_TIME_BASE,
+                         client->ctx->streams[index]->time_base);
+
+    int r = av_write_frame(client->ctx, p);
+    av_packet_unref(p);
+    return r >= 0;
+}
+
+// Write a new initialization segment for the new video config
+static bool
+sc_web_stream_client_restart_muxer(struct sc_web_stream *stream,
+                                   struct sc_web_stream_client *client) {
+    assert(client->format == SC_WEB_STREAM_FORMAT_FMP4);
+    assert(client->ctx);
+
+    // Flush the last fragment of the previous muxer
+    if (av_write_frame(client->ctx, NULL) < 0) {
+        return false;
+    }
+
+    sc_web_stream_client_close_muxer(client);
+    client->restart = false;
+
+    return sc_web_stream_client_open_muxer(stream, client, true);
+}
+
+static void
+sc_web_stream_client_push_video(struct sc_web_stream *stream,
+                                struct sc_web_stream_client *client,
+                                const AVPacket *packet, sc_tick now) {
+    if (client->ended) {
+        return;
+    }
+
+    bool is_key = packet->flags & AV_PKT_FLAG_KEY;
+
+    if (client->restart && is_key) {
+        LOGD("Web stream: new video config, restarting the client muxer");
+        if (!sc_web_stream_client_restart_muxer(stream, client)) {
+            LOGE("Web stream: could not restart the muxer");
+            client->ended = true;
+            return;
+        }
+    }
+
+    if (!client->ctx) {
+        if (!is_key) {
+            // Late joiners start from a keyframe
+            return;
+        }
+
+        if (!sc_web_stream_client_open_muxer(stream, client, false)) {
+            client->ended = true;
+            return;
+        }
+
+        client->pts_origin = packet->pts;
+    } else {
+        size_t lag = client->len + client->pending;
+        if (client->skipping) {
+            if (!is_key || lag > SC_WEB_STREAM_RESUME_LAG) {
+                if (now - client->skipping_since
+                        > SC_WEB_STREAM_MAX_SKIP_DURATION) {
+                    LOGW("Web stream: client too slow, disconnecting");
+                    client->ended = true;
+                } else {
+                    ++client->dropped;
+                }
+                return;
+            }
+
+            LOGD("Web stream: client resumed (%" PRIu64 " packets dropped)",
+                 client->dropped);
+            client->skipping = false;
+        } else if (lag > SC_WEB_STREAM_MAX_LAG) {
+            // Do not buffer without bound, skip to the next keyframe
+            LOGD("Web stream: client lagging, skipping to the next keyframe");
+            client->skipping = true;
+            client->skipping_since = now;
+            ++client->dropped;
+            return;
+        }
+    }
+
+    if (!sc_web_stream_client_write_packet(stream, client, packet,
+                                           client->video_index)) {
+        LOGE("Web stream: could not write video packet");
+        client->ended = true;
+    }
+}
+
+static void
+sc_web_stream_client_push_audio(struct sc_web_stream *stream,
+                                struct sc_web_stream_client *client,
+                                const AVPacket *packet) {
+    if (client->ended || !client->ctx || client->audio_index < 0
+            || client->skipping) {
+        return;
+    }
+
+    if (packet->pts < client->pts_origin) {
+        // Before the first video packet of this client
+        return;
+    }
+
+    if (!sc_web_stream_client_write_packet(stream, client, packet,
+                                           client->audio_index)) {
+        LOGE("Web stream: could not write audio packet");
+        client->ended = true;
+    }
+}
+
+static bool
+sc_web_stream_is_same_config(const AVPacket *config, const AVPacket *packet) {
+    return config && config->size == packet->size
+        && !memcmp(config->data, packet->data, packet->size);
+}
+
+static bool
+sc_web_stream_set_config(AVPacket **pconfig, const AVPacket *packet) {
+    if (!*pconfig) {
+        *pconfig = av_packet_alloc();
+        if (!*pconfig) {
+            LOG_OOM();
+            return false;
+        }
+    } else {
+        av_packet_unref(*pconfig);
+    }
+
+    if (av_packet_ref(*pconfig, packet)) {
+        LOG_OOM();
+        return false;
+    }
+
+    return true;
+}
+
+static bool
+sc_web_stream_open_params(AVCodecParameters **pparams, AVCodecContext *ctx) {
+    assert(!*pparams);
+
+    AVCodecParameters *params = avcodec_parameters_alloc();
+    if (!params) {
+        LOG_OOM();
+        return false;
+    }
+
+    if (avcodec_parameters_from_context(params, ctx) < 0) {
+        avcodec_parameters_free(&params);
+        return false;
+    }
+
+    *pparams = params;
+    return true;
+}
+
+static bool
+sc_web_stream_video_packet_sink_open(struct sc_packet_sink *sink,
+                                     AVCodecContext *ctx) {
+    struct sc_web_stream *stream = DOWNCAST_VIDEO(sink);
+
+    sc_mutex_lock(&stream->mutex);
+    bool ok = sc_web_stream_open_params(&stream->video_params, ctx);
+    sc_mutex_unlock(&stream->mutex);
+
+    return ok;
+}
+
+static void
+sc_web_stream_video_packet_sink_close(struct sc_packet_sink *sink) {
+    struct sc_web_stream *stream = DOWNCAST_VIDEO(sink);
+
+    sc_mutex_lock(&stream->mutex);
+    stream->eos = true;
+    for (unsigned i = 0; i < stream->client_count; ++i) {
+        struct sc_web_stream_client *client = stream->clients[i];
+        if (client->ctx && !client->ended) {
+            // Flush the last fragment, if any
+            av_write_trailer(client->ctx);
+        }
+        client->ended = true;
+    }
+    sc_mutex_unlock(&stream->mutex);
+
+    stream->cbs->on_data(stream, stream->cbs_userdata);
+}
+
+static bool
+sc_web_stream_video_packet_sink_push(struct sc_packet_sink *sink,
+                                     const AVPacket *packet) {
+    struct sc_web_stream *stream = DOWNCAST_VIDEO(sink);
+
+    sc_mutex_lock(&stream->mutex);
+
+    if (packet->pts == AV_NOPTS_VALUE) {
+        // A config packet must not be muxed, it is prepended to the next
+        // keyframe
+        if (!sc_web_stream_is_same_config(stream->video_config, packet)) {
+            // The encoder has been reset (for example on device rotation).
+            // MPEG-TS carries the new parameter sets in-band, but the fMP4
+            // clients need a new initialization segment.
+            for (unsigned i = 0; i < stream->client_count; ++i) {
+                struct sc_web_stream_client *client = stream->clients[i];
+                if (client->format == SC_WEB_STREAM_FORMAT_FMP4
+                        && client->ctx) {
+                    client->restart = true;
+                }
+            }
+        }
+        bool ok = sc_web_stream_set_config(&stream->video_config, packet);
+        sc_mutex_unlock(&stream->mutex);
+        return ok;
+    }
+
+    sc_tick now = sc_tick_now();
+    bool notify = false;
+    for (unsigned i = 0; i < stream->client_count; ++i) {
+        struct sc_web_stream_client *client = stream->clients[i];
+        bool was_empty = !client->len;
+        bool was_ended = client->ended;
+        sc_web_stream_client_push_video(stream, client, packet, now);
+        notify |= (was_empty && client->len) || client->ended != was_ended;
+    }
+
+    sc_mutex_unlock(&stream->mutex);
+
+    if (notify) {
+        stream->cbs->on_data(stream, stream->cbs_userdata);
+    }
+
+    // Never fail, the web stream must not stop the other sinks
+    return true;
+}
+
+static bool
+sc_web_stream_audio_packet_sink_open(struct sc_packet_sink *sink,
+                                     AVCodecContext *ctx) {
+    struct sc_web_stream *stream = DOWNCAST_AUDIO(sink);
+
+    sc_mutex_lock(&stream->mutex);
+    bool ok = sc_web_stream_open_params(&stream->audio_params, ctx);
+    sc_mutex_unlock(&stream->mutex);
+
+    return ok;
+}
+
+static void
+sc_web_stream_audio_packet_sink_close(struct sc_packet_sink *sink) {
+    (void) sink;
+    // Nothing to do, the stream ends with the video stream
+}
+
+static bool
+sc_web_stream_audio_packet_sink_push(struct sc_packet_sink *sink,
+                                     const AVPacket *packet) {
+    struct sc_web_stream *stream = DOWNCAST_AUDIO(sink);
+
+    sc_mutex_lock(&stream->mutex);
+
+    if (packet->pts == AV_NOPTS_VALUE) {
+        bool ok = sc_web_stream_set_config(&stream->audio_config, packet);
+        sc_mutex_unlock(&stream->mutex);
+        return ok;
+    }
+
+    bool notify = false;
+    for (unsigned i = 0; i < stream->client_count; ++i) {
+        struct sc_web_stream_client *client = stream->clients[i];
+        bool was_empty = !client->len;
+        bool was_ended = client->ended;
+        sc_web_stream_client_push_audio(stream, client, packet);
+        notify |= (was_empty && client->len) || client->ended != was_ended;
+    }
+
+    sc_mutex_unlock(&stream->mutex);
+
+    if (notify) {
+        stream->cbs->on_data(stream, stream->cbs_userdata);
+    }
+
+    return true;
+}
+
+static void
+sc_web_stream_audio_packet_sink_disable(struct sc_packet_sink *sink) {
+    (void) sink;
+    // The clients will stream video only
+}
+
+bool
+sc_web_stream_init(struct sc_web_stream *stream,
+                   const struct sc_web_stream_callbacks *cbs,
+                   void *cbs_userdata) {
+    bool ok = sc_mutex_init(&stream->mutex);
+    if (!ok) {
+        return false;
+    }
+
+    stream->packet = av_packet_alloc();
+    if (!stream->packet) {
+        LOG_OOM();
+        sc_mutex_destroy(&stream->mutex);
+        return false;
+    }
+
+    stream->video_params = NULL;
+    stream->audio_params = NULL;
+    stream->video_config = NULL;
+    stream->audio_config = NULL;
+    stream->eos = false;
+    stream->client_count = 0;
+
+    assert(cbs && cbs->on_data);
+    stream->cbs = cbs;
+    stream->cbs_userdata = cbs_userdata;
+
+    static const struct sc_packet_sink_ops video_ops = {
+        .open = sc_web_stream_video_packet_sink_open,
+        .close = sc_web_stream_video_packet_sink_close,
+        .push = sc_web_stream_video_packet_sink_push,
+    };
+
+    stream->video_packet_sink.ops = &video_ops;
+
+    static const struct sc_packet_sink_ops audio_ops = {
+        .open = sc_web_stream_audio_packet_sink_open,
+        .close = sc_web_stream_audio_packet_sink_close,
+        .push = sc_web_stream_audio_packet_sink_push,
+        .disable = sc_web_stream_audio_packet_sink_disable,
+    };
+
+    stream->audio_packet_sink.ops = &audio_ops;
+
+    return true;
+}
+
+static void
+sc_web_stream_client_destroy(struct sc_web_stream_client *client) {
+    sc_web_stream_client_close_muxer(client);
+    free(client->data);
+    free(client);
+}
+
+void
+sc_web_stream_destroy(struct sc_web_stream *stream) {
+    for (unsigned i = 0; i < stream->client_count; ++i) {
+        sc_web_stream_client_destroy(stream->clients[i]);
+    }
+
+    av_packet_free(&stream->video_config);
+    av_packet_free(&stream->audio_config);
+    av_packet_free(&stream->packet);
+    avcodec_parameters_free(&stream->video_params);
+    avcodec_parameters_free(&stream->audio_params);
+    sc_mutex_destroy(&stream->mutex);
+}
+
+struct sc_web_stream_client *
+sc_web_stream_add_client(struct sc_web_stream *stream,
+                         enum sc_web_stream_format format) {
+    struct sc_web_stream_client *client = malloc(sizeof(*client));
+    if (!client) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    client->format = format;
+    client->ctx = NULL;
+    client->video_index = -1;
+    client->audio_index = -1;
+    client->pts_origin = AV_NOPTS_VALUE;
+    client->skipping = false;
+    client->skipping_since = 0;
+    client->dropped = 0;
+    client->restart = false;
+    client->ended = false;
+    client->data = NULL;
+    client->len = 0;
+    client->cap = 0;
+    client->pending = 0;
+
+    sc_mutex_lock(&stream->mutex);
+    if (stream->eos || stream->client_count == SC_WEB_STREAM_MAX_CLIENTS) {
+        sc_mutex_unlock(&stream->mutex);
+        free(client);
+        return NULL;
+    }
+
+    stream->clients[stream->client_count++] = client;
+    sc_mutex_unlock(&stream->mutex);
+
+    return client;
+}
+
+void
+sc_web_stream_remove_client(struct sc_web_stream *stream,
+                            struct sc_web_stream_client *client) {
+    sc_mutex_lock(&stream->mutex);
+    for (unsigned i = 0; i < stream->client_count; ++i) {
+        if (stream->clients[i] == client) {
+            // The order does not matter
+            stream->clients[i] = stream->clients[--stream->client_count];
+            break;
+        }
+    }
+    sc_mutex_unlock(&stream->mutex);
+
+    if (client->dropped) {
+        LOGD("Web stream: %" PRIu64 " packets dropped for a slow client",
+             client->dropped);
+    }
+
+    sc_web_stream_client_destroy(client);
+}
+
+bool
+sc_web_stream_client_flush(struct sc_web_stream *stream,
+                           struct sc_web_stream_client *client, size_t pending,
+                           sc_web_stream_write_fn write, void *userdata) {
+    sc_mutex_lock(&stream->mutex);
+
+    if (client->len) {
+        write(userdata, client->data, client->len);
+        pending += client->len;
+        // keep the buffer allocated for the next packets
+        client->len = 0;
+    }
+    client->pending = pending;
+    bool ended = client->ended;
+
+    sc_mutex_unlock(&stream->mutex);
+
+    return !ended;
+}
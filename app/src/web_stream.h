@@ -0,0 +1,127 @@
+#ifndef SC_WEB_STREAM_H
+#define SC_WEB_STREAM_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+
+#include "trait/packet_sink.h"
+#include "util/thread.h"
+#include "util/tick.h"
+
+#define SC_WEB_STREAM_MAX_CLIENTS 8
+
+enum sc_web_stream_format {
+    SC_WEB_STREAM_FORMAT_MPEGTS,
+    SC_WEB_STREAM_FORMAT_FMP4,
+};
+
+/**
+ * A client of the live stream, muxing its own container.
+ *
+ * The muxer is fed from the demuxer threads, and writes into an output buffer
+ * drained by the web server thread.
+ */
+struct sc_web_stream_client {
+    enum sc_web_stream_format format;
+
+    // NULL until the first video keyframe
+    AVFormatContext *ctx;
+    int video_index;
+    int audio_index; // -1 if the audio is not muxed
+    int64_t pts_origin;
+
+    // set when the client lags behind, until the next keyframe
+    bool skipping;
+    sc_tick skipping_since;
+    uint64_t dropped;
+
+    // set on a new video config, until the next keyframe (fMP4 only, the
+    // muxer must be reopened to write a new initialization segment)
+    bool restart;
+
+    // set on end-of-stream, on muxing failure or if the client is too slow
+    bool ended;
+
+    // muxed data not yet handed to the connection
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+
+    // data handed to the connection but not sent yet
+    size_t pending;
+};
+
+struct sc_web_stream {
+    struct sc_packet_sink video_packet_sink;
+    struct sc_packet_sink audio_packet_sink;
+
+    sc_mutex mutex;
+
+    // NULL until the corresponding sink is open
+    AVCodecParameters *video_params;
+    AVCodecParameters *audio_params;
+
+    // last config packets, to initialize the muxers of late joiners
+    AVPacket *video_config;
+    AVPacket *audio_config;
+
+    AVPacket *packet; // reused for every write
+
+    bool eos;
+
+    struct sc_web_stream_client *clients[SC_WEB_STREAM_MAX_CLIENTS];
+    unsigned client_count;
+
+    const struct sc_web_stream_callbacks *cbs;
+    void *cbs_userdata;
+};
+
+struct sc_web_stream_callbacks {
+    // called from the demuxer threads when some client has new data to send
+    void (*on_data)(struct sc_web_stream *stream, void *userdata);
+};
+
+typedef void (*sc_web_stream_write_fn)(void *userdata, const uint8_t *data,
+                                       size_t len);
+
+bool
+sc_web_stream_init(struct sc_web_stream *stream,
+                   const struct sc_web_stream_callbacks *cbs,
+                   void *cbs_userdata);
+
+void
+sc_web_stream_destroy(struct sc_web_stream *stream);
+
+/**
+ * Register a new client
+ *
+ * Return NULL if the stream is ended or if there are too many clients.
+ */
+struct sc_web_stream_client *
+sc_web_stream_add_client(struct sc_web_stream *stream,
+                         enum sc_web_stream_format format);
+
+void
+sc_web_stream_remove_client(struct sc_web_stream *stream,
+                            struct sc_web_stream_client *client);
+
+/**
+ * Hand the muxed data of a client to its connection
+ *
+ * The `pending` parameter is the amount of data still queued on the
+ * connection, which is used to detect slow clients.
+ *
+ * Return false if the client stream is ended (all its data have been
+ * written).
+ */
+bool
+sc_web_stream_client_flush(struct sc_web_stream *stream,
+                           struct sc_web_stream_client *client, size_t pending,
+                           sc_web_stream_write_fn write, void *userdata);
+
+#endif
@@ -0,0 +1,751 @@
+#include "yuv2rgb.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "util/log.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) \
+        && (defined(__x86_64__) || defined(__i386__))
+# define SC_YUV2RGB_X86
+# include <immintrin.h>
+# define SC_TARGET(T) __attribute__((target(T)))
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# define SC_YUV2RGB_NEON
+# include <arm_neon.h>
+#endif
+
+/*
+ * Fixed-point arithmetic
+ *
+ * All the implementations compute exactly the same values, using only
+ * operations available on 16-bit SIMD lanes:
+ *
+ *     mulhi(a, b) = (a * b) >> 16   (signed, rounded toward -inf)
+ *
+ *     y' = mulhi(max(Y - yoff, 0) << 7, cy)
+ *     u' = (U - 128) << 8
+ *     v' = (V - 128) << 8
+ *
+ *     R = clamp((y' + mulhi(v', cvr) + 16) >> 5)
+ *     G = clamp((y' - (mulhi(u', cug) + mulhi(v', cvg)) + 16) >> 5)
+ *     B = clamp((y' + mulhi(u', cub) + 16) >> 5)
+ *
+ * The intermediate values are in Q5, the coefficients cy in Q14 and the
+ * chroma coefficients in Q13. The intermediate sums never overflow 16 bits.
+ *
+ * The downscaling by 2 averages 2x2 boxes as avg(avg(a, c), avg(b, d)) where
+ * avg(x, y) = (x + y + 1) >> 1 (which is what the SIMD instructions compute),
+ * the downscaling by 4 applies it twice.
+ */
+
+struct sc_yuv2rgb_coefs {
+    int16_t yoff;
+    int16_t cy;
+    int16_t cvr;
+    int16_t cug;
+    int16_t cvg;
+    int16_t cub;
+};
+
+#define SC_Q(X, BITS) ((int16_t) ((X) * (1 << (BITS)) + 0.5))
+
+// Range scaling of limited range content
+#define SC_YSCALE (255.0 / 219)
+#define SC_CSCALE (255.0 / 224)
+
+#define SC_COEFS(KR, KB, YSCALE, CSCALE) { \
+    .yoff = (YSCALE) == 1 ? 0 : 16, \
+    .cy = SC_Q(YSCALE, 14), \
+    .cvr = SC_Q(2 * (1 - (KR)) * (CSCALE), 13), \
+    .cug = SC_Q(2 * (KB) * (1 - (KB)) / (1 - (KR) - (KB)) * (CSCALE), 13), \
+    .cvg = SC_Q(2 * (KR) * (1 - (KR)) / (1 - (KR) - (KB)) * (CSCALE), 13), \
+    .cub = SC_Q(2 * (1 - (KB)) * (CSCALE), 13), \
+}
+
+// Indexed by [matrix][full_range]
+static const struct sc_yuv2rgb_coefs sc_yuv2rgb_coefs[2][2] = {
+    [SC_YUV_MATRIX_BT601] = {
+        SC_COEFS(0.299, 0.114, SC_YSCALE, SC_CSCALE),
+        SC_COEFS(0.299, 0.114, 1, 1),
+    },
+    [SC_YUV_MATRIX_BT709] = {
+        SC_COEFS(0.2126, 0.0722, SC_YSCALE, SC_CSCALE),
+        SC_COEFS(0.2126, 0.0722, 1, 1),
+    },
+};
+
+typedef void
+sc_yuv2rgb_row_fn(const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                  uint8_t *dst, unsigned width, bool chroma_444,
+                  enum sc_rgb_format format,
+                  const struct sc_yuv2rgb_coefs *c);
+
+// Average 2x2 boxes of two rows of 2 * width pixels
+typedef void
+sc_yuv2rgb_box2_fn(const uint8_t *r0, const uint8_t *r1, uint8_t *dst,
+                   unsigned width);
+
+static inline int
+sc_mulhi(int a, int b) {
+    // Right shift of negative values is arithmetic with all the supported
+    // compilers
+    return (a * b) >> 16;
+}
+
+static inline uint8_t
+sc_clamp_q5(int value) {
+    if (value < 0) {
+        return 0;
+    }
+    value >>= 5;
+    return value > 255 ? 255 : value;
+}
+
+static void
+sc_yuv2rgb_row_scalar(const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                      uint8_t *dst, unsigned width, bool chroma_444,
+                      enum sc_rgb_format format,
+                      const struct sc_yuv2rgb_coefs *c) {
+    for (unsigned x = 0; x < width; ++x) {
+        unsigned cx = chroma_444 ? x : x / 2;
+
+        int ys = y[x] > c->yoff ? y[x] - c->yoff : 0;
+        int yt = sc_mulhi(ys << 7, c->cy);
+        int us = (u[cx] - 128) * 256;
+        int vs = (v[cx] - 128) * 256;
+
+        uint8_t r = sc_clamp_q5(yt + sc_mulhi(vs, c->cvr) + 16);
+        uint8_t g = sc_clamp_q5(yt - (sc_mulhi(us, c->cug)
+                                    + sc_mulhi(vs, c->cvg)) + 16);
+        uint8_t b = sc_clamp_q5(yt + sc_mulhi(us, c->cub) + 16);
+
+        switch (format) {
+            case SC_RGB_FORMAT_RGB24:
+                dst[0] = r;
+                dst[1] = g;
+                dst[2] = b;
+                dst += 3;
+                break;
+            case SC_RGB_FORMAT_BGR24:
+                dst[0] = b;
+                dst[1] = g;
+                dst[2] = r;
+                dst += 3;
+                break;
+            case SC_RGB_FORMAT_RGBA:
+                dst[0] = r;
+                dst[1] = g;
+                dst[2] = b;
+                dst[3] = 0xFF;
+                dst += 4;
+                break;
+            case SC_RGB_FORMAT_BGRA:
+                dst[0] = b;
+                dst[1] = g;
+                dst[2] = r;
+                dst[3] = 0xFF;
+                dst += 4;
+                break;
+        }
+    }
+}
+
+static void
+sc_yuv2rgb_box2_scalar(const uint8_t *r0, const uint8_t *r1, uint8_t *dst,
+                       unsigned width) {
+    for (unsigned x = 0; x < width; ++x) {
+        unsigned left = (r0[2 * x] + r1[2 * x] + 1) >> 1;
+        unsigned right = (r0[2 * x + 1] + r1[2 * x + 1] + 1) >> 1;
+        dst[x] = (left + right + 1) >> 1;
+    }
+}
+
+// Convert the remaining pixels of a row, from x (which must be even)
+static inline void
+sc_yuv2rgb_row_tail(const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                    uint8_t *dst, unsigned x, unsigned width, bool chroma_444,
+                    enum sc_rgb_format format,
+                    const struct sc_yuv2rgb_coefs *c) {
+    assert(!(x & 1));
+    if (x < width) {
+        unsigned cx = chroma_444 ? x : x / 2;
+        unsigned bpp = sc_rgb_format_get_bytes_per_pixel(format);
+        sc_yuv2rgb_row_scalar(y + x, u + cx, v + cx, dst + x * bpp, width - x,
+                              chroma_444, format, c);
+    }
+}
+
+#ifdef SC_YUV2RGB_X86
+
+// Compute 8 pixels from the 16-bit values (chroma as (C - 128) << 8)
+SC_TARGET("sse2") static inline void
+sc_yuv2rgb_compute8_sse2(__m128i y, __m128i u, __m128i v,
+                         const struct sc_yuv2rgb_coefs *c,
+                         __m128i *r, __m128i *g, __m128i *b) {
+    __m128i rounding = _mm_set1_epi16(16);
+
+    __m128i ys = _mm_subs_epu16(y, _mm_set1_epi16(c->yoff));
+    __m128i yt = _mm_mulhi_epi16(_mm_slli_epi16(ys, 7),
+                                 _mm_set1_epi16(c->cy));
+
+    __m128i tr = _mm_mulhi_epi16(v, _mm_set1_epi16(c->cvr));
+    __m128i tg = _mm_add_epi16(_mm_mulhi_epi16(u, _mm_set1_epi16(c->cug)),
+                               _mm_mulhi_epi16(v, _mm_set1_epi16(c->cvg)));
+    __m128i tb = _mm_mulhi_epi16(u, _mm_set1_epi16(c->cub));
+
+    *r = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(yt, tr), rounding), 5);
+    *g = _mm_srai_epi16(_mm_add_epi16(_mm_sub_epi16(yt, tg), rounding), 5);
+    *b = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(yt, tb), rounding), 5);
+}
+
+// Compute 16 pixels from 16 luma and 16 chroma samples
+SC_TARGET("sse2") static inline void
+sc_yuv2rgb_compute16_sse2(__m128i y8, __m128i u8, __m128i v8,
+                          const struct sc_yuv2rgb_coefs *c,
+                          __m128i *r, __m128i *g, __m128i *b) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i bias = _mm_set1_epi16((short) 0x8000);
+
+    // (C - 128) << 8
+    __m128i u_lo = _mm_sub_epi16(_mm_unpacklo_epi8(zero, u8), bias);
+    __m128i u_hi = _mm_sub_epi16(_mm_unpackhi_epi8(zero, u8), bias);
+    __m128i v_lo = _mm_sub_epi16(_mm_unpacklo_epi8(zero, v8), bias);
+    __m128i v_hi = _mm_sub_epi16(_mm_unpackhi_epi8(zero, v8), bias);
+
+    __m128i r_lo, g_lo, b_lo;
+    sc_yuv2rgb_compute8_sse2(_mm_unpacklo_epi8(y8, zero), u_lo, v_lo, c,
+                             &r_lo, &g_lo, &b_lo);
+    __m128i r_hi, g_hi, b_hi;
+    sc_yuv2rgb_compute8_sse2(_mm_unpackhi_epi8(y8, zero), u_hi, v_hi, c,
+                             &r_hi, &g_hi, &b_hi);
+
+    *r = _mm_packus_epi16(r_lo, r_hi);
+    *g = _mm_packus_epi16(g_lo, g_hi);
+    *b = _mm_packus_epi16(b_lo, b_hi);
+}
+
+// Load the 16 chroma samples of 16 pixels
+SC_TARGET("sse2") static inline __m128i
+sc_yuv2rgb_load_chroma16_sse2(const uint8_t *p, unsigned x, bool chroma_444) {
+    if (chroma_444) {
+        return _mm_loadu_si128((const __m128i *) (p + x));
+    }
+
+    __m128i c = _mm_loadl_epi64((const __m128i *) (p + x / 2));
+    return _mm_unpacklo_epi8(c, c);
+}
+
+// Store 16 pixels in a 4-byte format (c0 is the first component in memory)
+SC_TARGET("sse2") static inline void
+sc_yuv2rgb_store16_4_sse2(uint8_t *dst, __m128i c0, __m128i c1, __m128i c2) {
+    __m128i alpha = _mm_set1_epi8((char) 0xFF);
+
+    __m128i c01_lo = _mm_unpacklo_epi8(c0, c1);
+    __m128i c01_hi = _mm_unpackhi_epi8(c0, c1);
+    __m128i c23_lo = _mm_unpacklo_epi8(c2, alpha);
+    __m128i c23_hi = _mm_unpackhi_epi8(c2, alpha);
+
+    _mm_storeu_si128((__m128i *) dst, _mm_unpacklo_epi16(c01_lo, c23_lo));
+    _mm_storeu_si128((__m128i *) (dst + 16),
+                     _mm_unpackhi_epi16(c01_lo, c23_lo));
+    _mm_storeu_si128((__m128i *) (dst + 32),
+                     _mm_unpacklo_epi16(c01_hi, c23_hi));
+    _mm_storeu_si128((__m128i *) (dst + 48),
+                     _mm_unpackhi_epi16(c01_hi, c23_hi));
+}
+
+// Store 16 pixels in a 3-byte format (c0 is the first component in memory)
+SC_TARGET("ssse3") static inline void
+sc_yuv2rgb_store16_3_ssse3(uint8_t *dst, __m128i c0, __m128i c1, __m128i c2) {
+    // For each 16-byte output block, the source pixel of each byte of each
+    // component (-1 to zero it)
+    const __m128i m00 = _mm_setr_epi8(0, -1, -1, 1, -1, -1, 2, -1,
+                                      -1, 3, -1, -1, 4, -1, -1, 5);
+    const __m128i m01 = _mm_setr_epi8(-1, 0, -1, -1, 1, -1, -1, 2,
+                                      -1, -1, 3, -1, -1, 4, -1, -1);
+    const __m128i m02 = _mm_setr_epi8(-1, -1, 0, -1, -1, 1, -1, -1,
+                                      2, -1, -1, 3, -1, -1, 4, -1);
+    const __m128i m10 = _mm_setr_epi8(-1, -1, 6, -1, -1, 7, -1, -1,
+                                      8, -1, -1, 9, -1, -1, 10, -1);
+    const __m128i m11 = _mm_setr_epi8(5, -1, -1, 6, -1, -1, 7, -1,
+                                      -1, 8, -1, -1, 9, -1, -1, 10);
+    const __m128i m12 = _mm_setr_epi8(-1, 5, -1, -1, 6, -1, -1, 7,
+                                      -1, -1, 8, -1, -1, 9, -1, -1);
+    const __m128i m20 = _mm_setr_epi8(-1, 11, -1, -1, 12, -1, -1, 13,
+                                      -1, -1, 14, -1, -1, 15, -1, -1);
+    const __m128i m21 = _mm_setr_epi8(-1, -1, 11, -1, -1, 12, -1, -1,
+                                      13, -1, -1, 14, -1, -1, 15, -1);
+    const __m128i m22 = _mm_setr_epi8(10, -1, -1, 11, -1, -1, 12, -1,
+                                      -1, 13, -1, -1, 14, -1, -1, 15);
+
+    __m128i out0 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(c0, m00),
+                                             _mm_shuffle_epi8(c1, m01)),
+                                _mm_shuffle_epi8(c2, m02));
+    __m128i out1 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(c0, m10),
+                                             _mm_shuffle_epi8(c1, m11)),
+                                _mm_shuffle_epi8(c2, m12));
+    __m128i out2 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(c0, m20),
+                                             _mm_shuffle_epi8(c1, m21)),
+                                _mm_shuffle_epi8(c2, m22));
+
+    _mm_storeu_si128((__m128i *) dst, out0);
+    _mm_storeu_si128((__m128i *) (dst + 16), out1);
+    _mm_storeu_si128((__m128i *) (dst + 32), out2);
+}
+
+SC_TARGET("sse2") static void
+sc_yuv2rgb_row_sse2(const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                    uint8_t *dst, unsigned width, bool chroma_444,
+                    enum sc_rgb_format format,
+                    const struct sc_yuv2rgb_coefs *c) {
+    if (sc_rgb_format_get_bytes_per_pixel(format) != 4) {
+        // Packing 3-byte pixels requires SSSE3
+        sc_yuv2rgb_row_scalar(y, u, v, dst, width, chroma_444, format, c);
+        return;
+    }
+
+    bool rgba = format == SC_RGB_FORMAT_RGBA;
+
+    unsigned x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i y8 = _mm_loadu_si128((const __m128i *) (y + x));
+        __m128i u8 = sc_yuv2rgb_load_chroma16_sse2(u, x, chroma_444);
+        __m128i v8 = sc_yuv2rgb_load_chroma16_sse2(v, x, chroma_444);
+
+        __m128i r, g, b;
+        sc_yuv2rgb_compute16_sse2(y8, u8, v8, c, &r, &g, &b);
+
+        uint8_t *out = dst + x * 4;
+        if (rgba) {
+            sc_yuv2rgb_store16_4_sse2(out, r, g, b);
+        } else {
+            sc_yuv2rgb_store16_4_sse2(out, b, g, r);
+        }
+    }
+
+    sc_yuv2rgb_row_tail(y, u, v, dst, x, width, chroma_444, format, c);
+}
+
+SC_TARGET("ssse3") static void
+sc_yuv2rgb_row_ssse3(const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                     uint8_t *dst, unsigned width, bool chroma_444,
+                     enum sc_rgb_format format,
+                     const struct sc_yuv2rgb_coefs *c) {
+    unsigned bpp = sc_rgb_format_get_bytes_per_pixel(format);
+    bool rgb_order = format == SC_RGB_FORMAT_RGB24
+                  || format == SC_RGB_FORMAT_RGBA;
+
+    unsigned x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i y8 = _mm_loadu_si128((const __m128i *) (y + x));
+        __m128i u8 = sc_yuv2rgb_load_chroma16_sse2(u, x, chroma_444);
+        __m128i v8 = sc_yuv2rgb_load_chroma16_sse2(v, x, chroma_444);
+
+        __m128i r, g, b;
+        sc_yuv2rgb_compute16_sse2(y8, u8, v8, c, &r, &g, &b);
+
+        __m128i c0 = rgb_order ? r : b;
+        __m128i c2 = rgb_order ? b : r;
+        uint8_t *out = dst + x * bpp;
+        if (bpp == 3) {
+            sc_yuv2rgb_store16_3_ssse3(out, c0, g, c2);
+        } else {
+            sc_yuv2rgb_store16_4_sse2(out, c0, g, c2);
+        }
+    }
+
+    sc_yuv2rgb_row_tail(y, u, v, dst, x, width, chroma_444, format, c);
+}
+
+SC_TARGET("sse2") static void
+sc_yuv2rgb_box2_sse2(const uint8_t *r0, const uint8_t *r1, uint8_t *dst,
+                     unsigned width) {
+    __m128i mask = _mm_set1_epi16(0x00FF);
+
+    unsigned x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const __m128i *p0 = (const __m128i *) (r0 + 2 * x);
+        const __m128i *p1 = (const __m128i *) (r1 + 2 * x);
+        __m128i v0 = _mm_avg_epu8(_mm_loadu_si128(p0), _mm_loadu_si128(p1));
+        __m128i v1 = _mm_avg_epu8(_mm_loadu_si128(p0 + 1),
+                                  _mm_loadu_si128(p1 + 1));
+
+        __m128i h0 = _mm_avg_epu16(_mm_and_si128(v0, mask),
+                                   _mm_srli_epi16(v0, 8));
+        __m128i h1 = _mm_avg_epu16(_mm_and_si128(v1, mask),
+                                   _mm_srli_epi16(v1, 8));
+
+        _mm_storeu_si128((__m128i *) (dst + x), _mm_packus_epi16(h0, h1));
+    }
+
+    if (x < width) {
+        sc_yuv2rgb_box2_scalar(r0 + 2 * x, r1 + 2 * x, dst + x, width - x);
+    }
+}
+
+// Compute 16 pixels from the 16-bit values (chroma as (C - 128) << 8)
+SC_TARGET("avx2") static inline void
+sc_yuv2rgb_compute16_avx2(__m256i y, __m256i u, __m256i v,
+                          const struct sc_yuv2rgb_coefs *c,
+                          __m256i *r, __m256i *g, __m256i *b) {
+    __m256i rounding = _mm256_set1_epi16(16);
+
+    __m256i ys = _mm256_subs_epu16(y, _mm256_set1_epi16(c->yoff));
+    __m256i yt = _mm256_mulhi_epi16(_mm256_slli_epi16(ys, 7),
+                                    _mm256_set1_epi16(c->cy));
+
+    __m256i tr = _mm256_mulhi_epi16(v, _mm256_set1_epi16(c->cvr));
+    __m256i tg =
+        _mm256_add_epi16(_mm256_mulhi_epi16(u, _mm256_set1_epi16(c->cug)),
+                         _mm256_mulhi_epi16(v, _mm256_set1_epi16(c->cvg)));
+    __m256i tb = _mm256_mulhi_epi16(u, _mm256_set1_epi16(c->cub));
+
+    *r = _mm256_srai_epi16(
+            _mm256_add_epi16(_mm256_add_epi16(yt, tr), rounding), 5);
+    *g = _mm256_srai_epi16(
+            _mm256_add_epi16(_mm256_sub_epi16(yt, tg), rounding), 5);
+    *b = _mm256_srai_epi16(
+            _mm256_add_epi16(_mm256_add_epi16(yt, tb), rounding), 5);
+}
+
+// Load the 16 chroma samples of 16 pixels, as (C - 128) << 8
+SC_TARGET("avx2") static inline __m256i
+sc_yuv2rgb_load_chroma16_avx2(const uint8_t *p, unsigned x, bool chroma_444) {
+    __m128i c8 = sc_yuv2rgb_load_chroma16_sse2(p, x, chroma_444);
+    __m256i c16 = _mm256_slli_epi16(_mm256_cvtepu8_epi16(c8), 8);
+    return _mm256_sub_epi16(c16, _mm256_set1_epi16((short) 0x8000));
+}
+
+// Pack two vectors of 16 16-bit values to 32 bytes, in order
+SC_TARGET("avx2") static inline __m256i
+sc_yuv2rgb_pack_avx2(__m256i a, __m256i b) {
+    return _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+}
+
+SC_TARGET("avx2") static void
+sc_yuv2rgb_row_avx2(const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                    uint8_t *dst, unsigned width, bool chroma_444,
+                    enum sc_rgb_format format,
+                    const struct sc_yuv2rgb_coefs *c) {
+    unsigned bpp = sc_rgb_format_get_bytes_per_pixel(format);
+    bool rgb_order = format == SC_RGB_FORMAT_RGB24
+                  || format == SC_RGB_FORMAT_RGBA;
+
+    unsigned x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i r16[2], g16[2], b16[2];
+        for (unsigned i = 0; i < 2; ++i) {
+            unsigned px = x + 16 * i;
+            __m128i y8 = _mm_loadu_si128((const __m128i *) (y + px));
+            __m256i y16 = _mm256_cvtepu8_epi16(y8);
+            __m256i u16 = sc_yuv2rgb_load_chroma16_avx2(u, px, chroma_444);
+            __m256i v16 = sc_yuv2rgb_load_chroma16_avx2(v, px, chroma_444);
+            sc_yuv2rgb_compute16_avx2(y16, u16, v16, c,
+                                      &r16[i], &g16[i], &b16[i]);
+        }
+
+        __m256i r = sc_yuv2rgb_pack_avx2(r16[0], r16[1]);
+        __m256i g = sc_yuv2rgb_pack_avx2(g16[0], g16[1]);
+        __m256i b = sc_yuv2rgb_pack_avx2(b16[0], b16[1]);
+
+        __m256i c0 = rgb_order ? r : b;
+        __m256i c2 = rgb_order ? b : r;
+
+        uint8_t *out = dst + x * bpp;
+        for (unsigned i = 0; i < 2; ++i) {
+            __m128i h0 = i ? _mm256_extracti128_si256(c0, 1)
+                           : _mm256_castsi256_si128(c0);
+            __m128i h1 = i ? _mm256_extracti128_si256(g, 1)
+                           : _mm256_castsi256_si128(g);
+            __m128i h2 = i ? _mm256_extracti128_si256(c2, 1)
+                           : _mm256_castsi256_si128(c2);
+            if (bpp == 3) {
+                sc_yuv2rgb_store16_3_ssse3(out, h0, h1, h2);
+            } else {
+                sc_yuv2rgb_store16_4_sse2(out, h0, h1, h2);
+            }
+            out += 16 * bpp;
+        }
+    }
+
+    if (x < width) {
+        // Convert the remaining pixels by blocks of 16
+        unsigned cx = chroma_444 ? x : x / 2;
+        sc_yuv2rgb_row_ssse3(y + x, u + cx, v + cx, dst + x * bpp, width - x,
+                             chroma_444, format, c);
+    }
+}
+
+#endif // SC_YUV2RGB_X86
+
+#ifdef SC_YUV2RGB_NEON
+
+static inline int16x8_t
+sc_yuv2rgb_mulhi_neon(int16x8_t a, int16_t b) {
+    int32x4_t lo = vmull_n_s16(vget_low_s16(a), b);
+    int32x4_t hi = vmull_n_s16(vget_high_s16(a), b);
+    return vcombine_s16(vshrn_n_s32(lo, 16), vshrn_n_s32(hi, 16));
+}
+
+// Compute 8 pixels from 8 luma and 8 chroma samples
+static inline void
+sc_yuv2rgb_compute8_neon(uint8x8_t y8, uint8x8_t u8, uint8x8_t v8,
+                         const struct sc_yuv2rgb_coefs *c,
+                         uint8x8_t *r, uint8x8_t *g, uint8x8_t *b) {
+    int16x8_t rounding = vdupq_n_s16(16);
+    uint16x8_t bias = vdupq_n_u16(0x8000);
+
+    uint16x8_t ys = vqsubq_u16(vmovl_u8(y8), vdupq_n_u16(c->yoff));
+    int16x8_t yt =
+        sc_yuv2rgb_mulhi_neon(vreinterpretq_s16_u16(vshlq_n_u16(ys, 7)),
+                              c->cy);
+
+    // (C - 128) << 8
+    int16x8_t u = vreinterpretq_s16_u16(vsubq_u16(vshll_n_u8(u8, 8), bias));
+    int16x8_t v = vreinterpretq_s16_u16(vsubq_u16(vshll_n_u8(v8, 8), bias));
+
+    int16x8_t tr = sc_yuv2rgb_mulhi_neon(v, c->cvr);
+    int16x8_t tg = vaddq_s16(sc_yuv2rgb_mulhi_neon(u, c->cug),
+                             sc_yuv2rgb_mulhi_neon(v, c->cvg));
+    int16x8_t tb = sc_yuv2rgb_mulhi_neon(u, c->cub);
+
+    *r = vqmovun_s16(vshrq_n_s16(vaddq_s16(vaddq_s16(yt, tr), rounding), 5));
+    *g = vqmovun_s16(vshrq_n_s16(vaddq_s16(vsubq_s16(yt, tg), rounding), 5));
+    *b = vqmovun_s16(vshrq_n_s16(vaddq_s16(vaddq_s16(yt, tb), rounding), 5));
+}
+
+// Load the 16 chroma samples of 16 pixels
+static inline uint8x16_t
+sc_yuv2rgb_load_chroma16_neon(const uint8_t *p, unsigned x, bool chroma_444) {
+    if (chroma_444) {
+        return vld1q_u8(p + x);
+    }
+
+    uint8x8_t c = vld1_u8(p + x / 2);
+    uint8x8x2_t dup = vzip_u8(c, c);
+    return vcombine_u8(dup.val[0], dup.val[1]);
+}
+
+static void
+sc_yuv2rgb_row_neon(const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                    uint8_t *dst, unsigned width, bool chroma_444,
+                    enum sc_rgb_format format,
+                    const struct sc_yuv2rgb_coefs *c) {
+    unsigned bpp = sc_rgb_format_get_bytes_per_pixel(format);
+    bool rgb_order = format == SC_RGB_FORMAT_RGB24
+                  || format == SC_RGB_FORMAT_RGBA;
+
+    unsigned x = 0;
+    for (; x + 16 <= width; x += 16) {
+        uint8x16_t y8 = vld1q_u8(y + x);
+        uint8x16_t u8 = sc_yuv2rgb_load_chroma16_neon(u, x, chroma_444);
+        uint8x16_t v8 = sc_yuv2rgb_load_chroma16_neon(v, x, chroma_444);
+
+        uint8x8_t r_lo, g_lo, b_lo;
+        sc_yuv2rgb_compute8_neon(vget_low_u8(y8), vget_low_u8(u8),
+                                 vget_low_u8(v8), c, &r_lo, &g_lo, &b_lo);
+        uint8x8_t r_hi, g_hi, b_hi;
+        sc_yuv2rgb_compute8_neon(vget_high_u8(y8), vget_high_u8(u8),
+                                 vget_high_u8(v8), c, &r_hi, &g_hi, &b_hi);
+
+        uint8x16_t r = vcombine_u8(r_lo, r_hi);
+        uint8x16_t g = vcombine_u8(g_lo, g_hi);
+        uint8x16_t b = vcombine_u8(b_lo, b_hi);
+
+        uint8_t *out = dst + x * bpp;
+        if (bpp == 3) {
+            uint8x16x3_t pixels = {{rgb_order ? r : b, g, rgb_order ? b : r}};
+            vst3q_u8(out, pixels);
+        } else {
+            uint8x16x4_t pixels = {{rgb_order ? r : b, g, rgb_order ? b : r,
+                                    vdupq_n_u8(0xFF)}};
+            vst4q_u8(out, pixels);
+        }
+    }
+
+    sc_yuv2rgb_row_tail(y, u, v, dst, x, width, chroma_444, format, c);
+}
+
+static void
+sc_yuv2rgb_box2_neon(const uint8_t *r0, const uint8_t *r1, uint8_t *dst,
+                     unsigned width) {
+    unsigned x = 0;
+    for (; x + 16 <= width; x += 16) {
+        // Deinterleave the even and odd columns
+        uint8x16x2_t a = vld2q_u8(r0 + 2 * x);
+        uint8x16x2_t b = vld2q_u8(r1 + 2 * x);
+        uint8x16_t left = vrhaddq_u8(a.val[0], b.val[0]);
+        uint8x16_t right = vrhaddq_u8(a.val[1], b.val[1]);
+        vst1q_u8(dst + x, vrhaddq_u8(left, right));
+    }
+
+    if (x < width) {
+        sc_yuv2rgb_box2_scalar(r0 + 2 * x, r1 + 2 * x, dst + x, width - x);
+    }
+}
+
+#endif // SC_YUV2RGB_NEON
+
+bool
+sc_yuv2rgb_is_supported(enum sc_yuv2rgb_impl impl) {
+    switch (impl) {
+        case SC_YUV2RGB_IMPL_AUTO:
+        case SC_YUV2RGB_IMPL_SCALAR:
+            return true;
+#ifdef SC_YUV2RGB_X86
+        case SC_YUV2RGB_IMPL_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case SC_YUV2RGB_IMPL_SSSE3:
+            return __builtin_cpu_supports("ssse3");
+        case SC_YUV2RGB_IMPL_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+#ifdef SC_YUV2RGB_NEON
+        case SC_YUV2RGB_IMPL_NEON:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+static enum sc_yuv2rgb_impl
+sc_yuv2rgb_get_best_impl(void) {
+    static const enum sc_yuv2rgb_impl impls[] = {
+        SC_YUV2RGB_IMPL_AVX2,
+        SC_YUV2RGB_IMPL_SSSE3,
+        SC_YUV2RGB_IMPL_SSE2,
+        SC_YUV2RGB_IMPL_NEON,
+    };
+
+    for (size_t i = 0; i < ARRAY_LEN(impls); ++i) {
+        if (sc_yuv2rgb_is_supported(impls[i])) {
+            return impls[i];
+        }
+    }
+
+    return SC_YUV2RGB_IMPL_SCALAR;
+}
+
+bool
+sc_yuv2rgb_convert_with(enum sc_yuv2rgb_impl impl,
+                        const struct sc_yuv_image *src, unsigned scale_shift,
+                        enum sc_rgb_format format, uint8_t *dst,
+                        ptrdiff_t dst_linesize) {
+    assert(scale_shift <= 2);
+    assert(src->matrix == SC_YUV_MATRIX_BT601
+        || src->matrix == SC_YUV_MATRIX_BT709);
+
+    unsigned width = src->width >> scale_shift;
+    unsigned height = src->height >> scale_shift;
+    assert(width && height);
+
+    if (impl == SC_YUV2RGB_IMPL_AUTO) {
+        impl = sc_yuv2rgb_get_best_impl();
+    }
+    assert(sc_yuv2rgb_is_supported(impl));
+
+    sc_yuv2rgb_row_fn *row = sc_yuv2rgb_row_scalar;
+    sc_yuv2rgb_box2_fn *box2 = sc_yuv2rgb_box2_scalar;
+    switch (impl) {
+#ifdef SC_YUV2RGB_X86
+        case SC_YUV2RGB_IMPL_SSE2:
+            row = sc_yuv2rgb_row_sse2;
+            box2 = sc_yuv2rgb_box2_sse2;
+            break;
+        case SC_YUV2RGB_IMPL_SSSE3:
+            row = sc_yuv2rgb_row_ssse3;
+            box2 = sc_yuv2rgb_box2_sse2;
+            break;
+        case SC_YUV2RGB_IMPL_AVX2:
+            row = sc_yuv2rgb_row_avx2;
+            // Not faster with 256-bit vectors (the rows are short)
+            box2 = sc_yuv2rgb_box2_sse2;
+            break;
+#endif
+#ifdef SC_YUV2RGB_NEON
+        case SC_YUV2RGB_IMPL_NEON:
+            row = sc_yuv2rgb_row_neon;
+            box2 = sc_yuv2rgb_box2_neon;
+            break;
+#endif
+        default:
+            break;
+    }
+
+    const struct sc_yuv2rgb_coefs *c =
+        &sc_yuv2rgb_coefs[src->matrix][src->full_range];
+
+    const uint8_t *const *planes = src->planes;
+    const int *ls = src->linesizes;
+
+    if (!scale_shift) {
+        for (unsigned y = 0; y < height; ++y) {
+            unsigned cy = y / 2;
+            row(planes[0] + (ptrdiff_t) y * ls[0],
+                planes[1] + (ptrdiff_t) cy * ls[1],
+                planes[2] + (ptrdiff_t) cy * ls[2],
+                dst + (ptrdiff_t) y * dst_linesize, width, false, format, c);
+        }
+        return true;
+    }
+
+    // Temporary rows: the downscaled luma row, and for a downscaling by 4, the
+    // luma rows downscaled by 2 and the downscaled chroma rows
+    size_t tmp_size = scale_shift == 1 ? width : 7 * (size_t) width;
+    uint8_t *tmp = malloc(tmp_size);
+    if (!tmp) {
+        LOG_OOM();
+        return false;
+    }
+
+    uint8_t *y_row = tmp;
+    for (unsigned y = 0; y < height; ++y) {
+        const uint8_t *u_row;
+        const uint8_t *v_row;
+
+        if (scale_shift == 1) {
+            const uint8_t *l0 = planes[0] + (ptrdiff_t) (2 * y) * ls[0];
+            box2(l0, l0 + ls[0], y_row, width);
+
+            // One chroma sample per output pixel
+            u_row = planes[1] + (ptrdiff_t) y * ls[1];
+            v_row = planes[2] + (ptrdiff_t) y * ls[2];
+        } else {
+            uint8_t *half0 = tmp + width;
+            uint8_t *half1 = half0 + 2 * width;
+            uint8_t *u_tmp = half1 + 2 * width;
+            uint8_t *v_tmp = u_tmp + width;
+
+            const uint8_t *l0 = planes[0] + (ptrdiff_t) (4 * y) * ls[0];
+            box2(l0, l0 + ls[0], half0, 2 * width);
+            box2(l0 + 2 * ls[0], l0 + 3 * ls[0], half1, 2 * width);
+            box2(half0, half1, y_row, width);
+
+            const uint8_t *c0 = planes[1] + (ptrdiff_t) (2 * y) * ls[1];
+            box2(c0, c0 + ls[1], u_tmp, width);
+            c0 = planes[2] + (ptrdiff_t) (2 * y) * ls[2];
+            box2(c0, c0 + ls[2], v_tmp, width);
+
+            u_row = u_tmp;
+            v_row = v_tmp;
+        }
+
+        row(y_row, u_row, v_row, dst + (ptrdiff_t) y * dst_linesize, width,
+            true, format, c);
+    }
+
+    free(tmp);
+    return true;
+}
+
+bool
+sc_yuv2rgb_convert(const struct sc_yuv_image *src, unsigned scale_shift,
+                   enum sc_rgb_format format, uint8_t *dst,
+                   ptrdiff_t dst_linesize) {
+    return sc_yuv2rgb_convert_with(SC_YUV2RGB_IMPL_AUTO, src, scale_shift,
+                                   format, dst, dst_linesize);
+}
@@ -0,0 +1,94 @@
+#ifndef SC_YUV2RGB_H
+#define SC_YUV2RGB_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Conversion of YUV 4:2:0 planar images to packed RGB on the CPU
+ *
+ * The conversion uses 16-bit fixed-point arithmetic, with nearest chroma
+ * upsampling. The SIMD implementations (SSE2, SSSE3, AVX2, NEON) are selected
+ * at runtime, and produce exactly the same output as the scalar reference.
+ *
+ * The image may be downscaled by 2 or 4 in the same pass (each output pixel
+ * is the average of a 2x2 or 4x4 box).
+ */
+
+enum sc_yuv_matrix {
+    SC_YUV_MATRIX_BT601,
+    SC_YUV_MATRIX_BT709,
+};
+
+enum sc_rgb_format {
+    SC_RGB_FORMAT_RGB24,
+    SC_RGB_FORMAT_BGR24,
+    SC_RGB_FORMAT_RGBA, // alpha is always 255
+    SC_RGB_FORMAT_BGRA, // alpha is always 255
+};
+
+enum sc_yuv2rgb_impl {
+    SC_YUV2RGB_IMPL_AUTO, // the best implementation supported by the CPU
+    SC_YUV2RGB_IMPL_SCALAR,
+    SC_YUV2RGB_IMPL_SSE2, // 4-byte formats only (scalar otherwise)
+    SC_YUV2RGB_IMPL_SSSE3,
+    SC_YUV2RGB_IMPL_AVX2,
+    SC_YUV2RGB_IMPL_NEON,
+};
+
+struct sc_yuv_image {
+    const uint8_t *planes[3]; // Y, U, V
+    int linesizes[3];
+    unsigned width;
+    unsigned height;
+    enum sc_yuv_matrix matrix;
+    bool full_range;
+};
+
+static inline unsigned
+sc_rgb_format_get_bytes_per_pixel(enum sc_rgb_format format) {
+    return format == SC_RGB_FORMAT_RGB24 || format == SC_RGB_FORMAT_BGR24
+         ? 3 : 4;
+}
+
+/**
+ * Return the matrix to use for a frame of the given height if the color space
+ * is not specified (like SDL, BT.709 for HD content)
+ */
+static inline enum sc_yuv_matrix
+sc_yuv_matrix_guess(unsigned height) {
+    return height > 576 ? SC_YUV_MATRIX_BT709 : SC_YUV_MATRIX_BT601;
+}
+
+/**
+ * Return true if the implementation can be used on this CPU
+ */
+bool
+sc_yuv2rgb_is_supported(enum sc_yuv2rgb_impl impl);
+
+/**
+ * Convert an image to RGB, downscaled by 2^scale_shift (0, 1 or 2)
+ *
+ * The output size is (width >> scale_shift) x (height >> scale_shift), which
+ * must not be empty. The output linesize may be negative (to write the rows
+ * bottom-up).
+ *
+ * Return false on allocation failure.
+ */
+bool
+sc_yuv2rgb_convert(const struct sc_yuv_image *src, unsigned scale_shift,
+                   enum sc_rgb_format format, uint8_t *dst,
+                   ptrdiff_t dst_linesize);
+
+// Same as sc_yuv2rgb_convert(), with a specific implementation (which must be
+// supported), for testing and benchmarking
+bool
+sc_yuv2rgb_convert_with(enum sc_yuv2rgb_impl impl,
+                        const struct sc_yuv_image *src, unsigned scale_shift,
+                        enum sc_rgb_format format, uint8_t *dst,
+                        ptrdiff_t dst_linesize);
+
+#endif
@@ -0,0 +1,459 @@
+#include "common.h"
+
+#include <assert.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/frame.h>
+
+#include "async_sink.h"
+
+#define DOWNCAST(SINK) container_of(SINK, struct test_sink, packet_sink)
+
+#define DOWNCAST_FRAME(SINK) \
+    container_of(SINK, struct test_frame_sink, frame_sink)
+
+#define TEST_SINK_MAX_PACKETS 16
+#define TEST_SINK_MAX_FRAMES 16
+
+struct test_sink {
+    struct sc_packet_sink packet_sink;
+
+    sc_mutex mutex;
+    sc_cond cond;
+    bool blocked; // block the async thread in push()
+    unsigned entered; // number of calls to push()
+
+    bool open;
+    int64_t pts[TEST_SINK_MAX_PACKETS];
+    unsigned count;
+};
+
+static bool
+test_sink_open(struct sc_packet_sink *sink, AVCodecContext *ctx) {
+    (void) ctx;
+    struct test_sink *ts = DOWNCAST(sink);
+    assert(!ts->open);
+    ts->open = true;
+    return true;
+}
+
+static void
+test_sink_close(struct sc_packet_sink *sink) {
+    struct test_sink *ts = DOWNCAST(sink);
+    assert(ts->open);
+    ts->open = false;
+}
+
+static bool
+test_sink_push(struct sc_packet_sink *sink, const AVPacket *packet) {
+    struct test_sink *ts = DOWNCAST(sink);
+    assert(ts->open);
+
+    sc_mutex_lock(&ts->mutex);
+    ++ts->entered;
+    sc_cond_signal(&ts->cond);
+    while (ts->blocked) {
+        sc_cond_wait(&ts->cond, &ts->mutex);
+    }
+    assert(ts->count < TEST_SINK_MAX_PACKETS);
+    ts->pts[ts->count++] = packet->pts;
+    sc_mutex_unlock(&ts->mutex);
+
+    return true;
+}
+
+static void
+test_sink_init(struct test_sink *ts) {
+    static const struct sc_packet_sink_ops ops = {
+        .open = test_sink_open,
+        .close = test_sink_close,
+        .push = test_sink_push,
+    };
+
+    ts->packet_sink.ops = &ops;
+
+    bool ok = sc_mutex_init(&ts->mutex);
+    assert(ok);
+    ok = sc_cond_init(&ts->cond);
+    assert(ok);
+    (void) ok;
+
+    ts->blocked = false;
+    ts->entered = 0;
+    ts->open = false;
+    ts->count = 0;
+}
+
+static void
+test_sink_destroy(struct test_sink *ts) {
+    sc_cond_destroy(&ts->cond);
+    sc_mutex_destroy(&ts->mutex);
+}
+
+static void
+test_sink_set_blocked(struct test_sink *ts, bool blocked) {
+    sc_mutex_lock(&ts->mutex);
+    ts->blocked = blocked;
+    sc_cond_signal(&ts->cond);
+    sc_mutex_unlock(&ts->mutex);
+}
+
+// Wait until the async thread is blocked in the push() of the n-th packet
+static void
+test_sink_wait_entered(struct test_sink *ts, unsigned n) {
+    sc_mutex_lock(&ts->mutex);
+    while (ts->entered < n) {
+        sc_cond_wait(&ts->cond, &ts->mutex);
+    }
+    sc_mutex_unlock(&ts->mutex);
+}
+
+static void
+push(struct sc_async_packet_sink *as, int64_t pts, bool key_frame) {
+    AVPacket *packet = av_packet_alloc();
+    assert(packet);
+    int r = av_new_packet(packet, 4);
+    assert(!r);
+    (void) r;
+    packet->pts = pts;
+    if (key_frame) {
+        packet->flags |= AV_PKT_FLAG_KEY;
+    }
+
+    bool ok = as->packet_sink.ops->push(&as->packet_sink, packet);
+    assert(ok);
+    (void) ok;
+
+    av_packet_free(&packet);
+}
+
+static void
+open_async_sink(struct sc_async_packet_sink *as, struct test_sink *ts,
+                size_t capacity) {
+    sc_async_packet_sink_init(as, "test", capacity);
+    sc_packet_source_add_sink(&as->packet_source, &ts->packet_sink);
+
+    // A dummy context, never dereferenced by the test sink
+    AVCodecContext *ctx = (AVCodecContext *) as;
+    bool ok = as->packet_sink.ops->open(&as->packet_sink, ctx);
+    assert(ok);
+    (void) ok;
+    assert(ts->open);
+}
+
+static void test_drop_until_key_frame(void) {
+    struct test_sink ts;
+    test_sink_init(&ts);
+    ts.blocked = true;
+
+    struct sc_async_packet_sink as;
+    open_async_sink(&as, &ts, 4);
+
+    push(&as, 0, true);
+    // The async thread is blocked on the first packet, the queue is empty
+    test_sink_wait_entered(&ts, 1);
+
+    push(&as, AV_NOPTS_VALUE, false); // config packet
+    push(&as, 1, false);
+    push(&as, 2, false);
+    push(&as, 3, false);
+
+    // The queue is full: the media packets are dropped, but not the config
+    // packet
+    push(&as, 4, false);
+    // Dropped until the next key frame
+    push(&as, 5, false);
+    push(&as, 6, true);
+    push(&as, 7, false);
+
+    test_sink_set_blocked(&ts, false);
+    as.packet_sink.ops->close(&as.packet_sink);
+    assert(!ts.open);
+
+    assert(ts.count == 4);
+    assert(ts.pts[0] == 0);
+    assert(ts.pts[1] == AV_NOPTS_VALUE);
+    assert(ts.pts[2] == 6);
+    assert(ts.pts[3] == 7);
+
+    struct sc_async_sink_stats stats;
+    sc_async_packet_sink_get_stats(&as, &stats);
+    assert(stats.pushed == 9);
+    assert(stats.delivered == 4);
+    assert(stats.dropped == 5);
+    assert(stats.max_queued == 4);
+
+    sc_async_packet_sink_destroy(&as);
+    test_sink_destroy(&ts);
+}
+
+static void test_drain_on_close(void) {
+    struct test_sink ts;
+    test_sink_init(&ts);
+    ts.blocked = true;
+
+    struct sc_async_packet_sink as;
+    open_async_sink(&as, &ts, 8);
+
+    push(&as, AV_NOPTS_VALUE, false);
+    test_sink_wait_entered(&ts, 1);
+
+    for (int64_t pts = 0; pts < 5; ++pts) {
+        push(&as, pts, pts == 0);
+    }
+
+    // The queued packets are delivered before the sinks are closed
+    test_sink_set_blocked(&ts, false);
+    as.packet_sink.ops->close(&as.packet_sink);
+    assert(!ts.open);
+
+    assert(ts.count == 6);
+    assert(ts.pts[0] == AV_NOPTS_VALUE);
+    for (unsigned i = 1; i < 6; ++i) {
+        assert(ts.pts[i] == (int64_t) i - 1);
+    }
+
+    struct sc_async_sink_stats stats;
+    sc_async_packet_sink_get_stats(&as, &stats);
+    assert(stats.dropped == 0);
+    assert(stats.delivered == 6);
+
+    sc_async_packet_sink_destroy(&as);
+    test_sink_destroy(&ts);
+}
+
+struct test_frame_sink {
+    struct sc_frame_sink frame_sink;
+
+    sc_mutex mutex;
+    sc_cond cond;
+    bool blocked; // block the async thread in push()
+    unsigned entered; // number of calls to push()
+
+    bool open;
+    int64_t pts[TEST_SINK_MAX_FRAMES];
+    bool unchanged[TEST_SINK_MAX_FRAMES];
+    unsigned count;
+};
+
+static bool
+test_frame_sink_open(struct sc_frame_sink *sink, const AVCodecContext *ctx) {
+    (void) ctx;
+    struct test_frame_sink *ts = DOWNCAST_FRAME(sink);
+    assert(!ts->open);
+    ts->open = true;
+    return true;
+}
+
+static void
+test_frame_sink_close(struct sc_frame_sink *sink) {
+    struct test_frame_sink *ts = DOWNCAST_FRAME(sink);
+    assert(ts->open);
+    ts->open = false;
+}
+
+static bool
+test_frame_sink_push(struct sc_frame_sink *sink, const AVFrame *frame) {
+    struct test_frame_sink *ts = DOWNCAST_FRAME(sink);
+    assert(ts->open);
+
+    sc_mutex_lock(&ts->mutex);
+    ++ts->entered;
+    sc_cond_signal(&ts->cond);
+    while (ts->blocked) {
+        sc_cond_wait(&ts->cond, &ts->mutex);
+    }
+    assert(ts->count < TEST_SINK_MAX_FRAMES);
+    ts->pts[ts->count] = frame->pts;
+    ts->unchanged[ts->count] = sc_frame_is_unchanged(frame);
+    ++ts->count;
+    sc_mutex_unlock(&ts->mutex);
+
+    return true;
+}
+
+static void
+test_frame_sink_init(struct test_frame_sink *ts) {
+    static const struct sc_frame_sink_ops ops = {
+        .open = test_frame_sink_open,
+        .close = test_frame_sink_close,
+        .push = test_frame_sink_push,
+    };
+
+    ts->frame_sink.ops = &ops;
+
+    bool ok = sc_mutex_init(&ts->mutex);
+    assert(ok);
+    ok = sc_cond_init(&ts->cond);
+    assert(ok);
+    (void) ok;
+
+    ts->blocked = true;
+    ts->entered = 0;
+    ts->open = false;
+    ts->count = 0;
+}
+
+static void
+test_frame_sink_destroy(struct test_frame_sink *ts) {
+    sc_cond_destroy(&ts->cond);
+    sc_mutex_destroy(&ts->mutex);
+}
+
+static void
+test_frame_sink_unblock(struct test_frame_sink *ts) {
+    sc_mutex_lock(&ts->mutex);
+    ts->blocked = false;
+    sc_cond_signal(&ts->cond);
+    sc_mutex_unlock(&ts->mutex);
+}
+
+// Wait until the async thread is blocked in the push() of the first frame
+static void
+test_frame_sink_wait_entered(struct test_frame_sink *ts) {
+    sc_mutex_lock(&ts->mutex);
+    while (!ts->entered) {
+        sc_cond_wait(&ts->cond, &ts->mutex);
+    }
+    sc_mutex_unlock(&ts->mutex);
+}
+
+static void
+push_frame(struct sc_async_frame_sink *as, int64_t pts, bool unchanged) {
+    AVFrame *frame = av_frame_alloc();
+    assert(frame);
+    frame->pts = pts;
+    sc_frame_set_unchanged(frame, unchanged);
+
+    bool ok = as->frame_sink.ops->push(&as->frame_sink, frame);
+    assert(ok);
+    (void) ok;
+
+    // The marker of the source frame is not modified
+    assert(sc_frame_is_unchanged(frame) == unchanged);
+
+    av_frame_free(&frame);
+}
+
+static void
+open_async_frame_sink(struct sc_async_frame_sink *as,
+                      struct test_frame_sink *ts,
+                      enum sc_async_frame_policy policy, size_t capacity) {
+    sc_async_frame_sink_init(as, "test", policy, capacity);
+    sc_frame_source_add_sink(&as->frame_source, &ts->frame_sink);
+
+    // A dummy context, never dereferenced by the test sink
+    const AVCodecContext *ctx = (const AVCodecContext *) as;
+    bool ok = as->frame_sink.ops->open(&as->frame_sink, ctx);
+    assert(ok);
+    (void) ok;
+    assert(ts->open);
+}
+
+static void test_frame_latest(void) {
+    struct test_frame_sink ts;
+    test_frame_sink_init(&ts);
+
+    struct sc_async_frame_sink as;
+    open_async_frame_sink(&as, &ts, SC_ASYNC_FRAME_POLICY_LATEST, 0);
+
+    push_frame(&as, 0, false);
+    // The async thread is blocked on the first frame, the queue is empty
+    test_frame_sink_wait_entered(&ts);
+
+    push_frame(&as, 1, false);
+    // Each frame replaces the previous one (the frame 2 is identical to the
+    // frame 1, never received by the sink)
+    push_frame(&as, 2, true);
+    push_frame(&as, 3, true);
+
+    test_frame_sink_unblock(&ts);
+
+    // Wait for the last frame to be delivered (the queued frames are dropped
+    // on close)
+    sc_mutex_lock(&ts.mutex);
+    while (ts.count < 2) {
+        sc_cond_wait(&ts.cond, &ts.mutex);
+    }
+    sc_mutex_unlock(&ts.mutex);
+
+    as.frame_sink.ops->close(&as.frame_sink);
+    assert(!ts.open);
+
+    assert(ts.count == 2);
+    assert(ts.pts[0] == 0);
+    assert(ts.pts[1] == 3);
+    // The sink never received the frame 1
+    assert(!ts.unchanged[1]);
+
+    struct sc_async_sink_stats stats;
+    sc_async_frame_sink_get_stats(&as, &stats);
+    assert(stats.pushed == 4);
+    assert(stats.delivered == 2);
+    assert(stats.dropped == 2);
+    assert(stats.max_queued == 1);
+
+    sc_async_frame_sink_destroy(&as);
+    test_frame_sink_destroy(&ts);
+}
+
+static void test_frame_fifo(void) {
+    struct test_frame_sink ts;
+    test_frame_sink_init(&ts);
+
+    struct sc_async_frame_sink as;
+    open_async_frame_sink(&as, &ts, SC_ASYNC_FRAME_POLICY_FIFO, 3);
+
+    push_frame(&as, 0, false);
+    test_frame_sink_wait_entered(&ts);
+
+    // Identical to the frame 0, received by the sink
+    push_frame(&as, 1, true);
+    push_frame(&as, 2, false);
+    push_frame(&as, 3, true);
+    // The queue is full: the frame 1 is dropped, the frame 2 is kept as is
+    push_frame(&as, 4, true);
+    // The frame 2 is dropped: the frame 3 must not be skipped anymore
+    push_frame(&as, 5, true);
+
+    test_frame_sink_unblock(&ts);
+
+    sc_mutex_lock(&ts.mutex);
+    while (ts.count < 4) {
+        sc_cond_wait(&ts.cond, &ts.mutex);
+    }
+    sc_mutex_unlock(&ts.mutex);
+
+    as.frame_sink.ops->close(&as.frame_sink);
+    assert(!ts.open);
+
+    assert(ts.count == 4);
+    assert(ts.pts[0] == 0);
+    assert(ts.pts[1] == 3);
+    assert(!ts.unchanged[1]);
+    assert(ts.pts[2] == 4);
+    assert(ts.unchanged[2]);
+    assert(ts.pts[3] == 5);
+    assert(ts.unchanged[3]);
+
+    struct sc_async_sink_stats stats;
+    sc_async_frame_sink_get_stats(&as, &stats);
+    assert(stats.pushed == 6);
+    assert(stats.delivered == 4);
+    assert(stats.dropped == 2);
+    assert(stats.max_queued == 3);
+
+    sc_async_frame_sink_destroy(&as);
+    test_frame_sink_destroy(&ts);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_drop_until_key_frame();
+    test_drain_on_close();
+    test_frame_latest();
+    test_frame_fifo();
+
+    return 0;
+}
@@ -121,6 +121,262 @@ static void test_options2(void) {
     assert(opts->record_format == SC_RECORD_FORMAT_MP4);
 }
 
+static void test_record_tee(void) {
+    struct scrcpy_cli_args args = {
+        .opts = scrcpy_options_default,
+        .help = false,
+        .version = false,
+    };
+
+    char *argv[] = {
+        "scrcpy",
+        "--record", "file.mkv",
+        "--record-tee", "share.mp4",
+        "--record-tee", "video:preview.mkv",
+        "--record-tee", "audio.opus",
+    };
+
+    bool ok = scrcpy_parse_args(&args, ARRAY_LEN(argv), argv);
+    assert(ok);
+
+    const struct scrcpy_options *opts = &args.opts;
+    assert(opts->record_tee_count == 3);
+    assert(!strcmp(opts->record_tees[0].filename, "share.mp4"));
+    assert(opts->record_tees[0].format == SC_RECORD_FORMAT_MP4);
+    assert(opts->record_tees[0].streams == SC_RECORD_STREAMS_ALL);
+    assert(!strcmp(opts->record_tees[1].filename, "preview.mkv"));
+    assert(opts->record_tees[1].format == SC_RECORD_FORMAT_MKV);
+    assert(opts->record_tees[1].streams == SC_RECORD_STREAMS_VIDEO);
+    // audio-only container, only the audio stream is recorded
+    assert(!strcmp(opts->record_tees[2].filename, "audio.opus"));
+    assert(opts->record_tees[2].format == SC_RECORD_FORMAT_OPUS);
+    assert(opts->record_tees[2].streams == SC_RECORD_STREAMS_AUDIO);
+}
+
+static void test_record_tee_invalid(void) {
+    struct scrcpy_cli_args args = {
+        .opts = scrcpy_options_default,
+        .help = false,
+        .version = false,
+    };
+
+    char *argv[] = {
+        "scrcpy",
+        "--record", "file.mkv",
+        "--record-tee", "video:audio.m4a",
+    };
+
+    // an audio container cannot record the video stream
+    bool ok = scrcpy_parse_args(&args, ARRAY_LEN(argv), argv);
+    assert(!ok);
+}
+
+static void test_record_tee_duplicate(void) {
+    struct scrcpy_cli_args args = {
+        .opts = scrcpy_options_default,
+        .help = false,
+        .version = false,
+    };
+
+    char *argv[] = {
+        "scrcpy",
+        "--record", "file.mkv",
+        "--record-tee", "share.mp4",
+        "--record-tee", "video:share.mp4",
+    };
+
+    // two writers must not mux into the same file
+    bool ok = scrcpy_parse_args(&args, ARRAY_LEN(argv), argv);
+    assert(!ok);
+}
+
+static void test_rtp(void) {
+    struct scrcpy_cli_args args = {
+        .opts = scrcpy_options_default,
+        .help = false,
+        .version = false,
+    };
+
+    char *argv[] = {
+        "scrcpy",
+        "--rtp-host", "192.168.1.10",
+        "--rtp-port", "5004",
+        "--rtp-mtu", "1400",
+        "--rtp-sdp", "session.sdp",
+    };
+
+    bool ok = scrcpy_parse_args(&args, ARRAY_LEN(argv), argv);
+    assert(ok);
+
+    const struct scrcpy_options *opts = &args.opts;
+    assert(opts->rtp_host == 0xC0A8010A);
+    assert(opts->rtp_port == 5004);
+    assert(opts->rtp_mtu == 1400);
+    assert(!strcmp(opts->rtp_sdp_filename, "session.sdp"));
+}
+
+static void test_rtp_invalid(void) {
+    struct scrcpy_cli_args args = {
+        .opts = scrcpy_options_default,
+        .help = false,
+        .version = false,
+    };
+
+    char *argv[] = {
+        "scrcpy",
+        "--rtp-port", "5004",
+        "--video-codec", "av1",
+    };
+
+    // AV1 cannot be sent over RTP
+    bool ok = scrcpy_parse_args(&args, ARRAY_LEN(argv), argv);
+    assert(!ok);
+
+    args.opts = scrcpy_options_default;
+    char *argv2[] = {
+        "scrcpy",
+        "--rtp-sdp", "session.sdp",
+    };
+
+    // --rtp-port is required
+    ok = scrcpy_parse_args(&args, ARRAY_LEN(argv2), argv2);
+    assert(!ok);
+}
+
+static void test_replay_streams(void) {
+    struct scrcpy_cli_args args = {
+        .opts = scrcpy_options_default,
+        .help = false,
+        .version = false,
+    };
+
+    char *argv[] = {
+        "scrcpy",
+        "--replay-streams", "/tmp/capture",
+        "--replay-fast",
+    };
+
+    bool ok = scrcpy_parse_args(&args, ARRAY_LEN(argv), argv);
+    assert(ok);
+
+    const struct scrcpy_options *opts = &args.opts;
+    assert(!strcmp(opts->replay_streams_dir, "/tmp/capture"));
+    assert(opts->replay_fast);
+    // There is no device to control
+    assert(!opts->control);
+
+    args.opts = scrcpy_options_default;
+    char *argv2[] = {
+        "scrcpy",
+        "--replay-streams", "/tmp/capture",
+        "--dump-streams", "/tmp/capture2",
+    };
+
+    ok = scrcpy_parse_args(&args, ARRAY_LEN(argv2), argv2);
+    assert(!ok);
+
+    args.opts = scrcpy_options_default;
+    char *argv3[] = {
+        "scrcpy",
+        "--replay-fast",
+    };
+
+    ok = scrcpy_parse_args(&args, ARRAY_LEN(argv3), argv3);
+    assert(!ok);
+}
+
+static void test_no_adb(void) {
+    struct scrcpy_cli_args args = {
+        .opts = scrcpy_options_default,
+        .help = false,
+        .version = false,
+    };
+
+    char *argv[] = {
+        "scrcpy",
+        "--no-adb",
+        "--tunnel-port", "27183",
+    };
+
+    bool ok = scrcpy_parse_args(&args, ARRAY_LEN(argv), argv);
+    assert(ok);
+
+    const struct scrcpy_options *opts = &args.opts;
+    assert(opts->no_adb);
+    assert(opts->tunnel_port == 27183);
+
+    args.opts = scrcpy_options_default;
+    char *argv2[] = {
+        "scrcpy",
+        "--no-adb",
+    };
+
+    // --tunnel-port is required
+    ok = scrcpy_parse_args(&args, ARRAY_LEN(argv2), argv2);
+    assert(!ok);
+}
+
+static void test_decoder_threads(void) {
+    struct scrcpy_cli_args args = {
+        .opts = scrcpy_options_default,
+        .help = false,
+        .version = false,
+    };
+
+    char *argv[] = {
+        "scrcpy",
+        "--decoder-threads", "4",
+        "--decoder-thread-type", "frame",
+    };
+
+    bool ok = scrcpy_parse_args(&args, ARRAY_LEN(argv), argv);
+    assert(ok);
+
+    const struct scrcpy_options *opts = &args.opts;
+    assert(opts->decoder_threads == 4);
+    assert(opts->decoder_thread_type == SC_DECODER_THREAD_TYPE_FRAME);
+
+    args.opts = scrcpy_options_default;
+    char *argv2[] = {
+        "scrcpy",
+        "--decoder-thread-type", "pixel",
+    };
+
+    ok = scrcpy_parse_args(&args, ARRAY_LEN(argv2), argv2);
+    assert(!ok);
+}
+
+static void test_video_buffer_max(void) {
+    struct scrcpy_cli_args args = {
+        .opts = scrcpy_options_default,
+        .help = false,
+        .version = false,
+    };
+
+    char *argv[] = {
+        "scrcpy",
+        "--video-buffer", "20",
+        "--video-buffer-max", "300",
+    };
+
+    bool ok = scrcpy_parse_args(&args, ARRAY_LEN(argv), argv);
+    assert(ok);
+
+    const struct scrcpy_options *opts = &args.opts;
+    assert(opts->video_buffer == SC_TICK_FROM_MS(20));
+    assert(opts->video_buffer_max == SC_TICK_FROM_MS(300));
+
+    args.opts = scrcpy_options_default;
+    char *argv2[] = {
+        "scrcpy",
+        "--video-buffer", "300",
+        "--video-buffer-max", "200",
+    };
+
+    ok = scrcpy_parse_args(&args, ARRAY_LEN(argv2), argv2);
+    assert(!ok);
+}
+
 static void test_parse_shortcut_mods(void) {
     uint8_t mods;
     bool ok;
@@ -157,6 +413,15 @@ int main(int argc, char *argv[]) {
     test_flag_help();
     test_options();
     test_options2();
+    test_record_tee();
+    test_record_tee_invalid();
+    test_record_tee_duplicate();
+    test_rtp();
+    test_rtp_invalid();
+    test_replay_streams();
+    test_no_adb();
+    test_decoder_threads();
+    test_video_buffer_max();
     test_parse_shortcut_mods();
     return 0;
 }
@@ -0,0 +1,127 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "control_msg.h"
+#include "fake_device/control_msg_size.h"
+
+static void check_size(const struct sc_control_msg *msg) {
+    static uint8_t buf[SC_CONTROL_MSG_MAX_SIZE];
+    size_t size = sc_control_msg_serialize(msg, buf);
+    assert(size);
+
+    assert(sc_control_msg_get_size(buf, size) == (ssize_t) size);
+    // The size must not depend on the bytes following the message
+    assert(sc_control_msg_get_size(buf, sizeof(buf)) == (ssize_t) size);
+
+    // With a partial message, the size is either known or unknown (0)
+    for (size_t len = 0; len < size; ++len) {
+        ssize_t r = sc_control_msg_get_size(buf, len);
+        assert(r == 0 || r == (ssize_t) size);
+    }
+}
+
+static void test_fixed_size(void) {
+    struct sc_control_msg msg = {
+        .type = SC_CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT,
+        .inject_touch_event = {
+            .action = AMOTION_EVENT_ACTION_DOWN,
+            .pointer_id = UINT64_C(0x1234567887654321),
+            .position = {
+                .point = {
+                    .x = 100,
+                    .y = 200,
+                },
+                .screen_size = {
+                    .width = 1080,
+                    .height = 1920,
+                },
+            },
+            .pressure = 1.0f,
+        },
+    };
+    check_size(&msg);
+
+    msg.type = SC_CONTROL_MSG_TYPE_BACK_OR_SCREEN_ON;
+    msg.back_or_screen_on.action = AKEY_EVENT_ACTION_DOWN;
+    check_size(&msg);
+
+    msg.type = SC_CONTROL_MSG_TYPE_RESET_VIDEO;
+    check_size(&msg);
+}
+
+static void test_inject_text(void) {
+    struct sc_control_msg msg = {
+        .type = SC_CONTROL_MSG_TYPE_INJECT_TEXT,
+        .inject_text = {
+            .text = "hello, world!",
+        },
+    };
+    check_size(&msg);
+}
+
+static void test_set_clipboard(void) {
+    struct sc_control_msg msg = {
+        .type = SC_CONTROL_MSG_TYPE_SET_CLIPBOARD,
+        .set_clipboard = {
+            .sequence = 42,
+            .text = "hello, world!",
+            .paste = true,
+        },
+    };
+    check_size(&msg);
+}
+
+static void test_uhid(void) {
+    const uint8_t report_desc[] = {1, 2, 3, 4, 5};
+    struct sc_control_msg msg = {
+        .type = SC_CONTROL_MSG_TYPE_UHID_CREATE,
+        .uhid_create = {
+            .id = 42,
+            .vendor_id = 0x1234,
+            .product_id = 0x5678,
+            .name = "ABC",
+            .report_desc_size = sizeof(report_desc),
+            .report_desc = report_desc,
+        },
+    };
+    check_size(&msg);
+
+    msg.type = SC_CONTROL_MSG_TYPE_UHID_INPUT;
+    msg.uhid_input.id = 42;
+    msg.uhid_input.size = 5;
+    memcpy(msg.uhid_input.data, report_desc, 5);
+    check_size(&msg);
+}
+
+static void test_start_app(void) {
+    struct sc_control_msg msg = {
+        .type = SC_CONTROL_MSG_TYPE_START_APP,
+        .start_app = {
+            .name = "firefox",
+        },
+    };
+    check_size(&msg);
+}
+
+static void test_invalid(void) {
+    const uint8_t buf[] = {0xff, 0, 0, 0};
+    assert(sc_control_msg_get_size(buf, sizeof(buf)) == -1);
+    assert(!sc_control_msg_get_type_name(0xff));
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_fixed_size();
+    test_inject_text();
+    test_set_clipboard();
+    test_uhid();
+    test_start_app();
+    test_invalid();
+
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include "common.h"
+
+#include <assert.h>
+#include <libavutil/frame.h>
+
+#include "trait/frame_source.h"
+
+#define DOWNCAST(SINK) container_of(SINK, struct test_sink, frame_sink)
+
+struct test_sink {
+    struct sc_frame_sink frame_sink;
+    bool open;
+    unsigned pushed;
+    unsigned unchanged;
+    bool first_unchanged;
+};
+
+static bool
+test_sink_open(struct sc_frame_sink *sink, const AVCodecContext *ctx) {
+    (void) ctx;
+    struct test_sink *ts = DOWNCAST(sink);
+    assert(!ts->open);
+    ts->open = true;
+    return true;
+}
+
+static void
+test_sink_close(struct sc_frame_sink *sink) {
+    struct test_sink *ts = DOWNCAST(sink);
+    assert(ts->open);
+    ts->open = false;
+}
+
+static bool
+test_sink_push(struct sc_frame_sink *sink, const AVFrame *frame) {
+    struct test_sink *ts = DOWNCAST(sink);
+    assert(ts->open);
+    bool unchanged = sc_frame_is_unchanged(frame);
+    if (!ts->pushed) {
+        ts->first_unchanged = unchanged;
+    }
+    ++ts->pushed;
+    if (unchanged) {
+        ++ts->unchanged;
+    }
+    return true;
+}
+
+static void
+test_sink_init(struct test_sink *ts) {
+    static const struct sc_frame_sink_ops ops = {
+        .open = test_sink_open,
+        .close = test_sink_close,
+        .push = test_sink_push,
+    };
+
+    ts->frame_sink.ops = &ops;
+    ts->open = false;
+    ts->pushed = 0;
+    ts->unchanged = 0;
+    ts->first_unchanged = false;
+}
+
+static void
+push(struct sc_frame_source *source, bool unchanged) {
+    AVFrame *frame = av_frame_alloc();
+    assert(frame);
+    sc_frame_set_unchanged(frame, unchanged);
+
+    bool ok = sc_frame_source_sinks_push(source, frame);
+    assert(ok);
+    (void) ok;
+
+    // The marker of the source frame is not modified
+    assert(sc_frame_is_unchanged(frame) == unchanged);
+
+    av_frame_free(&frame);
+}
+
+static void test_attach_on_unchanged_frame(void) {
+    struct sc_frame_source source;
+    sc_frame_source_init(&source);
+
+    struct test_sink fixed;
+    test_sink_init(&fixed);
+    sc_frame_source_add_sink(&source, &fixed.frame_sink);
+
+    // A dummy context, never dereferenced by the test sinks
+    const AVCodecContext *ctx = (const AVCodecContext *) &source;
+
+    bool ok = sc_frame_source_sinks_open(&source, ctx);
+    assert(ok);
+
+    push(&source, false);
+    push(&source, true);
+
+    struct test_sink late;
+    test_sink_init(&late);
+    ok = sc_frame_source_attach_sink(&source, &late.frame_sink);
+    assert(ok);
+
+    // The late sink never received the previous frame
+    push(&source, true);
+    assert(late.open);
+    assert(late.pushed == 1);
+    assert(!late.first_unchanged);
+
+    // The next frames are forwarded as is
+    push(&source, true);
+    assert(late.pushed == 2);
+    assert(late.unchanged == 1);
+    assert(fixed.unchanged == 3);
+
+    sc_frame_source_sinks_close(&source);
+    assert(!late.open);
+    assert(!fixed.open);
+
+    // Released without being detached
+    sc_frame_source_destroy(&source);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_attach_on_unchanged_frame();
+
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include "common.h"
+
+#include <assert.h>
+
+#include "util/histogram.h"
+
+static void test_empty(void) {
+    struct sc_histogram hist;
+    sc_histogram_init(&hist);
+
+    struct sc_histogram_stats stats;
+    sc_histogram_get_stats(&hist, &stats);
+    assert(stats.count == 0);
+    assert(stats.p50 == 0);
+    assert(stats.p95 == 0);
+    assert(stats.p99 == 0);
+    assert(stats.max == 0);
+}
+
+static void test_small_values(void) {
+    struct sc_histogram hist;
+    sc_histogram_init(&hist);
+
+    // The values lower than 16 are exact
+    for (unsigned i = 0; i < 100; ++i) {
+        sc_histogram_record(&hist, i % 10);
+    }
+
+    struct sc_histogram_stats stats;
+    sc_histogram_get_stats(&hist, &stats);
+    assert(stats.count == 100);
+    assert(stats.p50 == 4);
+    assert(stats.p95 == 9);
+    assert(stats.p99 == 9);
+    assert(stats.max == 9);
+}
+
+static void test_percentiles(void) {
+    struct sc_histogram hist;
+    sc_histogram_init(&hist);
+
+    // 1000 values from 1 to 1000
+    for (unsigned i = 1; i <= 1000; ++i) {
+        sc_histogram_record(&hist, i);
+    }
+
+    struct sc_histogram_stats stats;
+    sc_histogram_get_stats(&hist, &stats);
+    assert(stats.count == 1000);
+    assert(stats.max == 1000);
+
+    // The reported value is the highest of its bucket, with a relative error
+    // of at most 1/16
+    assert(stats.p50 >= 500 && stats.p50 <= 500 + 500 / 16);
+    assert(stats.p95 >= 950 && stats.p95 <= 950 + 950 / 16);
+    assert(stats.p99 >= 990 && stats.p99 <= 1000);
+}
+
+static void test_large_values(void) {
+    struct sc_histogram hist;
+    sc_histogram_init(&hist);
+
+    sc_histogram_record(&hist, 16666);
+    sc_histogram_record(&hist, UINT64_C(1) << 40);
+
+    struct sc_histogram_stats stats;
+    sc_histogram_get_stats(&hist, &stats);
+    assert(stats.count == 2);
+    assert(stats.p50 >= 16666 && stats.p50 <= 16666 + 16666 / 16);
+    // Clamped in the last bucket, but the max is exact
+    assert(stats.p99 == (UINT64_C(1) << 32) - 1);
+    assert(stats.max == UINT64_C(1) << 40);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_empty();
+    test_small_values();
+    test_percentiles();
+    test_large_values();
+
+    return 0;
+}
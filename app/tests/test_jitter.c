@@ -0,0 +1,113 @@
+#include "common.h"
+
+#include <assert.h>
+
+#include "jitter.h"
+
+static void test_jitter_constant(void) {
+    struct sc_jitter jitter;
+    sc_jitter_init(&jitter, SC_TICK_FROM_MS(10), SC_TICK_FROM_MS(200));
+
+    // Starts at the maximum, until the jitter is measured
+    assert(jitter.delay == SC_TICK_FROM_MS(200));
+
+    sc_tick delay = 0;
+    for (int i = 0; i < 2000; ++i) {
+        delay = sc_jitter_push(&jitter, SC_TICK_FROM_MS(3));
+    }
+
+    // No jitter: the delay converges to the minimum
+    assert(delay == SC_TICK_FROM_MS(10));
+}
+
+static void test_jitter_percentile(void) {
+    struct sc_jitter jitter;
+    sc_jitter_init(&jitter, 0, SC_TICK_FROM_MS(500));
+
+    sc_tick delay = 0;
+    for (int i = 0; i < 5000; ++i) {
+        // 1 frame out of 50 arrives 100ms late, the others 20ms late
+        sc_tick deviation = i % 50 ? SC_TICK_FROM_MS(20)
+                                   : SC_TICK_FROM_MS(100);
+        delay = sc_jitter_push(&jitter, deviation);
+    }
+
+    // The rare late frames (2%) are above the 95th percentile
+    assert(delay == SC_TICK_FROM_MS(20));
+
+    for (int i = 0; i < 5000; ++i) {
+        // 1 frame out of 10 arrives 100ms late
+        sc_tick deviation = i % 10 ? SC_TICK_FROM_MS(20)
+                                   : SC_TICK_FROM_MS(100);
+        delay = sc_jitter_push(&jitter, deviation);
+    }
+
+    assert(delay == SC_TICK_FROM_MS(100));
+}
+
+static void test_jitter_grow_fast_shrink_slowly(void) {
+    struct sc_jitter jitter;
+    sc_jitter_init(&jitter, 0, SC_TICK_FROM_MS(1000));
+
+    for (int i = 0; i < 2000; ++i) {
+        sc_jitter_push(&jitter, SC_TICK_FROM_MS(10));
+    }
+    assert(jitter.delay == SC_TICK_FROM_MS(10));
+
+    // Congestion: the delay must follow as soon as the late frames exceed the
+    // percentile
+    sc_tick delay = 0;
+    int i = 0;
+    do {
+        delay = sc_jitter_push(&jitter, SC_TICK_FROM_MS(300));
+        ++i;
+    } while (delay < SC_TICK_FROM_MS(300));
+    // Only the last 5% of the window (8 frames)
+    assert(i == 8);
+
+    // Back to normal: the delay decreases, but not immediately
+    for (i = 0; i < SC_JITTER_WINDOW; ++i) {
+        sc_jitter_push(&jitter, SC_TICK_FROM_MS(10));
+    }
+    delay = sc_jitter_push(&jitter, SC_TICK_FROM_MS(10));
+    assert(delay < SC_TICK_FROM_MS(300));
+    sc_tick previous = delay;
+    delay = sc_jitter_push(&jitter, SC_TICK_FROM_MS(10));
+    assert(delay < previous);
+    assert(previous - delay <= (previous - SC_TICK_FROM_MS(10))
+                               / SC_JITTER_SHRINK_RATE + 1);
+
+    for (i = 0; i < 2000; ++i) {
+        delay = sc_jitter_push(&jitter, SC_TICK_FROM_MS(10));
+    }
+    assert(delay == SC_TICK_FROM_MS(10));
+}
+
+static void test_jitter_bounds(void) {
+    struct sc_jitter jitter;
+    sc_jitter_init(&jitter, SC_TICK_FROM_MS(20), SC_TICK_FROM_MS(50));
+
+    sc_tick delay = 0;
+    for (int i = 0; i < 1000; ++i) {
+        delay = sc_jitter_push(&jitter, SC_TICK_FROM_MS(200));
+    }
+    assert(delay == SC_TICK_FROM_MS(50));
+
+    for (int i = 0; i < 2000; ++i) {
+        // Frames arriving earlier than expected
+        delay = sc_jitter_push(&jitter, -SC_TICK_FROM_MS(5));
+    }
+    assert(delay == SC_TICK_FROM_MS(20));
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_jitter_constant();
+    test_jitter_percentile();
+    test_jitter_grow_fast_shrink_slowly();
+    test_jitter_bounds();
+
+    return 0;
+}
@@ -0,0 +1,174 @@
+#include "common.h"
+
+#include <assert.h>
+#include <libavcodec/avcodec.h>
+
+#include "trait/packet_source.h"
+
+#define DOWNCAST(SINK) container_of(SINK, struct test_sink, packet_sink)
+
+struct test_sink {
+    struct sc_packet_sink packet_sink;
+    bool open;
+    bool fail;
+    unsigned pushed;
+    unsigned configs;
+    int64_t first_pts;
+};
+
+static bool
+test_sink_open(struct sc_packet_sink *sink, AVCodecContext *ctx) {
+    (void) ctx;
+    struct test_sink *ts = DOWNCAST(sink);
+    assert(!ts->open);
+    ts->open = true;
+    return true;
+}
+
+static void
+test_sink_close(struct sc_packet_sink *sink) {
+    struct test_sink *ts = DOWNCAST(sink);
+    assert(ts->open);
+    ts->open = false;
+}
+
+static bool
+test_sink_push(struct sc_packet_sink *sink, const AVPacket *packet) {
+    struct test_sink *ts = DOWNCAST(sink);
+    assert(ts->open);
+    if (ts->fail) {
+        return false;
+    }
+    if (!ts->pushed) {
+        ts->first_pts = packet->pts;
+    }
+    ++ts->pushed;
+    if (packet->pts == AV_NOPTS_VALUE) {
+        ++ts->configs;
+    }
+    return true;
+}
+
+static void
+test_sink_init(struct test_sink *ts) {
+    static const struct sc_packet_sink_ops ops = {
+        .open = test_sink_open,
+        .close = test_sink_close,
+        .push = test_sink_push,
+    };
+
+    ts->packet_sink.ops = &ops;
+    ts->open = false;
+    ts->fail = false;
+    ts->pushed = 0;
+    ts->configs = 0;
+    ts->first_pts = 0;
+}
+
+static void
+push(struct sc_packet_source *source, int64_t pts) {
+    AVPacket *packet = av_packet_alloc();
+    assert(packet);
+    int r = av_new_packet(packet, 4);
+    assert(!r);
+    (void) r;
+    packet->pts = pts;
+
+    bool ok = sc_packet_source_sinks_push(source, packet);
+    assert(ok);
+    (void) ok;
+
+    av_packet_free(&packet);
+}
+
+static void test_attach_while_streaming(void) {
+    struct sc_packet_source source;
+    sc_packet_source_init(&source);
+
+    struct test_sink fixed;
+    test_sink_init(&fixed);
+    sc_packet_source_add_sink(&source, &fixed.packet_sink);
+
+    // A dummy context, never dereferenced by the test sinks
+    AVCodecContext *ctx = (AVCodecContext *) &source;
+
+    bool ok = sc_packet_source_sinks_open(&source, ctx);
+    assert(ok);
+    assert(fixed.open);
+
+    push(&source, AV_NOPTS_VALUE); // config packet
+    push(&source, 0);
+
+    struct test_sink late;
+    test_sink_init(&late);
+    ok = sc_packet_source_attach_sink(&source, &late.packet_sink);
+    assert(ok);
+    // Opened on the next packet
+    assert(!late.open);
+
+    push(&source, 1);
+    assert(late.open);
+    // The config packet is received first
+    assert(late.pushed == 2);
+    assert(late.configs == 1);
+    assert(late.first_pts == AV_NOPTS_VALUE);
+
+    sc_packet_source_detach_sink(&source, &late.packet_sink);
+    assert(!late.open);
+
+    push(&source, 2);
+    assert(late.pushed == 2);
+    assert(fixed.pushed == 4);
+
+    sc_packet_source_sinks_close(&source);
+    assert(!fixed.open);
+}
+
+static void test_failing_attached_sink(void) {
+    struct sc_packet_source source;
+    sc_packet_source_init(&source);
+
+    struct test_sink fixed;
+    test_sink_init(&fixed);
+    sc_packet_source_add_sink(&source, &fixed.packet_sink);
+
+    struct test_sink a;
+    struct test_sink b;
+    test_sink_init(&a);
+    test_sink_init(&b);
+    b.fail = true;
+
+    // Attached before the stream is open
+    bool ok = sc_packet_source_attach_sink(&source, &a.packet_sink);
+    assert(ok);
+    ok = sc_packet_source_attach_sink(&source, &b.packet_sink);
+    assert(ok);
+
+    AVCodecContext *ctx = (AVCodecContext *) &source;
+    ok = sc_packet_source_sinks_open(&source, ctx);
+    assert(ok);
+
+    // The failing sink does not fail the stream
+    push(&source, 0);
+    push(&source, 1);
+    assert(a.pushed == 2);
+    assert(!b.open);
+    assert(fixed.pushed == 2);
+
+    sc_packet_source_sinks_close(&source);
+    assert(!a.open);
+
+    sc_packet_source_detach_sink(&source, &b.packet_sink);
+    sc_packet_source_detach_sink(&source, &a.packet_sink);
+    assert(!atomic_load(&source.dynamic_sinks));
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_attach_while_streaming();
+    test_failing_attached_sink();
+
+    return 0;
+}
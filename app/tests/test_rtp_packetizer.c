@@ -0,0 +1,215 @@
+#include "common.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "rtp_packetizer.h"
+#include "util/binary.h"
+
+static void check_header(const uint8_t *d, uint16_t seq, uint32_t timestamp,
+                         bool marker) {
+    assert(d[0] == 0x80);
+    assert(d[1] == (marker ? 0x80 | 96 : 96));
+    assert(sc_read16be(&d[2]) == seq);
+    assert(sc_read32be(&d[4]) == timestamp);
+    assert(sc_read32be(&d[8]) == 0x12345678);
+}
+
+static void test_h264_single_nal(void) {
+    struct sc_rtp_packetizer p;
+    bool ok = sc_rtp_packetizer_init(&p, SC_RTP_PAYLOAD_H264, 96, 0x12345678,
+                                     1000, 500, 100);
+    assert(ok);
+
+    // SPS, PPS and a small IDR slice, with 4-byte and 3-byte start codes
+    const uint8_t data[] = {
+        0, 0, 0, 1, 0x67, 0x42, 0x00, 0x1f,
+        0, 0, 0, 1, 0x68, 0xce, 0x3c,
+        0, 0, 1, 0x65, 0x88, 0x84, 0x00, 0x33,
+    };
+
+    // 1 second: 90000 ticks
+    ok = sc_rtp_packetizer_packetize(&p, data, sizeof(data), 1000000);
+    assert(ok);
+    assert(p.count == 3);
+
+    size_t len;
+    const uint8_t *d = sc_rtp_packetizer_get(&p, 0, &len);
+    assert(len == SC_RTP_HEADER_SIZE + 4);
+    check_header(d, 1000, 90500, false);
+    assert(!memcmp(&d[SC_RTP_HEADER_SIZE], &data[4], 4));
+
+    d = sc_rtp_packetizer_get(&p, 1, &len);
+    assert(len == SC_RTP_HEADER_SIZE + 3);
+    check_header(d, 1001, 90500, false);
+    assert(!memcmp(&d[SC_RTP_HEADER_SIZE], &data[12], 3));
+
+    // The marker bit is set on the last datagram of the access unit
+    d = sc_rtp_packetizer_get(&p, 2, &len);
+    assert(len == SC_RTP_HEADER_SIZE + 5);
+    check_header(d, 1002, 90500, true);
+    // The last byte of the slice is a zero, it must not be stripped
+    assert(!memcmp(&d[SC_RTP_HEADER_SIZE], &data[18], 5));
+
+    sc_rtp_packetizer_destroy(&p);
+}
+
+static void test_h264_fu_a(void) {
+    struct sc_rtp_packetizer p;
+    bool ok = sc_rtp_packetizer_init(&p, SC_RTP_PAYLOAD_H264, 96, 0x12345678,
+                                     0xFFFF, 0, 100);
+    assert(ok);
+
+    // A 300-byte IDR slice (NAL header 0x65: nri=3, type=5)
+    uint8_t data[4 + 300];
+    memcpy(data, (uint8_t[]) {0, 0, 0, 1, 0x65}, 5);
+    for (int i = 5; i < (int) sizeof(data); ++i) {
+        data[i] = i;
+    }
+
+    ok = sc_rtp_packetizer_packetize(&p, data, sizeof(data), 0);
+    assert(ok);
+
+    // 299 bytes of payload, 86 bytes per fragment
+    assert(p.count == 4);
+
+    uint8_t reassembled[300];
+    size_t reassembled_len = 0;
+    for (size_t i = 0; i < p.count; ++i) {
+        size_t len;
+        const uint8_t *d = sc_rtp_packetizer_get(&p, i, &len);
+        assert(len <= 100);
+        // The sequence number wraps around
+        check_header(d, (uint16_t) (0xFFFF + i), 0, i == p.count - 1);
+
+        const uint8_t *payload = &d[SC_RTP_HEADER_SIZE];
+        assert(payload[0] == (0x60 | 28)); // FU indicator
+        uint8_t fu_header = 5;
+        if (i == 0) {
+            fu_header |= 0x80;
+        }
+        if (i == p.count - 1) {
+            fu_header |= 0x40;
+        }
+        assert(payload[1] == fu_header);
+
+        size_t chunk = len - SC_RTP_HEADER_SIZE - 2;
+        memcpy(&reassembled[1 + reassembled_len], &payload[2], chunk);
+        reassembled_len += chunk;
+    }
+
+    assert(reassembled_len == 299);
+    reassembled[0] = 0x65;
+    assert(!memcmp(reassembled, &data[4], 300));
+
+    sc_rtp_packetizer_destroy(&p);
+}
+
+static void test_h265_fu(void) {
+    struct sc_rtp_packetizer p;
+    bool ok = sc_rtp_packetizer_init(&p, SC_RTP_PAYLOAD_H265, 96, 0x12345678,
+                                     0, 0, 64);
+    assert(ok);
+
+    // A 200-byte IDR_W_RADL slice (type 19, NAL header 0x26 0x01)
+    uint8_t data[3 + 200];
+    memcpy(data, (uint8_t[]) {0, 0, 1, 0x26, 0x01}, 5);
+    for (int i = 5; i < (int) sizeof(data); ++i) {
+        data[i] = i;
+    }
+
+    ok = sc_rtp_packetizer_packetize(&p, data, sizeof(data), 0);
+    assert(ok);
+
+    // 198 bytes of payload, 49 bytes per fragment
+    assert(p.count == 5);
+
+    size_t total = 0;
+    for (size_t i = 0; i < p.count; ++i) {
+        size_t len;
+        const uint8_t *d = sc_rtp_packetizer_get(&p, i, &len);
+        assert(len <= 64);
+        check_header(d, i, 0, i == p.count - 1);
+
+        const uint8_t *payload = &d[SC_RTP_HEADER_SIZE];
+        assert(payload[0] == (49 << 1));
+        assert(payload[1] == 0x01);
+        uint8_t fu_header = 19;
+        if (i == 0) {
+            fu_header |= 0x80;
+        }
+        if (i == p.count - 1) {
+            fu_header |= 0x40;
+        }
+        assert(payload[2] == fu_header);
+
+        size_t chunk = len - SC_RTP_HEADER_SIZE - 3;
+        assert(!memcmp(&payload[3], &data[5 + total], chunk));
+        total += chunk;
+    }
+
+    assert(total == 198);
+
+    sc_rtp_packetizer_destroy(&p);
+}
+
+static void test_grow(void) {
+    struct sc_rtp_packetizer p;
+    bool ok = sc_rtp_packetizer_init(&p, SC_RTP_PAYLOAD_H264, 96, 0x12345678,
+                                     0, 0, 32);
+    assert(ok);
+
+    // More fragments than the initial capacity
+    static uint8_t data[4 + 10000];
+    memcpy(data, (uint8_t[]) {0, 0, 0, 1, 0x65}, 5);
+    memset(&data[5], 0x42, sizeof(data) - 5);
+
+    ok = sc_rtp_packetizer_packetize(&p, data, sizeof(data), 0);
+    assert(ok);
+
+    // 9999 bytes, 18 bytes per fragment
+    assert(p.count == 556);
+    for (size_t i = 0; i < p.count; ++i) {
+        size_t len;
+        const uint8_t *d = sc_rtp_packetizer_get(&p, i, &len);
+        check_header(d, i, 0, i == p.count - 1);
+    }
+
+    sc_rtp_packetizer_destroy(&p);
+}
+
+static void test_opus(void) {
+    struct sc_rtp_packetizer p;
+    bool ok = sc_rtp_packetizer_init(&p, SC_RTP_PAYLOAD_OPUS, 96, 0x12345678,
+                                     42, 0, 100);
+    assert(ok);
+
+    const uint8_t data[] = {0xfc, 0xff, 0xfe, 0x00, 0x00, 0x01};
+
+    // 20 ms: 960 samples at 48 kHz
+    ok = sc_rtp_packetizer_packetize(&p, data, sizeof(data), 20000);
+    assert(ok);
+    assert(p.count == 1);
+
+    size_t len;
+    const uint8_t *d = sc_rtp_packetizer_get(&p, 0, &len);
+    assert(len == SC_RTP_HEADER_SIZE + sizeof(data));
+    check_header(d, 42, 960, false);
+    // No start code parsing for Opus
+    assert(!memcmp(&d[SC_RTP_HEADER_SIZE], data, sizeof(data)));
+
+    sc_rtp_packetizer_destroy(&p);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_h264_single_nal();
+    test_h264_fu_a();
+    test_h265_fu();
+    test_grow();
+    test_opus();
+
+    return 0;
+}
@@ -0,0 +1,213 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scaler.h"
+
+// Area average of a plane, in floating point
+static double
+area_average(const uint8_t *plane, int linesize, unsigned src_w,
+             unsigned src_h, unsigned dst_w, unsigned dst_h, unsigned x,
+             unsigned y) {
+    double x0 = (double) x * src_w / dst_w;
+    double x1 = (double) (x + 1) * src_w / dst_w;
+    double y0 = (double) y * src_h / dst_h;
+    double y1 = (double) (y + 1) * src_h / dst_h;
+
+    double sum = 0;
+    for (unsigned j = y0; j < y1; ++j) {
+        double hy = (j + 1 < y1 ? j + 1 : y1) - (j > y0 ? j : y0);
+        for (unsigned i = x0; i < x1; ++i) {
+            double hx = (i + 1 < x1 ? i + 1 : x1) - (i > x0 ? i : x0);
+            sum += plane[j * linesize + i] * hx * hy;
+        }
+    }
+
+    return sum / ((x1 - x0) * (y1 - y0));
+}
+
+static void
+test_scale(unsigned src_w, unsigned src_h, unsigned dst_w, unsigned dst_h) {
+    unsigned src_cw = (src_w + 1) / 2;
+    unsigned src_ch = (src_h + 1) / 2;
+    int src_linesizes[3] = {src_w + 3, src_cw + 1, src_cw + 1};
+    unsigned src_heights[3] = {src_h, src_ch, src_ch};
+
+    struct sc_yuv_image src = {
+        .width = src_w,
+        .height = src_h,
+        .matrix = SC_YUV_MATRIX_BT601,
+        .full_range = false,
+    };
+    uint8_t *src_data[3];
+    for (int p = 0; p < 3; ++p) {
+        size_t size = (size_t) src_linesizes[p] * src_heights[p];
+        src_data[p] = malloc(size);
+        assert(src_data[p]);
+        for (size_t i = 0; i < size; ++i) {
+            src_data[p][i] = rand();
+        }
+        src.planes[p] = src_data[p];
+        src.linesizes[p] = src_linesizes[p];
+    }
+
+    unsigned dst_cw = (dst_w + 1) / 2;
+    unsigned dst_ch = (dst_h + 1) / 2;
+    int dst_linesizes[3] = {dst_w, dst_cw, dst_cw};
+    uint8_t *dst_planes[3] = {
+        malloc(dst_w * dst_h),
+        malloc(dst_cw * dst_ch),
+        malloc(dst_cw * dst_ch),
+    };
+    assert(dst_planes[0] && dst_planes[1] && dst_planes[2]);
+
+    struct sc_scaler scaler;
+    sc_scaler_init(&scaler);
+    bool ok = sc_scaler_prepare(&scaler, src_w, src_h, dst_w, dst_h);
+    assert(ok);
+    (void) ok;
+
+    sc_scaler_scale(&scaler, &src, false, dst_planes, dst_linesizes);
+
+    for (int p = 0; p < 3; ++p) {
+        unsigned sw = p ? src_cw : src_w;
+        unsigned sh = p ? src_ch : src_h;
+        unsigned dw = p ? dst_cw : dst_w;
+        unsigned dh = p ? dst_ch : dst_h;
+        for (unsigned y = 0; y < dh; ++y) {
+            for (unsigned x = 0; x < dw; ++x) {
+                double expected = area_average(src.planes[p], src_linesizes[p],
+                                               sw, sh, dw, dh, x, y);
+                double actual = dst_planes[p][y * dst_linesizes[p] + x];
+                assert(actual - expected < 1 && expected - actual < 1);
+            }
+        }
+    }
+
+    sc_scaler_destroy(&scaler);
+    for (int p = 0; p < 3; ++p) {
+        free(src_data[p]);
+        free(dst_planes[p]);
+    }
+}
+
+static void test_scale_sizes(void) {
+    static const unsigned sizes[][4] = {
+        {1, 1, 1, 1},
+        {2, 2, 1, 1},
+        {5, 3, 5, 3}, // same size
+        {16, 16, 8, 8},
+        {33, 17, 10, 9},
+        {64, 48, 63, 47},
+        {97, 41, 3, 40},
+        {1080, 24, 320, 7},
+    };
+
+    for (size_t i = 0; i < ARRAY_LEN(sizes); ++i) {
+        test_scale(sizes[i][0], sizes[i][1], sizes[i][2], sizes[i][3]);
+    }
+}
+
+static void test_full_range(void) {
+    uint8_t luma[4 * 4];
+    uint8_t u[2 * 2];
+    uint8_t v[2 * 2];
+    memset(luma, 235, sizeof(luma));
+    luma[0] = luma[1] = luma[4] = luma[5] = 16;
+    memset(u, 128, sizeof(u));
+    memset(v, 240, sizeof(v));
+
+    struct sc_yuv_image src = {
+        .planes = {luma, u, v},
+        .linesizes = {4, 2, 2},
+        .width = 4,
+        .height = 4,
+        .matrix = SC_YUV_MATRIX_BT709,
+        .full_range = false,
+    };
+
+    uint8_t out_y[2 * 2];
+    uint8_t out_u;
+    uint8_t out_v;
+    uint8_t *planes[3] = {out_y, &out_u, &out_v};
+    int linesizes[3] = {2, 1, 1};
+
+    struct sc_scaler scaler;
+    sc_scaler_init(&scaler);
+    bool ok = sc_scaler_prepare(&scaler, 4, 4, 2, 2);
+    assert(ok);
+    (void) ok;
+
+    sc_scaler_scale(&scaler, &src, true, planes, linesizes);
+    assert(out_y[0] == 0 && out_y[1] == 255 && out_y[2] == 255);
+    assert(out_u == 128 && out_v == 255);
+
+    // Already full range: not modified
+    src.full_range = true;
+    sc_scaler_scale(&scaler, &src, true, planes, linesizes);
+    assert(out_y[0] == 16 && out_y[1] == 235);
+    assert(out_u == 128 && out_v == 240);
+
+    sc_scaler_destroy(&scaler);
+}
+
+static void test_cache(void) {
+    uint8_t luma[64 * 64];
+    uint8_t chroma[32 * 32];
+    memset(luma, 42, sizeof(luma));
+    memset(chroma, 128, sizeof(chroma));
+
+    struct sc_yuv_image src = {
+        .planes = {luma, chroma, chroma},
+        .linesizes = {64, 32, 32},
+        .width = 64,
+        .height = 64,
+        .matrix = SC_YUV_MATRIX_BT709,
+        .full_range = true,
+    };
+
+    struct sc_scaler_cache cache;
+    sc_scaler_cache_init(&cache);
+
+    const struct sc_yuv_image *first =
+        sc_scaler_cache_scale(&cache, &src, 32, 20);
+    assert(first);
+    assert(first->width == 32 && first->height == 20);
+    assert(first->matrix == SC_YUV_MATRIX_BT709 && first->full_range);
+    assert(first->planes[0][31] == 42 && first->planes[2][15] == 128);
+
+    // The same size reuses the same entry
+    const struct sc_yuv_image *image =
+        sc_scaler_cache_scale(&cache, &src, 32, 20);
+    assert(image == first);
+
+    // Fill the cache, then the least recently used entry is replaced
+    for (unsigned i = 1; i < SC_SCALER_CACHE_SIZE; ++i) {
+        image = sc_scaler_cache_scale(&cache, &src, i, i);
+        assert(image && image != first);
+    }
+    image = sc_scaler_cache_scale(&cache, &src, 32, 20);
+    assert(image == first);
+
+    image = sc_scaler_cache_scale(&cache, &src, 7, 5);
+    assert(image && image != first);
+    assert(image->width == 7 && image->height == 5);
+    image = sc_scaler_cache_scale(&cache, &src, 32, 20);
+    assert(image == first);
+    (void) image;
+
+    sc_scaler_cache_destroy(&cache);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_scale_sizes();
+    test_full_range();
+    test_cache();
+
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include "common.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "static_detector.h"
+
+#define WIDTH 35
+#define HEIGHT 20
+#define CHROMA_WIDTH ((WIDTH + 1) / 2)
+#define CHROMA_HEIGHT ((HEIGHT + 1) / 2)
+
+struct image {
+    uint8_t y[WIDTH * HEIGHT];
+    uint8_t u[CHROMA_WIDTH * CHROMA_HEIGHT];
+    uint8_t v[CHROMA_WIDTH * CHROMA_HEIGHT];
+};
+
+static void
+image_init(struct image *image) {
+    for (unsigned i = 0; i < sizeof(image->y); ++i) {
+        image->y[i] = i * 7;
+    }
+    memset(image->u, 128, sizeof(image->u));
+    memset(image->v, 128, sizeof(image->v));
+}
+
+static bool
+check(struct sc_static_detector *sd, int64_t pts, size_t packet_size,
+      bool key_frame, const struct image *image, sc_tick now) {
+    sc_static_detector_push_packet(sd, pts, packet_size, key_frame);
+
+    const uint8_t *const planes[3] = {image->y, image->u, image->v};
+    const int linesizes[3] = {WIDTH, CHROMA_WIDTH, CHROMA_WIDTH};
+    return sc_static_detector_check_frame(sd, pts, planes, linesizes, WIDTH,
+                                          HEIGHT, now);
+}
+
+static void test_repeated_frames(void) {
+    struct sc_static_detector sd;
+    sc_static_detector_init(&sd);
+
+    struct image image;
+    image_init(&image);
+
+    // The first frame is never unchanged
+    assert(!check(&sd, 0, 10, false, &image, SC_TICK_FROM_MS(1)));
+    assert(check(&sd, 100, 10, false, &image, SC_TICK_FROM_MS(101)));
+    assert(!sd.is_static);
+
+    // Repeated frames, until the screen is static
+    sc_tick now;
+    for (now = SC_TICK_FROM_MS(201); now < SC_TICK_FROM_MS(1001);
+            now += SC_TICK_FROM_MS(100)) {
+        assert(check(&sd, now, 10, false, &image, now));
+        assert(!sd.is_static);
+    }
+    assert(check(&sd, now, 10, false, &image, now));
+    assert(sd.is_static);
+
+    // A single pixel changed (in the last column, hashed byte per byte)
+    image.y[WIDTH - 1] ^= 1;
+    now += SC_TICK_FROM_MS(100);
+    assert(!check(&sd, now, 10, false, &image, now));
+    assert(!sd.is_static);
+
+    // Chroma changed
+    image.v[CHROMA_WIDTH * CHROMA_HEIGHT - 1] = 0;
+    now += SC_TICK_FROM_MS(100);
+    assert(!check(&sd, now, 10, false, &image, now));
+    now += SC_TICK_FROM_MS(100);
+    assert(check(&sd, now, 10, false, &image, now));
+}
+
+static void test_packet_heuristics(void) {
+    struct sc_static_detector sd;
+    sc_static_detector_init(&sd);
+
+    struct image image;
+    image_init(&image);
+
+    assert(!check(&sd, 0, 10, false, &image, 1));
+
+    // Large packets and key frames are not hashed
+    assert(!check(&sd, 1, 100000, false, &image, 2));
+    // So the next frame cannot be compared
+    assert(!check(&sd, 2, 10, false, &image, 3));
+    assert(check(&sd, 3, 10, false, &image, 4));
+    assert(!check(&sd, 4, 10, true, &image, 5));
+    assert(!check(&sd, 5, 10, false, &image, 6));
+
+    // The frame may be output several packets later
+    sc_static_detector_push_packet(&sd, 6, 10, false);
+    sc_static_detector_push_packet(&sd, 7, 100000, false);
+    const uint8_t *const planes[3] = {image.y, image.u, image.v};
+    const int linesizes[3] = {WIDTH, CHROMA_WIDTH, CHROMA_WIDTH};
+    assert(sc_static_detector_check_frame(&sd, 6, planes, linesizes, WIDTH,
+                                          HEIGHT, 7));
+    assert(!sc_static_detector_check_frame(&sd, 7, planes, linesizes, WIDTH,
+                                           HEIGHT, 8));
+
+    // Unknown packet
+    assert(!sc_static_detector_check_frame(&sd, 42, planes, linesizes, WIDTH,
+                                           HEIGHT, 9));
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_repeated_frames();
+    test_packet_heuristics();
+
+    return 0;
+}
@@ -0,0 +1,300 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "yuv2rgb.h"
+
+struct test_image {
+    struct sc_yuv_image image;
+    uint8_t *data[3];
+};
+
+static void test_image_init(struct test_image *ti, unsigned width,
+                            unsigned height, unsigned seed) {
+    unsigned cw = (width + 1) / 2;
+    unsigned ch = (height + 1) / 2;
+
+    // Some padding at the end of the rows, like FFmpeg frames
+    int linesizes[3] = {width + 7, cw + 5, cw + 3};
+    unsigned heights[3] = {height, ch, ch};
+
+    srand(seed);
+    for (int p = 0; p < 3; ++p) {
+        size_t size = (size_t) linesizes[p] * heights[p];
+        ti->data[p] = malloc(size);
+        assert(ti->data[p]);
+        for (size_t i = 0; i < size; ++i) {
+            ti->data[p][i] = rand();
+        }
+        ti->image.planes[p] = ti->data[p];
+        ti->image.linesizes[p] = linesizes[p];
+    }
+
+    ti->image.width = width;
+    ti->image.height = height;
+    ti->image.matrix = SC_YUV_MATRIX_BT601;
+    ti->image.full_range = false;
+}
+
+static void test_image_destroy(struct test_image *ti) {
+    for (int p = 0; p < 3; ++p) {
+        free(ti->data[p]);
+    }
+}
+
+static void test_convert_pixel(uint8_t y, uint8_t u, uint8_t v,
+                               enum sc_yuv_matrix matrix, bool full_range,
+                               uint8_t rgb[3]) {
+    // A 2x2 image has a single chroma sample
+    uint8_t luma[4] = {y, y, y, y};
+    struct sc_yuv_image image = {
+        .planes = {luma, &u, &v},
+        .linesizes = {2, 1, 1},
+        .width = 2,
+        .height = 2,
+        .matrix = matrix,
+        .full_range = full_range,
+    };
+
+    uint8_t out[2 * 2 * 3];
+    bool ok = sc_yuv2rgb_convert_with(SC_YUV2RGB_IMPL_SCALAR, &image, 0,
+                                      SC_RGB_FORMAT_RGB24, out, 2 * 3);
+    assert(ok);
+    (void) ok;
+
+    memcpy(rgb, out, 3);
+}
+
+static bool near(uint8_t actual, int expected) {
+    return abs(actual - expected) <= 1;
+}
+
+static void test_reference_values(void) {
+    uint8_t rgb[3];
+
+    // Limited range: black and white
+    test_convert_pixel(16, 128, 128, SC_YUV_MATRIX_BT601, false, rgb);
+    assert(rgb[0] == 0 && rgb[1] == 0 && rgb[2] == 0);
+    test_convert_pixel(235, 128, 128, SC_YUV_MATRIX_BT601, false, rgb);
+    assert(rgb[0] == 255 && rgb[1] == 255 && rgb[2] == 255);
+
+    // Out of range values are clamped
+    test_convert_pixel(0, 128, 128, SC_YUV_MATRIX_BT709, false, rgb);
+    assert(rgb[0] == 0 && rgb[1] == 0 && rgb[2] == 0);
+    test_convert_pixel(255, 255, 255, SC_YUV_MATRIX_BT709, false, rgb);
+    assert(rgb[0] == 255 && rgb[2] == 255);
+
+    // Full range gray
+    test_convert_pixel(128, 128, 128, SC_YUV_MATRIX_BT601, true, rgb);
+    assert(rgb[0] == 128 && rgb[1] == 128 && rgb[2] == 128);
+
+    // BT.601 limited range red (255, 0, 0)
+    test_convert_pixel(81, 90, 240, SC_YUV_MATRIX_BT601, false, rgb);
+    assert(near(rgb[0], 255) && near(rgb[1], 0) && near(rgb[2], 0));
+
+    // BT.709 limited range green (0, 255, 0)
+    test_convert_pixel(173, 42, 26, SC_YUV_MATRIX_BT709, false, rgb);
+    assert(near(rgb[0], 0) && near(rgb[1], 255) && near(rgb[2], 0));
+
+    // BT.709 full range blue (0, 0, 255)
+    test_convert_pixel(18, 255, 116, SC_YUV_MATRIX_BT709, true, rgb);
+    assert(near(rgb[0], 0) && near(rgb[1], 0) && near(rgb[2], 255));
+}
+
+static void test_formats(void) {
+    struct test_image ti;
+    test_image_init(&ti, 34, 6, 42);
+
+    uint8_t rgb[34 * 6 * 3];
+    uint8_t bgr[34 * 6 * 3];
+    uint8_t rgba[34 * 6 * 4];
+    uint8_t bgra[34 * 6 * 4];
+
+    bool ok = sc_yuv2rgb_convert(&ti.image, 0, SC_RGB_FORMAT_RGB24, rgb,
+                                 34 * 3);
+    assert(ok);
+    ok = sc_yuv2rgb_convert(&ti.image, 0, SC_RGB_FORMAT_BGR24, bgr, 34 * 3);
+    assert(ok);
+    ok = sc_yuv2rgb_convert(&ti.image, 0, SC_RGB_FORMAT_RGBA, rgba, 34 * 4);
+    assert(ok);
+    ok = sc_yuv2rgb_convert(&ti.image, 0, SC_RGB_FORMAT_BGRA, bgra, 34 * 4);
+    assert(ok);
+    (void) ok;
+
+    for (unsigned i = 0; i < 34 * 6; ++i) {
+        const uint8_t *p = &rgb[3 * i];
+        assert(bgr[3 * i] == p[2]);
+        assert(bgr[3 * i + 1] == p[1]);
+        assert(bgr[3 * i + 2] == p[0]);
+        assert(!memcmp(&rgba[4 * i], p, 3));
+        assert(rgba[4 * i + 3] == 0xFF);
+        assert(bgra[4 * i] == p[2]);
+        assert(bgra[4 * i + 1] == p[1]);
+        assert(bgra[4 * i + 2] == p[0]);
+        assert(bgra[4 * i + 3] == 0xFF);
+    }
+
+    test_image_destroy(&ti);
+}
+
+static void test_downscale(void) {
+    // A uniform image stays uniform
+    uint8_t luma[8 * 8];
+    uint8_t u[4 * 4];
+    uint8_t v[4 * 4];
+    memset(luma, 100, sizeof(luma));
+    memset(u, 90, sizeof(u));
+    memset(v, 200, sizeof(v));
+
+    struct sc_yuv_image image = {
+        .planes = {luma, u, v},
+        .linesizes = {8, 4, 4},
+        .width = 8,
+        .height = 8,
+        .matrix = SC_YUV_MATRIX_BT709,
+        .full_range = false,
+    };
+
+    uint8_t full[8 * 8 * 3];
+    bool ok = sc_yuv2rgb_convert(&image, 0, SC_RGB_FORMAT_RGB24, full, 8 * 3);
+    assert(ok);
+
+    for (unsigned shift = 1; shift <= 2; ++shift) {
+        unsigned w = 8 >> shift;
+        uint8_t out[4 * 4 * 3];
+        ok = sc_yuv2rgb_convert(&image, shift, SC_RGB_FORMAT_RGB24, out,
+                                w * 3);
+        assert(ok);
+        for (unsigned i = 0; i < w * w; ++i) {
+            assert(!memcmp(&out[3 * i], full, 3));
+        }
+    }
+    (void) ok;
+
+    // Box average of the luma: avg(avg(a, c), avg(b, d))
+    uint8_t luma2[2 * 2] = {10, 21, 30, 255};
+    uint8_t c = 128;
+    struct sc_yuv_image image2 = {
+        .planes = {luma2, &c, &c},
+        .linesizes = {2, 1, 1},
+        .width = 2,
+        .height = 2,
+        .matrix = SC_YUV_MATRIX_BT601,
+        .full_range = true,
+    };
+    uint8_t gray[3];
+    ok = sc_yuv2rgb_convert(&image2, 1, SC_RGB_FORMAT_RGB24, gray, 3);
+    assert(ok);
+    // avg(10, 30) = 20, avg(21, 255) = 138, avg(20, 138) = 79
+    assert(gray[0] == 79 && gray[1] == 79 && gray[2] == 79);
+}
+
+// All the implementations must produce exactly the same output
+static void test_bit_exact(void) {
+    static const enum sc_yuv2rgb_impl impls[] = {
+        SC_YUV2RGB_IMPL_SSE2,
+        SC_YUV2RGB_IMPL_SSSE3,
+        SC_YUV2RGB_IMPL_AVX2,
+        SC_YUV2RGB_IMPL_NEON,
+    };
+
+    // Odd sizes, to test the remaining pixels after the SIMD blocks
+    static const unsigned sizes[][2] = {
+        {1, 1}, {2, 2}, {15, 3}, {16, 4}, {33, 9}, {64, 8}, {97, 21},
+        {131, 17},
+    };
+
+    for (size_t s = 0; s < ARRAY_LEN(sizes); ++s) {
+        unsigned width = sizes[s][0];
+        unsigned height = sizes[s][1];
+
+        struct test_image ti;
+        test_image_init(&ti, width, height, s);
+
+        size_t size = (size_t) width * height * 4;
+        uint8_t *expected = malloc(size);
+        uint8_t *actual = malloc(size);
+        assert(expected && actual);
+
+        for (unsigned shift = 0; shift <= 2; ++shift) {
+            if (!(width >> shift) || !(height >> shift)) {
+                continue;
+            }
+
+            for (int m = 0; m < 4; ++m) {
+                ti.image.matrix = m & 1 ? SC_YUV_MATRIX_BT709
+                                        : SC_YUV_MATRIX_BT601;
+                ti.image.full_range = m & 2;
+
+                for (int f = 0; f < 4; ++f) {
+                    enum sc_rgb_format format = f;
+                    unsigned bpp = sc_rgb_format_get_bytes_per_pixel(format);
+                    ptrdiff_t linesize = (width >> shift) * bpp;
+                    size_t out_size = linesize * (height >> shift);
+
+                    bool ok =
+                        sc_yuv2rgb_convert_with(SC_YUV2RGB_IMPL_SCALAR,
+                                                &ti.image, shift, format,
+                                                expected, linesize);
+                    assert(ok);
+
+                    for (size_t i = 0; i < ARRAY_LEN(impls); ++i) {
+                        if (!sc_yuv2rgb_is_supported(impls[i])) {
+                            continue;
+                        }
+
+                        memset(actual, 0, size);
+                        ok = sc_yuv2rgb_convert_with(impls[i], &ti.image,
+                                                     shift, format, actual,
+                                                     linesize);
+                        assert(ok);
+                        assert(!memcmp(actual, expected, out_size));
+                    }
+                    (void) ok;
+                }
+            }
+        }
+
+        free(expected);
+        free(actual);
+        test_image_destroy(&ti);
+    }
+}
+
+static void test_negative_linesize(void) {
+    struct test_image ti;
+    test_image_init(&ti, 20, 4, 7);
+
+    uint8_t top_down[20 * 4 * 3];
+    uint8_t bottom_up[20 * 4 * 3];
+
+    bool ok = sc_yuv2rgb_convert(&ti.image, 0, SC_RGB_FORMAT_BGR24, top_down,
+                                 20 * 3);
+    assert(ok);
+    ok = sc_yuv2rgb_convert(&ti.image, 0, SC_RGB_FORMAT_BGR24,
+                            bottom_up + 3 * 20 * 3, -20 * 3);
+    assert(ok);
+    (void) ok;
+
+    for (unsigned y = 0; y < 4; ++y) {
+        assert(!memcmp(&top_down[y * 20 * 3], &bottom_up[(3 - y) * 20 * 3],
+                       20 * 3));
+    }
+
+    test_image_destroy(&ti);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_reference_values();
+    test_formats();
+    test_downscale();
+    test_bit_exact();
+    test_negative_linesize();
+
+    return 0;
+}